@@ -0,0 +1,266 @@
+// -------------------------------------------------------------------------
+//
+// PRODUCT:            DMA Driver
+// MODULE NAME:        DllBench.c
+//
+// MODULE DESCRIPTION:
+//
+// Calls per second of the synchronous PM40DriverDLL entry points on a
+// board: PacketSendEx on a send engine and Bar0Read.  Each call is timed
+// as a whole, DLL, IOCTL and driver, so the numbers show the per call
+// overhead an application sees.  Run it against two builds of the DLL to
+// compare them.
+//
+// $Revision:  $
+//
+// ------------------------- CONFIDENTIAL ----------------------------------
+//
+//              Copyright (c) 2017 by Northwest Logic, Inc.
+//                       All rights reserved.
+//
+// Trade Secret of Northwest Logic, Inc.  Do not disclose.
+//
+// Use of this source code in any form or means is permitted only
+// with a valid, written license agreement with Northwest Logic, Inc.
+//
+// Licensee shall keep all information contained herein confidential
+// and shall protect same in whole or in part from disclosure and
+// dissemination to all third parties.
+//
+//
+//                        Northwest Logic, Inc.
+//                  1100 NW Compton Drive, Suite 100
+//                      Beaverton, OR 97006, USA
+//
+//                        Ph:  +1 503 533 5800
+//                        Fax: +1 503 533 5900
+//                      E-Mail: info@nwlogic.com
+//                           www.nwlogic.com
+//
+// -------------------------------------------------------------------------
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DmaDriverDLL.h"
+
+// Calls between two reads of the performance counter
+#define BENCH_CLOCK_INTERVAL        64
+
+/*!
+ * \struct BENCH_CONFIG
+ * \brief Command line options.
+ */
+typedef struct _BENCH_CONFIG {
+    UINT32 Board;
+    INT32 EngineOffset;
+    UINT32 PacketSize;
+    UINT32 Seconds;
+    UINT32 BarOffset;
+    BOOLEAN MapWindow;              // Bar0Read through a MapBar window instead of the IOCTL
+    BOOLEAN RunSend;
+    BOOLEAN RunBar;
+} BENCH_CONFIG, * PBENCH_CONFIG;
+
+/*!
+ * \struct BENCH_RESULT
+ * \brief Counters collected by one run.
+ */
+typedef struct _BENCH_RESULT {
+    UINT64 Calls;
+    UINT64 Errors;
+    UINT32 FirstError;              // Status of the first failed call
+    double Seconds;
+} BENCH_RESULT, * PBENCH_RESULT;
+
+static void BenchUsage(const char * Name)
+{
+    printf("Usage: %s [-b board] [-e engine] [-s size] [-t seconds] [-a offset] [-m] [-o send|bar]\n", Name);
+    printf("  -b board    Board number (0)\n");
+    printf("  -e engine   Send DMA Engine offset for PacketSendEx (0)\n");
+    printf("  -s size     PacketSendEx packet size in bytes (64)\n");
+    printf("  -t seconds  Time per benchmark (5)\n");
+    printf("  -a offset   BAR 0 offset Bar0Read reads (0)\n");
+    printf("  -m          Map a BAR 0 window at the page of -a first, so Bar0Read\n");
+    printf("              is a load.  The window never covers the DMA Engine registers.\n");
+    printf("  -o op       Run only PacketSendEx (send) or Bar0Read (bar)\n");
+}
+
+static BOOLEAN BenchParse(int argc, char ** argv, PBENCH_CONFIG pConfig)
+{
+    int i;
+
+    memset(pConfig, 0, sizeof(BENCH_CONFIG));
+    pConfig->PacketSize = 64;
+    pConfig->Seconds = 5;
+    pConfig->RunSend = TRUE;
+    pConfig->RunBar = TRUE;
+
+    for (i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-m") == 0)) {
+            pConfig->MapWindow = TRUE;
+            continue;
+        }
+        if ((i + 1) >= argc) {
+            return FALSE;
+        }
+        if (strcmp(argv[i], "-b") == 0) {
+            pConfig->Board = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-e") == 0) {
+            pConfig->EngineOffset = strtol(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            pConfig->PacketSize = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            pConfig->Seconds = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-a") == 0) {
+            pConfig->BarOffset = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-o") == 0) {
+            i++;
+            pConfig->RunSend = (strcmp(argv[i], "send") == 0);
+            pConfig->RunBar = (strcmp(argv[i], "bar") == 0);
+        } else {
+            return FALSE;
+        }
+    }
+    return (pConfig->PacketSize != 0) && (pConfig->Seconds != 0) && (pConfig->RunSend || pConfig->RunBar);
+}
+
+static void BenchReport(const char * Name, PBENCH_RESULT pResult)
+{
+    double CallsPerSecond = (pResult->Seconds > 0.0) ? (pResult->Calls / pResult->Seconds) : 0.0;
+
+    printf("%-12s %12llu calls in %6.2f s  %10.0f calls/sec  %8.3f us/call",
+        Name, pResult->Calls, pResult->Seconds, CallsPerSecond, (CallsPerSecond > 0.0) ? (1000000.0 / CallsPerSecond) : 0.0);
+    if (pResult->Errors != 0) {
+        printf("  %llu errors, first status %u", pResult->Errors, pResult->FirstError);
+    }
+    printf("\n");
+}
+
+/*
+ * Call PacketSendEx back to back for Seconds.  Each call waits for its
+ * packet to complete, so this is the synchronous round trip.
+ */
+static void BenchPacketSend(PBENCH_CONFIG pConfig, PBENCH_RESULT pResult)
+{
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER Now;
+    LONGLONG Duration;
+    PUINT8 Buffer;
+    UINT32 status;
+    UINT32 i;
+
+    memset(pResult, 0, sizeof(BENCH_RESULT));
+    Buffer = (PUINT8) VirtualAlloc(NULL, pConfig->PacketSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (Buffer == NULL) {
+        printf("Failed to allocate a %u byte send buffer\n", pConfig->PacketSize);
+        return;
+    }
+    memset(Buffer, 0xA5, pConfig->PacketSize);
+
+    QueryPerformanceFrequency(&Frequency);
+    Duration = Frequency.QuadPart * pConfig->Seconds;
+    QueryPerformanceCounter(&Start);
+    do {
+        for (i = 0; i < BENCH_CLOCK_INTERVAL; i++) {
+            status = PacketSendEx(pConfig->Board, pConfig->EngineOffset, 0, 0, Buffer, pConfig->PacketSize);
+            if ((status != STATUS_SUCCESSFUL) && (pResult->Errors++ == 0)) {
+                pResult->FirstError = status;
+            }
+        }
+        pResult->Calls += BENCH_CLOCK_INTERVAL;
+        QueryPerformanceCounter(&Now);
+    } while ((Now.QuadPart - Start.QuadPart) < Duration);
+    pResult->Seconds = (double) (Now.QuadPart - Start.QuadPart) / (double) Frequency.QuadPart;
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+}
+
+/*
+ * Call Bar0Read back to back for Seconds.
+ */
+static void BenchBar0Read(PBENCH_CONFIG pConfig, PBENCH_RESULT pResult)
+{
+    LARGE_INTEGER Frequency;
+    LARGE_INTEGER Start;
+    LARGE_INTEGER Now;
+    LONGLONG Duration;
+    UINT32 Value;
+    UINT32 status;
+    UINT32 i;
+
+    memset(pResult, 0, sizeof(BENCH_RESULT));
+
+    QueryPerformanceFrequency(&Frequency);
+    Duration = Frequency.QuadPart * pConfig->Seconds;
+    QueryPerformanceCounter(&Start);
+    do {
+        for (i = 0; i < BENCH_CLOCK_INTERVAL; i++) {
+            status = Bar0Read(pConfig->BarOffset, &Value);
+            if ((status != STATUS_SUCCESSFUL) && (pResult->Errors++ == 0)) {
+                pResult->FirstError = status;
+            }
+        }
+        pResult->Calls += BENCH_CLOCK_INTERVAL;
+        QueryPerformanceCounter(&Now);
+    } while ((Now.QuadPart - Start.QuadPart) < Duration);
+    pResult->Seconds = (double) (Now.QuadPart - Start.QuadPart) / (double) Frequency.QuadPart;
+}
+
+int main(int argc, char ** argv)
+{
+    BENCH_CONFIG Config;
+    BENCH_RESULT Result;
+    DMA_INFO_STRUCT DmaInfo;
+    BOOLEAN Mapped = FALSE;
+    UINT32 status;
+
+    if (!BenchParse(argc, argv, &Config)) {
+        BenchUsage(argv[0]);
+        return 1;
+    }
+
+    memset(&DmaInfo, 0, sizeof(DmaInfo));
+    status = ConnectToBoard(Config.Board, &DmaInfo);
+    if (status != STATUS_SUCCESSFUL) {
+        printf("ConnectToBoard(%u) failed, status %u\n", Config.Board, status);
+        return 1;
+    }
+    printf("Board %u, DLL %d.%d.%d.%d, %d send / %d receive DMA Engines\n", Config.Board,
+        DmaInfo.DLLMajorVersion, DmaInfo.DLLMinorVersion, DmaInfo.DLLSubMinorVersion, DmaInfo.DLLBuildNumberVersion,
+        DmaInfo.PacketSendEngineCount, DmaInfo.PacketRecvEngineCount);
+
+    if (Config.RunSend) {
+        if (Config.EngineOffset < DmaInfo.PacketSendEngineCount) {
+            BenchPacketSend(&Config, &Result);
+            printf("%u byte packets on send engine offset %d\n", Config.PacketSize, Config.EngineOffset);
+            BenchReport("PacketSendEx", &Result);
+        } else {
+            printf("No send DMA Engine at offset %d, PacketSendEx skipped\n", Config.EngineOffset);
+        }
+    }
+
+    if (Config.RunBar) {
+        // Bar0Read only uses board 0
+        if (Config.MapWindow) {
+            status = MapBar(0, 0, Config.BarOffset & ~(UINT32) 0xFFF, 0, NULL);
+            if (status == STATUS_SUCCESSFUL) {
+                Mapped = TRUE;
+            } else {
+                printf("MapBar failed, status %u, Bar0Read goes through the IOCTL\n", status);
+            }
+        }
+        BenchBar0Read(&Config, &Result);
+        printf("BAR 0 offset 0x%x, %s\n", Config.BarOffset, Mapped ? "mapped window" : "IOCTL");
+        BenchReport("Bar0Read", &Result);
+        if (Mapped) {
+            UnmapBar(0, 0);
+        }
+    }
+
+    DisconnectFromBoard(Config.Board);
+    return 0;
+}
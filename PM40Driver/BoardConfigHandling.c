@@ -187,13 +187,21 @@ NTSTATUS GetDmaPerfNumbers(IN WDFDEVICE device, IN WDFREQUEST Request, IN size_t
                 pDmaStatStruct->HardwareTime = pDmaExt->HardwareTimeInLastSecond;
                 pDmaStatStruct->DriverTime = pDmaExt->DMAInactiveTime;
                 pDmaStatStruct->CompletedByteCount = pDmaExt->BytesInLastSecond;
-                if (DmaStatStructSize == sizeof(DMA_STAT_STRUCT)) {
+                // Callers built before PollTime was added pass the shorter structure
+                if (DmaStatStructSize >= FIELD_OFFSET(DMA_STAT_STRUCT, PollTime)) {
+                        // Latched once a second by the watchdog timer too
                         pDmaStatStruct->IntsPerSecond = pDmaExt->IntsInLastSecond;
                         pDmaStatStruct->DPCsPerSecond = pDmaExt->DPCsInLastSecond;
-                        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
-                        pDmaExt->IntsInLastSecond = 0;
-                        pDmaExt->DPCsInLastSecond = 0;
-                        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+                        if (DmaStatStructSize >= sizeof(DMA_STAT_STRUCT)) {
+                                LARGE_INTEGER Frequency;
+
+                                KeQueryPerformanceCounter(&Frequency);
+                                pDmaStatStruct->PollTime = (pDmaExt->PollTimeInLastSecond * 1000000000) / (UINT64) Frequency.QuadPart;
+                                pDmaStatStruct->InterruptTime = (pDmaExt->IntTimeInLastSecond * 1000000000) / (UINT64) Frequency.QuadPart;
+                                DmaStatStructSize = sizeof(DMA_STAT_STRUCT);
+                        } else {
+                                DmaStatStructSize = FIELD_OFFSET(DMA_STAT_STRUCT, PollTime);
+                        }
                 } else {
                         status = STATUS_INVALID_PARAMETER;
                 }
@@ -204,3 +212,197 @@ NTSTATUS GetDmaPerfNumbers(IN WDFDEVICE device, IN WDFREQUEST Request, IN size_t
         }
         return status;
 }
+
+/*! SetInterruptCoalescing
+ *
+ *     \brief SetInterruptCoalescing - This routine handles the
+ *   SET_INT_COALESCE_IOCTL IOCTL
+ *
+ *   Sets the InterruptControl register value of a DMA Engine and how many
+ *   packets complete per completion interrupt.  Completions that raise no
+ *   interrupt are polled every TimeoutUs.  On a C2S engine the count applies
+ *   to FIFO mode and counts descriptors.
+ *
+ *     \param device - The Device object - used to retreive the Device Extensions
+ *     \param Request - The I/O Request for the IOCTL call
+ *  \param pInfoSize - Pointer to the return size information
+ *
+ *  \return STATUS_SUCCESS if it works, an error if it fails.
+ */
+NTSTATUS SetInterruptCoalescing(IN WDFDEVICE device, IN WDFREQUEST Request, IN size_t * pInfoSize)
+{
+        NTSTATUS status;
+        PDEVICE_EXTENSION pDevExt = DMADriverGetDeviceContext(device);
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        PINT_COALESCE_STRUCT pCoalesce;
+        UINT32 PacketCount;
+        UINT32 TimeoutUs;
+
+        *pInfoSize = 0;
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(INT_COALESCE_STRUCT),    // Minimum size
+                                               (PVOID *) & pCoalesce,   // Buffer
+                                               NULL);
+        if (status != STATUS_SUCCESS) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- WdfRequestRetrieveInputBuffer failed 0x%x", status));
+                return status;
+        }
+        status = GetDMAEngineContext(pDevExt, pCoalesce->EngineNum, &pDmaExt);
+        if (status != STATUS_SUCCESS) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMA Engine number is invalid 0x%x", status));
+                return status;
+        }
+
+        PacketCount = (pCoalesce->PacketCount > 1) ? pCoalesce->PacketCount : 1;
+        TimeoutUs = (PacketCount > 1) ? pCoalesce->TimeoutUs : 0;
+        // A completion that does not interrupt needs the timer to be seen
+        if ((PacketCount > 1) && (TimeoutUs == 0)) {
+                return STATUS_INVALID_PARAMETER;
+        }
+        // Free run rings move their interrupt bit themselves
+        if ((PacketCount > 1) && pDmaExt->bFreeRun) {
+                return STATUS_INVALID_DEVICE_REQUEST;
+        }
+
+        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+        if (pCoalesce->InterruptMode != INT_COALESCE_KEEP_MODE) {
+                pDmaExt->InterruptControl = pCoalesce->InterruptMode;
+                if (!pDmaExt->bFreeRun) {
+                        pDmaExt->pDmaEng->InterruptControl = pDmaExt->InterruptControl;
+                }
+        }
+        // The S2C interrupt marking belongs to the submit side
+        WdfSpinLockAcquire(pDmaExt->SubmitSpinLock);
+        PacketRingSetIrqCount(&pDmaExt->Ring, PacketCount,
+                              (BOOLEAN) ((pDmaExt->DmaType == DMA_TYPE_PACKET_RECV) && (pDmaExt->PacketMode == PACKET_MODE_FIFO)));
+        WdfSpinLockRelease(pDmaExt->SubmitSpinLock);
+        pDmaExt->CoalesceTimeoutUs = TimeoutUs;
+        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+
+        if (TimeoutUs != 0) {
+                DMADriverCoalesceTimerStart(pDmaExt, TimeoutUs);
+        } else {
+                DMADriverCoalesceTimerStop(pDmaExt);
+        }
+        // Pick up anything that completed without an interrupt under the old setting
+        WdfDpcEnqueue(pDmaExt->CompletionDpc);
+
+        // Return the effective settings, METHOD_BUFFERED uses the same buffer
+        if (NT_SUCCESS(WdfRequestRetrieveOutputBuffer(Request, sizeof(INT_COALESCE_STRUCT), (PVOID *) & pCoalesce, NULL))) {
+                pCoalesce->InterruptMode = pDmaExt->InterruptControl;
+                pCoalesce->PacketCount = PacketCount;
+                pCoalesce->TimeoutUs = TimeoutUs;
+                pCoalesce->IntsPerSecond = pDmaExt->IntsInLastSecond;
+                *pInfoSize = sizeof(INT_COALESCE_STRUCT);
+        }
+        return STATUS_SUCCESS;
+}
+
+/*! SetPollMode
+ *
+ *     \brief SetPollMode - This routine handles the
+ *   SET_POLL_MODE_IOCTL IOCTL
+ *
+ *   In poll mode the ISR masks the engine interrupt and the DPC completes
+ *   at most Budget packets per pass.  While the ring has completed packets
+ *   a timer runs the next pass, at most POLL_MAX_PASSES_PER_SECOND a second.
+ *   The interrupt is enabled again after IdlePasses passes find the ring empty.
+ *
+ *     \param device - The Device object - used to retreive the Device Extensions
+ *     \param Request - The I/O Request for the IOCTL call
+ *  \param pInfoSize - Pointer to the return size information
+ *
+ *  \return STATUS_SUCCESS if it works, an error if it fails.
+ */
+NTSTATUS SetPollMode(IN WDFDEVICE device, IN WDFREQUEST Request, IN size_t * pInfoSize)
+{
+        NTSTATUS status;
+        PDEVICE_EXTENSION pDevExt = DMADriverGetDeviceContext(device);
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        PPOLL_MODE_STRUCT pPollMode;
+
+        *pInfoSize = 0;
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(POLL_MODE_STRUCT),       // Minimum size
+                                               (PVOID *) & pPollMode,   // Buffer
+                                               NULL);
+        if (status != STATUS_SUCCESS) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- WdfRequestRetrieveInputBuffer failed 0x%x", status));
+                return status;
+        }
+        status = GetDMAEngineContext(pDevExt, pPollMode->EngineNum, &pDmaExt);
+        if (status != STATUS_SUCCESS) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMA Engine number is invalid 0x%x", status));
+                return status;
+        }
+        // Receive engines only, the DPC polls FIFO mode rings
+        if (pDmaExt->DmaType != DMA_TYPE_PACKET_RECV) {
+                return STATUS_INVALID_DEVICE_REQUEST;
+        }
+
+        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+        pDmaExt->PollIdlePasses = (pPollMode->IdlePasses != 0) ? pPollMode->IdlePasses : 1;
+        pDmaExt->PollIdleCount = 0;
+        pDmaExt->PollBudget = pPollMode->Budget;
+        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+
+        // A pass re-enables the interrupt if poll mode was turned off while it was masked
+        WdfDpcEnqueue(pDmaExt->CompletionDpc);
+
+        // Return the effective settings, METHOD_BUFFERED uses the same buffer
+        if (NT_SUCCESS(WdfRequestRetrieveOutputBuffer(Request, sizeof(POLL_MODE_STRUCT), (PVOID *) & pPollMode, NULL))) {
+                pPollMode->Budget = pDmaExt->PollBudget;
+                pPollMode->IdlePasses = pDmaExt->PollIdlePasses;
+                *pInfoSize = sizeof(POLL_MODE_STRUCT);
+        }
+        return STATUS_SUCCESS;
+}
+
+/*! GetEngineAffinity
+ *
+ *     \brief GetEngineAffinity - This routine handles the
+ *   GET_ENGINE_AFFINITY_IOCTL IOCTL
+ *
+ *   Returns the processor and NUMA node placement of a DMA Engine, set
+ *   from the InterruptAffinity<n> registry values, so the application can
+ *   put its threads and data buffers on the same node.
+ *
+ *     \param device - The Device object - used to retreive the Device Extensions
+ *     \param Request - The I/O Request for the IOCTL call
+ *  \param pInfoSize - Pointer to the return size information
+ *
+ *  \return STATUS_SUCCESS if it works, an error if it fails.
+ */
+NTSTATUS GetEngineAffinity(IN WDFDEVICE device, IN WDFREQUEST Request, IN size_t * pInfoSize)
+{
+        NTSTATUS status;
+        PDEVICE_EXTENSION pDevExt = DMADriverGetDeviceContext(device);
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        PENGINE_AFFINITY_STRUCT pAffinity;
+        UINT32 EngineNum;
+
+        *pInfoSize = 0;
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(ENGINE_AFFINITY_STRUCT),  // Minimum size
+                                               (PVOID *) & pAffinity,   // Buffer
+                                               NULL);
+        if (status != STATUS_SUCCESS) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- WdfRequestRetrieveInputBuffer failed 0x%x", status));
+                return status;
+        }
+        EngineNum = pAffinity->EngineNum;
+        status = GetDMAEngineContext(pDevExt, EngineNum, &pDmaExt);
+        if (status != STATUS_SUCCESS) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMA Engine number is invalid 0x%x", status));
+                return status;
+        }
+
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(ENGINE_AFFINITY_STRUCT), (PVOID *) & pAffinity, NULL);
+        if (status != STATUS_SUCCESS) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- WdfRequestRetrieveOutputBuffer failed 0x%x", status));
+                return status;
+        }
+        pAffinity->EngineNum = EngineNum;
+        pAffinity->Affinity = pDmaExt->Affinity;
+        pAffinity->Processor = pDmaExt->DpcProcessor;
+        pAffinity->Node = pDmaExt->NumaNode;
+        *pInfoSize = sizeof(ENGINE_AFFINITY_STRUCT);
+        return STATUS_SUCCESS;
+}
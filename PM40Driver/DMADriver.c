@@ -130,6 +130,8 @@ NTSTATUS DMADriverEvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceIni
         PDEVICE_EXTENSION pDevExt = NULL;
         WDFDEVICE device;
         WDF_PNPPOWER_EVENT_CALLBACKS pnpPowerCallbacks;
+        WDF_FILEOBJECT_CONFIG fileConfig;
+        WDF_OBJECT_ATTRIBUTES fileAttributes;
 
         UNREFERENCED_PARAMETER(Driver);
 
@@ -159,6 +161,11 @@ NTSTATUS DMADriverEvtDeviceAdd(IN WDFDRIVER Driver, IN PWDFDEVICE_INIT DeviceIni
 
         WdfDeviceInitSetPnpPowerEventCallbacks(DeviceInit, &pnpPowerCallbacks);
 
+        // File object context and cleanup, the BAR windows a handle mapped go away with it
+        WDF_FILEOBJECT_CONFIG_INIT(&fileConfig, WDF_NO_EVENT_CALLBACK, WDF_NO_EVENT_CALLBACK, DMADriverEvtFileCleanup);
+        WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&fileAttributes, FILE_CONTEXT);
+        WdfDeviceInitSetFileObjectConfig(DeviceInit, &fileConfig, &fileAttributes);
+
         // Initialize FDO attributes
         WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, DEVICE_EXTENSION);
 
@@ -288,6 +295,9 @@ NTSTATUS DMADriverEvtDeviceReleaseHardware(WDFDEVICE Device, WDFCMRESLIST Resour
                 pDevExt->UsrIntSpinLock = 0;
         }
 
+        // Application windows point into the BARs, they go first
+        BarUnmapAll(pDevExt);
+
        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL MmUnmapIoSpace NumberOfBARS %d\n", pDevExt->NumberOfBARS));
         // Unmap anything mapped in DMADriverDevicePrepareHardware
         for (i = 0; i < pDevExt->NumberOfBARS; i++) {
@@ -329,6 +339,9 @@ NTSTATUS DMADriverEvtDeviceD0Entry(IN WDFDEVICE Device, IN WDF_POWER_DEVICE_STAT
 
         pDevExt = DMADriverGetDeviceContext(Device);
 
+        // The interrupts connect after this returns
+        DMADriverInterruptSetCommonIrql(pDevExt);
+
         // search for active dmaEngine
         for (i = 0; i < MAX_NUM_DMA_ENGINES; i++) {
                 pDmaExt = pDevExt->pDmaEngineDevExt[i];
@@ -170,6 +170,9 @@ PACKED DMA_COMMON_CONTROL_STRUCT, *PDMA_COMMON_CONTROL_STRUCT;
 #define CARD_MAX_READ_REQUEST_SIZE_MASK             0x7000
 #define CARD_S2C_INTERRUPT_STATUS_MASK              0x00FF0000
 #define CARD_C2S_INTERRUPT_STATUS_MASK              0xFF000000
+#define CARD_INTERRUPT_STATUS_SHIFT                 16      // S2C engine 0 status bit
+#define CARD_C2S_INTERRUPT_STATUS_INDEX             8       // C2S engine 0 status bit, from CARD_INTERRUPT_STATUS_SHIFT
+#define CARD_INTERRUPT_STATUS_ENGINES               16      // Engines with a status bit, 8 S2C then 8 C2S
 #define CARD_USER_INTERRUPT_MASK                    (CARD_USER_INTERRUPT_MODE|CARD_USER_INTERRUPT_ACTIVE)
 
 #define CARD_MAX_C2S_SIZE(x)                        (1UL << ((((x) >> 8) & 0xFF)+7))
@@ -303,24 +306,30 @@ PACKED DMA_ENGINE_STRUCT, *PDMA_ENGINE_STRUCT;
 // ---------------------------------------------------------------------
 //  Driver DMA Descriptor Ancillary data
 // ---------------------------------------------------------------------
+// The fields read on every submit and completion, 24 bytes so a cache line
+// holds more than two descriptors.  The HW descriptor and its physical
+// address follow from the index, see PacketRingHWDesc.
 typedef struct _DRIVER_DESC_STRUCT {
-    struct _DRIVER_DESC_STRUCT *pNextDesc;  // Driver usable pointer to the next descriptor
-    UINT32 DescriptorNumber;                // "Token" for this descriptor
+    UINT32 DescriptorNumber;                // "Token" for this descriptor, its index in the ring
     UINT32 DescFlags;                       // Flags for this decriptor
-    PDMA_DESCRIPTOR_STRUCT pHWDesc;         // Pointer to the associated HW DMA Descriptor
 #ifdef __WINNT__
-    PHYSICAL_ADDRESS pHWDescPhys;           // Physical address for the HW descriptor
-    PSCATTER_GATHER_LIST pScatterGatherList;// Pointer to the Scatter List for this set of descriptors
     PVOID *SystemAddressVirt;               // User address for the SystemAddress
     WDFDMATRANSACTION DmaTransaction;       // Contains the DMA Transaction associated to this descriptor
 #else
-    UINT32 pHWDescPhys;                     // Physical address for this descriptor
-                                            // struct scatterlist * pScatterGatherList;    // Pointer to the Scatter List for this set of descriptors
     PUINT8 SystemAddressVirt;               // User address for the SystemAddress
     PDMA_TRANSACTION_STRUCT pDmaTrans;      // Pointer to the DMA Transaction for this buffer
 #endif
 } DRIVER_DESC_STRUCT, *PDRIVER_DESC_STRUCT;
 
+// Setup and teardown only fields, in an array of their own next to the DRIVER_DESC_STRUCTs
+typedef struct _DRIVER_DESC_COLD_STRUCT {
+#ifdef __WINNT__
+    PSCATTER_GATHER_LIST pScatterGatherList;// Pointer to the Scatter List for this set of descriptors
+#else
+    PVOID pScatterGatherList;               // struct scatterlist * for this set of descriptors
+#endif
+} DRIVER_DESC_COLD_STRUCT, *PDRIVER_DESC_COLD_STRUCT;
+
 /*! \note
  * The Zero-sized array pragma only applies to DRIVER_DESC_STRUCT.
  * Here, the driver is setting the warning back to default.
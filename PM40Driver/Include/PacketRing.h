@@ -0,0 +1,259 @@
+// -------------------------------------------------------------------------
+//
+// PRODUCT:            DMA Driver
+// MODULE NAME:        PacketRing.h
+//
+// MODULE DESCRIPTION:
+//
+// OS neutral Packet DMA descriptor ring.  Contains the ring state, the
+// platform glue and the prototypes of the ring routines in PacketRing.c.
+//
+// $Revision:  $
+//
+// ------------------------- CONFIDENTIAL ----------------------------------
+//
+//              Copyright (c) 2017 by Northwest Logic, Inc.
+//                       All rights reserved.
+//
+// Trade Secret of Northwest Logic, Inc.  Do not disclose.
+//
+// Use of this source code in any form or means is permitted only
+// with a valid, written license agreement with Northwest Logic, Inc.
+//
+// Licensee shall keep all information contained herein confidential
+// and shall protect same in whole or in part from disclosure and
+// dissemination to all third parties.
+//
+//
+//                        Northwest Logic, Inc.
+//                  1100 NW Compton Drive, Suite 100
+//                      Beaverton, OR 97006, USA
+//
+//                        Ph:  +1 503 533 5800
+//                        Fax: +1 503 533 5900
+//                      E-Mail: info@nwlogic.com
+//                           www.nwlogic.com
+//
+// -------------------------------------------------------------------------
+
+//!
+// The ring routines only touch the DMA_DESCRIPTOR_STRUCT / DRIVER_DESC_STRUCT
+// arrays and the descriptor pointer registers of one engine.  Both arrays are
+// contiguous and a descriptor is addressed by its index, which is also the
+// receive token handed to applications.  The routines do no locking,
+// allocation or request handling, the caller holds the engine lock
+// (DmaSpinLock in the Windows driver) around every call.
+//
+// An S2C ring may instead be driven by one producer and one consumer with
+// separate locks.  S2C rings are a power of two and are addressed by free
+// running Head / Tail indices, occupancy is Head - Tail.  The producer
+// (PacketRingProgramS2C*, PacketRingSetIrqCount) owns Head, the interrupt
+// marking and the SoftwareDescriptorPtr, the consumer (PacketRingCompleteS2C)
+// owns Tail and the S2C accumulators.  Each side publishes its index once per
+// call, Tail only after the consumer is done with the descriptors it frees.
+// Initialization needs both locks.
+//
+// The SoftwareDescriptorPtr write is an uncached MMIO write, made once per
+// call, so a batch of sends or returns placed by one call costs one write.
+// A caller that knows where a burst of calls ends may set DoorbellBatch, the
+// S2C programming routines and PacketRingReturnDescriptors then leave the
+// pointer behind by up to DoorbellBatch - 1 packets and the caller moves it
+// with PacketRingFlushDoorbell at the end of the burst.  The driver's IOCTLs
+// are serialized and cannot see a burst, it leaves DoorbellBatch at 0.
+//
+// StdTypes.h, DmaDriverHw.h and DmaDriverIoctl.h must be included first.
+// Builds other than the Windows driver supply the PACKET_RING_SG_LIST glue
+// below from their PacketRingPlatform.h.
+
+#ifndef _PACKET_RING_H_
+#define _PACKET_RING_H_
+
+#ifdef __WINNT__                // Windows version ---------------------------------------------
+
+typedef WDFDMATRANSACTION PACKET_RING_COOKIE;   // Owner of the descriptors of an S2C packet
+typedef PHYSICAL_ADDRESS PACKET_RING_PHYS;
+typedef PACKET_RET_RECEIVE_STRUCT PACKET_RING_RECEIVE, *PPACKET_RING_RECEIVE;
+
+#define PACKET_RING_DESC_COOKIE(pDrvDesc)       ((pDrvDesc)->DmaTransaction)
+#define PACKET_RING_PHYS_LOW(Phys)              ((Phys).LowPart)
+#define PACKET_RING_PHYS_ADD(Phys, Bytes)       ((Phys).QuadPart += (Bytes))
+#define PACKET_RING_DESC_RESET(pDrvDesc)        ((pDrvDesc)->SystemAddressVirt = NULL, (pDrvDesc)->DmaTransaction = NULL)
+#define PACKET_RING_CACHE_ALIGN                 DECLSPEC_CACHEALIGN
+
+#define PACKET_RING_SG_LIST                     SCATTER_GATHER_LIST
+#define PACKET_RING_SG_COUNT(SgList)            ((SgList)->NumberOfElements)
+#define PACKET_RING_SG_ADDRESS(SgList, i)       ((SgList)->Elements[i].Address.QuadPart)
+#define PACKET_RING_SG_LENGTH(SgList, i)        ((SgList)->Elements[i].Length)
+
+#define PacketRingPublishIndex(p, Index)        InterlockedExchange((volatile LONG *)(p), (LONG)(Index))
+#define PacketRingReadIndex(p)                  ((UINT32) ReadAcquire((volatile LONG *)(p)))
+#define PacketRingPrint(...)                    KdPrintEx((1, DPFLTR_ERROR_LEVEL, __VA_ARGS__))
+
+#else                           // Linux / host version ---------------------------------------
+
+typedef PDMA_TRANSACTION_STRUCT PACKET_RING_COOKIE;
+typedef UINT32 PACKET_RING_PHYS;
+typedef PACKET_RECEIVE_STRUCT PACKET_RING_RECEIVE, *PPACKET_RING_RECEIVE;
+
+#define PACKET_RING_DESC_COOKIE(pDrvDesc)       ((pDrvDesc)->pDmaTrans)
+#define PACKET_RING_PHYS_LOW(Phys)              (Phys)
+#define PACKET_RING_PHYS_ADD(Phys, Bytes)       ((Phys) += (UINT32)(Bytes))
+#define PACKET_RING_DESC_RESET(pDrvDesc)        ((pDrvDesc)->SystemAddressVirt = NULL, (pDrvDesc)->pDmaTrans = NULL)
+
+#ifndef PACKET_RING_SG_LIST
+#error "PacketRingPlatform.h must define PACKET_RING_SG_LIST and its accessors"
+#endif                          // PACKET_RING_SG_LIST
+
+#ifndef PacketRingPublishIndex
+#define PacketRingPublishIndex(p, Index)        __atomic_store_n((p), (Index), __ATOMIC_RELEASE)
+#define PacketRingReadIndex(p)                  __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#endif                          // PacketRingPublishIndex
+#ifndef PacketRingPrint
+#define PacketRingPrint(...)                    ((void)0)
+#endif                          // PacketRingPrint
+#ifndef PACKET_RING_CACHE_ALIGN
+#define PACKET_RING_CACHE_ALIGN                 __attribute__((aligned(64)))
+#endif                          // PACKET_RING_CACHE_ALIGN
+
+#endif                          // Windows vs. Linux ------------------------------------------
+
+// Build with PACKET_RING_DESC_SSE2 defined to write descriptors as two 16 byte stores, see
+// PacketRingStoreDesc.  It pays where the descriptor memory is uncached or write combined, with
+// cached descriptors the store buffer merges the field stores anyway.  x64 kernel code may use
+// the XMM registers freely, AVX would need KeSaveExtendedProcessorState around every use.
+#if defined(PACKET_RING_DESC_SSE2) && !defined(_M_X64) && !defined(__SSE2__)
+#error "PACKET_RING_DESC_SSE2 needs SSE2, x64 builds only"
+#endif                          // PACKET_RING_DESC_SSE2
+
+typedef PACKET_RING_SG_LIST *PPACKET_RING_SG_LIST;
+
+// Ring return codes, PacketRingStatus() in the Windows driver maps them to NTSTATUS
+#define PACKET_RING_SUCCESS                     0
+#define PACKET_RING_INVALID_PARAMETER           (-1)    // Bad token or descriptor count
+#define PACKET_RING_INSUFFICIENT_RESOURCES      (-2)    // Not enough free descriptors
+#define PACKET_RING_UNSUCCESSFUL                (-3)    // Malformed packet at the head of the ring
+#define PACKET_RING_INTERNAL_ERROR              (-4)    // Ring overrun or ownership mismatch
+
+#define PACKET_RING_OK(Status)                  ((Status) >= 0)
+
+#ifdef __WINNT__
+#pragma warning(push)
+#pragma warning(disable:4324)   // Padded for PACKET_RING_CACHE_ALIGN
+#endif                          // __WINNT__
+
+/*!
+ * \struct PACKET_RING
+ * \brief Descriptor ring of one Packet DMA Engine.  The state written by
+ *  the S2C producer and by the consumer sit on cache lines of their own,
+ *  the ring must be allocated cache aligned.
+ */
+typedef struct _PACKET_RING {
+        // Set up with the ring, read only while it runs
+        PDMA_ENGINE_STRUCT pDmaEng;             // DMA Control registers of this engine
+        UINT32 NumberOfDescriptors;             // Descriptors allocated
+        UINT32 IndexMask;                       // S2C ring size - 1, set by PacketRingInitializeTx
+        UINT32 RingSize;                        // C2S descriptors linked into the ring
+        UINT32 IrqPacketCount;                  // Packets per completion interrupt, 0 or 1 for every packet, see PacketRingSetIrqCount
+        UINT32 DoorbellBatch;                   // Packets the SoftwareDescriptorPtr may be held back for, 0 or 1 for none
+        PDMA_DESCRIPTOR_STRUCT pHWDescriptorBase;
+        PACKET_RING_PHYS pHWDescriptorBasePhysical;
+        PDRIVER_DESC_STRUCT pDrvDescBase;       // Pointer to the base memory of the Driver Descs
+        PDRIVER_DESC_COLD_STRUCT pDrvDescCold;  // Setup / teardown fields of the same descriptors
+
+        // S2C producer side, see PacketRingS2CInUse
+        PACKET_RING_CACHE_ALIGN UINT32 Head;    // Descriptors placed on the ring, free running
+        UINT32 IrqPacketsPending;               // S2C packets programmed since the last one that interrupts
+        UINT32 DoorbellPending;                 // Packets placed (S2C) or returned (C2S) past the SoftwareDescriptorPtr
+
+        // Consumer side
+        PACKET_RING_CACHE_ALIGN volatile UINT32 Tail;   // S2C descriptors retired, free running
+
+        // S2C packet being completed, packets complete in order but may span DPCs
+        UINT32 S2CBytesTransferred;
+        UINT32 S2CPacketStatus;
+
+        // C2S ring position, indices into pDrvDescBase, see PacketRingNextIndex
+        UINT32 NextIndex;                       // Front of the queue, next descriptor to complete
+        UINT32 TailIndex;                       // Back of the queue, last descriptor given to the engine
+        UINT32 IrqIndex;                        // last descriptor in which IRQ bits were set to detect DMA overrun
+        LONG NumberOfUsedDescriptors;           // C2S: descriptors in the ring, S2C uses Head - Tail
+} PACKET_RING, *PPACKET_RING;
+
+#ifdef __WINNT__
+#pragma warning(pop)
+#endif                          // __WINNT__
+
+//! S2C descriptors in flight, exact for the producer and the consumer, a snapshot for anyone else
+#define PacketRingS2CInUse(pRing)               ((UINT32) ((pRing)->Head - (pRing)->Tail))
+
+// Descriptor Index of both arrays is found without loading anything, so a
+// walk does not wait on the previous descriptor.  C2S receive rings keep the
+// length the application's buffer gives them, so their indices wrap at
+// RingSize rather than by mask.
+#define PACKET_RING_NO_INDEX                    0xFFFFFFFF
+#define PacketRingDesc(pRing, Index)            (&(pRing)->pDrvDescBase[Index])
+#define PacketRingDescCold(pRing, Index)        (&(pRing)->pDrvDescCold[Index])
+#define PacketRingHWDesc(pRing, Index)          (&(pRing)->pHWDescriptorBase[Index])
+#define PacketRingHWDescPhys(pRing, Index)      \
+        (PACKET_RING_PHYS_LOW((pRing)->pHWDescriptorBasePhysical) + (UINT32) ((Index) * sizeof(DMA_DESCRIPTOR_STRUCT)))
+#define PacketRingNextIndex(pRing, Index)       ((((Index) + 1) == (pRing)->RingSize) ? 0 : ((Index) + 1))
+#define PacketRingPrevIndex(pRing, Index)       (((Index) == 0) ? ((pRing)->RingSize - 1) : ((Index) - 1))
+
+#ifdef PACKET_RING_DESC_SSE2
+#include <emmintrin.h>
+#endif                          // PACKET_RING_DESC_SSE2
+
+/*
+ * Writes a descriptor, S2C or C2S (User is UserControl or UserStatus).  With
+ * PACKET_RING_DESC_SSE2 the fields are put together in registers and stored
+ * as two 16 byte halves rather than five field stores, two of them straddling
+ * 8 byte boundaries.  NextDescriptorPhys must be the link the ring already
+ * has, only the vector stores rewrite it.
+ */
+static inline void PacketRingStoreDesc(PDMA_DESCRIPTOR_STRUCT pHWDesc, UINT32 StatusFlags, UINT64 User, UINT32 CardAddress,
+                                       UINT32 ControlFlags, UINT64 SystemAddressPhys, UINT32 NextDescriptorPhys)
+{
+#ifdef PACKET_RING_DESC_SSE2
+        // Each half is two quadwords, put together with shifts so no field is split into lanes
+        _mm_storeu_si128((__m128i *) pHWDesc,
+                         _mm_set_epi64x((INT64) ((User >> 32) | ((UINT64) CardAddress << 32)), (INT64) (StatusFlags | (User << 32))));
+        _mm_storeu_si128((__m128i *) pHWDesc + 1,
+                         _mm_set_epi64x((INT64) ((SystemAddressPhys >> 32) | ((UINT64) NextDescriptorPhys << 32)),
+                                        (INT64) (ControlFlags | (SystemAddressPhys << 32))));
+#else
+        pHWDesc->S2C.StatusFlags_BytesCompleted = StatusFlags;
+        pHWDesc->S2C.UserControl = User;
+        pHWDesc->S2C.CardAddress = CardAddress;
+        pHWDesc->S2C.ControlFlags_ByteCount = ControlFlags;
+        pHWDesc->S2C.SystemAddressPhys = SystemAddressPhys;
+        (void) NextDescriptorPhys;
+#endif                          // PACKET_RING_DESC_SSE2
+}
+
+//! Called by PacketRingCompleteS2C for every packet whose EOP descriptor has completed.
+typedef VOID(*PPACKET_RING_S2C_COMPLETE) (IN PVOID Context, IN PACKET_RING_COOKIE Cookie, IN UINT32 BytesTransferred, IN UINT32 PacketStatus);
+
+// PacketRing.c Prototypes
+UINT32 PacketRingSizeTx(IN UINT32 NumberDescriptors);
+INT32 PacketRingInitialize(IN PPACKET_RING pRing, IN UINT32 NumberDescriptors, IN UINT32 DescFlags);
+INT32 PacketRingInitializeTx(IN PPACKET_RING pRing);
+VOID PacketRingBeginRx(IN PPACKET_RING pRing);
+INT32 PacketRingAddRxDescriptor(IN PPACKET_RING pRing, IN UINT64 SystemAddressPhys, IN UINT32 Length, IN PVOID SystemAddressVirt, IN BOOLEAN bFreeRun);
+VOID PacketRingEndRx(IN PPACKET_RING pRing, IN BOOLEAN bFreeRun);
+VOID PacketRingSetIrqCount(IN PPACKET_RING pRing, IN UINT32 PacketCount, IN BOOLEAN bRx);
+INT32 PacketRingProgramS2C(IN PPACKET_RING pRing, IN PACKET_RING_COOKIE Cookie, IN UINT64 UserControl, IN UINT64 CardAddress, IN PPACKET_RING_SG_LIST SgList);
+INT32 PacketRingProgramS2CSends(IN PPACKET_RING pRing, IN PACKET_RING_COOKIE Cookie, IN PPACKET_RING_SG_LIST SgList,
+                                IN PPACKET_SEND_ENTRY_STRUCT pEntries, IN UINT32 NumEntries, OUT UINT32 * pNumProgrammed);
+INT32 PacketRingProgramS2CPoolPacket(IN PPACKET_RING pRing, IN PACKET_RING_COOKIE Cookie, IN UINT64 UserControl, IN PPACKET_RING_SG_LIST SgList,
+                                     IN UINT32 SGIndex, IN UINT32 SGOffset, IN UINT32 Length);
+UINT32 PacketRingCompleteS2C(IN PPACKET_RING pRing, IN PPACKET_RING_S2C_COMPLETE pfnComplete, IN PVOID Context);
+INT32 PacketRingProgramC2S(IN PPACKET_RING pRing, IN PACKET_RING_COOKIE Cookie, IN UINT64 CardAddress, IN PPACKET_RING_SG_LIST SgList);
+INT32 PacketRingCheckForCompletedPacket(IN PPACKET_RING pRing, OUT BOOLEAN * Completed);
+INT32 PacketRingCompleteReceivedPacket(IN PPACKET_RING pRing, IN PPACKET_RING_RECEIVE pRecvPacketRet);
+INT32 PacketRingReturnDescriptors(IN PPACKET_RING pRing, IN UINT32 ReturnToken);
+INT32 PacketRingReturnDescriptorsBatch(IN PPACKET_RING pRing, IN UINT32 * pTokens, IN UINT32 NumTokens, OUT UINT32 * pNumReturned);
+INT32 PacketRingReturnDescriptorsThrough(IN PPACKET_RING pRing, IN UINT32 LastToken, OUT UINT32 * pNumReturned);
+INT32 PacketRingProcessFreeRun(IN PPACKET_RING pRing, IN PPACKET_RECVS_STRUCT pPacketRecvs, IN BOOLEAN bAdvanceTail);
+VOID PacketRingFlushDoorbell(IN PPACKET_RING pRing, IN BOOLEAN bRx);
+
+#endif                          // _PACKET_RING_H_
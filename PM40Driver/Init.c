@@ -66,6 +66,8 @@ DECLARE_CONST_UNICODE_STRING(MSIXSupportedName, L"MSIXSupported");
 DECLARE_CONST_UNICODE_STRING(MSILimitName, L"MessageNumberLimit");
 DECLARE_CONST_UNICODE_STRING(InterruptModeName, L"InterruptMode");
 DECLARE_CONST_UNICODE_STRING(NumberDMADescName, L"NumberDMADescriptors");
+DECLARE_CONST_UNICODE_STRING(AllowBarMappingName, L"AllowBarMapping");
+#define INTERRUPT_AFFINITY_NAME_FORMAT  L"InterruptAffinity%u"
 
 // Local Prototypes
 NTSTATUS DmaDriverSetupQueues(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
@@ -74,6 +76,8 @@ NTSTATUS DmaDriverCreateDMAObjects(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_
 
 NTSTATUS DmaDriverCreateDMADescBuffers(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
 
+NTSTATUS DmaDriverCreateTransactionPool(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
+
 NTSTATUS DmaDriverSetupDPC(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
 
 NTSTATUS DMADriverScanPciResources(IN PDEVICE_EXTENSION pDevExt, IN WDFCMRESLIST ResourcesTranslated);
@@ -104,6 +108,8 @@ NTSTATUS DMADriverBoardDmaInit(PDEVICE_EXTENSION pDevExt)
         UINT8 dmaNum;
         PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
         WDF_DMA_DIRECTION dmaDirection;
+        GROUP_AFFINITY PreviousAffinity;
+        BOOLEAN bNodeAffinity;
 
        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL --> DMADriverBoardDmaInit\n"));
 
@@ -144,7 +150,7 @@ NTSTATUS DMADriverBoardDmaInit(PDEVICE_EXTENSION pDevExt)
                                         // If the DMA Engine Device extension has not been created
                                         if (pDevExt->pDmaEngineDevExt[dmaNum] == NULL) {
                                                 // create it
-                                                pDevExt->pDmaEngineDevExt[dmaNum] = (PDMA_ENGINE_DEVICE_EXTENSION) ExAllocatePoolWithTag(NonPagedPoolNx, sizeof(DMA_ENGINE_DEVICE_EXTENSION), 'amDP');
+                                                pDevExt->pDmaEngineDevExt[dmaNum] = (PDMA_ENGINE_DEVICE_EXTENSION) ExAllocatePoolWithTag(NonPagedPoolNxCacheAligned, sizeof(DMA_ENGINE_DEVICE_EXTENSION), 'amDP');
                                                 if (pDevExt->pDmaEngineDevExt[dmaNum] != NULL) {
                                                         pDmaExt = pDevExt->pDmaEngineDevExt[dmaNum];
                                                         pDevExt->pDmaExtMSIVector[pDevExt->NumberDMAEngines] = pDmaExt;
@@ -159,24 +165,53 @@ NTSTATUS DMADriverBoardDmaInit(PDEVICE_EXTENSION pDevExt)
                                                         pDmaExt->DmaEnabler32BitOnly = NULL;
                                                         pDmaExt->DmaRequest = NULL;
                                                         pDmaExt->DmaTransaction = NULL;
+                                                        InitializeSListHead(&pDmaExt->TransactionPool);
+                                                        pDmaExt->pTransactionPoolEntries = NULL;
+                                                        pDmaExt->TransactionPoolSize = 0;
+                                                        InitializeListHead(&pDmaExt->OutstandingRequests);
                                                         pDmaExt->DescCommonBuffer = NULL;
-                                                        pDmaExt->pHWDescriptorBasePhysical.QuadPart = 0;
-                                                        pDmaExt->pHWDescriptorBase = NULL;
+                                                        pDmaExt->Ring.pHWDescriptorBasePhysical.QuadPart = 0;
+                                                        pDmaExt->Ring.pHWDescriptorBase = NULL;
                                                         // Default to a single vector
                                                         pDmaExt->DMAEngineMSIVector = 0;
+                                                        pDmaExt->IrqStatusIndex = CARD_INTERRUPT_STATUS_NONE;
+                                                        // Same placement as the vector this engine gets
+                                                        DMADriverResolveAffinity(pDmaExt, pDevExt->VectorAffinity[pDevExt->NumberDMAEngines]);
 
                                                         // Packet Mode Specific variables
                                                         pDmaExt->PMdl = NULL;
                                                         pDmaExt->UserVa = NULL;
+                                                        pDmaExt->pReadDmaAdapter = NULL;
+                                                        pDmaExt->pWriteDmaAdapter = NULL;
+                                                        RtlZeroMemory(pDmaExt->SendPool, sizeof(pDmaExt->SendPool));
+                                                        RtlZeroMemory(&pDmaExt->CompRing, sizeof(pDmaExt->CompRing));
                                                         pDmaExt->DmaSpinLock = 0;
+                                                        pDmaExt->SubmitSpinLock = 0;
                                                         pDmaExt->PacketMode = DMA_MODE_NOT_SET;
                                                         pDmaExt->DMAEngineStatus = 0;
                                                         pDmaExt->bFreeRun = FALSE;
-
-                                                        pDmaExt->pDrvDescBase = NULL;
-                                                        pDmaExt->pNextDesc = NULL;
-                                                        pDmaExt->pTailDesc = NULL;
-                                                        pDmaExt->pIrqDesc = NULL;
+                                                        pDmaExt->InterruptControl = pDevExt->InterruptMode;
+                                                        pDmaExt->CoalesceTimeoutUs = 0;
+                                                        pDmaExt->PollBudget = 0;
+                                                        pDmaExt->PollIdlePasses = 1;
+                                                        pDmaExt->PollIdleCount = 0;
+                                                        pDmaExt->PollPassesInCurrentSecond = 0;
+                                                        pDmaExt->bIrqMasked = FALSE;
+                                                        pDmaExt->bPollPass = FALSE;
+                                                        pDmaExt->bPollParked = FALSE;
+
+                                                        pDmaExt->Ring.pDrvDescBase = NULL;
+                                                        pDmaExt->Ring.pDrvDescCold = NULL;
+                                                        pDmaExt->Ring.RingSize = 0;
+                                                        pDmaExt->Ring.NextIndex = 0;
+                                                        pDmaExt->Ring.TailIndex = 0;
+                                                        pDmaExt->Ring.IrqIndex = PACKET_RING_NO_INDEX;
+                                                        pDmaExt->Ring.IrqPacketCount = 0;
+                                                        pDmaExt->Ring.IrqPacketsPending = 0;
+                                                        // One SoftwareDescriptorPtr write per ring call, a
+                                                        // PACKET_SENDS or RETURN_RECEIVES batch is one call
+                                                        pDmaExt->Ring.DoorbellBatch = 0;
+                                                        pDmaExt->Ring.DoorbellPending = 0;
 
                                                         // initialize performance counters
                                                         pDmaExt->BytesInLastSecond = 0;
@@ -185,13 +220,20 @@ NTSTATUS DMADriverBoardDmaInit(PDEVICE_EXTENSION pDevExt)
                                                         pDmaExt->HardwareTimeInCurrentSecond = 0;
                                                         pDmaExt->DMAInactiveTime = 0;
                                                         pDmaExt->IntsInLastSecond = 0;
+                                                        pDmaExt->IntsInCurrentSecond = 0;
                                                         pDmaExt->DPCsInLastSecond = 0;
+                                                        pDmaExt->DPCsInCurrentSecond = 0;
+                                                        pDmaExt->PollTimeInLastSecond = 0;
+                                                        pDmaExt->PollTimeInCurrentSecond = 0;
+                                                        pDmaExt->IntTimeInLastSecond = 0;
+                                                        pDmaExt->IntTimeInCurrentSecond = 0;
 
                                                         // save the device direction
                                                         pDmaExt->DmaEngine = dmaNum;
                                                         pDmaExt->DmaDirection = dmaDirection;
                                                         // Setup the pointer to this DMA Engines registers
                                                         pDmaExt->pDmaEng = &pDevExt->pDmaRegisters->dmaEngine[dmaNum];
+                                                        pDmaExt->Ring.pDmaEng = pDmaExt->pDmaEng;
 
                                                         HardResetDMAEngine(pDmaExt);
 
@@ -207,8 +249,21 @@ NTSTATUS DMADriverBoardDmaInit(PDEVICE_EXTENSION pDevExt)
                                                                 // Go create the spnlocks and DMA Enabler objects
                                                                 status = DmaDriverCreateDMAObjects(pDevExt, pDmaExt);
                                                                 if (NT_SUCCESS(status)) {
-                                                                        // Go create the Common PCI DMA Descriptor buffers
+                                                                        // Go create the Common PCI DMA Descriptor buffers.
+                                                                        // Memory comes from the node of the processor we run on.
+                                                                        bNodeAffinity = FALSE;
+                                                                        if (pDmaExt->NumaNode != ENGINE_AFFINITY_ANY) {
+                                                                                GROUP_AFFINITY NodeAffinity;
+
+                                                                                if (DMADriverAffinityToGroup(ENGINE_AFFINITY_NODE_FLAG | pDmaExt->NumaNode, &NodeAffinity)) {
+                                                                                        KeSetSystemGroupAffinityThread(&NodeAffinity, &PreviousAffinity);
+                                                                                        bNodeAffinity = TRUE;
+                                                                                }
+                                                                        }
                                                                         status = DmaDriverCreateDMADescBuffers(pDevExt, pDmaExt);
+                                                                        if (bNodeAffinity) {
+                                                                                KeRevertToUserGroupAffinityThread(&PreviousAffinity);
+                                                                        }
                                                                         if (NT_SUCCESS(status)) {
                                                                                 // Go setup the DPC for this DMA Engine
                                                                                 status = DmaDriverSetupDPC(pDevExt, pDmaExt);
@@ -271,6 +326,10 @@ NTSTATUS DMADriverBoardDmaInit(PDEVICE_EXTENSION pDevExt)
                         }
                 }
         }
+        // Tell the ISR which engine each vector or status bit belongs to
+        if (status == STATUS_SUCCESS) {
+                DMADriverInterruptMapEngines(pDevExt);
+        }
         // Retireve the Card status and the FPGA Version information from the Card.
         if (status == STATUS_SUCCESS) {
                 pDevExt->BoardConfig.DMARegistersBAR = DMA_REG_BAR;
@@ -354,6 +413,9 @@ NTSTATUS DmaDriverCreateDMAObjects(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_
 		DMADriverLockInit(pDmaExt);
 
         status = WdfSpinLockCreate(WDF_NO_OBJECT_ATTRIBUTES, &pDmaExt->DmaSpinLock);
+        if (NT_SUCCESS(status)) {
+                status = WdfSpinLockCreate(WDF_NO_OBJECT_ATTRIBUTES, &pDmaExt->SubmitSpinLock);
+        }
         if (NT_SUCCESS(status)) {
                 pDmaExt->MaximumTransferLength = pDevExt->NumberOfDescriptors * PAGE_SIZE;
 
@@ -378,8 +440,12 @@ NTSTATUS DmaDriverCreateDMAObjects(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_
                         WdfDmaEnablerSetMaximumScatterGatherElements(pDmaExt->DmaEnabler, mapRegistersAllocated);
 
                         // Setup descriptor information used to be DMA_NUM_DESCR or the registry override
-                        pDmaExt->NumberOfDescriptors = mapRegistersAllocated;
-                        pDmaExt->NumberOfUsedDescriptors = 0;
+                        pDmaExt->Ring.NumberOfDescriptors = mapRegistersAllocated;
+                        if (pDmaExt->DmaDirection == WdfDmaDirectionWriteToDevice) {
+                                // S2C rings are indexed by mask, round up so the largest transfer still fits
+                                pDmaExt->Ring.NumberOfDescriptors = PacketRingSizeTx(mapRegistersAllocated);
+                        }
+                        pDmaExt->Ring.NumberOfUsedDescriptors = 0;
 
                        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL DMA Enabler Created, %d, MaxXferSize %d, mapRegistersAllocated = 0x%x\n", pDmaExt->DmaEngine, maxFragmentLengthSupported, mapRegistersAllocated));
 
@@ -416,43 +482,102 @@ NTSTATUS DmaDriverCreateDMADescBuffers(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENG
         UNREFERENCED_PARAMETER(pDevExt);
 
         // define the descriptor space
+        // The ring stays on small pages.  A common buffer cannot ask for large
+        // pages, and aligning it to one would take 2MB of contiguous memory
+        // below 4GB per engine for at most DMA_NUM_DESCR * 32 bytes (512KB).
+        // The rx pool pages the descriptors point at are the ones large pages
+        // help, see CalcRxDescLength.
         WDF_COMMON_BUFFER_CONFIG_INIT(&commonBufferConfig, DMA_DESCR_ALIGN_REQUIREMENT);
 
         // create it
         status = WdfCommonBufferCreateWithConfig(pDmaExt->DmaEnabler32BitOnly,
-                                                 (size_t) (sizeof(DMA_DESCRIPTOR_STRUCT) * pDmaExt->NumberOfDescriptors), &commonBufferConfig, WDF_NO_OBJECT_ATTRIBUTES, &pDmaExt->DescCommonBuffer);
+                                                 (size_t) (sizeof(DMA_DESCRIPTOR_STRUCT) * pDmaExt->Ring.NumberOfDescriptors), &commonBufferConfig, WDF_NO_OBJECT_ATTRIBUTES, &pDmaExt->DescCommonBuffer);
         if (NT_SUCCESS(status)) {
                 // initialize the structure
-                pDmaExt->pHWDescriptorBase = WdfCommonBufferGetAlignedVirtualAddress(pDmaExt->DescCommonBuffer);
-                pDmaExt->pHWDescriptorBasePhysical = WdfCommonBufferGetAlignedLogicalAddress(pDmaExt->DescCommonBuffer);
+                pDmaExt->Ring.pHWDescriptorBase = WdfCommonBufferGetAlignedVirtualAddress(pDmaExt->DescCommonBuffer);
+                pDmaExt->Ring.pHWDescriptorBasePhysical = WdfCommonBufferGetAlignedLogicalAddress(pDmaExt->DescCommonBuffer);
 #if defined(_AMD64_)
                 // This is a work-around for an error where the descriptor memory is allocated in
                 // above 4GB. The HW design requires the descriptors live in the first 4GB.
                 // If we set ScatterGatherDuplex then Windows restricts the number of Map registers
                 // to 256. We will take our chances with the allocate.
-                if (pDmaExt->pHWDescriptorBasePhysical.HighPart & 0xffffffff) {
-                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL ERROR: Descriptor Buffer Created in memory above 4GB (address:0x%p)\n", pDmaExt->pHWDescriptorBasePhysical));
+                if (pDmaExt->Ring.pHWDescriptorBasePhysical.HighPart & 0xffffffff) {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL ERROR: Descriptor Buffer Created in memory above 4GB (address:0x%p)\n", pDmaExt->Ring.pHWDescriptorBasePhysical));
                         DmaDriverBoardDmaRelease(pDevExt, pDmaExt->DmaEngine);
                         return STATUS_NO_MEMORY;
                 }
 #endif                          // defined(_AMD64_)||defined(_IA64_)
-                pDmaExt->pDrvDescBase = (PDRIVER_DESC_STRUCT) ExAllocatePoolWithTag(NonPagedPoolNx, sizeof(DRIVER_DESC_STRUCT) * pDmaExt->NumberOfDescriptors, 'pxDD');
-                if (pDmaExt->pDrvDescBase == NULL) {
+                pDmaExt->Ring.pDrvDescBase = (PDRIVER_DESC_STRUCT) ExAllocatePoolWithTag(NonPagedPoolNxCacheAligned, sizeof(DRIVER_DESC_STRUCT) * pDmaExt->Ring.NumberOfDescriptors, 'pxDD');
+                if (pDmaExt->Ring.pDrvDescBase == NULL) {
+                        return STATUS_INSUFFICIENT_RESOURCES;
+                }
+                pDmaExt->Ring.pDrvDescCold = (PDRIVER_DESC_COLD_STRUCT) ExAllocatePoolWithTag(NonPagedPoolNx, sizeof(DRIVER_DESC_COLD_STRUCT) * pDmaExt->Ring.NumberOfDescriptors, 'cxDD');
+                if (pDmaExt->Ring.pDrvDescCold == NULL) {
                         return STATUS_INSUFFICIENT_RESOURCES;
                 }
 
-                status = DMADriverIntiializeDMADescriptors(pDmaExt, pDmaExt->NumberOfDescriptors, 0);
+                status = DMADriverIntiializeDMADescriptors(pDmaExt, pDmaExt->Ring.NumberOfDescriptors, 0);
 
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL Descr Buffer Created, DmaEngine:%d, with %d Descriptor starting at address:0x%p\n", pDmaExt->DmaEngine, pDmaExt->NumberOfDescriptors, pDmaExt->pHWDescriptorBase));
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL Descr Buffer Created, DmaEngine:%d, with %d Descriptor starting at address:0x%p\n", pDmaExt->DmaEngine, pDmaExt->Ring.NumberOfDescriptors, pDmaExt->Ring.pHWDescriptorBase));
 
                 if (pDmaExt->DmaType == DMA_TYPE_PACKET_RECV) {
                         // For the Packet Recieve get the DMA Adapter handle
                         pDmaExt->pReadDmaAdapter = WdfDmaEnablerWdmGetDmaAdapter(pDmaExt->DmaEnabler, WdfDmaDirectionReadFromDevice);
+                } else {
+                        // For the Packet Send get the DMA Adapter handle used to map send pools
+                        pDmaExt->pWriteDmaAdapter = WdfDmaEnablerWdmGetDmaAdapter(pDmaExt->DmaEnabler, WdfDmaDirectionWriteToDevice);
+                }
+
+                if (NT_SUCCESS(status)) {
+                        status = DmaDriverCreateTransactionPool(pDmaExt);
                 }
         }
         return status;
 }
 
+/*! DmaDriverCreateTransactionPool
+ *
+ * \brief Creates the DMA Transactions used by the packet requests of this
+ *  DMA Engine.  Every packet holds at least one descriptor, so one
+ *  transaction per descriptor covers everything the ring can hold.
+ *  The transactions are taken with PacketGetTransaction, reinitialized for
+ *  each request and returned with PacketPutTransaction, so no transaction
+ *  object is created or deleted per packet.
+ * \param pDmaExt
+ * \return status
+ */
+NTSTATUS DmaDriverCreateTransactionPool(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
+{
+        NTSTATUS status = STATUS_SUCCESS;
+        WDF_OBJECT_ATTRIBUTES attributes;
+        PDMA_XFER_POOL_ENTRY pEntry;
+        UINT32 i;
+
+        pDmaExt->pTransactionPoolEntries = (PDMA_XFER_POOL_ENTRY) ExAllocatePoolWithTag(NonPagedPoolNx,
+                                                                                        sizeof(DMA_XFER_POOL_ENTRY) * pDmaExt->Ring.NumberOfDescriptors, 'lXDP');
+        if (pDmaExt->pTransactionPoolEntries == NULL) {
+                return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        RtlZeroMemory(pDmaExt->pTransactionPoolEntries, sizeof(DMA_XFER_POOL_ENTRY) * pDmaExt->Ring.NumberOfDescriptors);
+        pDmaExt->TransactionPoolSize = pDmaExt->Ring.NumberOfDescriptors;
+
+        WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, DMA_XFER);
+        for (i = 0; i < pDmaExt->TransactionPoolSize; i++) {
+                pEntry = &pDmaExt->pTransactionPoolEntries[i];
+                status = WdfDmaTransactionCreate(pDmaExt->DmaEnabler, &attributes, &pEntry->DmaTransaction);
+                if (!NT_SUCCESS(status)) {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL <-- WdfDmaTransactionCreate failed for DmaEngine[%d] 0x%x\n", pDmaExt->DmaEngine, status));
+                        pEntry->DmaTransaction = NULL;
+                        break;
+                }
+                DMAXferContext(pEntry->DmaTransaction)->Request = NULL;
+                DMAXferContext(pEntry->DmaTransaction)->pPoolEntry = pEntry;
+                InitializeListHead(&DMAXferContext(pEntry->DmaTransaction)->OutstandingEntry);
+                InterlockedPushEntrySList(&pDmaExt->TransactionPool, &pEntry->ListEntry);
+        }
+        return status;
+}
+
 /*! DMADriverSetupDPC
  *
  * \brief Sets up the WDF Driver DPC routine for this DMA Engine
@@ -493,6 +618,18 @@ NTSTATUS DmaDriverSetupDPC(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_E
                 // Keep a pointer to the Dma Device Extension
                 pDpcCtx = DPCContext(pDmaExt->CompletionDpc);
                 pDpcCtx->pDmaExt = pDmaExt;
+                // and the timer that runs it for coalesced completions
+                DMADriverCoalesceTimerInit(pDmaExt);
+                // Run both on the processor the engine is pinned to
+                if (pDmaExt->DpcProcessor != ENGINE_AFFINITY_ANY) {
+                        PROCESSOR_NUMBER ProcNumber;
+
+                        if (NT_SUCCESS(KeGetProcessorNumberFromIndex(pDmaExt->DpcProcessor, &ProcNumber))) {
+                                KeSetTargetProcessorDpcEx(WdfDpcWdmGetDpc(pDmaExt->CompletionDpc), &ProcNumber);
+                                KeSetTargetProcessorDpcEx(&pDmaExt->CoalesceDpc, &ProcNumber);
+                                KeSetTargetProcessorDpcEx(&pDmaExt->PollDpc, &ProcNumber);
+                        }
+                }
         } else {
                 // Create Queue Failed
                KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL <-- WdfDpcCreate failed for DmaEngine[%d] 0x%x\n", pDmaExt->DmaEngine, status));
@@ -561,26 +698,66 @@ NTSTATUS DmaDriverSetupUserIRQ(IN PDEVICE_EXTENSION pDevExt)
 NTSTATUS DmaDriverBoardDmaRelease(IN PDEVICE_EXTENSION pDevExt, IN UINT8 DmaEngNum)
 {
         PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        UINT32 i;
         NTSTATUS status = STATUS_SUCCESS;
 
         if (pDevExt->pDmaEngineDevExt[DmaEngNum] != NULL) {
                 pDmaExt = pDevExt->pDmaEngineDevExt[DmaEngNum];
 
+                // Stop polling for coalesced completions
+                if (pDmaExt->CoalesceTimeoutUs != 0) {
+                        DMADriverCoalesceTimerStop(pDmaExt);
+                        KeFlushQueuedDpcs();
+                }
+                // Stop the ISR dispatching to this engine
+                DMADriverInterruptUnmapEngine(pDevExt, pDmaExt);
+                // and the poll mode timer queuing the DPC
+                if (pDmaExt->PollBudget != 0) {
+                        pDmaExt->PollBudget = 0;
+                        DMADriverPollTimerStop(pDmaExt);
+                        KeFlushQueuedDpcs();
+                        WdfDpcCancel(pDmaExt->CompletionDpc, TRUE);
+                }
+                // Release any send pools the application left registered
+                for (i = 0; i < MAX_SEND_POOLS; i++) {
+                        if (pDmaExt->SendPool[i].pMdl != NULL) {
+                                FreeSendPool(pDmaExt, &pDmaExt->SendPool[i]);
+                        }
+                }
+                // and the completion ring
+                if (pDmaExt->CompRing.pMdl != NULL) {
+                        FreeCompRing(pDmaExt);
+                }
                 if (pDmaExt->DescCommonBuffer != NULL) {
                         // Free the Common Buffer
                         //
                         WdfObjectDelete(pDmaExt->DescCommonBuffer);
                         pDmaExt->DescCommonBuffer = NULL;
                 }
-                if (pDmaExt->pDrvDescBase != NULL) {
+                if (pDmaExt->Ring.pDrvDescBase != NULL) {
                         // Free the DMA Descriptor Software structure
-                        ExFreePoolWithTag(pDmaExt->pDrvDescBase, 'pxDD');
+                        ExFreePoolWithTag(pDmaExt->Ring.pDrvDescBase, 'pxDD');
+                }
+                if (pDmaExt->Ring.pDrvDescCold != NULL) {
+                        ExFreePoolWithTag(pDmaExt->Ring.pDrvDescCold, 'cxDD');
                 }
                 if (pDmaExt->DmaTransaction != NULL) {
                         // Free the Dma Transaction
                         WdfObjectDelete(pDmaExt->DmaTransaction);
                         pDmaExt->DmaTransaction = NULL;
                 }
+                if (pDmaExt->pTransactionPoolEntries != NULL) {
+                        // Free the pre-created Dma Transactions
+                        InitializeSListHead(&pDmaExt->TransactionPool);
+                        for (i = 0; i < pDmaExt->TransactionPoolSize; i++) {
+                                if (pDmaExt->pTransactionPoolEntries[i].DmaTransaction != NULL) {
+                                        WdfObjectDelete(pDmaExt->pTransactionPoolEntries[i].DmaTransaction);
+                                }
+                        }
+                        ExFreePoolWithTag(pDmaExt->pTransactionPoolEntries, 'lXDP');
+                        pDmaExt->pTransactionPoolEntries = NULL;
+                        pDmaExt->TransactionPoolSize = 0;
+                }
                 if (pDmaExt->DmaEnabler32BitOnly != NULL) {
                         // Free the Dma Enabler
                         WdfObjectDelete(pDmaExt->DmaEnabler32BitOnly);
@@ -596,6 +773,10 @@ NTSTATUS DmaDriverBoardDmaRelease(IN PDEVICE_EXTENSION pDevExt, IN UINT8 DmaEngN
                         WdfObjectDelete(pDmaExt->DmaSpinLock);
                         pDmaExt->DmaSpinLock = 0;
                 }
+                if (pDmaExt->SubmitSpinLock != 0) {
+                        WdfObjectDelete(pDmaExt->SubmitSpinLock);
+                        pDmaExt->SubmitSpinLock = 0;
+                }
                 // Adjust the number of dma engine(s)
                 if (pDmaExt->DmaDirection == WdfDmaDirectionWriteToDevice) {
                         // S2C DMA engine
@@ -626,6 +807,7 @@ NTSTATUS DMADriverInitializeDeviceExtension(PDEVICE_EXTENSION pDevExt)
 {
         NTSTATUS status = STATUS_SUCCESS;
         WDF_IO_QUEUE_CONFIG ioQueueConfig;
+        WDF_OBJECT_ATTRIBUTES queueAttributes;
         INT32 i;
 
         PAGED_CODE();
@@ -647,6 +829,12 @@ NTSTATUS DMADriverInitializeDeviceExtension(PDEVICE_EXTENSION pDevExt)
                 pDevExt->pDmaExtMSIVector[i] = NULL;
                 pDevExt->Interrupt[i] = NULL;
         }
+        pDevExt->bMsiDirect = FALSE;
+        pDevExt->NumIrqScanEngines = 0;
+        for (i = 0; i < MAX_NUM_DMA_ENGINES; i++) {
+                pDevExt->VectorAffinity[i] = ENGINE_AFFINITY_ANY;
+        }
+        RtlZeroMemory(pDevExt->pIrqStatusEngine, sizeof(pDevExt->pIrqStatusEngine));
 
         // Default to not supporting MSI/MSI-X Intterupt.
         pDevExt->MSISupported = FALSE;
@@ -665,6 +853,12 @@ NTSTATUS DMADriverInitializeDeviceExtension(PDEVICE_EXTENSION pDevExt)
 
         pDevExt->NumberOfDescriptors = DMA_NUM_DESCR;
 
+        // BAR mapping is off unless the registry turns it on
+        pDevExt->bAllowBarMapping = FALSE;
+        KeInitializeMutex(&pDevExt->BarMapMutex, 0);
+        InitializeListHead(&pDevExt->BarWindowFiles);
+        pDevExt->BarWindowCount = 0;
+
         // Check the registry for any initialization overrides
         DMADriverGetRegistryInfo(pDevExt);
 
@@ -685,6 +879,20 @@ NTSTATUS DMADriverInitializeDeviceExtension(PDEVICE_EXTENSION pDevExt)
                 return status;
         }
 
+        // DO_MEM_VECTOR_IOCTL Queue
+        // - One vector at a time, at PASSIVE_LEVEL and outside the device
+        //   synchronization lock so a MEM_OP_POLL can sleep
+        WDF_IO_QUEUE_CONFIG_INIT(&ioQueueConfig, WdfIoQueueDispatchSequential);
+        ioQueueConfig.EvtIoDeviceControl = DMADriverEvtIoMemVector;
+        WDF_OBJECT_ATTRIBUTES_INIT(&queueAttributes);
+        queueAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+        queueAttributes.SynchronizationScope = WdfSynchronizationScopeNone;
+        status = WdfIoQueueCreate(pDevExt->Device, &ioQueueConfig, &queueAttributes, &pDevExt->MemVectorQueue);
+        if (!NT_SUCCESS(status)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL <-- WdfIoQueueCreate failed for MemVectorQueue 0x%x\n", status));
+                return status;
+        }
+
         DMADriverGetRegHardwareInfo(pDevExt);
 
         // Setup the PCI Bus interface
@@ -1076,6 +1284,11 @@ NTSTATUS DMADriverGetRegistryInfo(PDEVICE_EXTENSION pDevExt)
         WDFKEY hKey;
         UINT32 InterruptMode;
         UINT32 NumberDMADescr;
+        UINT32 AllowBarMapping;
+        UINT32 Affinity;
+        UINT32 i;
+        WCHAR AffinityNameBuffer[32];
+        UNICODE_STRING AffinityName;
 
         // Open the Registry for our entry
         status = WdfDriverOpenParametersRegistryKey(WdfGetDriver(), STANDARD_RIGHTS_ALL, WDF_NO_OBJECT_ATTRIBUTES, &hKey);
@@ -1093,6 +1306,22 @@ NTSTATUS DMADriverGetRegistryInfo(PDEVICE_EXTENSION pDevExt)
                                KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL NumberDMADescr =  0x%x\n", pDevExt->NumberOfDescriptors));
                         }
                 }
+                // Let applications map BAR windows for direct register access
+                if (WdfRegistryQueryULong(hKey, &AllowBarMappingName, (PULONG) & AllowBarMapping) == STATUS_SUCCESS) {
+                        pDevExt->bAllowBarMapping = (AllowBarMapping != 0);
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL AllowBarMapping =  0x%x\n", AllowBarMapping));
+                }
+                // Get the processor / NUMA node of each interrupt vector
+                RtlInitEmptyUnicodeString(&AffinityName, AffinityNameBuffer, sizeof(AffinityNameBuffer));
+                for (i = 0; i < MAX_NUM_DMA_ENGINES; i++) {
+                        if (!NT_SUCCESS(RtlUnicodeStringPrintf(&AffinityName, INTERRUPT_AFFINITY_NAME_FORMAT, i))) {
+                                break;
+                        }
+                        if (WdfRegistryQueryULong(hKey, &AffinityName, (PULONG) & Affinity) == STATUS_SUCCESS) {
+                                pDevExt->VectorAffinity[i] = Affinity;
+                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL InterruptAffinity%u =  0x%x\n", i, Affinity));
+                        }
+                }
                 WdfRegistryClose(hKey);
         }
         else
@@ -63,16 +63,30 @@ static IoctlCode_Debug ioctls[] = {
     { .ioctlCode=GET_BOARD_CONFIG_IOCTL,    .ioctlName="GET_BOARD_CONFIG_IOCTL" },
     { .ioctlCode=DO_MEM_READ_ACCESS_IOCTL,  .ioctlName="DO_MEM_READ_ACCESS_IOCTL" },
     { .ioctlCode=DO_MEM_WRITE_ACCESS_IOCTL, .ioctlName="DO_MEM_WRITE_ACCESS_IOCTL" },
+    { .ioctlCode=DO_MEM_VECTOR_IOCTL,       .ioctlName="DO_MEM_VECTOR_IOCTL" },
     { .ioctlCode=GET_DMA_ENGINE_CAP_IOCTL,  .ioctlName="GET_DMA_ENGINE_CAP_IOCTL" },
     { .ioctlCode=GET_PERF_IOCTL,            .ioctlName="GET_PERF_IOCTL" },
     { .ioctlCode=RESET_DMA_ENGINE_IOCTL,    .ioctlName="RESET_DMA_ENGINE_IOCTL" },
     { .ioctlCode=WRITE_PCI_CONFIG_IOCTL,    .ioctlName="WRITE_PCI_CONFIG_IOCTL" },
     { .ioctlCode=READ_PCI_CONFIG_IOCTL,     .ioctlName="READ_PCI_CONFIG_IOCTL" },
+    { .ioctlCode=SET_INT_COALESCE_IOCTL,    .ioctlName="SET_INT_COALESCE_IOCTL" },
+    { .ioctlCode=SET_POLL_MODE_IOCTL,       .ioctlName="SET_POLL_MODE_IOCTL" },
+    { .ioctlCode=GET_ENGINE_AFFINITY_IOCTL, .ioctlName="GET_ENGINE_AFFINITY_IOCTL" },
+    { .ioctlCode=BAR_MAP_IOCTL,             .ioctlName="BAR_MAP_IOCTL" },
+    { .ioctlCode=BAR_UNMAP_IOCTL,           .ioctlName="BAR_UNMAP_IOCTL" },
     { .ioctlCode=PACKET_BUF_ALLOC_IOCTL,    .ioctlName="PACKET_BUF_ALLOC_IOCTL" },
     { .ioctlCode=PACKET_BUF_RELEASE_IOCTL,  .ioctlName="PACKET_BUF_RELEASE_IOCTL" },
     { .ioctlCode=PACKET_RECEIVE_IOCTL,      .ioctlName="PACKET_RECEIVE_IOCTL" },
     { .ioctlCode=PACKET_SEND_IOCTL,         .ioctlName="PACKET_SEND_IOCTL" },
     { .ioctlCode=PACKET_RECEIVES_IOCTL,     .ioctlName="PACKET_RECEIVES_IOCTL" },
+    { .ioctlCode=PACKET_SENDS_IOCTL,        .ioctlName="PACKET_SENDS_IOCTL" },
+    { .ioctlCode=PACKET_POOL_REGISTER_IOCTL, .ioctlName="PACKET_POOL_REGISTER_IOCTL" },
+    { .ioctlCode=PACKET_POOL_RELEASE_IOCTL, .ioctlName="PACKET_POOL_RELEASE_IOCTL" },
+    { .ioctlCode=PACKET_POOL_SEND_IOCTL,    .ioctlName="PACKET_POOL_SEND_IOCTL" },
+    { .ioctlCode=PACKET_COMP_RING_REGISTER_IOCTL, .ioctlName="PACKET_COMP_RING_REGISTER_IOCTL" },
+    { .ioctlCode=PACKET_COMP_RING_RELEASE_IOCTL, .ioctlName="PACKET_COMP_RING_RELEASE_IOCTL" },
+    { .ioctlCode=PACKET_COMP_RING_SYNC_IOCTL, .ioctlName="PACKET_COMP_RING_SYNC_IOCTL" },
+    { .ioctlCode=PACKET_RETURN_RECEIVES_IOCTL, .ioctlName="PACKET_RETURN_RECEIVES_IOCTL" },
     { .ioctlCode=PACKET_READ_IOCTL,         .ioctlName="PACKET_READ_IOCTL" },
     { .ioctlCode=PACKET_WRITE_IOCTL,        .ioctlName="PACKET_WRITE_IOCTL" },
     { .ioctlCode=USER_IRQ_WAIT_IOCTL,       .ioctlName="USER_IRQ_WAIT_IOCTL" },
@@ -143,9 +157,10 @@ VOID DMADriverEvtIoDeviceControl(IN WDFQUEUE Queue, IN WDFREQUEST Request, IN si
                                     status = GetDMAEngineContext(pDevExt, pRecvPacket->EngineNum, &pDmaExt);
                                     if (status == STATUS_SUCCESS) {
                                         status = STATUS_INVALID_DEVICE_REQUEST;
-                                        if (pDmaExt->DmaType == DMA_TYPE_PACKET_RECV) {
+                                        // Receives go through the completion ring once one is registered
+                                        if ((pDmaExt->DmaType == DMA_TYPE_PACKET_RECV) && (pDmaExt->CompRing.pMdl == NULL)) {
                                             if (pDmaExt->PacketMode == PACKET_MODE_FIFO) {
-                                                if (pRecvPacket->RxReleaseToken < (UINT32)pDmaExt->NumberOfUsedDescriptors) {
+                                                if (pRecvPacket->RxReleaseToken < (UINT32)pDmaExt->Ring.NumberOfUsedDescriptors) {
                                                     // Go do the return of a descriptor even if it is out of order
                                                     status = PacketProcessReturnedDescriptors(pDevExt, pDmaExt, pRecvPacket->RxReleaseToken);
                                                     if (status != STATUS_SUCCESS) {
@@ -172,13 +187,14 @@ VOID DMADriverEvtIoDeviceControl(IN WDFQUEUE Queue, IN WDFREQUEST Request, IN si
                                                             status = WdfRequestForwardToIoQueue(Request, pDmaExt->TransactionQueue);
                                                             WdfSpinLockRelease(pDmaExt->DmaSpinLock);
                                                             if (status == STATUS_SUCCESS) {
-                                                                status = PacketProcessCompletedReceives(pDevExt, pDmaExt);
+                                                                status = PacketProcessCompletedReceives(pDevExt, pDmaExt, NULL);
                                                                 completeRequest = FALSE;
                                                             }
                                                         } else {  // Non-blocking form of PacketReceive
                                                             status = PacketProcessCompletedReceiveNB(pDmaExt, Request);
                                                             completeRequest = FALSE;
                                                         }
+                                                        PacketPollResume(pDmaExt);
                                                     }
                                                 } else if (OutputBufferLength == 0) {
                                                     // This is a special case where the call was to return a buffer token only
@@ -273,7 +289,7 @@ VOID DMADriverEvtIoDeviceControl(IN WDFQUEUE Queue, IN WDFREQUEST Request, IN si
                                                                 status = GetDMAEngineContext(pDevExt, pPacketRecvs->EngineNum, &pDmaExt);
                                                                 if (status == STATUS_SUCCESS) {
                                                                         status = STATUS_INVALID_DEVICE_REQUEST;
-                                                                        if (pDmaExt->DmaType == DMA_TYPE_PACKET_RECV) {
+                                                                        if ((pDmaExt->DmaType == DMA_TYPE_PACKET_RECV) && (pDmaExt->CompRing.pMdl == NULL)) {
                                                                                 status = STATUS_INVALID_PARAMETER;
                                                                                 if (pDmaExt->UserVa) {
                                                                                    KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL PacketRecvs: DMA #%d, AvailEntries %d \n",
@@ -354,6 +370,157 @@ VOID DMADriverEvtIoDeviceControl(IN WDFQUEUE Queue, IN WDFREQUEST Request, IN si
                 }
                 break;
 
+        case PACKET_SENDS_IOCTL:
+                {
+                        PPACKET_SENDS_STRUCT pPacketSends;
+
+                        status = STATUS_INVALID_PARAMETER;
+                        if (OutputBufferLength >= sizeof(PACKET_SENDS_STRUCT)) {
+                                // Get the Output buffer, that has the packet entries and returns their status
+                                status = WdfRequestRetrieveOutputBuffer(Request, sizeof(PACKET_SENDS_STRUCT),   /* size */
+                                                                        (PVOID *) & pPacketSends,       /* buffer */
+                                                                        &bufferSize);
+                                if (status == STATUS_SUCCESS) {
+                                        status = STATUS_INVALID_PARAMETER;
+                                        if ((bufferSize >= sizeof(PACKET_SENDS_STRUCT)) && (pPacketSends != NULL)) {
+                                                // Range check and make sure we have a DMA Engine where we are asking
+                                                if ((pPacketSends->EngineNum < MAX_NUM_DMA_ENGINES) && (pDevExt->pDmaEngineDevExt[pPacketSends->EngineNum] != NULL)) {
+                                                        // Make sure we have a queue assigned
+                                                        status = STATUS_INVALID_DEVICE_REQUEST;
+                                                        if (pDevExt->pDmaEngineDevExt[pPacketSends->EngineNum]->DmaType == DMA_TYPE_PACKET_SEND) {
+                                                                KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL PacketSends: DMA #%d, AvailEntries %d \n",
+                                                                            pPacketSends->EngineNum, pPacketSends->AvailNumEntries));
+                                                                status = PacketStartSends(Request, pDevExt, pPacketSends, bufferSize);
+                                                                if (status == STATUS_SUCCESS) {
+                                                                        completeRequest = FALSE;
+                                                                }
+                                                        }
+                                                }
+                                                else {
+                                                   KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL %s: EngineNum (%u) > %u or DMA Engine context == NULL\n", ioctlCode(IoControlCode), pPacketSends->EngineNum, MAX_NUM_DMA_ENGINES));
+                                                }
+                                        }
+                                }
+                                else {
+                                   KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL %s: Could not retrieve output buffer\n", ioctlCode(IoControlCode)));
+                                }
+                        }
+                }
+                break;
+
+                // IOCtl for registering a locked send pool with the DMA Engine specified
+        case PACKET_POOL_REGISTER_IOCTL:
+                {
+                        status = PacketSendPoolRegister(pDevExt, Request, &infoSize);
+                }
+                break;
+
+                // IOCtl for releasing a registered send pool
+        case PACKET_POOL_RELEASE_IOCTL:
+                {
+                        status = PacketSendPoolRelease(pDevExt, Request);
+                }
+                break;
+
+                // IOCtl for giving the buffers of several FIFO receives back at once
+        case PACKET_RETURN_RECEIVES_IOCTL:
+                {
+                        PPACKET_RETURN_RECVS_STRUCT pReturnRecvs;
+
+                        status = STATUS_INVALID_PARAMETER;
+                        if (InputBufferLength >= sizeof(PACKET_RETURN_RECVS_STRUCT)) {
+                                // Get the buffer, the tokens are returned in place
+                                status = WdfRequestRetrieveInputBuffer(Request, sizeof(PACKET_RETURN_RECVS_STRUCT),     /* size */
+                                                                       (PVOID *) & pReturnRecvs,        /* buffer */
+                                                                       &bufferSize);
+                                if (status == STATUS_SUCCESS) {
+                                        status = STATUS_INVALID_PARAMETER;
+                                        // Make sure every token is inside the buffer
+                                        if ((pReturnRecvs != NULL) && (pReturnRecvs->NumTokens != 0) &&
+                                            (pReturnRecvs->NumTokens <= ((bufferSize - FIELD_OFFSET(PACKET_RETURN_RECVS_STRUCT, Tokens)) / sizeof(UINT32)))) {
+                                                if ((pReturnRecvs->EngineNum < MAX_NUM_DMA_ENGINES) && (pDevExt->pDmaEngineDevExt[pReturnRecvs->EngineNum] != NULL)) {
+                                                        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+                                                        status = GetDMAEngineContext(pDevExt, pReturnRecvs->EngineNum, &pDmaExt);
+                                                        if (status == STATUS_SUCCESS) {
+                                                                status = STATUS_INVALID_DEVICE_REQUEST;
+                                                                // The completion ring returns its own tokens
+                                                                if ((pDmaExt->DmaType == DMA_TYPE_PACKET_RECV) && (pDmaExt->PacketMode == PACKET_MODE_FIFO) &&
+                                                                    (pDmaExt->UserVa != NULL) && (pDmaExt->CompRing.pMdl == NULL)) {
+                                                                        status = PacketProcessReturnedDescriptorsBatch(pDmaExt, pReturnRecvs);
+                                                                        if (OutputBufferLength >= FIELD_OFFSET(PACKET_RETURN_RECVS_STRUCT, Tokens)) {
+                                                                                infoSize = FIELD_OFFSET(PACKET_RETURN_RECVS_STRUCT, Tokens);
+                                                                        }
+                                                                }
+                                                        }
+                                                }
+                                                else {
+                                                   KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL %s: EngineNum (%u) > %u or DMA Engine context == NULL\n", ioctlCode(IoControlCode), pReturnRecvs->EngineNum, MAX_NUM_DMA_ENGINES));
+                                                }
+                                        }
+                                }
+                                else {
+                                   KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL %s: Could not retrieve input buffer\n", ioctlCode(IoControlCode)));
+                                }
+                        }
+                }
+                break;
+
+                // IOCtl for registering a locked completion ring with the C2S DMA Engine specified
+        case PACKET_COMP_RING_REGISTER_IOCTL:
+                {
+                        status = PacketCompRingRegister(pDevExt, Request);
+                }
+                break;
+
+                // IOCtl for releasing the completion ring
+        case PACKET_COMP_RING_RELEASE_IOCTL:
+                {
+                        status = PacketCompRingRelease(pDevExt, Request);
+                }
+                break;
+
+                // IOCtl for updating the completion ring without waiting for an interrupt
+        case PACKET_COMP_RING_SYNC_IOCTL:
+                {
+                        status = PacketCompRingSync(pDevExt, Request);
+                }
+                break;
+
+        case PACKET_POOL_SEND_IOCTL:
+                {
+                        PPACKET_POOL_SEND_STRUCT pPoolSend;
+
+                        status = STATUS_INVALID_PARAMETER;
+                        if (InputBufferLength >= sizeof(PACKET_POOL_SEND_STRUCT)) {
+                                // Get the Input buffer, it names the pool and the packet within it
+                                status = WdfRequestRetrieveInputBuffer(Request, sizeof(PACKET_POOL_SEND_STRUCT),        /* size */
+                                                                       (PVOID *) & pPoolSend,   /* buffer */
+                                                                       &bufferSize);
+                                if (status == STATUS_SUCCESS) {
+                                        status = STATUS_INVALID_PARAMETER;
+                                        if ((bufferSize >= sizeof(PACKET_POOL_SEND_STRUCT)) && (pPoolSend != NULL)) {
+                                                // Range check and make sure we have a DMA Engine where we are asking
+                                                if ((pPoolSend->EngineNum < MAX_NUM_DMA_ENGINES) && (pDevExt->pDmaEngineDevExt[pPoolSend->EngineNum] != NULL)) {
+                                                        status = STATUS_INVALID_DEVICE_REQUEST;
+                                                        if (pDevExt->pDmaEngineDevExt[pPoolSend->EngineNum]->DmaType == DMA_TYPE_PACKET_SEND) {
+                                                                status = PacketStartPoolSend(Request, pDevExt, pPoolSend);
+                                                                if (status == STATUS_SUCCESS) {
+                                                                        completeRequest = FALSE;
+                                                                }
+                                                        }
+                                                }
+                                                else {
+                                                   KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL %s: EngineNum (%u) > %u or DMA Engine context == NULL\n", ioctlCode(IoControlCode), pPoolSend->EngineNum, MAX_NUM_DMA_ENGINES));
+                                                }
+                                        }
+                                }
+                                else {
+                                   KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL %s: Could not retrieve input buffer\n", ioctlCode(IoControlCode)));
+                                }
+                        }
+                }
+                break;
+
         case PACKET_WRITE_IOCTL:
                 {
                         PPACKET_WRITE_STRUCT pWritePacket;
@@ -505,6 +672,15 @@ VOID DMADriverEvtIoDeviceControl(IN WDFQUEUE Queue, IN WDFREQUEST Request, IN si
                 ReadWriteMemAccess(pDevExt, Request, dmaDirection);
                 break;
 
+        case DO_MEM_VECTOR_IOCTL:
+           KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL      DO_MEM_VECTOR_IOCTL, Forward to MemVectorQueue"));
+                // A MEM_OP_POLL may sleep, which it cannot do under the device synchronization lock
+                status = WdfRequestForwardToIoQueue(Request, pDevExt->MemVectorQueue);
+                if (NT_SUCCESS(status)) {
+                        completeRequest = FALSE;
+                }
+                break;
+
         case GET_BOARD_CONFIG_IOCTL:
                KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL      GET_BOARD_CONFIG_IOCTL, Process Now"));
                 status = GetBoardConfigDeviceControl(device, Request, &infoSize);
@@ -523,6 +699,18 @@ VOID DMADriverEvtIoDeviceControl(IN WDFQUEUE Queue, IN WDFREQUEST Request, IN si
                 status = GetDmaPerfNumbers(device, Request, &infoSize);
                 break;
 
+        case SET_INT_COALESCE_IOCTL:
+                status = SetInterruptCoalescing(device, Request, &infoSize);
+                break;
+
+        case SET_POLL_MODE_IOCTL:
+                status = SetPollMode(device, Request, &infoSize);
+                break;
+
+        case GET_ENGINE_AFFINITY_IOCTL:
+                status = GetEngineAffinity(device, Request, &infoSize);
+                break;
+
         case GET_DMA_ENGINE_CAP_IOCTL:
            KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL      GET_DMA_ENGINE_CAP_IOCTL, Process Now"));
                 status = GetDmaEngineCapabilities(device, Request, &infoSize);
@@ -598,57 +786,97 @@ INT32 GetDMAEngineContext(PDEVICE_EXTENSION pDevExt, UINT32 EngineNum, PDMA_ENGI
         return status;
 }
 
-/*! FindRequestByRequest
+/*! PacketTrackRequest
  *
- *     \brief Finds a queued request based on matching
- *    the Request that is passed in.
+ *     \brief Makes a request outstanding on a DMA Engine.  The request is
+ *    marked cancelable and its transfer is added to the tail of the engine's
+ *    OutstandingRequests list.  Packets complete in ring order, so
+ *    PacketRetireRequest normally unlinks the head of the list.
+ *    Called with DmaSpinLock held.
  *     \param pDmaExt - Pointer to the DMA Engine context
- *    \param Request - Request to comapre queued request to.
- *   \return WDFREQUEST if found, null otherwise.
+ *    \param pDmaXfer - Transfer context of the request's DMA Transaction
+ *    \param Request - Request to track
+ *   \return STATUS_SUCCESS, STATUS_CANCELLED if the request was already canceled
  */
-WDFREQUEST FindRequestByRequest(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN WDFREQUEST MatchReq)
+NTSTATUS PacketTrackRequest(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PDMA_XFER pDmaXfer, IN WDFREQUEST Request)
 {
-        WDFREQUEST prevTagRequest;
-        WDFREQUEST tagRequest;
-        WDFREQUEST compRequest;
         NTSTATUS status;
 
-        status = STATUS_INVALID_DEVICE_REQUEST;
-        compRequest = prevTagRequest = tagRequest = NULL;
-        do {
-                status = WdfIoQueueFindRequest(pDmaExt->TransactionQueue, prevTagRequest, NULL, NULL, &tagRequest);
-                if (prevTagRequest) {
-                        // WdfIoQueueFindRequest incremented the reference count of the 
-                        //  prevTagRequest object, so we decrement the count here.
-                        WdfObjectDereference(prevTagRequest);
-                }
-                if (status == STATUS_NO_MORE_ENTRIES) {
-                        break;
-                }
-                if (status == STATUS_NOT_FOUND) {
-                        // The prevTagRequest object is no longer in the queue.
-                        prevTagRequest = tagRequest = NULL;
+        status = WdfRequestMarkCancelableEx(Request, PacketRequestCancel);
+        if (NT_SUCCESS(status)) {
+                pDmaXfer->Request = Request;
+                InsertTailList(&pDmaExt->OutstandingRequests, &pDmaXfer->OutstandingEntry);
+        } else {
+                pDmaXfer->Request = NULL;
+        }
+        return status;
+}
+
+/*! PacketRetireRequest
+ *
+ *     \brief Takes the request of a transfer off the engine's
+ *    OutstandingRequests list so it can be completed.  Constant time, the
+ *    transfer holds its own list link.  Called with DmaSpinLock held.
+ *     \param pDmaExt - Pointer to the DMA Engine context
+ *    \param pDmaXfer - Transfer context of the request's DMA Transaction
+ *   \return WDFREQUEST to complete, NULL if the request was canceled,
+ *    PacketRequestCancel completes a canceled request.
+ */
+WDFREQUEST PacketRetireRequest(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PDMA_XFER pDmaXfer)
+{
+        WDFREQUEST Request = pDmaXfer->Request;
+
+        UNREFERENCED_PARAMETER(pDmaExt);
+
+        if (Request == NULL) {
+                return NULL;
+        }
+        pDmaXfer->Request = NULL;
+        RemoveEntryList(&pDmaXfer->OutstandingEntry);
+        InitializeListHead(&pDmaXfer->OutstandingEntry);
+        if (WdfRequestUnmarkCancelable(Request) == STATUS_CANCELLED) {
+                // PacketRequestCancel is running or about to, it will not find the transfer
+                return NULL;
+        }
+        return Request;
+}
+
+/*! PacketRequestCancel
+ *
+ *     \brief Cancels an outstanding packet request.  The packet stays on the
+ *    ring, its transfer is only detached from the request so its completion
+ *    has nothing to complete.  Cancellation is rare, so the engines'
+ *    OutstandingRequests lists are searched for the transfer.
+ *     \param Request - Request being canceled
+ *   \return none
+ */
+VOID PacketRequestCancel(IN WDFREQUEST Request)
+{
+        PDEVICE_EXTENSION pDevExt = DMADriverGetDeviceContext(WdfIoQueueGetDevice(WdfRequestGetIoQueue(Request)));
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        PLIST_ENTRY pEntry;
+        PDMA_XFER pDmaXfer;
+        UINT32 i;
+
+        for (i = 0; i < MAX_NUM_DMA_ENGINES; i++) {
+                pDmaExt = pDevExt->pDmaEngineDevExt[i];
+                if ((pDmaExt == NULL) || (pDmaExt->DmaSpinLock == 0)) {
                         continue;
                 }
-                if (!NT_SUCCESS(status)) {
-                        break;
-                }
-                if (tagRequest == MatchReq) {
-                        status = WdfIoQueueRetrieveFoundRequest(pDmaExt->TransactionQueue, tagRequest, &compRequest);
-                        // WdfIoQueueRetrieveFoundRequest incremented the reference count 
-                        // of the TagRequest object, so we decrement the count here.
-                        WdfObjectDereference(tagRequest);
-                        if (status == STATUS_NOT_FOUND) {
-                                // The TagRequest object is no longer in the queue. But other
-                                // requests might match our criteria, so we restart the search.
-                                prevTagRequest = tagRequest = NULL;
-                                continue;
+                WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+                for (pEntry = pDmaExt->OutstandingRequests.Flink; pEntry != &pDmaExt->OutstandingRequests; pEntry = pEntry->Flink) {
+                        pDmaXfer = CONTAINING_RECORD(pEntry, DMA_XFER, OutstandingEntry);
+                        if (pDmaXfer->Request == Request) {
+                                pDmaXfer->Request = NULL;
+                                RemoveEntryList(pEntry);
+                                InitializeListHead(pEntry);
+                                break;
                         }
-                        break;
                 }
-                prevTagRequest = tagRequest;
-        } while (TRUE);
-        return compRequest;
+                WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+        }
+       KdPrintEx((1, DPFLTR_WARNING_LEVEL, "PacketRequestCancel: request canceled"));
+        WdfRequestCompleteWithInformation(Request, STATUS_CANCELLED, 0);
 }
 
 /*! DMADriverIoInCallerContext - 
@@ -673,6 +901,7 @@ VOID DMADriverIoInCallerContext(WDFDEVICE Device, WDFREQUEST Request)
         size_t bufferSize = 0;
         PMDL pMdl = NULL;
         BOOLEAN MapAndLock = FALSE;
+        KPROCESSOR_MODE ProbeMode = KernelMode; // UserMode when BufferAddress comes from the application
         UINT8 DMAEngine = 0xFF;
         NTSTATUS status = STATUS_INVALID_DEVICE_REQUEST;
 
@@ -746,6 +975,72 @@ VOID DMADriverIoInCallerContext(WDFDEVICE Device, WDFREQUEST Request)
                                 }
                         }
                 }
+                // Check for PacketSends API Call.
+                else if (params.Parameters.DeviceIoControl.IoControlCode == PACKET_SENDS_IOCTL) {
+                        PPACKET_SENDS_STRUCT pPacketSends = (PPACKET_SENDS_STRUCT) pOutBuffer;
+
+                        status = STATUS_INVALID_PARAMETER;
+                        // Make sure the size is what we expect
+                        if (OutBufferLen >= sizeof(PACKET_SENDS_STRUCT)) {
+                                // Make sure it is a valid pointer
+                                if (pPacketSends != NULL) {
+#if defined(_AMD64_)
+                                        BufferAddress = (PVOID) pPacketSends->BufferAddress;
+#else                           // Assume 32 bit
+                                        // This keeps the compiler happy when /W4 is used.
+                                        BufferAddress = (PVOID) (UINT32) pPacketSends->BufferAddress;
+#endif                          // 32 vs. 64 bit
+                                        bufferSize = pPacketSends->Length;
+                                        DMAEngine = (UINT8) pPacketSends->EngineNum;
+                                        ProbeMode = UserMode;
+                                        MapAndLock = TRUE;
+                                }
+                        }
+                }
+                // Check for PacketRegisterSendPool API Call.
+                else if (params.Parameters.DeviceIoControl.IoControlCode == PACKET_POOL_REGISTER_IOCTL) {
+                        PSEND_POOL_STRUCT pSendPool = (PSEND_POOL_STRUCT) pInBuffer;
+
+                        status = STATUS_INVALID_PARAMETER;
+                        // Make sure the size is what we expect
+                        if (InBufferLen >= sizeof(SEND_POOL_STRUCT)) {
+                                // Make sure it is a valid pointer
+                                if ((pSendPool != NULL) && (pSendPool->Length != 0)) {
+#if defined(_AMD64_)
+                                        BufferAddress = (PVOID) pSendPool->BufferAddress;
+#else                           // Assume 32 bit
+                                        // This keeps the compiler happy when /W4 is used.
+                                        BufferAddress = (PVOID) (UINT32) pSendPool->BufferAddress;
+#endif                          // 32 vs. 64 bit
+                                        bufferSize = pSendPool->Length;
+                                        DMAEngine = (UINT8) pSendPool->EngineNum;
+                                        ProbeMode = UserMode;
+                                        MapAndLock = TRUE;
+                                }
+                        }
+                }
+                // Check for PacketRegisterCompletionRing API Call.
+                else if (params.Parameters.DeviceIoControl.IoControlCode == PACKET_COMP_RING_REGISTER_IOCTL) {
+                        PCOMP_RING_STRUCT pCompRingReg = (PCOMP_RING_STRUCT) pInBuffer;
+
+                        status = STATUS_INVALID_PARAMETER;
+                        // Make sure the size is what we expect
+                        if (InBufferLen >= sizeof(COMP_RING_STRUCT)) {
+                                // Make sure it is a valid pointer
+                                if ((pCompRingReg != NULL) && (pCompRingReg->Length != 0)) {
+#if defined(_AMD64_)
+                                        BufferAddress = (PVOID) pCompRingReg->BufferAddress;
+#else                           // Assume 32 bit
+                                        // This keeps the compiler happy when /W4 is used.
+                                        BufferAddress = (PVOID) (UINT32) pCompRingReg->BufferAddress;
+#endif                          // 32 vs. 64 bit
+                                        bufferSize = pCompRingReg->Length;
+                                        DMAEngine = (UINT8) pCompRingReg->EngineNum;
+                                        ProbeMode = UserMode;
+                                        MapAndLock = TRUE;
+                                }
+                        }
+                }
                 // Check for SetupPacketMode API Call.
                 else if (params.Parameters.DeviceIoControl.IoControlCode == PACKET_BUF_ALLOC_IOCTL) {
                         PBUF_ALLOC_STRUCT pBufAlloc = (PBUF_ALLOC_STRUCT) pInBuffer;
@@ -754,27 +1049,28 @@ VOID DMADriverIoInCallerContext(WDFDEVICE Device, WDFREQUEST Request)
                         if (pBufAlloc != NULL) {
                                 if ((pBufAlloc->EngineNum < MAX_NUM_DMA_ENGINES) && (pDevExt->pDmaEngineDevExt[pBufAlloc->EngineNum] != NULL)) {
                                         PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+                                        UINT32 PacketMode = pBufAlloc->AllocationMode & ~PACKET_ALLOC_FLAGS;
                                         status = GetDMAEngineContext(pDevExt, pBufAlloc->EngineNum, &pDmaExt);
                                         if (NT_SUCCESS(status)) {
                                                 // Now make sure there is a queue associated and it is a Packet Type Engine
                                                 if (pDmaExt->DmaType == DMA_TYPE_PACKET_RECV) {
                                                         // See if the Application did the allocate
-                                                        if ((pBufAlloc->AllocationMode == PACKET_MODE_FIFO) || (pBufAlloc->AllocationMode == PACKET_MODE_STREAMING)) {
+                                                        if ((PacketMode == PACKET_MODE_FIFO) || (PacketMode == PACKET_MODE_STREAMING)) {
                                                                 BufferAddress = pOutBuffer;
                                                                 bufferSize = OutBufferLen;
                                                                 DMAEngine = (UINT8) pBufAlloc->EngineNum;
                                                                 MapAndLock = TRUE;
-                                                                if (pBufAlloc->AllocationMode == PACKET_MODE_STREAMING) {
+                                                                if (PacketMode == PACKET_MODE_STREAMING) {
                                                                         pDmaExt->bFreeRun = TRUE;
                                                                 }
-                                                                pDmaExt->PacketMode = pBufAlloc->AllocationMode;
-                                                        } else if (pBufAlloc->AllocationMode == PACKET_MODE_ADDRESSABLE) {
+                                                                pDmaExt->PacketMode = PacketMode;
+                                                        } else if (PacketMode == PACKET_MODE_ADDRESSABLE) {
                                                                 if (pDmaExt->bAddressablePacketMode) {
-                                                                        if (pBufAlloc->NumberDescriptors > pDmaExt->NumberOfDescriptors) {
+                                                                        if (pBufAlloc->NumberDescriptors > pDmaExt->Ring.NumberOfDescriptors) {
                                                                            KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL Requesting more Descriptors than are available %ld\n", pBufAlloc->NumberDescriptors));
                                                                                 status = STATUS_INVALID_PARAMETER;
                                                                         } else {
-                                                                                pDmaExt->PacketMode = pBufAlloc->AllocationMode;
+                                                                                pDmaExt->PacketMode = PacketMode;
                                                                                 // Special case since we do not Map and lock for addressable mode.
                                                                                 status = WdfDeviceEnqueueRequest(Device, Request);
                                                                         }
@@ -795,6 +1091,19 @@ VOID DMADriverIoInCallerContext(WDFDEVICE Device, WDFREQUEST Request)
                                         status = STATUS_INVALID_PARAMETER;
                                 }
                         }
+                }
+                // Check for MapBar / UnmapBar API Calls, the window is mapped into (or out of)
+                // the calling process so they are completed here, in its context.
+                else if ((params.Parameters.DeviceIoControl.IoControlCode == BAR_MAP_IOCTL) ||
+                         (params.Parameters.DeviceIoControl.IoControlCode == BAR_UNMAP_IOCTL)) {
+                        bufferSize = 0;
+                        if (params.Parameters.DeviceIoControl.IoControlCode == BAR_MAP_IOCTL) {
+                                status = BarMapUser(pDevExt, Request, &bufferSize);
+                        } else {
+                                status = BarUnmapUser(pDevExt, Request);
+                        }
+                        WdfRequestCompleteWithInformation(Request, status, bufferSize);
+                        return;
                 } else {
                         // Not an DeviceIOControl we are trapping here...
                         status = WdfDeviceEnqueueRequest(Device, Request);
@@ -818,25 +1127,29 @@ VOID DMADriverIoInCallerContext(WDFDEVICE Device, WDFREQUEST Request)
                             // Allocate an MDL for locking down
                             pMdl = IoAllocateMdl(BufferAddress, (UINT32) bufferSize, FALSE, FALSE, NULL);
                             if (pMdl != NULL) {
-                                    //Needs to be put back in
-                                    //try {
-                                        MmProbeAndLockPages(pMdl, KernelMode, IoWriteAccess);
+                                    // An application address is probed as the application's, a bad one raises an exception
+                                    __try {
+                                        MmProbeAndLockPages(pMdl, ProbeMode, IoWriteAccess);
                                         reqContext->pMdl = pMdl;
                                         reqContext->pVA = BufferAddress;
                                         reqContext->Length = (UINT32)bufferSize;
                                         reqContext->DMAEngine = DMAEngine;
                                         status = STATUS_SUCCESS;
-                                        status = WdfDeviceEnqueueRequest(Device, Request);
-                                    //}
-                                    /*
-                                    except(EXCEPTION_EXECUTE_HANDLER) {
+                                    }
+                                    __except(EXCEPTION_EXECUTE_HANDLER) {
                                         status = GetExceptionCode();
                                         IoFreeMdl(pMdl);
                                        KdPrintEx((1, DPFLTR_ERROR_LEVEL,"DMADriverIoInCallerContext: Exception %lx locking buffer\n", status));
                                     }
-                                    */
+                                    if (NT_SUCCESS(status)) {
+                                        status = WdfDeviceEnqueueRequest(Device, Request);
+                                        if (!NT_SUCCESS(status)) {
+                                            FreeReqCtx(reqContext);
+                                        }
+                                    }
                              } else {
                                    KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL  DMADriverIoInCallerContext: MDL == NULL\n"));
+                                    status = STATUS_INSUFFICIENT_RESOURCES;
                              }
                         }
                 }
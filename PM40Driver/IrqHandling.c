@@ -41,6 +41,8 @@
 #include "IrqHandling.tmh"
 #endif                          // TRACE_ENABLED
 
+static VOID DMADriverInterruptSetAffinity(IN WDFINTERRUPT Interrupt, IN UINT32 Affinity);
+
 /*! DMADriverInterruptCreate
  *
  * \brief Create and Initialize the Interrupt object
@@ -57,6 +59,12 @@ NTSTATUS DMADriverInterruptCreate(IN PDEVICE_EXTENSION pDevExt)
        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL --> WdfInterruptCreate"));
         pDevExt->NumIRQVectors = 0;
 
+        // Each vector keeps its own interrupt lock so the ISRs of engines on
+        // different processors do not serialize.  Only the common status path
+        // takes IsrCommonLock, see DMADriverIsrCommonAcquire.
+        KeInitializeSpinLock(&pDevExt->IsrCommonLock);
+        pDevExt->IsrCommonIrql = PASSIVE_LEVEL;
+
         if (((pDevExt->MSIXSupported && (pDevExt->MSIXOverride == TRUE)) || ((pDevExt->MSISupported && (pDevExt->MSIOverride == TRUE)))) && (pDevExt->MSINumberVectors > 1)) {
 			KdPrintEx((1, DPFLTR_ERROR_LEVEL,"USL Setting up %u MSI vectors", pDevExt->MSINumberVectors));
 			if (pDevExt->MSINumberVectors > MAX_NUM_DMA_ENGINES) {
@@ -77,6 +85,7 @@ NTSTATUS DMADriverInterruptCreate(IN PDEVICE_EXTENSION pDevExt)
                                KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL <-- WdfInterruptCreate failed  0x%x", status));
                                 break;
                         }
+                        DMADriverInterruptSetAffinity(pDevExt->Interrupt[i], pDevExt->VectorAffinity[i]);
 
                         pDevExt->NumIRQVectors++;
                 }
@@ -106,6 +115,7 @@ NTSTATUS DMADriverInterruptCreate(IN PDEVICE_EXTENSION pDevExt)
                        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL <-- WdfInterruptCreate failed  0x%x", status));
                         return status;
                 }
+                DMADriverInterruptSetAffinity(pDevExt->Interrupt[0], pDevExt->VectorAffinity[0]);
                 pDevExt->NumIRQVectors++;
         }
 
@@ -117,10 +127,53 @@ NTSTATUS DMADriverInterruptCreate(IN PDEVICE_EXTENSION pDevExt)
 		return status;
 }
 
-static BOOLEAN CheckForUserInterrupt(PDEVICE_EXTENSION pDevExt, BOOLEAN IsOurInterrupt)
+/*! DMADriverInterruptSetCommonIrql
+ *
+ * \brief Record the highest DIRQL of the interrupt vectors.  MSI-X vectors
+ *  may be at different DIRQLs, IsrCommonLock is taken at this one so a
+ *  vector cannot interrupt a holder of the lock on its own processor.
+ *  Call once the interrupt resources are assigned, before they connect.
+ * \param pDevExt
+ * \return none
+ */
+VOID DMADriverInterruptSetCommonIrql(IN PDEVICE_EXTENSION pDevExt)
 {
+        WDF_INTERRUPT_INFO Info;
+        UINT32 i;
+
+        pDevExt->IsrCommonIrql = PASSIVE_LEVEL;
+        for (i = 0; i < pDevExt->NumIRQVectors; i++) {
+                WDF_INTERRUPT_INFO_INIT(&Info);
+                WdfInterruptGetInfo(pDevExt->Interrupt[i], &Info);
+                if (Info.Irql > pDevExt->IsrCommonIrql) {
+                        pDevExt->IsrCommonIrql = Info.Irql;
+                }
+        }
+}
 
-    if ((pDevExt->pDmaRegisters->commonControl.ControlStatus & CARD_USER_INTERRUPT_MASK) == CARD_USER_INTERRUPT_MASK) {
+static KIRQL DMADriverIsrCommonAcquire(PDEVICE_EXTENSION pDevExt)
+{
+    KIRQL Irql = (pDevExt->IsrCommonIrql > DISPATCH_LEVEL) ? pDevExt->IsrCommonIrql : DISPATCH_LEVEL;
+    KIRQL OldIrql = KeGetCurrentIrql();
+
+    // Raise from DISPATCH_LEVEL for the unmap, a vector at a lower DIRQL from the ISR
+    if (Irql > OldIrql) {
+        KeRaiseIrql(Irql, &OldIrql);
+    }
+    KeAcquireSpinLockAtDpcLevel(&pDevExt->IsrCommonLock);
+    return OldIrql;
+}
+
+static VOID DMADriverIsrCommonRelease(PDEVICE_EXTENSION pDevExt, KIRQL OldIrql)
+{
+    KeReleaseSpinLockFromDpcLevel(&pDevExt->IsrCommonLock);
+    KeLowerIrql(OldIrql);
+}
+
+static BOOLEAN CheckForUserInterrupt(PDEVICE_EXTENSION pDevExt, UINT32 ControlStatus, BOOLEAN IsOurInterrupt)
+{
+
+    if ((ControlStatus & CARD_USER_INTERRUPT_MASK) == CARD_USER_INTERRUPT_MASK) {
 
        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL user interrupt request %p", pDevExt->UsrIntRequest));
 
@@ -139,6 +192,26 @@ VOID DMADriverAckDmaInterrupt(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
     pDmaExt->pDmaEng->ControlStatus |= (COMMON_DMA_CTRL_IRQ_ACTIVE | COMMON_DMA_CTRL_IRQ_ENABLE | PACKET_DMA_CTRL_DMA_ENABLE);
 }
 
+VOID DMADriverMaskDmaInterrupt(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
+{
+    // Acknowledge interrupts for this DMA engine and leave them disabled
+    pDmaExt->pDmaEng->ControlStatus = (pDmaExt->pDmaEng->ControlStatus | COMMON_DMA_CTRL_IRQ_ACTIVE | PACKET_DMA_CTRL_DMA_ENABLE) & ~COMMON_DMA_CTRL_IRQ_ENABLE;
+}
+
+static VOID DMADriverDispatchInterrupt(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
+{
+    // Increment the Interrupt Count
+    pDmaExt->IntsInCurrentSecond++;
+
+    // In poll mode the DPC drains the ring with the interrupt masked
+    if (pDmaExt->PollBudget != 0) {
+        DMADriverMaskDmaInterrupt(pDmaExt);
+        pDmaExt->bIrqMasked = TRUE;
+    }
+
+    WdfDpcEnqueue(pDmaExt->CompletionDpc);
+}
+
 static BOOLEAN DMADriverHandleInterrupt(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
 {
     UINT32 Status;
@@ -147,11 +220,7 @@ static BOOLEAN DMADriverHandleInterrupt(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
 
 	if (Status == (COMMON_DMA_CTRL_IRQ_ACTIVE | COMMON_DMA_CTRL_IRQ_ENABLE)) {
  //      KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL Interrupt for DMA Channel %u, status %08x", pDmaExt->DmaEngine, pDmaExt->pDmaEng->Controlstatus));
-
-        // Increment the Interrupt Count
-        pDmaExt->IntsInLastSecond++;
-
-        WdfDpcEnqueue(pDmaExt->CompletionDpc);
+        DMADriverDispatchInterrupt(pDmaExt);
         return TRUE;
     }
 
@@ -161,6 +230,8 @@ static BOOLEAN DMADriverHandleInterrupt(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
 static BOOLEAN DMADriverHandleMsiInterrupt(PDEVICE_EXTENSION pDevExt, unsigned long MessageID)
 {
     PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+    KIRQL OldIrql;
+    BOOLEAN IsOurInterrupt;
 
     if (MessageID >= MAX_NUM_DMA_ENGINES) {
        KdPrintEx((1, DPFLTR_ERROR_LEVEL,"USL MessageID %u >= %u", MessageID, MAX_NUM_DMA_ENGINES));
@@ -174,10 +245,15 @@ static BOOLEAN DMADriverHandleMsiInterrupt(PDEVICE_EXTENSION pDevExt, unsigned l
            KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL Bogus MSI vector (%u), expected %u", MessageID, pDmaExt->DMAEngineMSIVector));
             return FALSE;
         }
-		return DMADriverHandleInterrupt(pDmaExt);
+        // The vector is the engine's own, no register read and no common lock needed
+        DMADriverDispatchInterrupt(pDmaExt);
+        return TRUE;
     }
     else {
-		return CheckForUserInterrupt(pDevExt, FALSE);
+        OldIrql = DMADriverIsrCommonAcquire(pDevExt);
+        IsOurInterrupt = CheckForUserInterrupt(pDevExt, pDevExt->pDmaRegisters->commonControl.ControlStatus, FALSE);
+        DMADriverIsrCommonRelease(pDevExt, OldIrql);
+        return IsOurInterrupt;
     }
 }
 
@@ -185,6 +261,10 @@ static BOOLEAN DMADriverHandleMsiInterrupt(PDEVICE_EXTENSION pDevExt, unsigned l
  *
  * \brief Interrupt Handler.
  *  Determine if this is our interrupt.  If so, save the status and schedule a DPC.
+ *  With a vector per DMA Engine the MessageID selects the engine.  On a
+ *  shared vector (INTx or too few MSI vectors) the common ControlStatus is
+ *  read once and only the engines whose status bit is set are checked, under
+ *  IsrCommonLock as several vectors may scan the same engines.
  * \param Interrupt
  * \param MessageID
  * \return IsOurInterrupt
@@ -192,31 +272,125 @@ static BOOLEAN DMADriverHandleMsiInterrupt(PDEVICE_EXTENSION pDevExt, unsigned l
 BOOLEAN DMADriverInterruptIsr(IN WDFINTERRUPT Interrupt, IN unsigned long MessageID)
 {
     PDEVICE_EXTENSION pDevExt;
-    UINT32 dmaEngine;
+    PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+    UINT32 ControlStatus;
+    ULONG Pending;
+    ULONG Index;
+    UINT32 i;
+    KIRQL OldIrql;
     BOOLEAN IsOurInterrupt = FALSE;
 
     // Get Device Extensions
     pDevExt = DMADriverGetDeviceContext(WdfInterruptGetDevice(Interrupt));
 
-    if (pDevExt->NumIRQVectors > 1) {
-//		return DMADriverHandleMsiInterrupt(pDevExt, MessageID);  //????****
-		DMADriverHandleMsiInterrupt(pDevExt, MessageID);
-	}
-    
-    // search for active dmaEngine
-    for (dmaEngine = 0; dmaEngine < MAX_NUM_DMA_ENGINES; dmaEngine++) {
-        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+    if (pDevExt->bMsiDirect) {
+        return DMADriverHandleMsiInterrupt(pDevExt, MessageID);
+    }
 
-        pDmaExt = pDevExt->pDmaEngineDevExt[dmaEngine];
-        if (pDmaExt != NULL) {
-            IsOurInterrupt = DMADriverHandleInterrupt(pDmaExt);
-            if (IsOurInterrupt == TRUE) {
-                break; 
-            }
+    OldIrql = DMADriverIsrCommonAcquire(pDevExt);
+    ControlStatus = pDevExt->pDmaRegisters->commonControl.ControlStatus;
+
+    // Engines flagged in the common S2C / C2S interrupt status
+    Pending = (ControlStatus & (CARD_S2C_INTERRUPT_STATUS_MASK | CARD_C2S_INTERRUPT_STATUS_MASK)) >> CARD_INTERRUPT_STATUS_SHIFT;
+    while (BitScanForward(&Index, Pending)) {
+        Pending &= Pending - 1;
+        pDmaExt = pDevExt->pIrqStatusEngine[Index];
+        if ((pDmaExt != NULL) && DMADriverHandleInterrupt(pDmaExt)) {
+            IsOurInterrupt = TRUE;
         }
     }
 
-    return CheckForUserInterrupt(pDevExt, IsOurInterrupt);
+    // Engines numbered past the status bits have to be read one by one
+    for (i = 0; i < pDevExt->NumIrqScanEngines; i++) {
+        if (DMADriverHandleInterrupt(pDevExt->pIrqScanEngine[i])) {
+            IsOurInterrupt = TRUE;
+        }
+    }
+
+    IsOurInterrupt = CheckForUserInterrupt(pDevExt, ControlStatus, IsOurInterrupt);
+    DMADriverIsrCommonRelease(pDevExt, OldIrql);
+    return IsOurInterrupt;
+}
+
+/*! DMADriverInterruptMapEngines
+ *
+ * \brief Build the ISR dispatch tables once the DMA Engines are found.
+ *  Engine n of a direction reports in bit n of the common S2C / C2S
+ *  interrupt status, engines numbered 8 and up are scanned instead.
+ * \param pDevExt
+ * \return none
+ */
+VOID DMADriverInterruptMapEngines(IN PDEVICE_EXTENSION pDevExt)
+{
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        UINT32 dmaNum;
+        UINT32 EngineNum;
+        UINT32 Index;
+
+        RtlZeroMemory(pDevExt->pIrqStatusEngine, sizeof(pDevExt->pIrqStatusEngine));
+        pDevExt->NumIrqScanEngines = 0;
+
+        for (dmaNum = 0; dmaNum < MAX_NUM_DMA_ENGINES; dmaNum++) {
+                pDmaExt = pDevExt->pDmaEngineDevExt[dmaNum];
+                if (pDmaExt == NULL) {
+                        continue;
+                }
+                EngineNum = DMA_CAP_ENGINE_NUMBER(pDevExt->pDmaRegisters->dmaEngine[dmaNum].Capabilities);
+                Index = EngineNum;
+                if (pDmaExt->DmaDirection == WdfDmaDirectionReadFromDevice) {
+                        Index += CARD_C2S_INTERRUPT_STATUS_INDEX;
+                }
+                if ((EngineNum < CARD_C2S_INTERRUPT_STATUS_INDEX) && (pDevExt->pIrqStatusEngine[Index] == NULL)) {
+                        pDmaExt->IrqStatusIndex = Index;
+                        pDevExt->pIrqStatusEngine[Index] = pDmaExt;
+                } else {
+                        pDmaExt->IrqStatusIndex = CARD_INTERRUPT_STATUS_NONE;
+                        pDevExt->pIrqScanEngine[pDevExt->NumIrqScanEngines++] = pDmaExt;
+                }
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL DMA Engine %u interrupt status bit %d\n", dmaNum, (INT32) pDmaExt->IrqStatusIndex));
+        }
+
+        // DMADriverBoardDmaInit gave every engine its own vector
+        pDevExt->bMsiDirect = (pDevExt->NumIRQVectors > 1) && (pDevExt->NumIRQVectors >= pDevExt->NumberDMAEngines);
+}
+
+/*! DMADriverInterruptUnmapEngine
+ *
+ * \brief Remove a DMA Engine that is being released from the ISR dispatch tables.
+ *  The shared tables are guarded by IsrCommonLock, the engine's own MSI
+ *  table entry by the lock of its vector, the only ISR that reads it.
+ * \param pDevExt
+ * \param pDmaExt
+ * \return none
+ */
+VOID DMADriverInterruptUnmapEngine(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
+{
+        WDFINTERRUPT Interrupt = pDevExt->Interrupt[pDmaExt->DMAEngineMSIVector];
+        KIRQL OldIrql;
+        UINT32 i;
+
+        if (Interrupt != NULL) {
+                WdfInterruptAcquireLock(Interrupt);
+        }
+        if (pDevExt->pDmaExtMSIVector[pDmaExt->DMAEngineMSIVector] == pDmaExt) {
+                pDevExt->pDmaExtMSIVector[pDmaExt->DMAEngineMSIVector] = NULL;
+        }
+        if (Interrupt != NULL) {
+                WdfInterruptReleaseLock(Interrupt);
+        }
+
+        OldIrql = DMADriverIsrCommonAcquire(pDevExt);
+        if (pDmaExt->IrqStatusIndex < CARD_INTERRUPT_STATUS_ENGINES) {
+                pDevExt->pIrqStatusEngine[pDmaExt->IrqStatusIndex] = NULL;
+                pDmaExt->IrqStatusIndex = CARD_INTERRUPT_STATUS_NONE;
+        }
+        for (i = 0; i < pDevExt->NumIrqScanEngines; i++) {
+                if (pDevExt->pIrqScanEngine[i] == pDmaExt) {
+                        pDevExt->pIrqScanEngine[i] = pDevExt->pIrqScanEngine[--pDevExt->NumIrqScanEngines];
+                        break;
+                }
+        }
+        DMADriverIsrCommonRelease(pDevExt, OldIrql);
 }
 
 BOOLEAN DMADriverInterruptUserIRQMSIIsr(IN WDFINTERRUPT Interrupt, IN unsigned long MessageID)
@@ -229,7 +403,7 @@ BOOLEAN DMADriverInterruptUserIRQMSIIsr(IN WDFINTERRUPT Interrupt, IN unsigned l
 
        KdPrintEx((1, DPFLTR_ERROR_LEVEL, ""));
 
-        return CheckForUserInterrupt(pDevExt, FALSE);
+        return CheckForUserInterrupt(pDevExt, pDevExt->pDmaRegisters->commonControl.ControlStatus, FALSE);
 }
 
 /*! DMADriverInterruptEnable
@@ -347,3 +521,225 @@ VOID UserIRQDpc(IN WDFDPC Dpc)
 }
 
 // End User Interrupt
+
+// Interrupt Coalescing Support
+static KDEFERRED_ROUTINE DMADriverCoalesceDpc;
+
+/*! DMADriverCoalesceDpc
+ *
+ * \brief Runs the engine's completion DPC for completions that were coalesced
+ *  and raised no interrupt.  The timer ticks for as long as coalescing is on;
+ *  the completion DPC is only queued when a tick finds work: S2C descriptors
+ *  in flight, or a completed descriptor at the head of the C2S ring.  The C2S
+ *  peek is a hint without DmaSpinLock, the completion DPC checks it again.
+ * \param Dpc
+ * \param context - DMA Engine context
+ * \return none
+ */
+static VOID DMADriverCoalesceDpc(IN PRKDPC Dpc, PVOID context, PVOID SystemArgument1, PVOID SystemArgument2)
+{
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt = context;
+
+        UNREFERENCED_PARAMETER(Dpc);
+        UNREFERENCED_PARAMETER(SystemArgument1);
+        UNREFERENCED_PARAMETER(SystemArgument2);
+
+        if (pDmaExt->DmaType == DMA_TYPE_PACKET_SEND) {
+                if (PacketRingS2CInUse(&pDmaExt->Ring) != 0) {
+                        WdfDpcEnqueue(pDmaExt->CompletionDpc);
+                }
+        } else if ((pDmaExt->PacketMode == PACKET_MODE_FIFO) && (pDmaExt->UserVa != NULL)) {
+                if (PacketRingHWDesc(&pDmaExt->Ring, pDmaExt->Ring.NextIndex)->C2S.StatusFlags_BytesCompleted &
+                    PACKET_DESC_C2S_STAT_COMPLETE) {
+                        WdfDpcEnqueue(pDmaExt->CompletionDpc);
+                }
+        }
+}
+
+/*! DMADriverCoalesceTimerInit
+ *
+ * \brief Initialize the coalescing and poll mode timers of a DMA Engine.  Do not start them.
+ * \param pDmaExt
+ * \return none
+ */
+VOID DMADriverCoalesceTimerInit(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
+{
+        KeInitializeDpc(&pDmaExt->CoalesceDpc, DMADriverCoalesceDpc, pDmaExt);
+        KeInitializeTimer(&pDmaExt->CoalesceTimer);
+        KeInitializeDpc(&pDmaExt->PollDpc, DMADriverPollDpc, pDmaExt);
+        KeInitializeTimer(&pDmaExt->PollTimer);
+}
+
+/*! DMADriverCoalesceTimerStart
+ *
+ * \brief Start (or restart) polling the engine every TimeoutUs.  The period
+ *  is rounded up to milliseconds and runs at the system timer resolution.
+ * \param pDmaExt
+ * \param TimeoutUs - Longest a coalesced completion waits, in microseconds
+ * \return none
+ */
+VOID DMADriverCoalesceTimerStart(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN UINT32 TimeoutUs)
+{
+        LARGE_INTEGER DueTime;
+
+        DueTime.QuadPart = TimeoutUs;
+        DueTime.QuadPart *= 10; /* 100 nsec intervals */
+        DueTime.QuadPart *= (-1); /* relative timeout */
+
+        KeSetTimerEx(&pDmaExt->CoalesceTimer, DueTime, (LONG) ((TimeoutUs + 999) / 1000), &pDmaExt->CoalesceDpc);
+}
+
+/*! DMADriverCoalesceTimerStop
+ *
+ * \brief Stop the coalescing timer, a DPC already queued may still run.
+ * \param pDmaExt
+ * \return none
+ */
+VOID DMADriverCoalesceTimerStop(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
+{
+        KeCancelTimer(&pDmaExt->CoalesceTimer);
+}
+
+// Poll Mode Support
+static KDEFERRED_ROUTINE DMADriverPollDpc;
+
+/*! DMADriverPollDpc
+ *
+ * \brief Runs the engine's completion DPC as a poll pass while the ISR
+ *  has the engine interrupt masked.
+ * \param Dpc
+ * \param context - DMA Engine context
+ * \return none
+ */
+static VOID DMADriverPollDpc(IN PRKDPC Dpc, PVOID context, PVOID SystemArgument1, PVOID SystemArgument2)
+{
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt = context;
+
+        UNREFERENCED_PARAMETER(Dpc);
+        UNREFERENCED_PARAMETER(SystemArgument1);
+        UNREFERENCED_PARAMETER(SystemArgument2);
+
+        pDmaExt->bPollPass = TRUE;
+        WdfDpcEnqueue(pDmaExt->CompletionDpc);
+}
+
+/*! DMADriverPollTimerStart
+ *
+ * \brief Queue the next poll pass POLL_PASS_INTERVAL_US from now.  The
+ *  timer is one shot, the completion DPC starts it again while the ring
+ *  has packets.  It runs at the system timer resolution.
+ * \param pDmaExt
+ * \return none
+ */
+VOID DMADriverPollTimerStart(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
+{
+        LARGE_INTEGER DueTime;
+
+        DueTime.QuadPart = POLL_PASS_INTERVAL_US;
+        DueTime.QuadPart *= 10; /* 100 nsec intervals */
+        DueTime.QuadPart *= (-1); /* relative timeout */
+
+        KeSetTimer(&pDmaExt->PollTimer, DueTime, &pDmaExt->PollDpc);
+}
+
+/*! DMADriverPollTimerStop
+ *
+ * \brief Stop the poll timer, a DPC already queued may still run.
+ * \param pDmaExt
+ * \return none
+ */
+VOID DMADriverPollTimerStop(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
+{
+        KeCancelTimer(&pDmaExt->PollTimer);
+}
+
+// Processor / NUMA Affinity Support
+/*! DMADriverAffinityToGroup
+ *
+ * \brief Convert an ENGINE_AFFINITY value to the processors it selects.
+ * \param Affinity - Processor index or ENGINE_AFFINITY_NODE_FLAG | node
+ * \param pGroupAffinity - Returned processor set
+ * \return TRUE if Affinity names an active processor or node
+ */
+BOOLEAN DMADriverAffinityToGroup(IN UINT32 Affinity, OUT PGROUP_AFFINITY pGroupAffinity)
+{
+        PROCESSOR_NUMBER ProcNumber;
+
+        RtlZeroMemory(pGroupAffinity, sizeof(GROUP_AFFINITY));
+        if (Affinity == ENGINE_AFFINITY_ANY) {
+                return FALSE;
+        }
+        if (Affinity & ENGINE_AFFINITY_NODE_FLAG) {
+                Affinity &= ~ENGINE_AFFINITY_NODE_FLAG;
+                if (Affinity > KeQueryHighestNodeNumber()) {
+                        return FALSE;
+                }
+                KeQueryNodeActiveAffinity((USHORT) Affinity, pGroupAffinity, NULL);
+        } else {
+                if (!NT_SUCCESS(KeGetProcessorNumberFromIndex(Affinity, &ProcNumber))) {
+                        return FALSE;
+                }
+                pGroupAffinity->Group = ProcNumber.Group;
+                pGroupAffinity->Mask = (KAFFINITY) 1 << ProcNumber.Number;
+        }
+        return (pGroupAffinity->Mask != 0);
+}
+
+/*! DMADriverResolveAffinity
+ *
+ * \brief Work out where a DMA Engine's DPCs run and its memory lives.
+ *  A processor affinity targets the DPCs at that processor and places the
+ *  memory on its node.  A node affinity only places the memory, the DPCs
+ *  run where the interrupt (steered to the node) was taken.
+ * \param pDmaExt
+ * \param Affinity - InterruptAffinity<n> setting of the engine's vector
+ * \return none
+ */
+VOID DMADriverResolveAffinity(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN UINT32 Affinity)
+{
+        GROUP_AFFINITY GroupAffinity;
+        PROCESSOR_NUMBER ProcNumber;
+        UCHAR Buffer[sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)];
+        PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pInfo = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX) Buffer;
+        ULONG Length = sizeof(Buffer);
+
+        pDmaExt->Affinity = Affinity;
+        pDmaExt->DpcProcessor = ENGINE_AFFINITY_ANY;
+        pDmaExt->NumaNode = ENGINE_AFFINITY_ANY;
+
+        if (!DMADriverAffinityToGroup(Affinity, &GroupAffinity)) {
+                return;
+        }
+        if (Affinity & ENGINE_AFFINITY_NODE_FLAG) {
+                pDmaExt->NumaNode = Affinity & ~ENGINE_AFFINITY_NODE_FLAG;
+                return;
+        }
+        pDmaExt->DpcProcessor = Affinity;
+        KeGetProcessorNumberFromIndex(Affinity, &ProcNumber);
+        if (NT_SUCCESS(KeQueryLogicalProcessorRelationship(&ProcNumber, RelationNumaNode, pInfo, &Length))) {
+                pDmaExt->NumaNode = pInfo->NumaNode.NodeNumber;
+        }
+}
+
+/*! DMADriverInterruptSetAffinity
+ *
+ * \brief Steer an MSI / MSI-X vector to the processor or node configured for it.
+ *  Must be called before the interrupt resources are assigned.
+ * \param Interrupt
+ * \param Affinity - InterruptAffinity<n> setting of the vector
+ * \return none
+ */
+static VOID DMADriverInterruptSetAffinity(IN WDFINTERRUPT Interrupt, IN UINT32 Affinity)
+{
+        WDF_INTERRUPT_EXTENDED_POLICY policy;
+        GROUP_AFFINITY GroupAffinity;
+
+        if (!DMADriverAffinityToGroup(Affinity, &GroupAffinity)) {
+                return;
+        }
+        WDF_INTERRUPT_EXTENDED_POLICY_INIT(&policy);
+        policy.Policy = WdfIrqPolicySpecifiedProcessors;
+        policy.Priority = WdfIrqPriorityUndefined;
+        policy.TargetProcessorSetAndGroup = GroupAffinity;
+        WdfInterruptSetExtendedPolicy(Interrupt, &policy);
+}
@@ -54,31 +54,63 @@ BOOLEAN PacketProgramS2CDmaCallback(IN WDFDMATRANSACTION DmaTransaction, IN WDFD
 
 BOOLEAN PacketProgramC2SDmaCallback(IN WDFDMATRANSACTION DmaTransaction, IN WDFDEVICE Device, IN WDFCONTEXT Context, IN WDF_DMA_DIRECTION Direction, IN PSCATTER_GATHER_LIST SgList);
 
-/*
- * Calculate how much of this buffer that a HW descriptor can handle.
+/*! PacketRingStatus
+ *
+ * \brief Maps a PacketRing.c return code to an NTSTATUS.
+ * \param RingStatus - PACKET_RING_xxx
+ * \return status
  */
-static inline UINT64 PacketProgramDescFrag(ULONG SGLength)
+NTSTATUS PacketRingStatus(IN INT32 RingStatus)
 {
-    return (SGLength > PACKET_DESC_BYTE_COUNT_MASK) ? PACKET_DESC_BYTE_COUNT_MASK : (UINT64)SGLength;
+        switch (RingStatus) {
+        case PACKET_RING_SUCCESS:
+                return STATUS_SUCCESS;
+        case PACKET_RING_INVALID_PARAMETER:
+                return STATUS_INVALID_PARAMETER;
+        case PACKET_RING_INSUFFICIENT_RESOURCES:
+                return STATUS_INSUFFICIENT_RESOURCES;
+        case PACKET_RING_UNSUCCESSFUL:
+                return STATUS_UNSUCCESSFUL;
+        default:
+                return STATUS_DRIVER_INTERNAL_ERROR;
+        }
 }
 
-/*
- * Count the number of descriptor fragments required for this S/G list.
+/*! PacketGetTransaction
+ *
+ * \brief Takes a DMA Transaction from the engine's pool of pre-created
+ *  transactions, see DmaDriverCreateTransactionPool.  Callers hold
+ *  DMADriverLock, so a transaction a failed program DMA callback gives
+ *  back is not reused before WdfDmaTransactionExecute returns.
+ * \param pDmaExt - DMA Engine Context
+ * \return The transaction or NULL if all of them are in use
  */
-static UINT32 PacketProgramCountDescFragments(PSCATTER_GATHER_LIST SgList)
+WDFDMATRANSACTION PacketGetTransaction(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
 {
-    ULONG SGLength;
-    ULONG i;
-    UINT32 SGFragments = 0;
-
-    for (i=0; i<SgList->NumberOfElements; i++) {
-        SGLength = SgList->Elements[i].Length;
-        while (SGLength) {
-            SGFragments++;
-            SGLength -= (ULONG)PacketProgramDescFrag(SGLength);
+        PSLIST_ENTRY pListEntry;
+
+        pListEntry = InterlockedPopEntrySList(&pDmaExt->TransactionPool);
+        if (pListEntry == NULL) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMA Transaction pool of DmaEngine[%d] is empty", pDmaExt->DmaEngine));
+                return NULL;
         }
-    }
-    return SGFragments;
+        return CONTAINING_RECORD(pListEntry, DMA_XFER_POOL_ENTRY, ListEntry)->DmaTransaction;
+}
+
+/*! PacketPutTransaction
+ *
+ * \brief Returns a DMA Transaction to the engine's pool.  A transaction
+ *  that was initialized must be released with WdfDmaTransactionRelease first.
+ * \param pDmaExt - DMA Engine Context
+ * \param DmaTransaction - Transaction taken with PacketGetTransaction
+ * \return none
+ */
+VOID PacketPutTransaction(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN WDFDMATRANSACTION DmaTransaction)
+{
+        PDMA_XFER pDmaXfer = DMAXferContext(DmaTransaction);
+
+        pDmaXfer->Request = NULL;
+        InterlockedPushEntrySList(&pDmaExt->TransactionPool, &pDmaXfer->pPoolEntry->ListEntry);
 }
 
 
@@ -103,7 +135,6 @@ NTSTATUS PacketStartSend(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN
         PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
         WDFDMATRANSACTION DmaTransaction;
         PDMA_XFER pDmaXfer;
-        WDF_OBJECT_ATTRIBUTES attributes;
         PREQUEST_CONTEXT reqContext = NULL;
 
         status = GetDMAEngineContext(pDevExt, pSendPacket->EngineNum, &pDmaExt);
@@ -125,12 +156,11 @@ NTSTATUS PacketStartSend(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN
         DMADriverLock(pDmaExt);
 
         if ((UINT64) reqContext->Length >= pSendPacket->Length) {
-                // Create a DMA Transaction object just for this transfer
-                WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, DMA_XFER);
-                status = WdfDmaTransactionCreate(pDmaExt->DmaEnabler, &attributes, &DmaTransaction);
+                // Take a pre-created DMA Transaction object for this transfer
+                DmaTransaction = PacketGetTransaction(pDmaExt);
 
                 // if no errors kick off the DMA, first save a pointer to the request.
-                if (NT_SUCCESS(status)) {
+                if (DmaTransaction != NULL) {
                         // Keep a pointer the Request and the accumulated byte count in the Transaction
                         pDmaXfer = DMAXferContext(DmaTransaction);
                         pDmaXfer->Request = Request;
@@ -140,6 +170,8 @@ NTSTATUS PacketStartSend(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN
                         pDmaXfer->Mode = 0;
                         pDmaXfer->PacketStatus = 0;
                         pDmaXfer->pMdl = reqContext->pMdl;
+                        pDmaXfer->pPacketSends = NULL;
+                        pDmaXfer->pSendPool = NULL;
 
                        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "    Calling WdfDmaTransactionInitialize, Length %d, MdlLength %d", (UINT32) pSendPacket->Length, reqContext->Length));
 
@@ -147,34 +179,39 @@ NTSTATUS PacketStartSend(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN
                                                              (PFN_WDF_PROGRAM_DMA) PacketProgramS2CDmaCallback, pDmaExt->DmaDirection, reqContext->pMdl, reqContext->pVA, (size_t) pSendPacket->Length);
 
                         if (NT_SUCCESS(status)) {
-                                // Put the request on a WDF maintained Queue in case it gets canceled before we complete it
+                                // Track the request on the engine, cancelable until it completes
                                 WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
-                                status = WdfRequestForwardToIoQueue(Request, pDmaExt->TransactionQueue);
+                                status = PacketTrackRequest(pDmaExt, pDmaXfer, Request);
                                 WdfSpinLockRelease(pDmaExt->DmaSpinLock);
                                 if (NT_SUCCESS(status)) {
                                         // start the DMA, via PacketProgramDmaCallback
                                         status = WdfDmaTransactionExecute(DmaTransaction, pDmaExt);
                                         if (!NT_SUCCESS(status)) {
                                                KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketStartSend failed 0x%x", status));
-                                                // Make sure we get the Request off the queue.
+                                                // Make sure we get the Request off the outstanding list
                                                 WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
-                                                FindRequestByRequest(pDmaExt, Request);
+                                                if (PacketRetireRequest(pDmaExt, pDmaXfer) == NULL) {
+                                                        // Canceled meanwhile, PacketRequestCancel completes it
+                                                        status = STATUS_SUCCESS;
+                                                }
                                                 WdfSpinLockRelease(pDmaExt->DmaSpinLock);
                                                 FreeReqCtx(reqContext);
-                                                WdfObjectDelete(DmaTransaction);
+                                                WdfDmaTransactionRelease(DmaTransaction);
+                                                PacketPutTransaction(pDmaExt, DmaTransaction);
                                         }
                                 } else {
-                                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfRequestForwardToIoQueue failed 0x%x", status));
+                                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketTrackRequest failed 0x%x", status));
                                         FreeReqCtx(reqContext);
-                                        WdfObjectDelete(DmaTransaction);
+                                        WdfDmaTransactionRelease(DmaTransaction);
+                                        PacketPutTransaction(pDmaExt, DmaTransaction);
                                 }
                         } else {
                                KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfDmaTransactionInitialize failed 0x%x", status));
                                 FreeReqCtx(reqContext);
-                                WdfObjectDelete(DmaTransaction);
+                                PacketPutTransaction(pDmaExt, DmaTransaction);
                         }
                 } else {
-                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfDmaTransactionCreate failed 0x%x", status));
+                        status = STATUS_INSUFFICIENT_RESOURCES;
                         FreeReqCtx(reqContext);
                 }
         } else {
@@ -188,6 +225,247 @@ NTSTATUS PacketStartSend(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN
         return status;
 }
 
+/*! PacketStartSends
+ *
+ *  \brief This routine setups a PACKET_SENDS request then calls
+ *     WdfDmaTransactionExecute to place all of its packets on the ring.
+ *   One transaction maps the span of the send buffer the packets use,
+ *   PacketProgramS2CDmaCallback splits it into packets.
+ *  \param Request - Pointer to the IOCtl request
+ *  \param pDevExt - Pointer to this drivers context (data store)
+ *  \param pPacketSends - Pointer to the PACKET_SENDS_STRUCT
+ *  \param BufferSize - Size of the PACKET_SENDS_STRUCT buffer
+ *  \return NTSTATUS
+ */
+NTSTATUS PacketStartSends(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN PPACKET_SENDS_STRUCT pPacketSends, IN size_t BufferSize)
+{
+        NTSTATUS status = STATUS_SUCCESS;
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        WDFDMATRANSACTION DmaTransaction;
+        PDMA_XFER pDmaXfer;
+        PREQUEST_CONTEXT reqContext = NULL;
+        UINT64 PacketEnd;
+        UINT64 SpanLength = 0;
+        UINT32 NumEntries;
+        UINT32 i;
+
+        status = GetDMAEngineContext(pDevExt, pPacketSends->EngineNum, &pDmaExt);
+        if (!NT_SUCCESS(status)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketSends DMA Engine number invalid 0x%x", status));
+                return status;
+        }
+
+        reqContext = RequestContext(Request);
+        if (reqContext == NULL) {
+                return STATUS_ACCESS_VIOLATION;
+        }
+
+        if (reqContext->pMdl == NULL) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketSends MDL == NULL\n"));
+                return STATUS_ACCESS_VIOLATION;
+        }
+
+        // Make sure every packet is inside the locked buffer, and find the span to map
+        NumEntries = pPacketSends->AvailNumEntries;
+        status = STATUS_INVALID_PARAMETER;
+        if ((NumEntries != 0) && (BufferSize >= (FIELD_OFFSET(PACKET_SENDS_STRUCT, Packets) + (NumEntries * sizeof(PACKET_SEND_ENTRY_STRUCT))))) {
+                status = STATUS_SUCCESS;
+                for (i = 0; i < NumEntries; i++) {
+                        PacketEnd = pPacketSends->Packets[i].BufferOffset + pPacketSends->Packets[i].Length;
+                        if ((pPacketSends->Packets[i].Length == 0) || (PacketEnd > (UINT64) reqContext->Length)) {
+                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, " Invalid packet %d, Offset 0x%llx, Length %d, MdlLength %d",
+                                           i, pPacketSends->Packets[i].BufferOffset, pPacketSends->Packets[i].Length, reqContext->Length));
+                                status = STATUS_INVALID_PARAMETER;
+                                break;
+                        }
+                        pPacketSends->Packets[i].Status = 0;
+                        if (PacketEnd > SpanLength) {
+                                SpanLength = PacketEnd;
+                        }
+                }
+                // The whole batch has to be mapped by a single program DMA callback
+                if (SpanLength > (UINT64) pDmaExt->MaximumTransferLength) {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, " Send buffer span %lld larger than the maximum transfer %lld", SpanLength, (UINT64) pDmaExt->MaximumTransferLength));
+                        status = STATUS_INVALID_PARAMETER;
+                }
+        }
+        if (!NT_SUCCESS(status)) {
+                FreeReqCtx(reqContext);
+                return status;
+        }
+        pPacketSends->RetNumEntries = 0;
+
+        DMADriverLock(pDmaExt);
+
+        // Take a pre-created DMA Transaction object for the whole batch
+        DmaTransaction = PacketGetTransaction(pDmaExt);
+
+        // if no errors kick off the DMA, first save a pointer to the request.
+        if (DmaTransaction != NULL) {
+                pDmaXfer = DMAXferContext(DmaTransaction);
+                pDmaXfer->Request = Request;
+                pDmaXfer->bytesTransferred = 0;
+                pDmaXfer->CardAddress = 0;
+                pDmaXfer->UserControl = 0;
+                pDmaXfer->Mode = 0;
+                pDmaXfer->PacketStatus = 0;
+                pDmaXfer->pMdl = reqContext->pMdl;
+                pDmaXfer->pPacketSends = pPacketSends;
+                pDmaXfer->SendsProgrammed = NumEntries;
+                pDmaXfer->SendsCompleted = 0;
+                pDmaXfer->pSendPool = NULL;
+
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "    Calling WdfDmaTransactionInitialize, Packets %d, Span %d, MdlLength %d", NumEntries, (UINT32) SpanLength, reqContext->Length));
+
+                status = WdfDmaTransactionInitialize(DmaTransaction,
+                                                     (PFN_WDF_PROGRAM_DMA) PacketProgramS2CDmaCallback, pDmaExt->DmaDirection, reqContext->pMdl, reqContext->pVA, (size_t) SpanLength);
+
+                if (NT_SUCCESS(status)) {
+                        // Track the request on the engine, cancelable until it completes
+                        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+                        status = PacketTrackRequest(pDmaExt, pDmaXfer, Request);
+                        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+                        if (NT_SUCCESS(status)) {
+                                // start the DMA, via PacketProgramDmaCallback
+                                status = WdfDmaTransactionExecute(DmaTransaction, pDmaExt);
+                                if (!NT_SUCCESS(status)) {
+                                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketStartSends failed 0x%x", status));
+                                        // Make sure we get the Request off the outstanding list
+                                        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+                                        if (PacketRetireRequest(pDmaExt, pDmaXfer) == NULL) {
+                                                // Canceled meanwhile, PacketRequestCancel completes it
+                                                status = STATUS_SUCCESS;
+                                        }
+                                        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+                                        FreeReqCtx(reqContext);
+                                        WdfDmaTransactionRelease(DmaTransaction);
+                                        PacketPutTransaction(pDmaExt, DmaTransaction);
+                                }
+                        } else {
+                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketTrackRequest failed 0x%x", status));
+                                FreeReqCtx(reqContext);
+                                WdfDmaTransactionRelease(DmaTransaction);
+                                PacketPutTransaction(pDmaExt, DmaTransaction);
+                        }
+                } else {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfDmaTransactionInitialize failed 0x%x", status));
+                        FreeReqCtx(reqContext);
+                        PacketPutTransaction(pDmaExt, DmaTransaction);
+                }
+        } else {
+                status = STATUS_INSUFFICIENT_RESOURCES;
+                FreeReqCtx(reqContext);
+        }
+
+        DMADriverUnlock(pDmaExt);
+
+        return status;
+}
+
+/*! PacketStartPoolSend
+ *
+ *  \brief This routine places a packet from a registered send pool on the
+ *     ring.  The pool is already locked and mapped, so there is no MDL to
+ *     build and the pooled transaction is never initialized, it only carries
+ *     the DMA_XFER context to PacketS2CComplete.
+ *  \param Request - WDF I/O Request (PACKET_POOL_SEND_IOCTL)
+ *  \param pDevExt - Pointer to this drivers context (data store)
+ *  \param pPoolSend - Contents of the PACKET_POOL_SEND_IOCTL request
+ *  \return NTSTATUS
+ */
+NTSTATUS PacketStartPoolSend(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN PPACKET_POOL_SEND_STRUCT pPoolSend)
+{
+        NTSTATUS status = STATUS_SUCCESS;
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        WDFDMATRANSACTION DmaTransaction;
+        PDMA_XFER pDmaXfer;
+        PSEND_POOL pPool;
+        UINT64 PoolOffset;
+        UINT32 SGIndex;
+        UINT32 SGOffset;
+
+        status = GetDMAEngineContext(pDevExt, pPoolSend->EngineNum, &pDmaExt);
+        if (!NT_SUCCESS(status)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketPoolSend DMA Engine number invalid 0x%x", status));
+                return status;
+        }
+
+        if ((pPoolSend->PoolId >= MAX_SEND_POOLS) || (pPoolSend->Length == 0)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, " Invalid pool send, Pool %d, Length %d", pPoolSend->PoolId, pPoolSend->Length));
+                return STATUS_INVALID_PARAMETER;
+        }
+        pPool = &pDmaExt->SendPool[pPoolSend->PoolId];
+
+        DMADriverLock(pDmaExt);
+
+        // Take a DMA Transaction object to track the packet
+        DmaTransaction = PacketGetTransaction(pDmaExt);
+        if (DmaTransaction == NULL) {
+                DMADriverUnlock(pDmaExt);
+                return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        pDmaXfer = DMAXferContext(DmaTransaction);
+        pDmaXfer->Request = Request;
+        pDmaXfer->bytesTransferred = 0;
+        pDmaXfer->CardAddress = 0;
+        pDmaXfer->UserControl = pPoolSend->UserControl;
+        pDmaXfer->Mode = 0;
+        pDmaXfer->PacketStatus = 0;
+        pDmaXfer->pMdl = NULL;
+        pDmaXfer->pPacketSends = NULL;
+        pDmaXfer->pSendPool = pPool;
+
+        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+
+        status = STATUS_INVALID_PARAMETER;
+        if (pPool->bMapped && (pPoolSend->BufferOffset < pPool->Length) && (pPoolSend->Length <= (pPool->Length - pPoolSend->BufferOffset))) {
+                // Track the request on the engine, cancelable until it completes
+                status = PacketTrackRequest(pDmaExt, pDmaXfer, Request);
+                if (NT_SUCCESS(status)) {
+                        // Count the send now so the pool cannot be released under it
+                        pPool->SendsOutstanding++;
+                }
+        }
+
+        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+
+        if (NT_SUCCESS(status)) {
+                // The pool S/G list has one element per page, the first one starts at the pool
+                PoolOffset = pPoolSend->BufferOffset + BYTE_OFFSET(pPool->UserVa);
+                SGIndex = (UINT32) (PoolOffset >> PAGE_SHIFT);
+                SGOffset = (SGIndex == 0) ? (UINT32) pPoolSend->BufferOffset : (UINT32) BYTE_OFFSET(PoolOffset);
+
+                WdfSpinLockAcquire(pDmaExt->SubmitSpinLock);
+                status = PacketRingStatus(PacketRingProgramS2CPoolPacket(&pDmaExt->Ring, DmaTransaction, pDmaXfer->UserControl,
+                                                                         pPool->pSgList, SGIndex, SGOffset, pPoolSend->Length));
+                if (NT_SUCCESS(status)) {
+                        pDmaExt->TimeoutCount = CARD_WATCHDOG_INTERVAL;
+                }
+                WdfSpinLockRelease(pDmaExt->SubmitSpinLock);
+
+                if (!NT_SUCCESS(status)) {
+                        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+                        pPool->SendsOutstanding--;
+                        if (PacketRetireRequest(pDmaExt, pDmaXfer) == NULL) {
+                                // Canceled meanwhile, PacketRequestCancel completes it
+                                PacketPutTransaction(pDmaExt, DmaTransaction);
+                                status = STATUS_SUCCESS;
+                        }
+                        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+                }
+        }
+
+        if (!NT_SUCCESS(status)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketStartPoolSend failed 0x%x, Pool %d, Offset 0x%llx, Length %d", status, pPoolSend->PoolId, pPoolSend->BufferOffset, pPoolSend->Length));
+                PacketPutTransaction(pDmaExt, DmaTransaction);
+        }
+
+        DMADriverUnlock(pDmaExt);
+
+        return status;
+}
+
 // Addressable Packet Mode functions
 
 /*! PacketStartWrite
@@ -205,7 +483,6 @@ NTSTATUS PacketStartWrite(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, I
         PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
         WDFDMATRANSACTION DmaTransaction;
         PDMA_XFER pDmaXfer;
-        WDF_OBJECT_ATTRIBUTES attributes;
         PREQUEST_CONTEXT reqContext = NULL;
 
         status = GetDMAEngineContext(pDevExt, pWritePacket->EngineNum, &pDmaExt);
@@ -226,12 +503,11 @@ NTSTATUS PacketStartWrite(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, I
         DMADriverLock(pDmaExt);
 
         if ((UINT64) reqContext->Length >= pWritePacket->Length) {
-                // Create a DMA Transaction object just for this transfer
-                WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, DMA_XFER);
-                status = WdfDmaTransactionCreate(pDmaExt->DmaEnabler, &attributes, &DmaTransaction);
+                // Take a pre-created DMA Transaction object for this transfer
+                DmaTransaction = PacketGetTransaction(pDmaExt);
 
                 // if no errors kick off the DMA, first save a pointer to the request.
-                if (NT_SUCCESS(status)) {
+                if (DmaTransaction != NULL) {
                         // Keep a pointer the Request and the accumulated byte count in the Transaction
                         pDmaXfer = DMAXferContext(DmaTransaction);
                         pDmaXfer->Request = Request;
@@ -241,6 +517,8 @@ NTSTATUS PacketStartWrite(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, I
                         pDmaXfer->Mode = pWritePacket->ModeFlags;
                         pDmaXfer->PacketStatus = 0;
                         pDmaXfer->pMdl = reqContext->pMdl;
+                        pDmaXfer->pPacketSends = NULL;
+                        pDmaXfer->pSendPool = NULL;
 
                        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "    Calling WdfDmaTransactionInitialize, Length %d, MdlLength %d", (UINT32) pWritePacket->Length, reqContext->Length));
 
@@ -249,34 +527,39 @@ NTSTATUS PacketStartWrite(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, I
                                                              pDmaExt->DmaDirection, reqContext->pMdl, reqContext->pVA, (size_t) pWritePacket->Length);
 
                         if (NT_SUCCESS(status)) {
-                                // Put the request on a WDF maintained Queue in case it gets canceled before we complete it
+                                // Track the request on the engine, cancelable until it completes
                                 WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
-                                status = WdfRequestForwardToIoQueue(Request, pDmaExt->TransactionQueue);
+                                status = PacketTrackRequest(pDmaExt, pDmaXfer, Request);
                                 WdfSpinLockRelease(pDmaExt->DmaSpinLock);
                                 if (NT_SUCCESS(status)) {
                                         // start the DMA, via PacketProgramDmaCallback
                                         status = WdfDmaTransactionExecute(DmaTransaction, pDmaExt);
                                         if (!NT_SUCCESS(status)) {
                                                KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfDmaTransactionExecute failed 0x%x", status));
-                                                // Make sure we get the Request off the queue.
+                                                // Make sure we get the Request off the outstanding list
                                                 WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
-                                                FindRequestByRequest(pDmaExt, Request);
+                                                if (PacketRetireRequest(pDmaExt, pDmaXfer) == NULL) {
+                                                        // Canceled meanwhile, PacketRequestCancel completes it
+                                                        status = STATUS_SUCCESS;
+                                                }
                                                 WdfSpinLockRelease(pDmaExt->DmaSpinLock);
                                                 FreeReqCtx(reqContext);
-                                                WdfObjectDelete(DmaTransaction);
+                                                WdfDmaTransactionRelease(DmaTransaction);
+                                                PacketPutTransaction(pDmaExt, DmaTransaction);
                                         }
                                 } else {
-                                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfRequestForwardToIoQueue failed 0x%x", status));
+                                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketTrackRequest failed 0x%x", status));
                                         FreeReqCtx(reqContext);
-                                        WdfObjectDelete(DmaTransaction);
+                                        WdfDmaTransactionRelease(DmaTransaction);
+                                        PacketPutTransaction(pDmaExt, DmaTransaction);
                                 }
                         } else {
                                KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfDmaTransactionInitialize failed 0x%x", status));
                                 FreeReqCtx(reqContext);
-                                WdfObjectDelete(DmaTransaction);
+                                PacketPutTransaction(pDmaExt, DmaTransaction);
                         }
                 } else {
-                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfDmaTransactionCreate failed 0x%x", status));
+                        status = STATUS_INSUFFICIENT_RESOURCES;
                         FreeReqCtx(reqContext);
                 }
         } else {
@@ -305,226 +588,256 @@ NTSTATUS PacketStartWrite(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, I
  */
 BOOLEAN PacketProgramS2CDmaCallback(IN WDFDMATRANSACTION DmaTransaction, IN WDFDEVICE Device, IN WDFCONTEXT Context, IN WDF_DMA_DIRECTION Direction, IN PSCATTER_GATHER_LIST SgList)
 {
-        NTSTATUS status = STATUS_SUCCESSFUL;
-        UINT32 SGFragments;
-        UINT32 SGIndex;
-        ULONG SGLength;
-        UINT64 SGAddr;
-        PDEVICE_EXTENSION pDevExt;
+        NTSTATUS status;
         PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
-        PDRIVER_DESC_STRUCT pDrvDesc;
-        PDMA_DESCRIPTOR_STRUCT pHWDesc;
-        PDMA_DESCRIPTOR_STRUCT pLastHWDesc = NULL;
         PDMA_XFER pDmaXfer;
-        UINT64 CardAddress;
-        UINT32 numAvailDescriptors;
-        UINT32 Control;
-        UINT32 descNum;
+        WDFREQUEST Request = NULL;
+        BOOLEAN bDmaLocked = FALSE;
 
+        UNREFERENCED_PARAMETER(Device);
         UNREFERENCED_PARAMETER(Direction);
 
        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "--> PacketProgramDmaCallback, IRQL=%d", KeGetCurrentIrql()));
 
         // Get Device Extensions
-        pDevExt = DMADriverGetDeviceContext(Device);
         pDmaExt = (PDMA_ENGINE_DEVICE_EXTENSION) Context;
         pDmaXfer = DMAXferContext(DmaTransaction);
-        CardAddress = pDmaXfer->CardAddress;
 
         /*
-         * One thread at a time.
+         * A PACKET_SENDS batch lives in the request's system buffer, which is
+         * gone once PacketRequestCancel completes the request.  Cancel detaches
+         * the request under DmaSpinLock, so hold it (taken before SubmitSpinLock)
+         * while the entries are read.
          */
-        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
-
-        // Determine number of available descriptors
-        numAvailDescriptors = pDmaExt->NumberOfDescriptors - pDmaExt->NumberOfUsedDescriptors;
-
-        SGFragments = PacketProgramCountDescFragments(SgList);
-
-        if (numAvailDescriptors >= SGFragments) {
-                // Lock the access to the head pointer, get the next pointer, calc the new head, store it back and release the lock
-                pDrvDesc = pDmaExt->pNextDesc;
-                pHWDesc = pDrvDesc->pHWDesc;
-
-                // Setup descriptor control, Interrupt when the DMA is stopped short
-                Control = PACKET_DESC_S2C_CTRL_START_OF_PACKET;
-
-                // Get the first fragment address and length
-                SGIndex = 0;
-                SGLength = SgList->Elements[SGIndex].Length;
-                SGAddr = SgList->Elements[SGIndex].Address.QuadPart;
-                SGIndex++;
-
-                // setup each of the descriptors
-                for (descNum = 0; descNum < SGFragments; descNum++) {
-                        if (descNum == (SGFragments - 1)) {
-                                /*
-                                   End the processing here only interrupt on completion of the
-                                   last DMA descriptor and when the DMA is stopped short.
-                                 */
-                                Control |= PACKET_DESC_S2C_CTRL_END_OF_PACKET | PACKET_DESC_S2C_CTRL_IRQ_ON_COMPLETE | PACKET_DESC_S2C_CTRL_IRQ_ON_ERROR;
-                        }
-                        // Setup the descriptor
-                        pHWDesc->S2C.StatusFlags_BytesCompleted = (UINT32)PacketProgramDescFrag(SGLength);
-                        // Set the User Control field in the first packet only
-                        pHWDesc->S2C.UserControl = pDmaXfer->UserControl;
-                        pDmaXfer->UserControl = 0;
-
-                        pHWDesc->S2C.CardAddress = (UINT32) (CardAddress & 0xFFFFFFFF);
-                        pHWDesc->S2C.ControlFlags_ByteCount = (UINT32) ((CardAddress & 0xF00000000) >> 12);
-                        pHWDesc->S2C.ControlFlags_ByteCount |= ((UINT32)PacketProgramDescFrag(SGLength)) | Control;
-                        pHWDesc->S2C.SystemAddressPhys = SGAddr;
-                        pDrvDesc->DmaTransaction = DmaTransaction;
-
-                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Descriptor #%d, Length=%d, Control=0x%x, SA=0x%x, ND=0x%p", descNum, SGLength, Control, (UINT32) SGAddr, pDrvDesc->pNextDesc));
-
-                        // Remove the start of packet bit for next descriptor and zero the CardAddress.
-                        Control &= ~PACKET_DESC_S2C_CTRL_START_OF_PACKET;
-
-                        // Update the card offset in the next descriptor.
-                        CardAddress += PacketProgramDescFrag(SGLength);
-
-                        // Update pointers
-                        pLastHWDesc = pHWDesc;
-                        pDrvDesc = pDrvDesc->pNextDesc;
-                        pHWDesc = pDrvDesc->pHWDesc;
-                        _InterlockedIncrement(&pDmaExt->NumberOfUsedDescriptors);
-
-                        // See if we have exhausted this fragment
-                        SGAddr += PacketProgramDescFrag(SGLength);
-                        SGLength -= (ULONG)PacketProgramDescFrag(SGLength);
-                        if (SGLength == 0) {
-                                SGLength = SgList->Elements[SGIndex].Length;
-                                SGAddr = SgList->Elements[SGIndex].Address.QuadPart;
-                                SGIndex++;
-                        }
-                }
+        if (pDmaXfer->pPacketSends != NULL) {
+                WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+                bDmaLocked = TRUE;
+        }
 
-                pDmaExt->TimeoutCount = CARD_WATCHDOG_INTERVAL;
+        /*
+         * One producer at a time, the completion DPC runs alongside under DmaSpinLock.
+         */
+        WdfSpinLockAcquire(pDmaExt->SubmitSpinLock);
 
-                if (pLastHWDesc != NULL) {
-                        // setup the descriptor pointer
-                        pDmaExt->pDmaEng->SoftwareDescriptorPtr = pLastHWDesc->S2C.NextDescriptorPhys;
-                        pDmaExt->pNextDesc = pDrvDesc;
+        if (pDmaXfer->pPacketSends != NULL) {
+                if (pDmaXfer->Request == NULL) {
+                        // Canceled before any of the batch reached the ring
+                        status = STATUS_CANCELLED;
+                } else {
+                        // PACKET_SENDS, place as many packets of the batch as fit with one doorbell write
+                        // RetNumEntries is filled in at completion, the batch may complete before this returns
+                        status = PacketRingStatus(PacketRingProgramS2CSends(&pDmaExt->Ring, DmaTransaction, SgList, pDmaXfer->pPacketSends->Packets,
+                                                                            pDmaXfer->SendsProgrammed, &pDmaXfer->SendsProgrammed));
                 }
         } else {
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Too many desc, Available = %d, Required = %d", numAvailDescriptors, SGFragments));
-                status = STATUS_INSUFFICIENT_RESOURCES;
+                // Place the packet on the ring, the User Control field goes in the first descriptor only
+                status = PacketRingStatus(PacketRingProgramS2C(&pDmaExt->Ring, DmaTransaction, pDmaXfer->UserControl, pDmaXfer->CardAddress, SgList));
+        }
+        if (NT_SUCCESS(status)) {
+                pDmaXfer->UserControl = 0;
+                pDmaExt->TimeoutCount = CARD_WATCHDOG_INTERVAL;
         }
 
-        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+        WdfSpinLockRelease(pDmaExt->SubmitSpinLock);
 
         if (!NT_SUCCESS(status)) {
                 NTSTATUS FinalStatus = status;
+
+                if (!bDmaLocked) {
+                        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+                }
+                Request = PacketRetireRequest(pDmaExt, pDmaXfer);
+                WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+
                 // an error has occurred, reset this transaction
                KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMAD PacketProgramDmaCallback failed status 0x%x", status));
                 WdfDmaTransactionDmaCompletedFinal(DmaTransaction, 0, &FinalStatus);
-                // complete the transaction
-                WdfRequestCompleteWithInformation(pDmaXfer->Request, status, 0);
-                WdfObjectDelete(DmaTransaction);
+                if (Request != NULL) {
+                        // complete the transaction
+                        WdfRequestCompleteWithInformation(Request, status, 0);
+                }
+                WdfDmaTransactionRelease(DmaTransaction);
+                PacketPutTransaction(pDmaExt, DmaTransaction);
                 return FALSE;
         }
+        if (bDmaLocked) {
+                WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+        }
         return TRUE;
 }
 
+/*
+ * Transfers PacketS2CComplete finished during one PacketS2CDpc pass, they
+ * are completed by PacketS2CFinish once DmaSpinLock is released.
+ */
+typedef struct _PACKET_S2C_DONE {
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        LIST_ENTRY DoneList;            // DMA_XFERs linked by OutstandingEntry, in ring order
+} PACKET_S2C_DONE, *PPACKET_S2C_DONE;
+
+/*! PacketS2CComplete
+ *
+ *  \brief Completes the WDF transaction of a sent packet, called by
+ *   PacketRingCompleteS2C at the packet's EOP descriptor with DmaSpinLock
+ *   held.  A PACKET_SENDS request completes with the last packet of its batch.
+ *   A PACKET_POOL_SEND packet has no mapping to complete.  The request is
+ *   retired here and left on the DoneList for PacketS2CFinish.
+ *  \param Context - PACKET_S2C_DONE of the DPC pass
+ *  \param DmaTransaction - Transaction that owns the packet
+ *  \param BytesTransferred - Bytes sent
+ *  \param PacketStatus - Error status of the packet's descriptors
+ *  \return none
+ */
+static VOID PacketS2CComplete(IN PVOID Context, IN WDFDMATRANSACTION DmaTransaction, IN UINT32 BytesTransferred, IN UINT32 PacketStatus)
+{
+        PPACKET_S2C_DONE pDone = (PPACKET_S2C_DONE) Context;
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt = pDone->pDmaExt;
+        PDMA_XFER pDmaXfer;
+        BOOLEAN transactionComplete;
+        NTSTATUS status = STATUS_SUCCESS;
+
+        pDmaXfer = DMAXferContext(DmaTransaction);
+        if (pDmaXfer->pSendPool != NULL) {
+                // Nothing was mapped for a send pool packet, just complete the request
+                pDmaXfer->pSendPool->SendsOutstanding--;
+                pDmaXfer->bytesTransferred = BytesTransferred;
+                pDmaXfer->CompleteStatus = PacketStatus ? STATUS_ADAPTER_HARDWARE_ERROR : STATUS_SUCCESS;
+
+                // Retrieve the originating request from the Transaction data extension
+                pDmaXfer->CompleteRequest = PacketRetireRequest(pDmaExt, pDmaXfer);
+                InsertTailList(&pDone->DoneList, &pDmaXfer->OutstandingEntry);
+                return;
+        }
+        if (pDmaXfer->pPacketSends != NULL) {
+                PPACKET_SEND_ENTRY_STRUCT pEntry;
+
+                // Packets complete in order, report this one and wait for the rest of the batch
+                pEntry = &pDmaXfer->pPacketSends->Packets[pDmaXfer->SendsCompleted++];
+                if (pDmaXfer->Request != NULL) {
+                        // The batch lives in the request buffer, gone once the request is canceled
+                        pEntry->Length = BytesTransferred;
+                        pEntry->Status = PacketStatus;
+                }
+                pDmaXfer->bytesTransferred += BytesTransferred;
+                pDmaXfer->PacketStatus |= PacketStatus;
+                if (pDmaXfer->SendsCompleted < pDmaXfer->SendsProgrammed) {
+                        return;
+                }
+                if (pDmaXfer->Request != NULL) {
+                        pDmaXfer->pPacketSends->RetNumEntries = (UINT16) pDmaXfer->SendsProgrammed;
+                }
+                // The packets need not cover the mapped span, finish the transaction here
+                transactionComplete = WdfDmaTransactionDmaCompletedFinal(DmaTransaction, pDmaXfer->bytesTransferred, &status);
+                status = pDmaXfer->PacketStatus ? STATUS_ADAPTER_HARDWARE_ERROR : STATUS_SUCCESS;
+        } else {
+                pDmaXfer->bytesTransferred = BytesTransferred;
+                pDmaXfer->PacketStatus = PacketStatus;
+
+                if (pDmaXfer->PacketStatus) {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMADriver Error: Control/Status returned error"));
+                        // Stop the current DMA transfer, tell driver to not continue
+                        transactionComplete = WdfDmaTransactionDmaCompletedFinal(DmaTransaction, pDmaXfer->bytesTransferred, &status);
+                        status = STATUS_ADAPTER_HARDWARE_ERROR;
+                } else {
+                        status = STATUS_SUCCESS;
+                        // complete the transaction,  transaction completed successfully
+                        // tell the framework that this DMA set is complete
+                        transactionComplete = WdfDmaTransactionDmaCompletedWithLength(DmaTransaction, pDmaXfer->bytesTransferred, &status);
+                }
+        }
+
+        // Is the full transaction complete?
+        if (transactionComplete) {
+           KdPrintEx((1, DPFLTR_INFO_LEVEL, "      Transaction Complete, size=%lu", (UINT32) pDmaXfer->bytesTransferred));
+                pDmaXfer->CompleteStatus = status;
+
+                // Retrieve the originating request from the Transaction data extension
+                pDmaXfer->CompleteRequest = PacketRetireRequest(pDmaExt, pDmaXfer);
+                InsertTailList(&pDone->DoneList, &pDmaXfer->OutstandingEntry);
+        }
+}
+
+/*! PacketS2CFinish
+ *
+ *  \brief Unlocks the buffers and completes the requests of the transfers
+ *   PacketS2CComplete finished, then returns their transactions to the pool.
+ *   Called without DmaSpinLock, the transfers are off every engine list.
+ *  \param pDone - PACKET_S2C_DONE of the DPC pass
+ *  \return none
+ */
+static VOID PacketS2CFinish(IN PPACKET_S2C_DONE pDone)
+{
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt = pDone->pDmaExt;
+        WDFDMATRANSACTION DmaTransaction;
+        PLIST_ENTRY pEntry;
+        PDMA_XFER pDmaXfer;
+
+        while (!IsListEmpty(&pDone->DoneList)) {
+                pEntry = RemoveHeadList(&pDone->DoneList);
+                InitializeListHead(pEntry);
+                pDmaXfer = CONTAINING_RECORD(pEntry, DMA_XFER, OutstandingEntry);
+                DmaTransaction = pDmaXfer->pPoolEntry->DmaTransaction;
+
+                if (pDmaXfer->pSendPool == NULL) {
+                        if (pDmaXfer->pMdl != NULL) {
+                                // Unlock the pages locked by MmProbeAndLockPages
+                                MmUnlockPages(pDmaXfer->pMdl);
+                                IoFreeMdl(pDmaXfer->pMdl);
+                                pDmaXfer->pMdl = NULL;
+                        } else {
+                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketSend/Write MDL == NULL\n"));
+                        }
+                }
+                if (pDmaXfer->CompleteRequest != NULL) {
+                        // complete the transaction
+                        WdfRequestCompleteWithInformation(pDmaXfer->CompleteRequest, pDmaXfer->CompleteStatus, pDmaXfer->bytesTransferred);
+                        pDmaXfer->CompleteRequest = NULL;
+                }
+                if (pDmaXfer->pSendPool == NULL) {
+                        // Release the Transaction record, a send pool transaction is never initialized
+                        WdfDmaTransactionRelease(DmaTransaction);
+                }
+                PacketPutTransaction(pDmaExt, DmaTransaction);
+        }
+}
+
 /*! PacketS2CDpc
  *
  *  \brief This routine processes completed
- *    DMA Packet descriptors, dequeues requests and completes them
+ *    DMA Packet descriptors, dequeues requests and completes them.
+ *    Only the ring tail is walked under DmaSpinLock, sends are placed on the
+ *    ring meanwhile under SubmitSpinLock.  Buffers are unlocked and requests
+ *    completed after the lock is released.
  *     \param Dpc - Pointer to the driver context for this Dpc
  *  \return none
  */
 VOID PacketS2CDpc(IN WDFDPC Dpc)
 {
         PDPC_CTX pDpcCtx;
-        PDEVICE_EXTENSION pDevExt;
         PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
-        PDRIVER_DESC_STRUCT pDrvDesc;
-        PDMA_DESCRIPTOR_STRUCT pHWDesc;
-        PDMA_XFER pDmaXfer = NULL;
-        WDFREQUEST Request;
-        BOOLEAN transactionComplete;
-        NTSTATUS status = STATUS_SUCCESS;
+        PACKET_S2C_DONE Done;
 
-        pDevExt = DMADriverGetDeviceContext(WdfDpcGetParentObject(Dpc));
         pDpcCtx = DPCContext(Dpc);
         pDmaExt = pDpcCtx->pDmaExt;
 
+        Done.pDmaExt = pDmaExt;
+        InitializeListHead(&Done.DoneList);
+
         WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
 
         // Inc the DPC Count
-        pDmaExt->DPCsInLastSecond++;
-
-        // Make sure we have completed descriptor(s)
-        pDrvDesc = pDmaExt->pTailDesc;
-        pHWDesc = pDrvDesc->pHWDesc;
+        pDmaExt->DPCsInCurrentSecond++;
 
        KdPrintEx((1, DPFLTR_INFO_LEVEL, "DMA Engine %u status 0x%08x", pDmaExt->DmaEngine, pDmaExt->pDmaEng->ControlStatus));
 
-        while (pHWDesc->S2C.StatusFlags_BytesCompleted & (PACKET_DESC_S2C_STAT_COMPLETE|PACKET_DESC_S2C_STAT_ERROR)) {
-                // At this point we know we have a completed Send DMA Descriptor
-                // Update the contexts links to the next descriptor
-                pDmaExt->pTailDesc = pDrvDesc->pNextDesc;
-                _InterlockedDecrement(&pDmaExt->NumberOfUsedDescriptors);
-
-                // The Transaction data pointer is in every descriptor for a given Request
-                pDmaXfer = DMAXferContext(pDrvDesc->DmaTransaction);
-
-                if (pHWDesc->S2C.ControlFlags_ByteCount & PACKET_DESC_S2C_CTRL_START_OF_PACKET) {
-                        pDmaXfer->bytesTransferred = 0;
-                }
-                pDmaXfer->bytesTransferred += (pHWDesc->S2C.StatusFlags_BytesCompleted & PACKET_DESC_COMPLETE_BYTE_COUNT_MASK);
-                pDmaXfer->PacketStatus |= (pHWDesc->S2C.StatusFlags_BytesCompleted & PACKET_DESC_S2C_STAT_ERROR);
-
-                if (pHWDesc->S2C.ControlFlags_ByteCount & PACKET_DESC_S2C_CTRL_END_OF_PACKET) {
-                        if (pDmaXfer->PacketStatus) {
-                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMADriver Error: Control/Status returned error"));
-                                // Stop the current DMA transfer, tell driver to not continue
-                                transactionComplete = WdfDmaTransactionDmaCompletedFinal(pDrvDesc->DmaTransaction, pDmaXfer->bytesTransferred, &status);
-                                status = STATUS_ADAPTER_HARDWARE_ERROR;
-                        } else {
-                                status = STATUS_SUCCESS;
-                                // complete the transaction,  transaction completed successfully
-                                // tell the framework that this DMA set is complete
-                                transactionComplete = WdfDmaTransactionDmaCompletedWithLength(pDrvDesc->DmaTransaction, pDmaXfer->bytesTransferred, &status);
-                        }
-
-                        // Is the full transaction complete?
-                        if (transactionComplete) {
-                           KdPrintEx((1, DPFLTR_INFO_LEVEL, "      Transaction Complete, size=%lu", (UINT32) pDmaXfer->bytesTransferred));
-                                if (pDmaXfer->pMdl != NULL) {
-                                        // Unlock the pages locked by MmProbeAndLockPages
-                                        MmUnlockPages(pDmaXfer->pMdl);
-                                        IoFreeMdl(pDmaXfer->pMdl);
-                                        pDmaXfer->pMdl = NULL;
-                                } else {
-                                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketSend/Write MDL == NULL\n"));
-                                }
-
-                                // Retrieve the originating request from the Transaction data extension
-                                Request = FindRequestByRequest(pDmaExt, pDmaXfer->Request);
-                                if (Request != NULL) {
-                                        // complete the transaction
-                                        WdfRequestCompleteWithInformation(Request, status, pDmaXfer->bytesTransferred);
-                                }
-                                // Release the Transaction record
-                                WdfDmaTransactionRelease(pDrvDesc->DmaTransaction);
-                                pDmaXfer->Request = NULL;
-                                WdfObjectDelete(pDrvDesc->DmaTransaction);
-                                pDmaXfer = NULL;
-                        }
-                }
-                // Indicate we processed this descriptor by clearing Complete and Error flags
-                pHWDesc->S2C.StatusFlags_BytesCompleted &= ~(PACKET_DESC_S2C_STAT_COMPLETE | PACKET_DESC_S2C_STAT_ERROR);
-
-                // Link to the next packets
-                pDrvDesc = pDrvDesc->pNextDesc; // Link to the next descriptor in the chain
-                pHWDesc = pDrvDesc->pHWDesc;
-        }
+        // Retire the completed descriptor(s), finishing each packet at its EOP
+        PacketRingCompleteS2C(&pDmaExt->Ring, PacketS2CComplete, &Done);
 
         DMADriverAckDmaInterrupt(pDmaExt);
 
         WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+
+        PacketS2CFinish(&Done);
 }
 
 //-----------------------------------------------------------
@@ -551,7 +864,6 @@ NTSTATUS PacketStartRead(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN
         PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
         WDFDMATRANSACTION DmaTransaction;
         PDMA_XFER pDmaXfer;
-        WDF_OBJECT_ATTRIBUTES attributes;
         PREQUEST_CONTEXT reqContext = NULL;
 
         status = GetDMAEngineContext(pDevExt, pReadPacket->EngineNum, &pDmaExt);
@@ -577,12 +889,11 @@ NTSTATUS PacketStartRead(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN
 
         DMADriverLock(pDmaExt);
 
-        // Create a DMA Transaction object just for this transfer
-        WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, DMA_XFER);
-        status = WdfDmaTransactionCreate(pDmaExt->DmaEnabler, &attributes, &DmaTransaction);
+        // Take a pre-created DMA Transaction object for this transfer
+        DmaTransaction = PacketGetTransaction(pDmaExt);
 
         // if no errors kick off the DMA, first save a pointer to the request.
-        if (NT_SUCCESS(status)) {
+        if (DmaTransaction != NULL) {
                 // Keep a pointer the Request and the accumulated byte count in the Transaction
                 pDmaXfer = DMAXferContext(DmaTransaction);
                 pDmaXfer->Request = Request;
@@ -591,22 +902,24 @@ NTSTATUS PacketStartRead(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN
                 pDmaXfer->pMdl = reqContext->pMdl;
                 pDmaXfer->Mode = pReadPacket->ModeFlags;
                 pDmaXfer->PacketStatus = 0;
+                pDmaXfer->pPacketSends = NULL;
+                pDmaXfer->pSendPool = NULL;
 
                KdPrintEx((1, DPFLTR_INFO_LEVEL, " Calling WdfDmaTransactionInitialize, Length %d", (UINT32) pReadPacket->Length));
                 //#pragma warning(suppress: 28160)
                 if ((DmaTransaction == NULL) || (reqContext->pMdl == NULL) || (reqContext->pVA == NULL)) {
                        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketStartRead Null pointer found"));
                         DbgBreakPoint();
-                        WdfObjectDelete(DmaTransaction);
+                        PacketPutTransaction(pDmaExt, DmaTransaction);
                         status = STATUS_INVALID_PARAMETER;
                         goto PacketStartReadExit;
                 }
                 status = WdfDmaTransactionInitialize(DmaTransaction,
                                                      (PFN_WDF_PROGRAM_DMA) PacketProgramC2SDmaCallback, pDmaExt->DmaDirection, reqContext->pMdl, reqContext->pVA, (size_t) pReadPacket->Length);
                 if (NT_SUCCESS(status)) {
-                        // Put the request on a WDF maintained Queue in case it gets canceled before we complete it
+                        // Track the request on the engine, cancelable until it completes
                         WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
-                        status = WdfRequestForwardToIoQueue(Request, pDmaExt->TransactionQueue);
+                        status = PacketTrackRequest(pDmaExt, pDmaXfer, Request);
                         WdfSpinLockRelease(pDmaExt->DmaSpinLock);
 
                         if (NT_SUCCESS(status)) {
@@ -614,25 +927,30 @@ NTSTATUS PacketStartRead(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN
                                 status = WdfDmaTransactionExecute(DmaTransaction, pDmaExt);
                                 if (!NT_SUCCESS(status)) {
                                        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfDmaTransactionExecute failed 0x%x", status));
-                                        // Make sure we get the Request off the queue.
                                         FreeReqCtx(reqContext);
+                                        // Make sure we get the Request off the outstanding list
                                         WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
-                                        FindRequestByRequest(pDmaExt, Request);
+                                        if (PacketRetireRequest(pDmaExt, pDmaXfer) == NULL) {
+                                                // Canceled meanwhile, PacketRequestCancel completes it
+                                                status = STATUS_SUCCESS;
+                                        }
                                         WdfSpinLockRelease(pDmaExt->DmaSpinLock);
-                                        WdfObjectDelete(DmaTransaction);
+                                        WdfDmaTransactionRelease(DmaTransaction);
+                                        PacketPutTransaction(pDmaExt, DmaTransaction);
                                 }
                         } else {
-                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfRequestForwardToIoQueue failed 0x%x", status));
+                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketTrackRequest failed 0x%x", status));
                                 FreeReqCtx(reqContext);
-                                WdfObjectDelete(DmaTransaction);
+                                WdfDmaTransactionRelease(DmaTransaction);
+                                PacketPutTransaction(pDmaExt, DmaTransaction);
                         }
                 } else {
                        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfDmaTransactionInitialize failed 0x%x", status));
                         FreeReqCtx(reqContext);
-                        WdfObjectDelete(DmaTransaction);
+                        PacketPutTransaction(pDmaExt, DmaTransaction);
                 }
         } else {
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfDmaTransactionCreate failed 0x%x", status));
+                status = STATUS_INSUFFICIENT_RESOURCES;
                 FreeReqCtx(reqContext);
         }
 
@@ -661,102 +979,29 @@ PacketStartReadExit:
  */
 BOOLEAN PacketProgramC2SDmaCallback(IN WDFDMATRANSACTION DmaTransaction, IN WDFDEVICE Device, IN WDFCONTEXT Context, IN WDF_DMA_DIRECTION Direction, IN PSCATTER_GATHER_LIST SgList)
 {
-        NTSTATUS status = STATUS_SUCCESSFUL;
-        UINT32 SGFragments;
-        UINT32 SGIndex;
-        ULONG SGLength;
-        UINT64 SGAddr;
-        PDEVICE_EXTENSION pDevExt;
+        NTSTATUS status;
         PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
-        PDRIVER_DESC_STRUCT pDrvDesc;
-        PDMA_DESCRIPTOR_STRUCT pHWDesc;
-        PDMA_DESCRIPTOR_STRUCT pLastHWDesc = NULL;
         PDMA_XFER pDmaXfer;
-        UINT64 CardAddress;
-        UINT32 Control;
-        UINT32 numAvailDescriptors;
-        UINT32 descNum;
+        WDFREQUEST Request = NULL;
 
+        UNREFERENCED_PARAMETER(Device);
         UNREFERENCED_PARAMETER(Direction);
 
        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "--> PacketProgramDmaCallback, IRQL=%d", KeGetCurrentIrql()));
 
         // Get Device Extensions
-        pDevExt = DMADriverGetDeviceContext(Device);
         pDmaExt = (PDMA_ENGINE_DEVICE_EXTENSION) Context;
         pDmaXfer = DMAXferContext(DmaTransaction);
-        CardAddress = pDmaXfer->CardAddress;
 
         WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
 
-        // Determine number of available descriptors
-        numAvailDescriptors = pDmaExt->NumberOfDescriptors - pDmaExt->NumberOfUsedDescriptors;
-
-        // Setup descriptor control, Set for the first descriptor
-        Control = PACKET_DESC_C2S_CTRL_START_OF_PACKET;
-
-        // Count the fragments, including the fragments bigger than one DMA Descriptor size
-        SGFragments = PacketProgramCountDescFragments(SgList);
-
-        if (numAvailDescriptors >= SGFragments) {
-                // Lock the access to the head pointer, get the next pointer, calc the new head, store it back and release the lock
-                pDrvDesc = pDmaExt->pNextDesc;
-                pHWDesc = pDrvDesc->pHWDesc;
-
-                // Get the first fragment address and length
-                SGIndex = 0;
-                SGLength = SgList->Elements[SGIndex].Length;
-                SGAddr = SgList->Elements[SGIndex].Address.QuadPart;
-                SGIndex++;
-
-                // setup each of the descriptors
-                for (descNum = 0; descNum < SGFragments; descNum++) {
-                        // setup the descriptor
-                        pHWDesc->C2S.StatusFlags_BytesCompleted = (UINT32)PacketProgramDescFrag(SGLength);
-                        pHWDesc->C2S.UserStatus = 0;
-                        pHWDesc->C2S.CardAddress = (UINT32) (CardAddress & 0xFFFFFFFF);
-                        if (descNum == (SGFragments - 1)) {
-                                // End the processing here, Only interrupt on completion of the last DMA descriptor and
-                                // when the DMA is stopped short.
-                                Control |= PACKET_DESC_C2S_CTRL_END_OF_PACKET | PACKET_DESC_C2S_CTRL_IRQ_ON_COMPLETE | PACKET_DESC_C2S_CTRL_IRQ_ON_ERROR;
-                        }
-                        pHWDesc->C2S.ControlFlags_ByteCount = ((UINT32) ((CardAddress & 0xF00000000) >> 12)) | ((UINT32)PacketProgramDescFrag(SGLength)) | Control;
-                        pHWDesc->C2S.SystemAddressPhys = SGAddr;
-                        pDrvDesc->DmaTransaction = DmaTransaction;
-
-                       KdPrintEx((1, DPFLTR_INFO_LEVEL, "Descriptor #%d, Length=%d, SA=0x%x, ND=0x%p", descNum, SGLength, (UINT32) SGAddr, pDrvDesc->pNextDesc));
-
-                        // Remove the start of packet bit for next descriptor and zero out CardAddress
-                        Control &= ~PACKET_DESC_S2C_CTRL_START_OF_PACKET;
-
-                        // Card Address must be contiguous between Descriptors in the same packet. Use of DescCardAddress is optional. If unused, tie to 0.
-                        CardAddress += PacketProgramDescFrag(SGLength);
-
-                        // update pointers
-                        pLastHWDesc = pDrvDesc->pHWDesc;
-                        pDrvDesc = pDrvDesc->pNextDesc;
-                        pHWDesc = pDrvDesc->pHWDesc;
-                        _InterlockedIncrement(&pDmaExt->NumberOfUsedDescriptors);
-
-                        // See if we have exhausted this fragment
-                        SGAddr += PacketProgramDescFrag(SGLength);
-                        SGLength -= (ULONG)PacketProgramDescFrag(SGLength);
-                        if (SGLength == 0) {
-                                SGLength = SgList->Elements[SGIndex].Length;
-                                SGAddr = SgList->Elements[SGIndex].Address.QuadPart;
-                                SGIndex++;
-                        }
-                }
+        // Place the read on the ring, under DmaSpinLock
+        status = PacketRingStatus(PacketRingProgramC2S(&pDmaExt->Ring, DmaTransaction, pDmaXfer->CardAddress, SgList));
+        if (NT_SUCCESS(status)) {
                 pDmaExt->TimeoutCount = CARD_WATCHDOG_INTERVAL;
-
-                if (pLastHWDesc != NULL) {
-                        // setup the descriptor pointer
-                        pDmaExt->pDmaEng->SoftwareDescriptorPtr = pLastHWDesc->C2S.NextDescriptorPhys;
-                        pDmaExt->pNextDesc = pDrvDesc;
-                }
-        } else {
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Too many desc, Available = %d, Required = %d", numAvailDescriptors, SGFragments));
-                status = STATUS_INSUFFICIENT_RESOURCES;
+        }
+        if (!NT_SUCCESS(status)) {
+                Request = PacketRetireRequest(pDmaExt, pDmaXfer);
         }
         WdfSpinLockRelease(pDmaExt->DmaSpinLock);
 
@@ -771,9 +1016,12 @@ BOOLEAN PacketProgramC2SDmaCallback(IN WDFDMATRANSACTION DmaTransaction, IN WDFD
                         pDmaXfer->pMdl = NULL;
                 }
                 WdfDmaTransactionDmaCompletedFinal(DmaTransaction, 0, &FinalStatus);
-                // complete the transaction
-                WdfRequestCompleteWithInformation(pDmaXfer->Request, status, 0);
-                WdfObjectDelete(DmaTransaction);
+                if (Request != NULL) {
+                        // complete the transaction
+                        WdfRequestCompleteWithInformation(Request, status, 0);
+                }
+                WdfDmaTransactionRelease(DmaTransaction);
+                PacketPutTransaction(pDmaExt, DmaTransaction);
                 return FALSE;
         }
         return TRUE;
@@ -791,17 +1039,33 @@ VOID PacketC2SDpc(IN WDFDPC Dpc)
         PDPC_CTX pDpcCtx;
         PDEVICE_EXTENSION pDevExt;
         PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        LARGE_INTEGER StartTime;
+        UINT64 Elapsed;
+        UINT32 Budget;
+        BOOLEAN bPollPass;
+        BOOLEAN bRepoll = FALSE;
+        BOOLEAN bParked = FALSE;
+
+        StartTime = KeQueryPerformanceCounter(NULL);
 
         pDevExt = DMADriverGetDeviceContext(WdfDpcGetParentObject(Dpc));
         pDpcCtx = DPCContext(Dpc);
         pDmaExt = pDpcCtx->pDmaExt;
 
         // Inc the DPC Count
-        pDmaExt->DPCsInLastSecond++;
+        pDmaExt->DPCsInCurrentSecond++;
+
+        bPollPass = pDmaExt->bPollPass;
+        pDmaExt->bPollPass = FALSE;
+        Budget = pDmaExt->PollBudget;
 
         if (pDmaExt->PacketMode == PACKET_MODE_FIFO) {
                 // We only want one thread processing recieves at a time.
-                PacketProcessCompletedReceives(pDevExt, pDmaExt);
+                if (pDmaExt->CompRing.pRing != NULL) {
+                        PacketProcessCompRing(pDmaExt, (Budget != 0) ? &Budget : NULL);
+                } else {
+                        PacketProcessCompletedReceives(pDevExt, pDmaExt, (Budget != 0) ? &Budget : NULL);
+                }
         } else if (pDmaExt->PacketMode == PACKET_MODE_ADDRESSABLE) {
                 PacketReadComplete(pDevExt, pDmaExt);
         } else if (pDmaExt->PacketMode == PACKET_MODE_STREAMING) {
@@ -809,140 +1073,67 @@ VOID PacketC2SDpc(IN WDFDPC Dpc)
         }
 
         WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
-        DMADriverAckDmaInterrupt(pDmaExt);
-        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
-}
-
-// FIFO Packet Mode functions
-
-static NTSTATUS CheckForCompletedPacket(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, BOOLEAN *Completed)
-{
-    PDRIVER_DESC_STRUCT pDrvDesc;
-    PDMA_DESCRIPTOR_STRUCT pHWDesc;
-    UINT32 CachedDescStatus;
-    LONG NumberOfCheckedDescriptors=0;
-
-    *Completed = FALSE;
-
-    pDrvDesc = pDmaExt->pNextDesc;
-    pHWDesc = pDrvDesc->pHWDesc;
-
-    if (pHWDesc->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_COMPLETE) {
-
-        if (!(pHWDesc->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_START_OF_PACKET)) {
-           KdPrintEx((1, DPFLTR_ERROR_LEVEL,"Missing SOP at Head descriptor 0x%p (0x%x)\n", pHWDesc, pHWDesc->C2S.StatusFlags_BytesCompleted));
-            return STATUS_UNSUCCESSFUL;
-        }
-
-        // Walk the descriptors looking for the EOP descriptor. It could be this descriptor
-        do {
-            // Save a copy of the status flags for later loop while test
-            CachedDescStatus = pHWDesc->C2S.StatusFlags_BytesCompleted;
-            if (CachedDescStatus & (PACKET_DESC_C2S_STAT_COMPLETE | PACKET_DESC_C2S_STAT_ERROR)) {
-                if (pDrvDesc->DescFlags == DESC_FLAGS_HW_OWNED) {
-                    // Link to the next descriptor
-                    pDrvDesc = pDrvDesc->pNextDesc;
-                    pHWDesc = pDrvDesc->pHWDesc;
-                } else {  // This is an ERROR! It means we overran the queue
-                   KdPrintEx((1, DPFLTR_ERROR_LEVEL,"Descriptor is NOT owned by hardware"));
-                    return STATUS_DRIVER_INTERNAL_ERROR;
+        // In poll mode keep the interrupt masked while the ring has completed
+        // packets, and for PollIdlePasses passes after it is found empty so a
+        // burst does not re-arm it.  The poll timer runs the next pass, past
+        // POLL_MAX_PASSES_PER_SECOND the interrupt paces the DPC instead.
+        // Completed packets with no receive request queued for them park the
+        // poll with the interrupt still masked, PacketPollResume restarts it.
+        if (pDmaExt->bIrqMasked && (pDmaExt->PollBudget != 0) && (pDmaExt->PacketMode == PACKET_MODE_FIFO) &&
+            (pDmaExt->PollPassesInCurrentSecond < POLL_MAX_PASSES_PER_SECOND)) {
+                BOOLEAN Completed = FALSE;
+
+                PacketRingCheckForCompletedPacket(&pDmaExt->Ring, &Completed);
+                if (Completed) {
+                        pDmaExt->PollIdleCount = 0;
+                        if ((pDmaExt->CompRing.pRing == NULL) &&
+                            WDF_IO_QUEUE_IDLE(WdfIoQueueGetState(pDmaExt->TransactionQueue, NULL, NULL))) {
+                                bParked = TRUE;
+                        } else {
+                                bRepoll = TRUE;
+                        }
+                } else if (++pDmaExt->PollIdleCount < pDmaExt->PollIdlePasses) {
+                        bRepoll = TRUE;
                 }
-            } else {  // This Packet is not complete, exit out.
-               KdPrintEx((1, DPFLTR_INFO_LEVEL, "Packet is not complete, exiting"));
-                return STATUS_SUCCESS;
-            }
-        } while ((!(CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET)) && ((++NumberOfCheckedDescriptors) < pDmaExt->NumberOfUsedDescriptors));
-
-        if (NumberOfCheckedDescriptors >= pDmaExt->NumberOfUsedDescriptors) {
-           KdPrintEx((1, DPFLTR_ERROR_LEVEL,"Overran the ring"));
-            return STATUS_UNSUCCESSFUL;
         }
+        pDmaExt->bPollParked = bParked;
+        if (bRepoll) {
+                pDmaExt->PollPassesInCurrentSecond++;
+                DMADriverPollTimerStart(pDmaExt);
+        } else if (!bParked) {
+                pDmaExt->PollIdleCount = 0;
+                pDmaExt->bIrqMasked = FALSE;
+                DMADriverAckDmaInterrupt(pDmaExt);
+        }
+        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
 
-        // If we exit the while loop then we have a completed packet
-        *Completed = TRUE;
-        return STATUS_SUCCESS;
-
-    } else {
-        // This is not necessarily an error. We could be looping past a completed packet to the next
-        // DMA Descriptor that has not started to be DMA'd yet.
-        return STATUS_SUCCESS;
-    }
+        Elapsed = (UINT64) (KeQueryPerformanceCounter(NULL).QuadPart - StartTime.QuadPart);
+        if (bPollPass) {
+                pDmaExt->PollTimeInCurrentSecond += Elapsed;
+        } else {
+                pDmaExt->IntTimeInCurrentSecond += Elapsed;
+        }
 }
 
-static NTSTATUS CompleteReceivedPacket(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PPACKET_RET_RECEIVE_STRUCT pRecvPacketRet)
+/*! PacketPollResume
+ *
+ *  \brief Restarts a poll that PacketC2SDpc parked because completed packets
+ *   had no receive request to take them.  Called after a PACKET_RECEIVE.
+ *  \param pDmaExt - Pointer to the DMA Engine Context
+ *  \return nothing
+ */
+VOID PacketPollResume(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
 {
-    PDRIVER_DESC_STRUCT pDrvDesc;
-    PDMA_DESCRIPTOR_STRUCT pHWDesc;
-    UINT32 CachedDescStatus;
-    NTSTATUS status = STATUS_DRIVER_INTERNAL_ERROR;
-    LONG NumberOfCheckedDescriptors=0;
-
-    pDrvDesc = pDmaExt->pNextDesc;
-    pHWDesc = pDrvDesc->pHWDesc;
-
-    // Walk the descriptors again looking for the EOP descriptor. It could be this descriptor
-    do {
-        // Save a copy of the status flags for later loop while test
-        CachedDescStatus = pHWDesc->C2S.StatusFlags_BytesCompleted;
-
-        // Get the bytes transfered before we clear this field below
-        pRecvPacketRet->Length += (CachedDescStatus & PACKET_DESC_COMPLETE_BYTE_COUNT_MASK);
-
-        // The descriptor is now "owned" by software and will not get it back until
-        // the application does another PACKET_RECEIVE_IOCTL with this "token"
-        // Indicate we processed this descriptor by clearing all but the SOP and EOP flags
-        pHWDesc->C2S.StatusFlags_BytesCompleted &= (PACKET_DESC_C2S_STAT_START_OF_PACKET | PACKET_DESC_C2S_STAT_END_OF_PACKET);
-        pDrvDesc->DescFlags = DESC_FLAGS_SW_OWNED;
-
-        if (CachedDescStatus & PACKET_DESC_C2S_STAT_START_OF_PACKET) {
-            pRecvPacketRet->RxToken = pDrvDesc->DescriptorNumber;
-            pRecvPacketRet->Address = (UINT64)pDrvDesc->SystemAddressVirt;
-
-            // Make sure we flush the processor(s) caches for this memory.
-            // It should not be cached so this should take almost zero time.
-            // This is strickly a precaution.
-            KeFlushIoBuffers(pDmaExt->PMdl, TRUE, TRUE);
-        }
-        if (CachedDescStatus & PACKET_DESC_C2S_STAT_ERROR) {
-            // Indicate a bad packet by zeroing out the address and Length fields
-            pRecvPacketRet->Address = 0;
-            pRecvPacketRet->Length = 0;
-            pDrvDesc->DescFlags = DESC_FLAGS_SW_FREED;
-           KdPrintEx((1, DPFLTR_ERROR_LEVEL,"Received a bad packet"));
-        }
-
-        if (CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET) {
-
-            // Return the EOP UserStatus to the application
-            pRecvPacketRet->UserStatus = pHWDesc->C2S.UserStatus;
-
-            // Make sure the return token is valid
-            if (pRecvPacketRet->RxToken == INVALID_RELEASE_TOKEN) {
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL,"Bad Token Return in Receive Process"));
-            } else if (pRecvPacketRet->Address) {
-                status = STATUS_SUCCESS;
-            } else {
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL,"Found an error during the End of packet. The address is zero."));
-            }
+        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+        if (pDmaExt->bPollParked) {
+                pDmaExt->bPollParked = FALSE;
+                DMADriverPollTimerStart(pDmaExt);
         }
-
-        // Link to the next descriptor in the chain
-        pDrvDesc = pDrvDesc->pNextDesc;
-        pHWDesc = pDrvDesc->pHWDesc;
-
-    } while ((!(CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET)) && ((++NumberOfCheckedDescriptors) < pDmaExt->NumberOfUsedDescriptors));
-
-    if (NumberOfCheckedDescriptors >= pDmaExt->NumberOfUsedDescriptors) {
-       KdPrintEx((1, DPFLTR_ERROR_LEVEL,"Overran the ring"));
-        status = STATUS_DRIVER_INTERNAL_ERROR;
-    }
-
-    // We consider this descriptor processed at this point, link to the next descriptor in the chain
-    pDmaExt->pNextDesc = pDrvDesc;
-
-    return status;
+        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
 }
 
+// FIFO Packet Mode functions
+
 static void InitRecvPacket(PPACKET_RET_RECEIVE_STRUCT pRecvPacketRet)
 {
     // Zero out the return length, address and set Token to -1
@@ -952,16 +1143,32 @@ static void InitRecvPacket(PPACKET_RET_RECEIVE_STRUCT pRecvPacketRet)
     pRecvPacketRet->UserStatus = 0;
 }
 
+static NTSTATUS PacketCompleteReceivedPacket(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PPACKET_RET_RECEIVE_STRUCT pRecvPacketRet)
+{
+        NTSTATUS status;
+
+        status = PacketRingStatus(PacketRingCompleteReceivedPacket(&pDmaExt->Ring, pRecvPacketRet));
+        if (pRecvPacketRet->Address != 0) {
+                // Make sure we flush the processor(s) caches for this memory.
+                // It should not be cached so this should take almost zero time.
+                // This is strickly a precaution.
+                KeFlushIoBuffers(pDmaExt->PMdl, TRUE, TRUE);
+        }
+        return status;
+}
+
 /*! PacketProcessCompletedReceives
  *
  *  \brief This routine processes completed DMA Packet descriptors,
  *   dequeues requests and completes them
  *     \param pDevExt - Pointer to the driver context for this adapter
  *  \param pDmaExt - Pointer to the DMA Engine Context
+ *  \param pBudget - Packets that may be completed, decremented for each one.
+ *     NULL for no limit.
  *     \return STATUS_SUCCESS if it works, an error if it fails.
  *     \note This routine must be called while protected by a spinlock
  */
-NTSTATUS PacketProcessCompletedReceives(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
+NTSTATUS PacketProcessCompletedReceives(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN OUT PUINT32 pBudget OPTIONAL)
 {
         PPACKET_RET_RECEIVE_STRUCT pRecvPacketRet;
         WDFREQUEST Request;
@@ -977,8 +1184,11 @@ NTSTATUS PacketProcessCompletedReceives(IN PDEVICE_EXTENSION pDevExt, IN PDMA_EN
         while (!WDF_IO_QUEUE_IDLE(WdfIoQueueGetState(pDmaExt->TransactionQueue, NULL, NULL))) {
                 BOOLEAN Completed;
 
+                if ((pBudget != NULL) && (*pBudget == 0)) {
+                        break;
+                }
                 // Stage 1: Make sure we have a completed DMA PAcket, i.e. both SOP and EOP completed descriptor(s)
-                status = CheckForCompletedPacket(pDmaExt, &Completed);
+                status = PacketRingStatus(PacketRingCheckForCompletedPacket(&pDmaExt->Ring, &Completed));
                 if (!NT_SUCCESS(status) || (Completed == FALSE)) {
                     goto PacketProcessCompletedReceivesExit;
                 }
@@ -991,8 +1201,11 @@ NTSTATUS PacketProcessCompletedReceives(IN PDEVICE_EXTENSION pDevExt, IN PDMA_EN
                         status = WdfRequestRetrieveOutputBuffer(Request, sizeof(PACKET_RET_RECEIVE_STRUCT), &pRecvPacketRet, &bufferSize);
                         if (NT_SUCCESS(status)) {
                                 InitRecvPacket(pRecvPacketRet);
-                                status = CompleteReceivedPacket(pDmaExt, pRecvPacketRet);
+                                status = PacketCompleteReceivedPacket(pDmaExt, pRecvPacketRet);
                                 WdfRequestCompleteWithInformation(Request, status, sizeof(PACKET_RET_RECEIVE_STRUCT));
+                                if (pBudget != NULL) {
+                                        (*pBudget)--;
+                                }
                                 if (NT_SUCCESS(status)) {
                                     pDmaExt->TimeoutCount = CARD_WATCHDOG_INTERVAL; 
                                 }
@@ -1040,13 +1253,13 @@ NTSTATUS PacketProcessCompletedReceiveNB(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt
                 InitRecvPacket(pRecvPacketRet);
 
                 // Stage 1: Make sure we have a completed DMA PAcket, i.e. both SOP and EOP completed descriptor(s)
-                status = CheckForCompletedPacket(pDmaExt, &Completed);
+                status = PacketRingStatus(PacketRingCheckForCompletedPacket(&pDmaExt->Ring, &Completed));
                 if (!NT_SUCCESS(status) || (Completed == FALSE)) {
                     goto PacketProcessCompletedReceiveNBExit;
                 }
 
                 // Stage 2: We have a completed packet.
-                status = CompleteReceivedPacket(pDmaExt, pRecvPacketRet);
+                status = PacketCompleteReceivedPacket(pDmaExt, pRecvPacketRet);
                 if (NT_SUCCESS(status)) {
                     pDmaExt->TimeoutCount = CARD_WATCHDOG_INTERVAL; 
                 }
@@ -1075,121 +1288,145 @@ PacketProcessCompletedReceiveNBExit:
  */
 NTSTATUS PacketProcessReturnedDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN UINT32 ReturnToken)
 {
-        PDRIVER_DESC_STRUCT pDrvDesc;
-        PDRIVER_DESC_STRUCT pPrevDrvDesc;
-        PDMA_DESCRIPTOR_STRUCT pHWDesc;
-        UINT32 DescriptorState = DESC_FLAGS_HW_OWNED;
-        UINT32 CachedDescStatus = 0;
-        NTSTATUS status = STATUS_SUCCESS;
-        LONG NumberOfCheckedDescriptors=0;
+        NTSTATUS status;
 
         UNREFERENCED_PARAMETER(pDevExt);
 
         // We only want one thread processing descriptors at a time.
         WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
 
-        // Stage 1: Determine if this token is at the tail or will create a 'hole' in the list
-        // Get the descriptor that is at the tail of the queue
-        pDrvDesc = pDmaExt->pTailDesc->pNextDesc;
-        pHWDesc = pDrvDesc->pHWDesc;
-        if (pDrvDesc->DescFlags != DESC_FLAGS_SW_OWNED) {
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Returned Token %d is NOT owned by Software (Flags:0x%x)", ReturnToken, pDrvDesc->DescFlags));
-                status = STATUS_INVALID_PARAMETER;
-                goto PacketProcessReturnedDescriptorsExit;
+        status = PacketRingStatus(PacketRingReturnDescriptors(&pDmaExt->Ring, ReturnToken));
+        if (!NT_SUCCESS(status)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMA Engine %d, Return Token %d failed 0x%x", pDmaExt->DmaEngine, ReturnToken, status));
         }
-        if ((pHWDesc->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_START_OF_PACKET) != PACKET_DESC_C2S_STAT_START_OF_PACKET) {
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Descriptor at Token %d is not SOP", ReturnToken));
-                status = STATUS_INVALID_PARAMETER;
-                goto PacketProcessReturnedDescriptorsExit;
+
+        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+        return status;
+}
+
+/*! PacketProcessReturnedDescriptorsBatch
+ *
+ *    \brief This routine returns the descriptors of several received
+ *      packets and updates the pointer once
+ *  \param pDmaExt - Pointer to the DMA Engine Context
+ *  \param pReturnRecvs - Tokens to return, RetNumTokens is filled in.  NumTokens
+ *     must have been checked against the buffer size.
+ *  \return STATUS_SUCCESS if every token was returned, an error if one failed.
+ */
+NTSTATUS PacketProcessReturnedDescriptorsBatch(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PPACKET_RETURN_RECVS_STRUCT pReturnRecvs)
+{
+        UINT32 NumReturned;
+        NTSTATUS status;
+
+        // We only want one thread processing descriptors at a time.
+        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+
+        if (pReturnRecvs->Flags & PACKET_RETURN_THROUGH) {
+                status = PacketRingStatus(PacketRingReturnDescriptorsThrough(&pDmaExt->Ring, pReturnRecvs->Tokens[0], &NumReturned));
+        } else {
+                status = PacketRingStatus(PacketRingReturnDescriptorsBatch(&pDmaExt->Ring, pReturnRecvs->Tokens, pReturnRecvs->NumTokens, &NumReturned));
         }
+        pReturnRecvs->RetNumTokens = NumReturned;
 
-        pPrevDrvDesc = pDrvDesc;
-
-        // See if the Returned decscriptor (token) is next in line.
-        if (pDrvDesc->DescriptorNumber != ReturnToken) {
-                // In this case we are not at the tail, hence we just "free" the descriptor
-                // Get the Descriptor at the Token Index into the descriptor array
-                pDrvDesc = &pDmaExt->pDrvDescBase[ReturnToken];
-                pHWDesc = pDrvDesc->pHWDesc;
-                // Make sure the Token matches the Desciptor
-                if (pDrvDesc->DescriptorNumber == ReturnToken) {
-                        if ((pHWDesc->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_START_OF_PACKET) != PACKET_DESC_C2S_STAT_START_OF_PACKET) {
-                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Descriptor at Return Token %d is not SOP", ReturnToken));
-                                status = STATUS_INVALID_PARAMETER;
-                                goto PacketProcessReturnedDescriptorsExit;
-                        }
-                        DescriptorState = DESC_FLAGS_SW_FREED;
-                } else {
-                        // Log error and exit
-                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMA Engine %d, Descriptor %d number does not match ReturnToken %d", pDmaExt->DmaEngine, pDrvDesc->DescriptorNumber, ReturnToken));
-                        status = STATUS_INVALID_PARAMETER;
-                        goto PacketProcessReturnedDescriptorsExit;
-                }
+        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+
+        if (!NT_SUCCESS(status)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMA Engine %d, Return of %d Tokens failed 0x%x, %d returned", pDmaExt->DmaEngine, pReturnRecvs->NumTokens, status, NumReturned));
         }
-        // Stage 2: Walk the list starting at the token and either Free or mark for HW the descriptor(s)
-        // Make sure the token is the start of the packet. If not it is either an app error or something worse
-        if (pHWDesc->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_START_OF_PACKET) {
-                CachedDescStatus = pHWDesc->C2S.StatusFlags_BytesCompleted;
-                // Walk the descriptors looking for the EOP descriptor. It could be this descriptor
-                do {
-                        if (pDrvDesc->DescFlags != DESC_FLAGS_HW_OWNED) {
-                                // We can change ownership back to hardware since we sill be setting the SwDescPtr
-                                pDrvDesc->DescFlags = DescriptorState;
-                                // Save a copy of the status flags for later loop while test
-                                CachedDescStatus = pHWDesc->C2S.StatusFlags_BytesCompleted;
-                                // Clear the status just in case
-                                pHWDesc->C2S.StatusFlags_BytesCompleted = 0;
-                                // Cache the current Descriptor
-                                pPrevDrvDesc = pDrvDesc;
-                                // Link to the next descriptor
-                                pDrvDesc = pDrvDesc->pNextDesc;
-                                pHWDesc = pDrvDesc->pHWDesc;
-                        } else {
-                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Returned Token %d descriptor is owned by hardware (Flags:0x%x)", ReturnToken, pDrvDesc->DescFlags));
-                                status = STATUS_INVALID_PARAMETER;
-                                goto PacketProcessReturnedDescriptorsExit;
-                        }
-                } while ((!(CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET)) && ((++NumberOfCheckedDescriptors) < pDmaExt->NumberOfUsedDescriptors));
+        return status;
+}
 
-                if (NumberOfCheckedDescriptors >= pDmaExt->NumberOfUsedDescriptors) {
-                   KdPrintEx((1, DPFLTR_ERROR_LEVEL,"Overran the receive ring"));
-                    status = STATUS_DRIVER_INTERNAL_ERROR;
-                    goto PacketProcessReturnedDescriptorsExit;
-                }
+/*! PacketProcessCompRing
+ *
+ *  \brief This routine gives the descriptors of the completion ring entries
+ *   the application has consumed back to the DMA Engine, then fills the
+ *   ring with the completed packets at the head of the C2S ring.
+ *  \param pDmaExt - Pointer to the DMA Engine Context
+ *  \param pBudget - Entries that may be filled, decremented for each one.  NULL for no limit.
+ *  \return STATUS_SUCCESS if it works, an error if it fails.
+ *  \note The application writes ConsumerIndex, it is read once and range
+ *   checked.  The tokens returned are the driver's copies.
+ */
+NTSTATUS PacketProcessCompRing(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN OUT PUINT32 pBudget OPTIONAL)
+{
+        PCOMP_RING pCompRing = &pDmaExt->CompRing;
+        PPACKET_COMP_ENTRY_STRUCT pEntry;
+        PACKET_RET_RECEIVE_STRUCT RecvPacket;
+        UINT32 Consumer;
+        UINT32 Index;
+        UINT32 Count;
+        UINT32 NumReturned;
+        UINT32 Produced = 0;
+        BOOLEAN Completed;
+        NTSTATUS packetStatus;
+        NTSTATUS status = STATUS_SUCCESS;
 
-        } else {
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Returned Token %d Descriptor missing SOP", ReturnToken));
-                status = STATUS_DRIVER_INTERNAL_ERROR;
-                goto PacketProcessReturnedDescriptorsExit;
+        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+
+        if (pCompRing->pRing == NULL) {
+                goto PacketProcessCompRingExit;
         }
 
-        // Stage 3: If not a 'freed hole' then advance the list, look for freed descriptors ahead first
-        if (DescriptorState == DESC_FLAGS_HW_OWNED) {
-                // pDesc is pointing to the descriptor following the EOP
-                // Now see if there are any previously 'freed' descriptors ahead of us.
-                NumberOfCheckedDescriptors = 0;
-                while ((pDrvDesc->DescFlags == DESC_FLAGS_SW_FREED) && ((++NumberOfCheckedDescriptors) < pDmaExt->NumberOfUsedDescriptors)) {
-                        // And mark it as HW Owned
-                        pDrvDesc->DescFlags = DESC_FLAGS_HW_OWNED;
-                        // Cache the current Descriptor
-                        pPrevDrvDesc = pDrvDesc;
-                        // Link to the next descriptor
-                        pDrvDesc = pDrvDesc->pNextDesc;
-                        pHWDesc = pDrvDesc->pHWDesc;
+        // Stage 1: Return the descriptors of the entries the application is done with
+        Consumer = pCompRing->pRing->ConsumerIndex;
+        if ((Consumer - pCompRing->Consumer) > (pCompRing->Producer - pCompRing->Consumer)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMA Engine %d, Bad completion ring ConsumerIndex %d (%d - %d)\n",
+                          pDmaExt->DmaEngine, Consumer, pCompRing->Consumer, pCompRing->Producer));
+                Consumer = pCompRing->Consumer;
+        }
+        // One batch per contiguous run of entries, two when the run wraps
+        while (pCompRing->Consumer != Consumer) {
+                Index = pCompRing->Consumer & (pCompRing->NumEntries - 1);
+                Count = Consumer - pCompRing->Consumer;
+                if (Count > (pCompRing->NumEntries - Index)) {
+                        Count = pCompRing->NumEntries - Index;
+                }
+                packetStatus = PacketRingStatus(PacketRingReturnDescriptorsBatch(&pDmaExt->Ring, &pCompRing->pTokens[Index], Count, &NumReturned));
+                if (!NT_SUCCESS(packetStatus)) {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMA Engine %d, Return of %d Tokens failed 0x%x", pDmaExt->DmaEngine, Count, packetStatus));
+                }
+                pCompRing->Consumer += Count;
+                while (Count-- != 0) {
+                        pCompRing->pTokens[Index++] = INVALID_RELEASE_TOKEN;
                 }
+        }
 
-                if (NumberOfCheckedDescriptors >= pDmaExt->NumberOfUsedDescriptors) {
-                   KdPrintEx((1, DPFLTR_ERROR_LEVEL,"Overran the receive ring"));
-                    status = STATUS_DRIVER_INTERNAL_ERROR;
-                    goto PacketProcessReturnedDescriptorsExit;
+        // Stage 2: Fill the free entries with completed packets
+        while ((pCompRing->Producer - pCompRing->Consumer) < pCompRing->NumEntries) {
+                if ((pBudget != NULL) && (*pBudget == 0)) {
+                        break;
+                }
+                status = PacketRingStatus(PacketRingCheckForCompletedPacket(&pDmaExt->Ring, &Completed));
+                if (!NT_SUCCESS(status) || (Completed == FALSE)) {
+                        break;
+                }
+                InitRecvPacket(&RecvPacket);
+                packetStatus = PacketCompleteReceivedPacket(pDmaExt, &RecvPacket);
+
+                Index = pCompRing->Producer & (pCompRing->NumEntries - 1);
+                pEntry = &pCompRing->pRing->Entries[Index];
+                pEntry->Address = RecvPacket.Address;
+                pEntry->Length = RecvPacket.Length;
+                pEntry->Status = NT_SUCCESS(packetStatus) ? 0 : PACKET_ERROR_MALFORMED;
+                pEntry->UserStatus = RecvPacket.UserStatus;
+                pEntry->RxToken = RecvPacket.RxToken;
+                pCompRing->pTokens[Index] = RecvPacket.RxToken;
+                pCompRing->Producer++;
+                Produced++;
+                if (pBudget != NULL) {
+                        (*pBudget)--;
                 }
+        }
 
-                // Set the last descriptor as the new end and update the Tail pointer
-                pDmaExt->pDmaEng->SoftwareDescriptorPtr = pPrevDrvDesc->pHWDescPhys.LowPart;
-                pDmaExt->pTailDesc = pPrevDrvDesc;
+        if (Produced != 0) {
+                // The entries must be visible before the index that covers them
+                KeMemoryBarrier();
+                pCompRing->pRing->ProducerIndex = pCompRing->Producer;
+                pDmaExt->TimeoutCount = CARD_WATCHDOG_INTERVAL;
         }
 
-PacketProcessReturnedDescriptorsExit:
+PacketProcessCompRingExit:
+
         WdfSpinLockRelease(pDmaExt->DmaSpinLock);
         return status;
 }
@@ -1211,6 +1448,8 @@ NTSTATUS PacketReadComplete(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_
         PPACKET_RET_READ_STRUCT pReadRetPacket;
         size_t ReadRetPacketSize = 0;
         BOOLEAN transactionComplete;
+        UINT32 Retired = 0;
+        UINT32 Index;
         NTSTATUS status = STATUS_SUCCESS;
 
         UNREFERENCED_PARAMETER(pDevExt);
@@ -1219,16 +1458,14 @@ NTSTATUS PacketReadComplete(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_
         WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
 
         // Make sure we have completed descriptor(s)
-        pDrvDesc = pDmaExt->pTailDesc;
-        pHWDesc = pDrvDesc->pHWDesc;
-       KdPrintEx((1, DPFLTR_INFO_LEVEL, "PacketReadComplete Desc [%p] status 0x%x", pDrvDesc, pHWDesc->C2S.StatusFlags_BytesCompleted));
+        Index = pDmaExt->Ring.TailIndex;
+        pDrvDesc = PacketRingDesc(&pDmaExt->Ring, Index);
+        pHWDesc = PacketRingHWDesc(&pDmaExt->Ring, Index);
+       KdPrintEx((1, DPFLTR_INFO_LEVEL, "PacketReadComplete Desc [%d] status 0x%x", Index, pHWDesc->C2S.StatusFlags_BytesCompleted));
         while ((pHWDesc->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_COMPLETE) || (pHWDesc->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_ERROR)) {
                 // At this point we know we have a completed Send DMA Descriptor
-                // Update the contexts links to the next descriptor
-                pDmaExt->pTailDesc = pDrvDesc->pNextDesc;
-
                 if (pDrvDesc->DmaTransaction != NULL) {
-                        _InterlockedDecrement(&pDmaExt->NumberOfUsedDescriptors);
+                        Retired++;
 
                         // The Transaction data pointer is in every decriptor for a given Request
                         pDmaXfer = DMAXferContext(pDrvDesc->DmaTransaction);
@@ -1265,7 +1502,7 @@ NTSTATUS PacketReadComplete(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_
                                         }
 
                                         // Retrieve the originating request from the Transaction data extension
-                                        Request = FindRequestByRequest(pDmaExt, pDmaXfer->Request);
+                                        Request = PacketRetireRequest(pDmaExt, pDmaXfer);
                                         if (Request != NULL) {
                                                 // get the output buffer pointer
                                                 status = WdfRequestRetrieveOutputBuffer(Request, (size_t) sizeof(PPACKET_RET_READ_STRUCT),      // Min size
@@ -1281,10 +1518,9 @@ NTSTATUS PacketReadComplete(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_
                                                         WdfRequestCompleteWithInformation(Request, status, ReadRetPacketSize);
                                                 }
                                         }
-                                        // Release the Transaction record
+                                        // Release the Transaction record and return it to the pool
                                         WdfDmaTransactionRelease(pDrvDesc->DmaTransaction);
-                                        pDmaXfer->Request = NULL;
-                                        WdfObjectDelete(pDrvDesc->DmaTransaction);
+                                        PacketPutTransaction(pDmaExt, pDrvDesc->DmaTransaction);
                                         pDmaXfer = NULL;
                                 }
                         }
@@ -1293,10 +1529,13 @@ NTSTATUS PacketReadComplete(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_
                 pDrvDesc->DmaTransaction = NULL;
                 pHWDesc->C2S.StatusFlags_BytesCompleted = 0;
 
-                // Link to the next packets
-                pDrvDesc = pDrvDesc->pNextDesc; // Link to the next descriptor in the chain
-                pHWDesc = pDrvDesc->pHWDesc;
+                // Move to the next descriptor in the ring
+                Index = PacketRingNextIndex(&pDmaExt->Ring, Index);
+                pDrvDesc = PacketRingDesc(&pDmaExt->Ring, Index);
+                pHWDesc = PacketRingHWDesc(&pDmaExt->Ring, Index);
         }
+        pDmaExt->Ring.TailIndex = Index;
+        pDmaExt->Ring.NumberOfUsedDescriptors -= Retired;
         WdfSpinLockRelease(pDmaExt->DmaSpinLock);
 
         return STATUS_SUCCESS;
@@ -1317,6 +1556,8 @@ VOID PacketReadRequestCancel(IN WDFQUEUE Queue, IN WDFREQUEST Request)
         PDMA_DESCRIPTOR_STRUCT pHWDesc;
         PDMA_XFER pDmaXfer;
         WDFREQUEST CancelRequest;
+        UINT32 Retired = 0;
+        UINT32 Index;
         NTSTATUS status;
 
        KdPrintEx((1, DPFLTR_WARNING_LEVEL, "In function PacketReadRequestCancel"));
@@ -1330,11 +1571,10 @@ VOID PacketReadRequestCancel(IN WDFQUEUE Queue, IN WDFREQUEST Request)
         WdfRequestGetParameters(Request, &Params);
 
         if (Params.Parameters.DeviceIoControl.IoControlCode == PACKET_READ_IOCTL) {
-                pDrvDesc = pDmaExt->pTailDesc;
-                pHWDesc = pDrvDesc->pHWDesc;
-                while (pDrvDesc != pDmaExt->pNextDesc) {
-                        // Update the contexts links to the next descriptor
-                        pDmaExt->pTailDesc = pDrvDesc->pNextDesc;
+                Index = pDmaExt->Ring.TailIndex;
+                pDrvDesc = PacketRingDesc(&pDmaExt->Ring, Index);
+                pHWDesc = PacketRingHWDesc(&pDmaExt->Ring, Index);
+                while (Index != pDmaExt->Ring.NextIndex) {
                         if (pDrvDesc->DmaTransaction != NULL) {
                                 // The Transaction data pointer is in every decriptor for a given Request
                                 pDmaXfer = DMAXferContext(pDrvDesc->DmaTransaction);
@@ -1349,34 +1589,33 @@ VOID PacketReadRequestCancel(IN WDFQUEUE Queue, IN WDFREQUEST Request)
                                                 } else {
                                                        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketReadRequestCancel: pMDL = NULL"));
                                                 }
-                                                if (Request != pDmaXfer->Request) {
-                                                        CancelRequest = FindRequestByRequest(pDmaExt, pDmaXfer->Request);
-                                                        if (CancelRequest != NULL) {
-                                                                // complete the transaction
-                                                                WdfRequestCompleteWithInformation(CancelRequest, STATUS_CANCELLED, 0);
-                                                        }
+                                                CancelRequest = PacketRetireRequest(pDmaExt, pDmaXfer);
+                                                if ((CancelRequest != NULL) && (CancelRequest != Request)) {
+                                                        // complete the transaction
+                                                        WdfRequestCompleteWithInformation(CancelRequest, STATUS_CANCELLED, 0);
                                                 }
-                                                // Release the Transaction record
-                                                pDmaXfer->Request = NULL;
+                                                // Release the Transaction record and return it to the pool
                                                 WdfDmaTransactionRelease(pDrvDesc->DmaTransaction);
-                                                WdfObjectDelete(pDrvDesc->DmaTransaction);
+                                                PacketPutTransaction(pDmaExt, pDrvDesc->DmaTransaction);
                                                 pDmaXfer = NULL;
                                         }
                                 }
                         }       // if (pDesc->Packet.C2S.DmaTransaction...
 
-                        _InterlockedDecrement(&pDmaExt->NumberOfUsedDescriptors);
+                        Retired++;
                         // Clear the byte count and the SOP and EOP
                         pHWDesc->C2S.ControlFlags_ByteCount = 0;
                         pHWDesc->C2S.StatusFlags_BytesCompleted = PACKET_DESC_C2S_STAT_ERROR;
                         pDrvDesc->DmaTransaction = NULL;
-                        pDrvDesc->pScatterGatherList = 0;
-
-                        pDrvDesc = pDrvDesc->pNextDesc; // Link to the next descriptor in the chain
-                        pHWDesc = pDrvDesc->pHWDesc;
-                }               // while (pDesc != pDmaExt->pNextDesc)
+                        PacketRingDescCold(&pDmaExt->Ring, Index)->pScatterGatherList = NULL;
+
+                        Index = PacketRingNextIndex(&pDmaExt->Ring, Index);
+                        pDrvDesc = PacketRingDesc(&pDmaExt->Ring, Index);
+                        pHWDesc = PacketRingHWDesc(&pDmaExt->Ring, Index);
+                }               // while (Index != pDmaExt->Ring.NextIndex)
+                pDmaExt->Ring.TailIndex = Index;
+                pDmaExt->Ring.NumberOfUsedDescriptors -= Retired;
         }
-        FindRequestByRequest(pDmaExt, Request);
         // complete the transaction
         WdfRequestCompleteWithInformation(Request, STATUS_CANCELLED, 0);
 
@@ -1384,76 +1623,6 @@ VOID PacketReadRequestCancel(IN WDFQUEUE Queue, IN WDFREQUEST Request)
         return;
 }
 
-static BOOLEAN PacketProcessCompletedFreeRunDescriptorsFindEOP(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
-{
-    PDRIVER_DESC_STRUCT pDrvDesc;
-    PDMA_DESCRIPTOR_STRUCT pHWDesc;
-    UINT32 StatusFlags_BytesCompleted;
-
-    pDrvDesc = pDmaExt->pNextDesc;
-    pHWDesc = pDrvDesc->pHWDesc;
-
-    /*
-     * Don't go around the descriptor ring more then once.
-     */
-    do
-    {
-        StatusFlags_BytesCompleted = pHWDesc->C2S.StatusFlags_BytesCompleted;
-        if (!(StatusFlags_BytesCompleted & (PACKET_DESC_C2S_STAT_COMPLETE | PACKET_DESC_C2S_STAT_ERROR))) {
-            return FALSE;
-        }
-        if (StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_END_OF_PACKET)
-        {
-            return TRUE;
-        }
-
-        pDrvDesc = pDrvDesc->pNextDesc; 
-        pHWDesc = pDrvDesc->pHWDesc;
-
-    } while (pDrvDesc != pDmaExt->pNextDesc);
-
-    return FALSE;
-}
-
-/*
- * Setting the IRQ bits in a HW descriptor will cause an interrupt if the
- * DMA engine processes that descriptor. When this happens you know there has been a
- * DMA overrun. The detection algorithm is to set the IRQ bits in the first descriptor
- * of a group of packets, then clear them the next time PacketRecvsIOCtlHandler() is
- * called to process a packet. Wash rinse repeat...
-*/
-#define PACKET_RECVS_IRQ_BITS (PACKET_DESC_S2C_CTRL_IRQ_ON_COMPLETE | PACKET_DESC_S2C_CTRL_IRQ_ON_ERROR)
-
-static void PacketProcessCompletedFreeRunDescriptorsClearIRQ(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
-{
-    if (pDmaExt->pIrqDesc)
-    {
-        pDmaExt->pIrqDesc->pHWDesc->C2S.ControlFlags_ByteCount &= (~PACKET_RECVS_IRQ_BITS);
-        pDmaExt->pIrqDesc = NULL;
-    }
-}
-
-static void PacketProcessCompletedFreeRunDescriptorsSetIRQ(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, PDRIVER_DESC_STRUCT pDrvDesc)
-{
-    PacketProcessCompletedFreeRunDescriptorsClearIRQ(pDmaExt);
-
-    pDrvDesc->pHWDesc->C2S.ControlFlags_ByteCount |= PACKET_RECVS_IRQ_BITS;
-    pDmaExt->pIrqDesc = pDrvDesc;
-}
-
-static void PacketProcessCompletedFreeRunDescriptorsResetLastIRQ(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
-{
-    if (pDmaExt->pIrqDesc && pDmaExt->pIrqDesc->pNextDesc != pDmaExt->pNextDesc)
-    {
-        PDRIVER_DESC_STRUCT pDrvDesc = pDmaExt->pIrqDesc;
-        while (pDrvDesc->pNextDesc != pDmaExt->pNextDesc)
-        {
-            pDrvDesc = pDrvDesc->pNextDesc;
-        }
-        PacketProcessCompletedFreeRunDescriptorsSetIRQ(pDmaExt, pDrvDesc);
-    }
-}
-
 // Free Run FIFO Packet Mode functions
 /*! PacketProcessCompletedFreeRunDescriptors
  *
@@ -1468,112 +1637,22 @@ static void PacketProcessCompletedFreeRunDescriptorsResetLastIRQ(PDMA_ENGINE_DEV
  */
 NTSTATUS PacketProcessCompletedFreeRunDescriptors(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, PPACKET_RECVS_STRUCT pPacketRecvs)
 {
-        PDRIVER_DESC_STRUCT pDrvDesc;
-        PDRIVER_DESC_STRUCT pPrevDrvDesc = NULL;
-        PDMA_DESCRIPTOR_STRUCT pHWDesc;
-        UINT32 CachedDescStatus = 0;
-        NTSTATUS status = STATUS_SUCCESS;
-        LONG NumberOfCheckedDescriptors=0;
+        NTSTATUS status;
 
         WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
 
-        pPacketRecvs->RetNumEntries = 0;
         pPacketRecvs->EngineStatus = pDmaExt->DMAEngineStatus;
         pDmaExt->DMAEngineStatus = 0;
-        // Loop to file out the packet receives.
-        while (pPacketRecvs->RetNumEntries < pPacketRecvs->AvailNumEntries) {
-                // Zero out the return length, address, etc
-                pPacketRecvs->Packets[pPacketRecvs->RetNumEntries].Length = 0;
-                pPacketRecvs->Packets[pPacketRecvs->RetNumEntries].Address = 0;
-                pPacketRecvs->Packets[pPacketRecvs->RetNumEntries].Status = PACKET_ERROR_MALFORMED;
-                pPacketRecvs->Packets[pPacketRecvs->RetNumEntries].UserStatus = 0;
-
-                if (PacketProcessCompletedFreeRunDescriptorsFindEOP(pDmaExt) != TRUE)
-                {
-                    /*
-                     * We can usually assume the previous packets have been processed by the application
-                     * and can now be released from DMA overrun detection. Note that this may not be an accurate 
-                     * assumption if there are multiple threads calling this IOCTL handler.
-                     */
-                    if (pPacketRecvs->RetNumEntries == 0)
-                    {
-                        PacketProcessCompletedFreeRunDescriptorsResetLastIRQ(pDmaExt);
-                    }
-                    goto PacketProcessCompletedFreeRunDescriptorsExit;
-                }
-
-                /*
-                 * If this is the first loop, and there is an EOP, then set the IRQ bits to detect
-                 * DMA overrun.
-                 */
-                if (pPacketRecvs->RetNumEntries == 0)
-                {
-                    PacketProcessCompletedFreeRunDescriptorsSetIRQ(pDmaExt, pDmaExt->pNextDesc);
-                }
 
-                pDrvDesc = pDmaExt->pNextDesc;;
-                pHWDesc = pDrvDesc->pHWDesc;
-                // Walk the descriptors again retrieving length, addressm etc. and looking for
-                //   the EOP descriptor, it could be this one.
-                do {
-                        CachedDescStatus = pHWDesc->C2S.StatusFlags_BytesCompleted;
-                        // Make sure we have a completed DMA Descriptor.
-                        if (CachedDescStatus & (PACKET_DESC_C2S_STAT_COMPLETE | PACKET_DESC_C2S_STAT_ERROR)) {
-                                // Get the bytes transfered before we clear this field below
-                                pPacketRecvs->Packets[pPacketRecvs->RetNumEntries].Length += (CachedDescStatus & PACKET_DESC_COMPLETE_BYTE_COUNT_MASK);
-                                pHWDesc->C2S.StatusFlags_BytesCompleted = 0;
-                                if (CachedDescStatus & PACKET_DESC_C2S_STAT_START_OF_PACKET) {
-                                        pPacketRecvs->Packets[pPacketRecvs->RetNumEntries].Address = (UINT64) pDrvDesc->SystemAddressVirt;
-                                        if (pDmaExt->PMdl != NULL) {
-                                                // Make sure we flush the processor(s) caches for this memory.
-                                                // Should not be necessary, it is just a precaution.
-                                                KeFlushIoBuffers(pDmaExt->PMdl, TRUE, TRUE);
-                                        }
-                                }
-                                if (CachedDescStatus & PACKET_DESC_C2S_STAT_ERROR) {
-                                        pPacketRecvs->Packets[pPacketRecvs->RetNumEntries].Status = CachedDescStatus & (PACKET_DESC_C2S_STAT_ERROR | PACKET_DESC_C2S_STAT_SHORT);
-                                }
-                                if (CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET) {
-                                        // Return the EOP UserStatus to the application
-                                        pPacketRecvs->Packets[pPacketRecvs->RetNumEntries].UserStatus = pHWDesc->C2S.UserStatus;
-                                        // Since we found the EOP remove the Malformed packet indicator.
-                                        pPacketRecvs->Packets[pPacketRecvs->RetNumEntries].Status &= ~PACKET_ERROR_MALFORMED;
-                                        pPacketRecvs->RetNumEntries++;
-                                }
-                                // Mark the descriptor as HW Owned
-                                pDrvDesc->DescFlags = DESC_FLAGS_HW_OWNED;
-                                // Cache the current Descriptor
-                                pPrevDrvDesc = pDrvDesc;
-                                // Link to the next descriptor
-                                pDrvDesc = pDrvDesc->pNextDesc;
-                                pHWDesc = pDrvDesc->pHWDesc;
-                        } else  // This descriptor is not complete and it should be, exit out.
-                        {
-                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Packet is not complete, exiting"));
-                                status = STATUS_DRIVER_INTERNAL_ERROR;
-                                goto PacketProcessCompletedFreeRunDescriptorsExit;
-                        }
-                } while ((!(CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET)) && ((++NumberOfCheckedDescriptors) < pDmaExt->NumberOfUsedDescriptors));
+        // In FIFO mode the descriptors go back to the DMA Engine as the packets are returned
+        status = PacketRingStatus(PacketRingProcessFreeRun(&pDmaExt->Ring, pPacketRecvs, (BOOLEAN) (pDmaExt->PacketMode == PACKET_MODE_FIFO)));
 
-                if (NumberOfCheckedDescriptors >= pDmaExt->NumberOfUsedDescriptors) {
-                   KdPrintEx((1, DPFLTR_ERROR_LEVEL,"Overran the ring"));
-                    status = STATUS_DRIVER_INTERNAL_ERROR;
-                    goto PacketProcessCompletedFreeRunDescriptorsExit;
-                }
-
-                // We consider this Packet processed at this point, link to the next descriptor in the chain
-                pDmaExt->pNextDesc = pDrvDesc;
-
-                if (pDmaExt->PacketMode == PACKET_MODE_FIFO) {
-                        if (pPrevDrvDesc != NULL) {
-                                // Set the last descriptor as the new end and update the Tail pointer
-                                pDmaExt->pDmaEng->SoftwareDescriptorPtr = pPrevDrvDesc->pHWDescPhys.LowPart;
-                                pDmaExt->pTailDesc = pPrevDrvDesc;
-                        }
-                }
-        }                       // while more packets available to return in the struct...
+        if ((pPacketRecvs->RetNumEntries != 0) && (pDmaExt->PMdl != NULL)) {
+                // Make sure we flush the processor(s) caches for this memory.
+                // Should not be necessary, it is just a precaution.
+                KeFlushIoBuffers(pDmaExt->PMdl, TRUE, TRUE);
+        }
 
-PacketProcessCompletedFreeRunDescriptorsExit:
         WdfSpinLockRelease(pDmaExt->DmaSpinLock);
         return status;
 }
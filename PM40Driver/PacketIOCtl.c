@@ -59,6 +59,7 @@ NTSTATUS PacketBufferAllocate(PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request)
 {
         PDMA_ENGINE_DEVICE_EXTENSION pDmaExt = NULL;
         PREQUEST_CONTEXT reqContext = NULL;
+        PBUF_ALLOC_STRUCT pBufAlloc;
         PMDL Mdl;
         PVOID RetVirtAddress;
         NTSTATUS status = STATUS_SUCCESS;
@@ -81,10 +82,15 @@ NTSTATUS PacketBufferAllocate(PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request)
                                 pDmaExt->PMdl = reqContext->pMdl;
                                 pDmaExt->UserVa = reqContext->pVA;
 
-                                status = WdfRequestRetrieveOutputWdmMdl(Request, &Mdl);
+                                status = WdfRequestRetrieveInputBuffer(Request, sizeof(BUF_ALLOC_STRUCT), (PVOID *) & pBufAlloc, NULL);
+                                if (NT_SUCCESS(status)) {
+                                        status = WdfRequestRetrieveOutputWdmMdl(Request, &Mdl);
+                                }
                                 if (NT_SUCCESS(status)) {
                                         RetVirtAddress = MmGetMdlVirtualAddress(Mdl);
-                                        status = InitializeRxDescriptors(pDevExt, pDmaExt, RetVirtAddress, reqContext->Length);
+                                        // MaxPacketSize only sizes the descriptors when the application asks for it
+                                        status = InitializeRxDescriptors(pDevExt, pDmaExt, RetVirtAddress, reqContext->Length,
+                                                                         (pBufAlloc->AllocationMode & PACKET_ALLOC_MAX_PACKET_DESC) ? pBufAlloc->MaxPacketSize : 0);
                                 }
                         } else {
                                KdPrintEx((1, DPFLTR_WARNING_LEVEL, "Buffer Pool size less than %d not supported.\n", MIN_BUFFER_POOL_SIZE));
@@ -92,7 +98,6 @@ NTSTATUS PacketBufferAllocate(PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request)
                         }
                 }
         } else {
-                PBUF_ALLOC_STRUCT pBufAlloc;
                 status = WdfRequestRetrieveInputBuffer(Request, sizeof(PBUF_ALLOC_STRUCT), &pBufAlloc, NULL);
 
                 if (NT_SUCCESS(status)) {
@@ -158,6 +163,9 @@ NTSTATUS PacketBufferRelease(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request
                         if (pDmaExt->DmaType == DMA_TYPE_PACKET_RECV) {
                                 if ((pDmaExt->PacketMode == PACKET_MODE_FIFO) || (pDmaExt->PacketMode == PACKET_MODE_STREAMING)) {
                                         pDmaExt->bFreeRun = FALSE;
+                                        if (pDmaExt->CompRing.pMdl != NULL) {
+                                                FreeCompRing(pDmaExt);
+                                        }
                                         FreeRxDescriptors(pDevExt, pDmaExt);
                                         if (pDmaExt->PMdl != NULL) {
 //                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketBufferRelease: MDL = 0x%p\n", pDmaExt->PMdl);
@@ -190,6 +198,404 @@ NTSTATUS PacketBufferRelease(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request
         return status;
 }
 
+/*! PacketSendPoolRegister
+ *
+ * \brief This routine is called when a
+ *  PACKET_POOL_REGISTER_IOCTL is sent from the application.
+ *  The buffer locked by DMADriverIoInCallerContext becomes a send pool
+ *  of the S2C DMA Engine and stays locked until it is released.
+ *  This routine is called at IRQL < DISPATCH_LEVEL.
+ * \param pDevExt - Pointer to this drivers context (data store)
+ * \param Request - Pointer to the IOCtl request
+ * \param pInfoSize - Returns the size of the returned SEND_POOL_STRUCT
+ * \return NTSTATUS
+ */
+NTSTATUS PacketSendPoolRegister(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request, OUT size_t * pInfoSize)
+{
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        PREQUEST_CONTEXT reqContext;
+        PSEND_POOL_STRUCT pSendPool;
+        PSEND_POOL pPool = NULL;
+        UINT32 PoolId;
+        NTSTATUS status;
+
+        *pInfoSize = 0;
+
+        reqContext = RequestContext(Request);
+        if ((reqContext == NULL) || (reqContext->pMdl == NULL)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketSendPoolRegister MDL == NULL\n"));
+                return STATUS_ACCESS_VIOLATION;
+        }
+
+        // Get the output buffer, where we return the Pool Id
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(SEND_POOL_STRUCT),      /* Min size */
+                                                (PVOID *) & pSendPool,  /* buffer */
+                                                NULL);
+        if (NT_SUCCESS(status)) {
+                status = GetDMAEngineContext(pDevExt, reqContext->DMAEngine, &pDmaExt);
+                if (NT_SUCCESS(status)) {
+                        status = STATUS_INVALID_DEVICE_REQUEST;
+                        if (pDmaExt->DmaType == DMA_TYPE_PACKET_SEND) {
+                                DMADriverLock(pDmaExt);
+
+                                for (PoolId = 0; PoolId < MAX_SEND_POOLS; PoolId++) {
+                                        if (pDmaExt->SendPool[PoolId].pMdl == NULL) {
+                                                pPool = &pDmaExt->SendPool[PoolId];
+                                                break;
+                                        }
+                                }
+                                if (pPool != NULL) {
+                                        // The pool owns the MDL from here on
+                                        pPool->pMdl = reqContext->pMdl;
+                                        pPool->UserVa = reqContext->pVA;
+                                        pPool->Length = reqContext->Length;
+                                        pPool->FileObject = WdfRequestGetFileObject(Request);
+                                        reqContext->pMdl = NULL;
+
+                                        status = InitializeSendPool(pDevExt, pDmaExt, pPool);
+                                        if (NT_SUCCESS(status)) {
+                                                WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+                                                pPool->SendsOutstanding = 0;
+                                                pPool->bMapped = TRUE;
+                                                WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+
+                                                pSendPool->PoolId = PoolId;
+                                                *pInfoSize = sizeof(SEND_POOL_STRUCT);
+                                        } else {
+                                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Send pool mapping failed 0x%x\n", status));
+                                                FreeSendPool(pDmaExt, pPool);
+                                        }
+                                } else {
+                                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "All %d send pools of DMA Engine %d are registered\n", MAX_SEND_POOLS, pDmaExt->DmaEngine));
+                                        status = STATUS_INSUFFICIENT_RESOURCES;
+                                }
+
+                                DMADriverUnlock(pDmaExt);
+                        }
+                } else {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Send Pool Register DMA Engine number invalid. Status: 0x%x.\n", status));
+                }
+        } else {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- WdfRequestRetrieveOutputBuffer Failed. Status: 0x%x\n", status));
+        }
+        if (reqContext->pMdl != NULL) {
+                FreeReqCtx(reqContext);
+        }
+        return status;
+}
+
+/*! PacketSendPoolRelease
+ *
+ * \brief This routine is called when a
+ *  PACKET_POOL_RELEASE_IOCTL is sent from the application.
+ *  The pool cannot be released while sends from it are on the ring.
+ *  This routine is called at IRQL < DISPATCH_LEVEL.
+ * \param pDevExt - Pointer to this drivers context (data store)
+ * \param Request - Pointer to the IOCtl request
+ * \return NTSTATUS
+ */
+NTSTATUS PacketSendPoolRelease(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request)
+{
+        PSEND_POOL_STRUCT pSendPool;
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        PSEND_POOL pPool;
+        NTSTATUS status = STATUS_SUCCESS;
+
+        // Get the input buffer, where we find the pool to release
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(SEND_POOL_STRUCT),       /* Min size */
+                                               (PVOID *) & pSendPool,   /* buffer */
+                                               NULL);
+        if (status == STATUS_SUCCESS) {
+                status = STATUS_INVALID_DEVICE_REQUEST;
+                // Validate EngineNum
+                if ((pSendPool != NULL) && (pSendPool->EngineNum < MAX_NUM_DMA_ENGINES) && (pDevExt->pDmaEngineDevExt[pSendPool->EngineNum] != NULL)) {
+                        status = GetDMAEngineContext(pDevExt, pSendPool->EngineNum, &pDmaExt);
+                        if (!NT_SUCCESS(status)) {
+                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Send Pool Release DMA Engine number is invalid. Status: 0x%x\n", status));
+                                return status;
+                        }
+                        status = STATUS_INVALID_PARAMETER;
+                        if ((pDmaExt->DmaType == DMA_TYPE_PACKET_SEND) && (pSendPool->PoolId < MAX_SEND_POOLS)) {
+                                pPool = &pDmaExt->SendPool[pSendPool->PoolId];
+
+                                DMADriverLock(pDmaExt);
+
+                                // Stop new sends from the pool
+                                WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+                                if (pPool->bMapped) {
+                                        if (pPool->SendsOutstanding == 0) {
+                                                pPool->bMapped = FALSE;
+                                                status = STATUS_SUCCESS;
+                                        } else {
+                                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Send pool %d has %d sends outstanding\n", pSendPool->PoolId, pPool->SendsOutstanding));
+                                                status = STATUS_DEVICE_BUSY;
+                                        }
+                                }
+                                WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+
+                                if (NT_SUCCESS(status)) {
+                                        FreeSendPool(pDmaExt, pPool);
+                                }
+
+                                DMADriverUnlock(pDmaExt);
+                        }
+                }
+        } else {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- WdfRequestRetrieveInputBuffer Failed. Status: 0x%x\n", status));
+        }
+        return status;
+}
+
+/*! PacketFileCleanup
+ *
+ * \brief Releases the send pools and completion rings a handle registered
+ *  and did not release, before the pages of the closing process are
+ *  unlocked and reused; the DPC must not write a ring after that.  A pool
+ *  with sends on the ring is given SEND_POOL_DRAIN_TIMEOUT_MS to finish.
+ *  This routine is called at PASSIVE_LEVEL from DMADriverEvtFileCleanup.
+ * \param pDevExt - Pointer to this drivers context (data store)
+ * \param FileObject - The handle being closed
+ * \return None
+ */
+VOID PacketFileCleanup(IN PDEVICE_EXTENSION pDevExt, IN WDFFILEOBJECT FileObject)
+{
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        PSEND_POOL pPool;
+        LARGE_INTEGER Interval;
+        UINT32 Outstanding;
+        UINT32 Waited;
+        UINT32 i;
+        UINT32 PoolId;
+
+        Interval.QuadPart = -10 * 1000;         // 1 msec, relative
+        for (i = 0; i < MAX_NUM_DMA_ENGINES; i++) {
+                pDmaExt = pDevExt->pDmaEngineDevExt[i];
+                if (pDmaExt == NULL) {
+                        continue;
+                }
+                if (pDmaExt->DmaType == DMA_TYPE_PACKET_RECV) {
+                        DMADriverLock(pDmaExt);
+                        if ((pDmaExt->CompRing.pMdl != NULL) && (pDmaExt->CompRing.FileObject == FileObject)) {
+                                FreeCompRing(pDmaExt);
+                        }
+                        DMADriverUnlock(pDmaExt);
+                        continue;
+                }
+                if (pDmaExt->DmaType != DMA_TYPE_PACKET_SEND) {
+                        continue;
+                }
+                DMADriverLock(pDmaExt);
+                for (PoolId = 0; PoolId < MAX_SEND_POOLS; PoolId++) {
+                        pPool = &pDmaExt->SendPool[PoolId];
+                        if ((pPool->pMdl == NULL) || (pPool->FileObject != FileObject)) {
+                                continue;
+                        }
+                        // Stop new sends from the pool and let the ones on the ring finish
+                        for (Waited = 0;; Waited++) {
+                                WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+                                pPool->bMapped = FALSE;
+                                Outstanding = pPool->SendsOutstanding;
+                                WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+                                if ((Outstanding == 0) || (Waited >= SEND_POOL_DRAIN_TIMEOUT_MS)) {
+                                        break;
+                                }
+                                KeDelayExecutionThread(KernelMode, FALSE, &Interval);
+                        }
+                        if (Outstanding != 0) {
+                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Send pool %d of DMA Engine %d released with %d sends outstanding\n", PoolId, pDmaExt->DmaEngine, Outstanding));
+                        }
+                        FreeSendPool(pDmaExt, pPool);
+                }
+                DMADriverUnlock(pDmaExt);
+        }
+}
+
+/*! PacketCompRingRegister
+ *
+ * \brief This routine is called when a
+ *  PACKET_COMP_RING_REGISTER_IOCTL is sent from the application.
+ *  The buffer locked by DMADriverIoInCallerContext becomes the completion
+ *  ring of the FIFO mode C2S DMA Engine and stays locked until it is
+ *  released.  The receive buffer must be allocated first.
+ *  This routine is called at IRQL < DISPATCH_LEVEL.
+ * \param pDevExt - Pointer to this drivers context (data store)
+ * \param Request - Pointer to the IOCtl request
+ * \return NTSTATUS
+ */
+NTSTATUS PacketCompRingRegister(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request)
+{
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        PREQUEST_CONTEXT reqContext;
+        PCOMP_RING_STRUCT pCompRingReg;
+        PCOMP_RING pCompRing;
+        PPACKET_COMP_RING_STRUCT pRing;
+        PUINT32 pTokens;
+        UINT32 i;
+        NTSTATUS status;
+
+        reqContext = RequestContext(Request);
+        if ((reqContext == NULL) || (reqContext->pMdl == NULL)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "PacketCompRingRegister MDL == NULL\n"));
+                return STATUS_ACCESS_VIOLATION;
+        }
+
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(COMP_RING_STRUCT),        /* Min size */
+                                               (PVOID *) & pCompRingReg,        /* buffer */
+                                               NULL);
+        if (NT_SUCCESS(status)) {
+                status = GetDMAEngineContext(pDevExt, reqContext->DMAEngine, &pDmaExt);
+                if (NT_SUCCESS(status)) {
+                        status = STATUS_INVALID_DEVICE_REQUEST;
+                        if ((pDmaExt->DmaType == DMA_TYPE_PACKET_RECV) && (pDmaExt->PacketMode == PACKET_MODE_FIFO) && (pDmaExt->UserVa != NULL)) {
+                                pCompRing = &pDmaExt->CompRing;
+
+                                DMADriverLock(pDmaExt);
+
+                                status = STATUS_INVALID_PARAMETER;
+                                if (pCompRing->pMdl != NULL) {
+                                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DMA Engine %d already has a completion ring\n", pDmaExt->DmaEngine));
+                                        status = STATUS_DEVICE_BUSY;
+                                } else if ((pCompRingReg->NumEntries < 2) || ((pCompRingReg->NumEntries & (pCompRingReg->NumEntries - 1)) != 0) ||
+                                           (pCompRingReg->NumEntries > pDmaExt->Ring.NumberOfDescriptors)) {
+                                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Completion ring entries %d not a power of 2 up to %d\n",
+                                                  pCompRingReg->NumEntries, pDmaExt->Ring.NumberOfDescriptors));
+                                } else if (reqContext->Length < PACKET_COMP_RING_SIZE(pCompRingReg->NumEntries)) {
+                                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Completion ring length %d too small for %d entries\n",
+                                                  reqContext->Length, pCompRingReg->NumEntries));
+                                } else {
+                                        status = STATUS_INSUFFICIENT_RESOURCES;
+                                        pRing = (PPACKET_COMP_RING_STRUCT) MmGetSystemAddressForMdlSafe(reqContext->pMdl, NormalPagePriority | MdlMappingNoExecute);
+                                        pTokens = (PUINT32) ExAllocatePoolWithTag(NonPagedPoolNx, pCompRingReg->NumEntries * sizeof(UINT32), 'gRCP');
+                                        if ((pRing != NULL) && (pTokens != NULL)) {
+                                                for (i = 0; i < pCompRingReg->NumEntries; i++) {
+                                                        pTokens[i] = INVALID_RELEASE_TOKEN;
+                                                }
+                                                pRing->ProducerIndex = 0;
+                                                pRing->ConsumerIndex = 0;
+
+                                                // The ring owns the MDL from here on
+                                                pCompRing->pMdl = reqContext->pMdl;
+                                                pCompRing->FileObject = WdfRequestGetFileObject(Request);
+                                                reqContext->pMdl = NULL;
+
+                                                WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+                                                pCompRing->pTokens = pTokens;
+                                                pCompRing->NumEntries = pCompRingReg->NumEntries;
+                                                pCompRing->Producer = 0;
+                                                pCompRing->Consumer = 0;
+                                                pCompRing->pRing = pRing;
+                                                WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+
+                                                // Hand over any packets that are already waiting
+                                                status = PacketProcessCompRing(pDmaExt, NULL);
+                                        } else {
+                                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Completion ring mapping failed\n"));
+                                                if (pTokens != NULL) {
+                                                        ExFreePoolWithTag(pTokens, 'gRCP');
+                                                }
+                                        }
+                                }
+
+                                DMADriverUnlock(pDmaExt);
+                        }
+                } else {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Completion Ring Register DMA Engine number invalid. Status: 0x%x.\n", status));
+                }
+        } else {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- WdfRequestRetrieveInputBuffer Failed. Status: 0x%x\n", status));
+        }
+        if (reqContext->pMdl != NULL) {
+                FreeReqCtx(reqContext);
+        }
+        return status;
+}
+
+/*! PacketCompRingGetEngine
+ *
+ * \brief Returns the C2S DMA Engine named in a COMP_RING_STRUCT request.
+ * \param pDevExt - Pointer to this drivers context (data store)
+ * \param Request - Pointer to the IOCtl request
+ * \param ppDmaExt - Returns the DMA Engine Context
+ * \return NTSTATUS
+ */
+static NTSTATUS PacketCompRingGetEngine(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request, OUT PDMA_ENGINE_DEVICE_EXTENSION * ppDmaExt)
+{
+        PCOMP_RING_STRUCT pCompRingReg;
+        NTSTATUS status;
+
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(COMP_RING_STRUCT),        /* Min size */
+                                               (PVOID *) & pCompRingReg,        /* buffer */
+                                               NULL);
+        if (status == STATUS_SUCCESS) {
+                status = STATUS_INVALID_DEVICE_REQUEST;
+                // Validate EngineNum
+                if ((pCompRingReg != NULL) && (pCompRingReg->EngineNum < MAX_NUM_DMA_ENGINES) && (pDevExt->pDmaEngineDevExt[pCompRingReg->EngineNum] != NULL)) {
+                        status = GetDMAEngineContext(pDevExt, pCompRingReg->EngineNum, ppDmaExt);
+                        if (NT_SUCCESS(status) && ((*ppDmaExt)->DmaType != DMA_TYPE_PACKET_RECV)) {
+                                status = STATUS_INVALID_DEVICE_REQUEST;
+                        }
+                }
+        } else {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- WdfRequestRetrieveInputBuffer Failed. Status: 0x%x\n", status));
+        }
+        return status;
+}
+
+/*! PacketCompRingRelease
+ *
+ * \brief This routine is called when a
+ *  PACKET_COMP_RING_RELEASE_IOCTL is sent from the application.
+ *  Packets the application had not consumed are given back to the DMA Engine.
+ *  This routine is called at IRQL < DISPATCH_LEVEL.
+ * \param pDevExt - Pointer to this drivers context (data store)
+ * \param Request - Pointer to the IOCtl request
+ * \return NTSTATUS
+ */
+NTSTATUS PacketCompRingRelease(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request)
+{
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        NTSTATUS status;
+
+        status = PacketCompRingGetEngine(pDevExt, Request, &pDmaExt);
+        if (NT_SUCCESS(status)) {
+                DMADriverLock(pDmaExt);
+                status = STATUS_INVALID_PARAMETER;
+                if (pDmaExt->CompRing.pMdl != NULL) {
+                        FreeCompRing(pDmaExt);
+                        status = STATUS_SUCCESS;
+                }
+                DMADriverUnlock(pDmaExt);
+        }
+        return status;
+}
+
+/*! PacketCompRingSync
+ *
+ * \brief This routine is called when a
+ *  PACKET_COMP_RING_SYNC_IOCTL is sent from the application.
+ *  Returns the consumed entries and fills the ring without waiting for the
+ *  next interrupt, for an application that found the ring empty after it
+ *  had consumed every entry.
+ *  This routine is called at IRQL < DISPATCH_LEVEL.
+ * \param pDevExt - Pointer to this drivers context (data store)
+ * \param Request - Pointer to the IOCtl request
+ * \return NTSTATUS
+ */
+NTSTATUS PacketCompRingSync(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request)
+{
+        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt;
+        NTSTATUS status;
+
+        status = PacketCompRingGetEngine(pDevExt, Request, &pDmaExt);
+        if (NT_SUCCESS(status)) {
+                status = STATUS_INVALID_PARAMETER;
+                if (pDmaExt->CompRing.pMdl != NULL) {
+                        status = PacketProcessCompRing(pDmaExt, NULL);
+                }
+        }
+        return status;
+}
+
 /*! ResetDMAEngine 
  *
  * \brief This routine is called when a
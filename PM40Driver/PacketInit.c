@@ -43,9 +43,9 @@
 
 // Local functions
 
-DRIVER_LIST_CONTROL PacketRxGetReadSgListComplete;
+DRIVER_LIST_CONTROL PacketGetSgListComplete;
 
-VOID PacketRxGetReadSgListComplete(PDEVICE_OBJECT, PIRP, PSCATTER_GATHER_LIST, PVOID);
+VOID PacketGetSgListComplete(PDEVICE_OBJECT, PIRP, PSCATTER_GATHER_LIST, PVOID);
 
 #ifdef ALLOC_PRAGMA
 #endif                          /* ALLOC_PRAGMA */
@@ -67,49 +67,87 @@ static UINT32 CalcNumPages(PUINT8 p, UINT32 len)
 }
 
 /*
- * Given a virt buffer and a length, figure out how much of a 4K page to DMA
+ * Largest Rx descriptor for a pool: MaxPacketSize rounded up to whole pages,
+ * so a full size packet lands in one descriptor and the pool still holds
+ * Length / MaxPacketSize packets, and no more than the descriptor byte count
+ * can hold.  Without PACKET_ALLOC_MAX_PACKET_DESC the caller passes 0 and
+ * the pool keeps one descriptor per page.
  */
-static UINT32 CalcDmaLength(PUINT8 Buffer, UINT32 BufferLength)
+static UINT32 CalcRxDescLength(UINT32 MaxPacketSize)
 {
-    UINT32 DmaLength;
-    UINT32 leftoverPageLen;
+    UINT32 MaxLength = PACKET_DESC_BYTE_COUNT_MASK & ~(PAGE_SIZE - 1);
 
-    if (!Buffer || !BufferLength) {
-        return 0;
+    if (MaxPacketSize <= PAGE_SIZE) {
+        return PAGE_SIZE;
+    }
+    if (MaxPacketSize >= MaxLength) {
+        return MaxLength;
     }
+    return (MaxPacketSize + (PAGE_SIZE - 1)) & ~(PAGE_SIZE - 1);
+}
 
-    /*
-     * The buffer may not start at the beginning of a page.
-     */
-    if (offset_in_page(Buffer)) {
-        leftoverPageLen = PAGE_SIZE - offset_in_page(Buffer);
-        if (BufferLength > leftoverPageLen) {
-            /*
-             * DMA the rest of the page.
-            */
-            DmaLength = leftoverPageLen;
-        }
-        else {
-            /*
-             * DMA just a piece of the page.
-             */
-            DmaLength = BufferLength;
+/*
+ * Release the Scatter/Gather lists InitializeRxDescriptors cached on the
+ * descriptors, for a setup that failed part way.
+ */
+static VOID PutRxSgLists(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
+{
+    KIRQL oldIrql;
+    UINT32 i;
+
+    KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+    for (i = 0; i < pDmaExt->Ring.NumberOfDescriptors; i++) {
+        if (pDmaExt->Ring.pDrvDescCold[i].pScatterGatherList != NULL) {
+            pDmaExt->pReadDmaAdapter->DmaOperations->PutScatterGatherList(pDmaExt->pReadDmaAdapter, pDmaExt->Ring.pDrvDescCold[i].pScatterGatherList, FALSE);
+            pDmaExt->Ring.pDrvDescCold[i].pScatterGatherList = NULL;
         }
     }
-    else if (BufferLength >= PAGE_SIZE) {
-        /*
-         * DMA the whole page
-         */
-        DmaLength = PAGE_SIZE;
-    }
-    else {
-        /*
-         * The buffer is aligned but smaller then a page.
-         */
-        DmaLength = BufferLength;
+    KeLowerIrql(oldIrql);
+}
+
+/*
+ * Release the Scatter/Gather lists a send pool holds, for FreeSendPool and
+ * for a mapping that has to wait for map registers.
+ */
+static VOID PutPoolSgLists(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, PSEND_POOL pPool)
+{
+    KIRQL oldIrql;
+    UINT32 chunk;
+
+    KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+    for (chunk = 0; chunk < pPool->NumberOfChunks; chunk++) {
+        if (pPool->ppChunkSgLists[chunk] != NULL) {
+            pDmaExt->pWriteDmaAdapter->DmaOperations->PutScatterGatherList(pDmaExt->pWriteDmaAdapter, pPool->ppChunkSgLists[chunk], TRUE);
+            pPool->ppChunkSgLists[chunk] = NULL;
+        }
     }
+    KeLowerIrql(oldIrql);
+}
 
-    return DmaLength;
+/*
+ * Number of Rx descriptors InitializeRxDescriptors carves from a chunk's
+ * Scatter/Gather list, starting DescOffset into an RxDescLength boundary.
+ */
+static UINT32 CountRxDescriptors(PSCATTER_GATHER_LIST pSgList, UINT32 RxDescLength, UINT32 DescOffset)
+{
+    UINT32 ElementLength;
+    UINT32 DmaLength;
+    UINT32 Count = 0;
+    UINT32 i;
+
+    for (i = 0; i < pSgList->NumberOfElements; i++) {
+        ElementLength = pSgList->Elements[i].Length;
+        while (ElementLength) {
+            DmaLength = RxDescLength - DescOffset;
+            if (DmaLength > ElementLength) {
+                DmaLength = ElementLength;
+            }
+            ElementLength -= DmaLength;
+            DescOffset = (DescOffset + DmaLength) % RxDescLength;
+            Count++;
+        }
+    }
+    return Count;
 }
 
 static LARGE_INTEGER ElapsedUsec(LARGE_INTEGER *start)
@@ -173,106 +211,61 @@ VOID HardResetDMAEngine(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
  */
 NTSTATUS DMADriverIntiializeDMADescriptors(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN UINT32 NumberDescriptors, IN UINT32 DescFlags)
 {
-        PDRIVER_DESC_STRUCT pDrvDesc;
-        PDRIVER_DESC_STRUCT pNextDrvDesc;
-        PDMA_DESCRIPTOR_STRUCT pHWDesc;
-        PHYSICAL_ADDRESS pHWDescPhys;
-        UINT32 descNum;
-
-        // Setup the Next and tail pointers to start at the base.
-        pDmaExt->pNextDesc = pDmaExt->pDrvDescBase;
-        pDmaExt->pTailDesc = pDmaExt->pDrvDescBase;
-
-        pDrvDesc = pDmaExt->pDrvDescBase;
-        pHWDesc = pDmaExt->pHWDescriptorBase;
-        pHWDescPhys = pDmaExt->pHWDescriptorBasePhysical;
-
-        if (NumberDescriptors < MINIMUM_NUMBER_DESCRIPTORS)
-                return STATUS_BAD_PARAMETER;
-        if (NumberDescriptors > pDmaExt->NumberOfDescriptors)
-                return STATUS_BAD_PARAMETER;
-
-        // Set the DMA Engine back to a restarted state
-        pDmaExt->NumberOfUsedDescriptors = 0;
-
-        // setup each of the descriptors
-        for (descNum = 0; descNum < NumberDescriptors; descNum++) {
-                pNextDrvDesc = pDrvDesc;
-
-                // Initialize the Hardware DMA Descriptor
-                pHWDesc->C2S.StatusFlags_BytesCompleted = 0;
-                pHWDesc->C2S.UserStatus = 0;
-                pHWDesc->C2S.CardAddress = 0;
-                pHWDesc->C2S.ControlFlags_ByteCount = 0;
-                pHWDesc->C2S.SystemAddressPhys = 0;
-
-                // Initialize the Drivers reference to the Hardware DMA Descriptor
-                pDrvDesc->pHWDesc = pHWDesc;
-                pDrvDesc->pHWDescPhys = pHWDescPhys;
-                pDrvDesc->DescriptorNumber = descNum;
-                pDrvDesc->DescFlags = DescFlags;
-                pDrvDesc->pScatterGatherList = NULL;
-                pDrvDesc->SystemAddressVirt = NULL;
-                pDrvDesc->DmaTransaction = NULL;
-
-                // If this is the last descriptor...
-                if (descNum == (NumberDescriptors - 1)) {
-                        // Link back to the top of the Descriptor pool
-                        pDrvDesc->pNextDesc = pDmaExt->pDrvDescBase;
-                        pHWDesc->S2C.NextDescriptorPhys = pDmaExt->pHWDescriptorBasePhysical.LowPart;
-                } else {
-                        // Link to the Next Descriptor
-                        pHWDescPhys.QuadPart += sizeof(DMA_DESCRIPTOR_STRUCT);
-                        pHWDesc->S2C.NextDescriptorPhys = pHWDescPhys.LowPart;
-                        pDrvDesc->pNextDesc = ++pNextDrvDesc;
-                        pDrvDesc = pNextDrvDesc;
-                        pHWDesc++;
-                }
-        }
-
-        // setup the descriptor pointers
-        pDmaExt->pDmaEng->NextDescriptorPtr = pDmaExt->pHWDescriptorBasePhysical.LowPart;
-        pDmaExt->pDmaEng->SoftwareDescriptorPtr = pDmaExt->pHWDescriptorBasePhysical.LowPart;
-        pDmaExt->pDmaEng->CompletedDescriptorPtr = 0;
-
-        return STATUS_SUCCESS;
+        return PacketRingStatus(PacketRingInitialize(&pDmaExt->Ring, NumberDescriptors, DescFlags));
 }
 
 /*! InitializeRxDescriptors 
  *
  *     \brief - This routine initializes the Packet Recieve DMA Descriptors
+ *   The pool is mapped in MaximumTransferLength chunks, one Scatter/Gather
+ *   list each, and the descriptors are carved from the elements.  The list
+ *   of a chunk is cached on its first descriptor for FreeRxDescriptors.
+ *   A chunk is only added once the ring has room for all its descriptors.
+ *   If the HAL defers the list for lack of map registers, the chunks mapped
+ *   so far are released, the list is waited for and released too, and the
+ *   pool fails with STATUS_INSUFFICIENT_RESOURCES.
  *    \param pDevExt - Pointer to this drivers context (data store)
  *  \param pDmaExt - Pointer to the DMA Engine Context
  *  \param pvRetVirtAddr - Virtual Addresses to return in the PacketReceives call
  *  \param AllocSize - Size to allocate the buffer in bytes
  *    Must be larger than 1 page and should be in multiples of 4K
+ *  \param MaxPacketSize - Largest packet the application expects, sizes the
+ *    descriptors carved from physically contiguous (large page) runs
  *  \return STATUS_SUCCESS if it works, an error if it fails.
  *     \note This routine is called at IRQL < DISPATCH_LEVEL.
  *   We MUST be running in the process where we want this memory mapped.
  */
-NTSTATUS InitializeRxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PVOID pvRetVirtAddr, IN UINT32 AllocSize)
+NTSTATUS InitializeRxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PVOID pvRetVirtAddr, IN UINT32 AllocSize,
+                                 IN UINT32 MaxPacketSize)
 {
-        PDRIVER_DESC_STRUCT pDrvDesc;
-        PDMA_DESCRIPTOR_STRUCT pHWDesc;
+        PSCATTER_GATHER_LIST pChunkSgList;
         PUINT8 UserAddrVirt;
         PUINT8 pRetVirtAddr;
-        UINT32 MaxDescCount;
-        UINT32 descNum;
-        NTSTATUS status = STATUS_INVALID_PARAMETER;
+        UINT32 RxDescLength = CalcRxDescLength(MaxPacketSize);
+        UINT32 MinDescCount;
+        UINT32 MaxChunkLength;
+        UINT32 NumberOfChunks;
+        UINT32 ChunkLength;
+        UINT32 BuffLength;
+        UINT32 DescOffset;
+        UINT32 FirstIndex;
+        UINT32 FirstUsed;
+        UINT64 ElementAddr;
+        UINT32 ElementLength;
+        UINT32 DmaLength;
+        UINT32 chunk;
+        UINT32 i;
+        INT32 RingStatus = PACKET_RING_SUCCESS;
+        LARGE_INTEGER StartTime;
+        KIRQL oldIrql;
+        NTSTATUS status = STATUS_SUCCESS;
+
+        StartTime = KeQueryPerformanceCounter(NULL);
 
         // Shutdown the DMA Engine
         pDmaExt->pDmaEng->ControlStatus = 0;
         // Set the DMA Engine back to a restarted state
-        pDmaExt->NumberOfUsedDescriptors = 0;
-
-        // Setup the Next and tail pointers to start at the base.
-        pDrvDesc = pDmaExt->pDrvDescBase;
-        pDmaExt->pNextDesc = pDrvDesc;
-
-        pDmaExt->bDescriptorAllocSuccess = TRUE;
-
-        // Calc the total number of descriptors
-        MaxDescCount = CalcNumPages(pDmaExt->UserVa, AllocSize);
+        PacketRingBeginRx(&pDmaExt->Ring);
 
         if (pDmaExt->pDmaEng->ControlStatus & PACKET_DMA_CTRL_DMA_RUNNING) {
                KdPrintEx((1, DPFLTR_WARNING_LEVEL, "DMA Engine %u is still running, status %08x.", pDmaExt->DmaEngine, pDmaExt->pDmaEng->ControlStatus));
@@ -282,147 +275,119 @@ NTSTATUS InitializeRxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DE
         if (pDmaExt->bFreeRun) {
                 pDmaExt->pDmaEng->InterruptControl = 0;
         } else {
-                // Default to EOP Interrupt mode
-                pDmaExt->pDmaEng->InterruptControl = pDevExt->InterruptMode;
+                // Default to EOP Interrupt mode, see SetInterruptCoalescing
+                pDmaExt->pDmaEng->InterruptControl = pDmaExt->InterruptControl;
         }
 
-        // If we have enough descriptors, if so initialize the structures
-        if (pDmaExt->NumberOfDescriptors >= MaxDescCount) {
-                UINT32 BuffLength = AllocSize;
-
-                UserAddrVirt = pDmaExt->UserVa;
-                pRetVirtAddr = pvRetVirtAddr;
+        // No descriptor holds more than RxDescLength, the S/G elements can only add to this.
+        // Each chunk is counted exactly before it is added, see CountRxDescriptors.
+        MinDescCount = (UINT32) (((UINT64) AllocSize + RxDescLength - 1) / RxDescLength);
+        if (pDmaExt->Ring.NumberOfDescriptors < MinDescCount) {
+                // Not enough descriptors available
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Not enough descriptors (Req=%d) are available (%d) in DmaEngine[%d]", MinDescCount, pDmaExt->Ring.NumberOfDescriptors, pDmaExt->DmaEngine));
+                return STATUS_INSUFFICIENT_RESOURCES;
+        }
 
-                // setup each of the descriptors
-                for (descNum = 0; descNum < MaxDescCount; descNum++) {
-                        UINT32 DmaLength = CalcDmaLength(UserAddrVirt, BuffLength);
+        UserAddrVirt = pDmaExt->UserVa;
+        pRetVirtAddr = pvRetVirtAddr;
+        BuffLength = AllocSize;
+        MaxChunkLength = (UINT32) pDmaExt->MaximumTransferLength;
+        NumberOfChunks = (UINT32) ((offset_in_page(UserAddrVirt) + AllocSize + MaxChunkLength - 1) / MaxChunkLength);
 
-                        pDmaExt->pNextDesc->SystemAddressVirt = (PVOID) pRetVirtAddr;
+        // Descriptors end on RxDescLength boundaries of the pool pages, so one per page for small packets
+        DescOffset = (UINT32) offset_in_page(UserAddrVirt);
 
-                        status = pDmaExt->pReadDmaAdapter->DmaOperations->GetScatterGatherList(pDmaExt->pReadDmaAdapter, pDevExt->FunctionalDeviceObject,
-                                                                                               pDmaExt->PMdl, UserAddrVirt, DmaLength, PacketRxGetReadSgListComplete, pDmaExt,
-                                                                                               FALSE);
+        for (chunk = 0; (chunk < NumberOfChunks) && NT_SUCCESS(status); chunk++) {
+                // Every chunk but the first starts on a page boundary
+                ChunkLength = MaxChunkLength - (UINT32) offset_in_page(UserAddrVirt);
+                if (ChunkLength > BuffLength) {
+                        ChunkLength = BuffLength;
+                }
 
-                        if (status != STATUS_SUCCESS) {
-                                // Get Scatter/Gather failed!
-                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Get Scatter/Gather List Failed with error (%d) in DmaEngine[%d]", status, pDmaExt->DmaEngine));
-                                return status;
-                        }
-                        if (!pDmaExt->bDescriptorAllocSuccess) {
-                                // GetScatterGather failed!
-                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Failed setting up ScatterGather entries in DmaEngine[%d]", pDmaExt->DmaEngine));
-                                status = STATUS_DRIVER_INTERNAL_ERROR;
-                                return status;
-                        }
-                        UserAddrVirt += DmaLength;
-                        pRetVirtAddr += DmaLength;
-                        BuffLength -= DmaLength;
+                pDmaExt->SgMap.pSgList = NULL;
+                KeInitializeEvent(&pDmaExt->SgMap.Mapped, NotificationEvent, FALSE);
+                KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+                status = pDmaExt->pReadDmaAdapter->DmaOperations->GetScatterGatherList(pDmaExt->pReadDmaAdapter, pDevExt->FunctionalDeviceObject,
+                                                                                       pDmaExt->PMdl, UserAddrVirt, ChunkLength, PacketGetSgListComplete,
+                                                                                       &pDmaExt->SgMap, FALSE);
+                KeLowerIrql(oldIrql);
+                if (status != STATUS_SUCCESS) {
+                        // Get Scatter/Gather failed!
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Get Scatter/Gather List Failed with error (%d) in DmaEngine[%d]", status, pDmaExt->DmaEngine));
+                        break;
+                }
+                if (KeReadStateEvent(&pDmaExt->SgMap.Mapped) == 0) {
+                        // Deferred until map registers are free, give back the ones this pool holds
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Out of map registers mapping receive pool chunk %d in DmaEngine[%d]", chunk, pDmaExt->DmaEngine));
+                        PutRxSgLists(pDmaExt);
+                        KeWaitForSingleObject(&pDmaExt->SgMap.Mapped, Executive, KernelMode, FALSE, NULL);
+                        status = STATUS_INSUFFICIENT_RESOURCES;
+                }
+                pChunkSgList = pDmaExt->SgMap.pSgList;
+                pDmaExt->SgMap.pSgList = NULL;
+                if (NT_SUCCESS(status) &&
+                    ((pDmaExt->Ring.NumberOfDescriptors - (UINT32) pDmaExt->Ring.NumberOfUsedDescriptors) < CountRxDescriptors(pChunkSgList, RxDescLength, DescOffset))) {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Not enough descriptors for receive pool chunk %d (used %d of %d) in DmaEngine[%d]", chunk,
+                                  pDmaExt->Ring.NumberOfUsedDescriptors, pDmaExt->Ring.NumberOfDescriptors, pDmaExt->DmaEngine));
+                        status = STATUS_INSUFFICIENT_RESOURCES;
+                }
+                if (!NT_SUCCESS(status)) {
+                        KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+                        pDmaExt->pReadDmaAdapter->DmaOperations->PutScatterGatherList(pDmaExt->pReadDmaAdapter, pChunkSgList, FALSE);
+                        KeLowerIrql(oldIrql);
+                        break;
                 }
 
-                // Make sure we have at least one completed descriptor
-                if (pDmaExt->pNextDesc != pDmaExt->pDrvDescBase) {
-                        // At this point the 'Next' Pointer are at the last Desc + 1
-                        // We need to back it up to the last Desc and wrap the links back to the start
-                        pDrvDesc = (PDRIVER_DESC_STRUCT) ((PUINT8) pDmaExt->pNextDesc - sizeof(DRIVER_DESC_STRUCT));
-                        pHWDesc = pDrvDesc->pHWDesc;
-
-                        // Last Descriptor, link back to the top of the Descriptor pool (both virtual and Physical addresses).
-                        pDrvDesc->pNextDesc = (PDRIVER_DESC_STRUCT) pDmaExt->pDrvDescBase;
-                        pHWDesc->C2S.NextDescriptorPhys = pDmaExt->pHWDescriptorBasePhysical.LowPart;
-
-                        if (pDmaExt->bFreeRun) {
-                                pDmaExt->pDmaEng->SoftwareDescriptorPtr = 0;
-                        } else {
-                                pDmaExt->pDmaEng->SoftwareDescriptorPtr = pDrvDesc->pHWDescPhys.LowPart;
-                        }
-                        pDmaExt->pTailDesc = pDrvDesc;
+                FirstIndex = pDmaExt->Ring.NextIndex;
+                FirstUsed = pDmaExt->Ring.NumberOfUsedDescriptors;
+                for (i = 0; (i < pChunkSgList->NumberOfElements) && PACKET_RING_OK(RingStatus); i++) {
+                        ElementAddr = pChunkSgList->Elements[i].Address.QuadPart;
+                        ElementLength = pChunkSgList->Elements[i].Length;
+                        while (ElementLength && PACKET_RING_OK(RingStatus)) {
+                                DmaLength = RxDescLength - DescOffset;
+                                if (DmaLength > ElementLength) {
+                                        DmaLength = ElementLength;
+                                }
+                                RingStatus = PacketRingAddRxDescriptor(&pDmaExt->Ring, ElementAddr, DmaLength, pRetVirtAddr, pDmaExt->bFreeRun);
 
-                        // Reset the 'Next' pointers to start at the base.
-                        pDmaExt->pNextDesc = pDmaExt->pDrvDescBase;
+                                ElementAddr += DmaLength;
+                                ElementLength -= DmaLength;
+                                pRetVirtAddr += DmaLength;
+                                DescOffset = (DescOffset + DmaLength) % RxDescLength;
+                        }
                 }
-                // setup the DMA Engine descriptor pointers
-                pDmaExt->pDmaEng->NextDescriptorPtr = pDmaExt->pHWDescriptorBasePhysical.LowPart;
-                pDmaExt->pDmaEng->CompletedDescriptorPtr = 0;
 
-                // Now enable the DMA Engine
-                pDmaExt->pDmaEng->ControlStatus = (COMMON_DMA_CTRL_IRQ_ENABLE | PACKET_DMA_CTRL_DMA_ENABLE);
-                status = STATUS_SUCCESS;
-        } else {
-                // Not enough descriptors available
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Not enough descriptors (Req=%d) are available (%d) in DmaEngine[%d]", MaxDescCount, pDmaExt->NumberOfDescriptors, pDmaExt->DmaEngine));
-                status = STATUS_INSUFFICIENT_RESOURCES;
+                if ((UINT32) pDmaExt->Ring.NumberOfUsedDescriptors != FirstUsed) {
+                        // Cache the pointer to the Scatter Gather list so FreeRxDescriptors can release it
+                        PacketRingDescCold(&pDmaExt->Ring, FirstIndex)->pScatterGatherList = pChunkSgList;
+                } else {
+                        KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+                        pDmaExt->pReadDmaAdapter->DmaOperations->PutScatterGatherList(pDmaExt->pReadDmaAdapter, pChunkSgList, FALSE);
+                        KeLowerIrql(oldIrql);
+                }
+                if (!PACKET_RING_OK(RingStatus)) {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Failed setting up ScatterGather entries (%d), desc # %d in DmaEngine[%d]", RingStatus,
+                                  pDmaExt->Ring.NumberOfUsedDescriptors, pDmaExt->DmaEngine));
+                        status = PacketRingStatus(RingStatus);
+                }
+                UserAddrVirt += ChunkLength;
+                BuffLength -= ChunkLength;
         }
-        return status;
-}
 
-/* PacketRxGetReadSgListComplete 
- *
- * \brief - This routine converts a scatter gather entries into DMA Descriptors
- * \param pDeviceObject - Caller-supplied pointer to a DEVICE_OBJECT structure. 
- *    This is the device object for the target device, previously created 
- *    by the driver's AddDevice routine.
- * \param pIrp - Not used - Caller-supplied pointer to an IRP structure that 
- *    describes the I/O operation, 
- *    \note: Do not use unless CurrentIrp is set in the DeviceObject.
- * \param pScatterGatherList - Caller-supplied pointer to a 
- *    SCATTER_GATHER_LIST structure describing scatter/gather regions.
- * \param Context - Caller Supplied Context field
- * \return nothing
- */
-VOID PacketRxGetReadSgListComplete(IN PDEVICE_OBJECT pDeviceObject, IN PIRP pIrp, IN PSCATTER_GATHER_LIST pScatterGatherList, IN PVOID Context)
-{
-        PDMA_ENGINE_DEVICE_EXTENSION pDmaExt = (PDMA_ENGINE_DEVICE_EXTENSION) Context;
-        PDRIVER_DESC_STRUCT pDrvDesc;
-        PDMA_DESCRIPTOR_STRUCT pHWDesc;
+        if (!NT_SUCCESS(status)) {
+                PutRxSgLists(pDmaExt);
+                return status;
+        }
 
-        UNREFERENCED_PARAMETER(pDeviceObject);
-        UNREFERENCED_PARAMETER(pIrp);
+        // Link the last descriptor back to the first and hand the ring to the DMA Engine
+        PacketRingEndRx(&pDmaExt->Ring, pDmaExt->bFreeRun);
 
-        if (pScatterGatherList != NULL) {
-                // Since we allocating based on PAGE_SIZE we "should never get" more than one element
-                if (pScatterGatherList->NumberOfElements == 1) {
-                        pDrvDesc = pDmaExt->pNextDesc;
-                        pHWDesc = pDrvDesc->pHWDesc;
-
-                        // setup the descriptor
-                        pHWDesc->C2S.StatusFlags_BytesCompleted = 0;
-                        pHWDesc->C2S.UserStatus = 0;
-                        pHWDesc->C2S.CardAddress = 0;
-
-                        if (pDmaExt->bFreeRun) {
-                                pHWDesc->C2S.ControlFlags_ByteCount = pScatterGatherList->Elements[0].Length;
-                        } else {
-                                pHWDesc->C2S.ControlFlags_ByteCount = (pScatterGatherList->Elements[0].Length | PACKET_DESC_S2C_CTRL_IRQ_ON_COMPLETE | PACKET_DESC_S2C_CTRL_IRQ_ON_ERROR);
-                        }
-                        pHWDesc->C2S.SystemAddressPhys = pScatterGatherList->Elements[0].Address.QuadPart;
-                        pDrvDesc->DmaTransaction = NULL;
+        // Now enable the DMA Engine
+        pDmaExt->pDmaEng->ControlStatus = (COMMON_DMA_CTRL_IRQ_ENABLE | PACKET_DMA_CTRL_DMA_ENABLE);
 
-                        // Make sure we get a valid address
-                        if (pHWDesc->C2S.SystemAddressPhys != 0) {
-                                // On the Rx Side we use the UsedDescriptors as a total allocated count
-                                pDrvDesc->DescriptorNumber = pDmaExt->NumberOfUsedDescriptors++;
-                                pDrvDesc->DescFlags = DESC_FLAGS_HW_OWNED;
-
-                                // Cache the pointer to the Scatter Gather list only if this is the last descriptor
-                                pDrvDesc->pScatterGatherList = pScatterGatherList;
-
-                                // Link to the next driver descriptor in the chain (driver usable address)
-                                pDrvDesc->pNextDesc = (PDRIVER_DESC_STRUCT) ((UINT8 *) pDrvDesc + sizeof(DRIVER_DESC_STRUCT));
-                                pDrvDesc = pDrvDesc->pNextDesc;
-                                pDmaExt->pNextDesc = pDrvDesc;
-                        } else {
-                               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL PacketRxGetReadSgListComplete ERROR, S/G return a null system pointer, desc # %d\n", pDrvDesc->DescriptorNumber));
-                                pDmaExt->bDescriptorAllocSuccess = FALSE;
-                        }
-                } else {
-                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL PacketRxGetReadSgListComplete ERROR, S/G entry count != 1 (%d).\n", pScatterGatherList->NumberOfElements));
-                        pDmaExt->bDescriptorAllocSuccess = FALSE;
-                }
-        } else {
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL PacketRxGetReadSgListComplete ERROR, S/G pointer is null.\n"));
-                pDmaExt->bDescriptorAllocSuccess = FALSE;
-        }
-        return;
+       KdPrintEx((1, DPFLTR_INFO_LEVEL, "USL DmaEngine[%d] receive pool of %u bytes, %d descriptors from %u S/G lists in %lld usec\n", pDmaExt->DmaEngine,
+                  AllocSize, pDmaExt->Ring.NumberOfUsedDescriptors, NumberOfChunks, ElapsedUsec(&StartTime).QuadPart));
+        return status;
 }
 
 /*! InitializeAddressablePacketDescriptors 
@@ -439,29 +404,31 @@ NTSTATUS InitializeAddressablePacketDescriptors(IN PDEVICE_EXTENSION pDevExt, IN
 {
         NTSTATUS status = STATUS_INVALID_PARAMETER;
 
+        UNREFERENCED_PARAMETER(pDevExt);
+
         if (pDmaExt->pDmaEng->ControlStatus & PACKET_DMA_CTRL_DMA_RUNNING) {
                KdPrintEx((1, DPFLTR_WARNING_LEVEL, "DMA Engine %u is still running, status %08x.", pDmaExt->DmaEngine, pDmaExt->pDmaEng->ControlStatus));
                 HardResetDMAEngine(pDmaExt);
         }
 
         // Set the DMA Engine back to a restarted state
-        pDmaExt->NumberOfUsedDescriptors = 0;
+        pDmaExt->Ring.NumberOfUsedDescriptors = 0;
 
-        // Default to EOP Interrupt mode
-        pDmaExt->pDmaEng->InterruptControl = pDevExt->InterruptMode;
+        // Default to EOP Interrupt mode, see SetInterruptCoalescing
+        pDmaExt->pDmaEng->InterruptControl = pDmaExt->InterruptControl;
 
         WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
 
         // Make sure the buffer was allocated
-        if (pDmaExt->NumberOfDescriptors) {
-                DMADriverIntiializeDMADescriptors(pDmaExt, pDmaExt->NumberOfDescriptors, DESC_FLAGS_ADDRESSABLE_MODE);
+        if (pDmaExt->Ring.NumberOfDescriptors) {
+                DMADriverIntiializeDMADescriptors(pDmaExt, pDmaExt->Ring.NumberOfDescriptors, DESC_FLAGS_ADDRESSABLE_MODE);
 
                 // Now enable the DMA Engine
                 pDmaExt->pDmaEng->ControlStatus = (COMMON_DMA_CTRL_IRQ_ENABLE | PACKET_DMA_CTRL_DMA_ENABLE);
                 status = STATUS_SUCCESS;
         } else {
                 // Not enough descriptors available
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Not enough descriptors are available (%d) in DmaEngine[%d]", pDmaExt->NumberOfDescriptors, pDmaExt->DmaEngine));
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Not enough descriptors are available (%d) in DmaEngine[%d]", pDmaExt->Ring.NumberOfDescriptors, pDmaExt->DmaEngine));
                 status = STATUS_INSUFFICIENT_RESOURCES;
         }
         WdfSpinLockRelease(pDmaExt->DmaSpinLock);
@@ -487,25 +454,25 @@ VOID FreeRxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTEN
 
        KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL FreeRxDescriptors\n"));
 
-        pDrvDesc = pDmaExt->pDrvDescBase;
+        pDrvDesc = pDmaExt->Ring.pDrvDescBase;
 
         ShutdownDMAEngine(pDevExt, pDmaExt);
 
         WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
 
-        for (i = 0; i < (int)pDmaExt->NumberOfDescriptors; i++) {
-                if ((pDrvDesc->pScatterGatherList != 0)) {
+        for (i = 0; i < (int)pDmaExt->Ring.NumberOfDescriptors; i++) {
+                if ((pDmaExt->Ring.pDrvDescCold[i].pScatterGatherList != 0)) {
                         // Release the ScatterGatherList
-                        pDmaExt->pReadDmaAdapter->DmaOperations->PutScatterGatherList(pDmaExt->pReadDmaAdapter, pDrvDesc->pScatterGatherList, FALSE);
-                        pDrvDesc->pScatterGatherList = NULL;
+                        pDmaExt->pReadDmaAdapter->DmaOperations->PutScatterGatherList(pDmaExt->pReadDmaAdapter, pDmaExt->Ring.pDrvDescCold[i].pScatterGatherList, FALSE);
+                        pDmaExt->Ring.pDrvDescCold[i].pScatterGatherList = NULL;
                 }
                 if (pDrvDesc->DmaTransaction != NULL) {
-                        if (pDrvDesc->pHWDesc->C2S.ControlFlags_ByteCount & PACKET_DESC_C2S_STAT_END_OF_PACKET) {
+                        if (pDmaExt->Ring.pHWDescriptorBase[i].C2S.ControlFlags_ByteCount & PACKET_DESC_C2S_STAT_END_OF_PACKET) {
                                 pDmaXfer = DMAXferContext(pDrvDesc->DmaTransaction);
                                 if (pDmaXfer != NULL) {
                                         WdfDmaTransactionDmaCompletedFinal(pDrvDesc->DmaTransaction, 0, &status);
                                         // Retrieve the originating request from the Transaction data extension
-                                        Request = FindRequestByRequest(pDmaExt, pDmaXfer->Request);
+                                        Request = PacketRetireRequest(pDmaExt, pDmaXfer);
                                         if (Request != NULL) {
                                                 // complete the transaction
                                                 WdfRequestCompleteWithInformation(Request, STATUS_CANCELLED, 0);
@@ -518,9 +485,9 @@ VOID FreeRxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTEN
                                         }
                                         pDmaXfer->Request = NULL;
                                 }
-                                // Release the Transaction record
+                                // Release the Transaction record and return it to the pool
                                 WdfDmaTransactionRelease(pDrvDesc->DmaTransaction);
-                                WdfObjectDelete(pDrvDesc->DmaTransaction);
+                                PacketPutTransaction(pDmaExt, pDrvDesc->DmaTransaction);
                                 pDmaXfer = NULL;
                         }
                         pDrvDesc->DmaTransaction = NULL;
@@ -528,7 +495,7 @@ VOID FreeRxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTEN
                 pDrvDesc++;
         }
 
-        DMADriverIntiializeDMADescriptors(pDmaExt, pDmaExt->NumberOfDescriptors, 0);
+        DMADriverIntiializeDMADescriptors(pDmaExt, pDmaExt->Ring.NumberOfDescriptors, 0);
 
         WdfSpinLockRelease(pDmaExt->DmaSpinLock);
 }
@@ -543,16 +510,13 @@ VOID FreeRxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTEN
  */
 NTSTATUS InitializeTxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
 {
-        PDRIVER_DESC_STRUCT pDrvDesc;
-        PDMA_DESCRIPTOR_STRUCT pHWDesc;
-        PHYSICAL_ADDRESS pHWDescPhys;
-        UINT32 descNum;
+        UINT32 i;
         NTSTATUS status = STATUS_INSUFFICIENT_RESOURCES;
 
         UNREFERENCED_PARAMETER(pDevExt);
 
         // Set the DMA Engine back to a restarted state
-        pDmaExt->NumberOfUsedDescriptors = 0;
+        pDmaExt->Ring.NumberOfUsedDescriptors = 0;
 
         if (pDmaExt->pDmaEng->ControlStatus & PACKET_DMA_CTRL_DMA_RUNNING) {
                KdPrintEx((1, DPFLTR_WARNING_LEVEL, "DMA Engine %u is still running, status %08x.", pDmaExt->DmaEngine, pDmaExt->pDmaEng->ControlStatus));
@@ -561,63 +525,243 @@ NTSTATUS InitializeTxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DE
 
         WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
 
+        // The ring is empty, no send refers to a send pool any more
+        for (i = 0; i < MAX_SEND_POOLS; i++) {
+                pDmaExt->SendPool[i].SendsOutstanding = 0;
+        }
+
         // Make sure the buffer was allocated
-        if (pDmaExt->NumberOfDescriptors) {
-                pDmaExt->pNextDesc = pDmaExt->pDrvDescBase;
-                pDmaExt->pTailDesc = pDmaExt->pDrvDescBase;
-                pHWDescPhys = pDmaExt->pHWDescriptorBasePhysical;
-
-                pDrvDesc = pDmaExt->pNextDesc;
-                pHWDesc = pDrvDesc->pHWDesc;
-
-                // setup each of the descriptors
-                for (descNum = 0; descNum < pDmaExt->NumberOfDescriptors; descNum++) {
-                        // setup the descriptor
-                        pHWDesc->S2C.StatusFlags_BytesCompleted = 0;
-                        pHWDesc->S2C.UserControl = 0;
-                        pHWDesc->S2C.CardAddress = 0;
-                        pHWDesc->S2C.ControlFlags_ByteCount = (0 |
-                                                               PACKET_DESC_S2C_CTRL_IRQ_ON_COMPLETE |
-                                                               PACKET_DESC_S2C_CTRL_IRQ_ON_ERROR | PACKET_DESC_S2C_CTRL_END_OF_PACKET | PACKET_DESC_S2C_CTRL_START_OF_PACKET);
-                        pHWDesc->S2C.SystemAddressPhys = (UINT64) - 1;
+        if (pDmaExt->Ring.NumberOfDescriptors) {
+                // setup each of the descriptors and the descriptor pointers, both ends of the ring move
+                WdfSpinLockAcquire(pDmaExt->SubmitSpinLock);
+                status = PacketRingStatus(PacketRingInitializeTx(&pDmaExt->Ring));
+                WdfSpinLockRelease(pDmaExt->SubmitSpinLock);
+                if (NT_SUCCESS(status)) {
+                        // Now enable the DMA Engine
+                        pDmaExt->pDmaEng->ControlStatus = (COMMON_DMA_CTRL_IRQ_ENABLE | PACKET_DMA_CTRL_DMA_ENABLE);
+                }
+        } else {
+                // Not enough descriptors available
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Not enough descriptors are available (%d) in DmaEngine[%d]", pDmaExt->Ring.NumberOfDescriptors, pDmaExt->DmaEngine));
+        }
 
-                        pDrvDesc->DmaTransaction = NULL;
-                        pDrvDesc->DescriptorNumber = descNum;
-                        pDrvDesc->pHWDescPhys = pHWDescPhys;
-
-                        // update pointers
-                        if (descNum == (pDmaExt->NumberOfDescriptors - 1)) {
-                                // This is the last descriptor, link back to the top of the Descriptor pool
-                                pDrvDesc->pNextDesc = pDmaExt->pDrvDescBase;
-                                pHWDesc->S2C.NextDescriptorPhys = pDmaExt->pHWDescriptorBasePhysical.LowPart;
-                        } else {
-                                // Link to the Next Descriptor
-                                pHWDescPhys.QuadPart += sizeof(DMA_DESCRIPTOR_STRUCT);
-                                pHWDesc->S2C.NextDescriptorPhys = pHWDescPhys.LowPart;
-                                pDrvDesc->pNextDesc = pDrvDesc + 1;
-                                pDrvDesc = pDrvDesc->pNextDesc;
-                                pHWDesc++;
-                                if (pDrvDesc->pHWDesc != pHWDesc) {
-                                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL Broken Link detected in DrvDesc\n"));
+        WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+        return status;
+}
+
+/*! InitializeSendPool
+ *
+ *     \brief This routine maps a send buffer pool for the S2C DMA Engine.
+ *   The pool is mapped in MaximumTransferLength chunks, the Scatter/Gather
+ *   lists are kept until the pool is released and are copied into a list
+ *   with one element per page of the pool so a send can find its first
+ *   element from its offset.
+ *   This routine is called at IRQL < DISPATCH_LEVEL.
+ *    \param pDevExt - Pointer to this drivers context (data store)
+ *  \param pDmaExt - Pointer to the DMA Engine Context
+ *  \param pPool - Send pool, pMdl, UserVa and Length must be set
+ *  \return STATUS_SUCCESS if it works, an error if it fails.
+ *   On error the caller releases the pool with FreeSendPool.
+ */
+NTSTATUS InitializeSendPool(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PSEND_POOL pPool)
+{
+        PSCATTER_GATHER_LIST pChunkSgList;
+        PSCATTER_GATHER_ELEMENT pElement;
+        PUINT8 UserAddrVirt;
+        UINT32 NumberOfPages;
+        UINT32 MaxChunkLength;
+        UINT32 ChunkLength;
+        UINT32 BuffLength;
+        UINT32 PoolOffset = 0;
+        UINT64 ElementAddr;
+        UINT32 ElementLength;
+        UINT32 PageLength;
+        UINT32 chunk;
+        UINT32 i;
+        KIRQL oldIrql;
+        NTSTATUS status = STATUS_SUCCESS;
+
+        UserAddrVirt = pPool->UserVa;
+        NumberOfPages = CalcNumPages(UserAddrVirt, pPool->Length);
+        MaxChunkLength = (UINT32) pDmaExt->MaximumTransferLength;
+        pPool->NumberOfChunks = (UINT32) ((offset_in_page(UserAddrVirt) + pPool->Length + MaxChunkLength - 1) / MaxChunkLength);
+
+        pPool->ppChunkSgLists = (PSCATTER_GATHER_LIST *) ExAllocatePoolWithTag(NonPagedPoolNx, pPool->NumberOfChunks * sizeof(PSCATTER_GATHER_LIST), 'lgSP');
+        pPool->pSgList = (PSCATTER_GATHER_LIST) ExAllocatePoolWithTag(NonPagedPoolNx,
+                                                                      FIELD_OFFSET(SCATTER_GATHER_LIST, Elements) + (NumberOfPages * sizeof(SCATTER_GATHER_ELEMENT)), 'lgSP');
+        if ((pPool->ppChunkSgLists == NULL) || (pPool->pSgList == NULL)) {
+                return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        RtlZeroMemory(pPool->ppChunkSgLists, pPool->NumberOfChunks * sizeof(PSCATTER_GATHER_LIST));
+        pPool->pSgList->NumberOfElements = 0;
+
+        BuffLength = pPool->Length;
+        for (chunk = 0; chunk < pPool->NumberOfChunks; chunk++) {
+                // Every chunk but the first starts on a page boundary
+                ChunkLength = MaxChunkLength - (UINT32) offset_in_page(UserAddrVirt);
+                if (ChunkLength > BuffLength) {
+                        ChunkLength = BuffLength;
+                }
+
+                pDmaExt->SgMap.pSgList = NULL;
+                KeInitializeEvent(&pDmaExt->SgMap.Mapped, NotificationEvent, FALSE);
+                KeRaiseIrql(DISPATCH_LEVEL, &oldIrql);
+                status = pDmaExt->pWriteDmaAdapter->DmaOperations->GetScatterGatherList(pDmaExt->pWriteDmaAdapter, pDevExt->FunctionalDeviceObject,
+                                                                                        pPool->pMdl, UserAddrVirt, ChunkLength, PacketGetSgListComplete,
+                                                                                        &pDmaExt->SgMap, TRUE);
+                KeLowerIrql(oldIrql);
+                if (status != STATUS_SUCCESS) {
+                        // Get Scatter/Gather failed!
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Get Scatter/Gather List Failed with error (%d) in DmaEngine[%d]", status, pDmaExt->DmaEngine));
+                        return status;
+                }
+                if (KeReadStateEvent(&pDmaExt->SgMap.Mapped) == 0) {
+                        // Deferred until map registers are free, give back the ones this pool holds
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Out of map registers mapping send pool chunk %d in DmaEngine[%d]", chunk, pDmaExt->DmaEngine));
+                        PutPoolSgLists(pDmaExt, pPool);
+                        KeWaitForSingleObject(&pDmaExt->SgMap.Mapped, Executive, KernelMode, FALSE, NULL);
+                        status = STATUS_INSUFFICIENT_RESOURCES;
+                }
+                // FreeSendPool puts the list back, also when the mapping fails here
+                pChunkSgList = pDmaExt->SgMap.pSgList;
+                pDmaExt->SgMap.pSgList = NULL;
+                pPool->ppChunkSgLists[chunk] = pChunkSgList;
+                if (!NT_SUCCESS(status)) {
+                        return status;
+                }
+
+                // Split the elements at the page boundaries of the pool
+                for (i = 0; i < pChunkSgList->NumberOfElements; i++) {
+                        ElementAddr = pChunkSgList->Elements[i].Address.QuadPart;
+                        ElementLength = pChunkSgList->Elements[i].Length;
+                        while (ElementLength) {
+                                PageLength = PAGE_SIZE - (UINT32) offset_in_page((PUINT8) pPool->UserVa + PoolOffset);
+                                if (PageLength > ElementLength) {
+                                        PageLength = ElementLength;
+                                }
+                                if (pPool->pSgList->NumberOfElements >= NumberOfPages) {
+                                        return STATUS_DRIVER_INTERNAL_ERROR;
                                 }
+                                pElement = &pPool->pSgList->Elements[pPool->pSgList->NumberOfElements++];
+                                pElement->Address.QuadPart = ElementAddr;
+                                pElement->Length = PageLength;
+                                pElement->Reserved = 0;
+
+                                ElementAddr += PageLength;
+                                ElementLength -= PageLength;
+                                PoolOffset += PageLength;
                         }
                 }
+                UserAddrVirt += ChunkLength;
+                BuffLength -= ChunkLength;
+        }
 
-                // setup the descriptor pointers
-                pDmaExt->pDmaEng->NextDescriptorPtr = pDmaExt->pHWDescriptorBasePhysical.LowPart;
-                pDmaExt->pDmaEng->SoftwareDescriptorPtr = pDmaExt->pHWDescriptorBasePhysical.LowPart;
-                pDmaExt->pDmaEng->CompletedDescriptorPtr = 0;
+        // PacketStartPoolSend indexes the list by page
+        if (pPool->pSgList->NumberOfElements != NumberOfPages) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Send pool S/G list has %d elements for %d pages", pPool->pSgList->NumberOfElements, NumberOfPages));
+                status = STATUS_DRIVER_INTERNAL_ERROR;
+        }
+        return status;
+}
 
-                // Now enable the DMA Engine
-                pDmaExt->pDmaEng->ControlStatus = (COMMON_DMA_CTRL_IRQ_ENABLE | PACKET_DMA_CTRL_DMA_ENABLE);
-                status = STATUS_SUCCESS;
-        } else {
-                // Not enough descriptors available
-               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "<-- Not enough descriptors are available (%d) in DmaEngine[%d]", pDmaExt->NumberOfDescriptors, pDmaExt->DmaEngine));
+/* PacketGetSgListComplete
+ *
+ * \brief - This routine saves the Scatter/Gather list of a send or receive pool
+ *  chunk and wakes InitializeSendPool / InitializeRxDescriptors if it is waiting for it
+ * \param pDeviceObject - Not used
+ * \param pIrp - Not used
+ * \param pScatterGatherList - Scatter/Gather list of the chunk
+ * \param Context - The engine's SG_MAP
+ * \return nothing
+ */
+VOID PacketGetSgListComplete(IN PDEVICE_OBJECT pDeviceObject, IN PIRP pIrp, IN PSCATTER_GATHER_LIST pScatterGatherList, IN PVOID Context)
+{
+        PSG_MAP pSgMap = Context;
+
+        UNREFERENCED_PARAMETER(pDeviceObject);
+        UNREFERENCED_PARAMETER(pIrp);
+
+        pSgMap->pSgList = pScatterGatherList;
+        KeSetEvent(&pSgMap->Mapped, IO_NO_INCREMENT, FALSE);
+}
+
+/*! FreeSendPool
+ *
+ *     \brief This routine unmaps and unlocks a send buffer pool
+ *   and frees its slot.  No send from the pool may be on the ring.
+ *   This routine is called at IRQL < DISPATCH_LEVEL.
+ *  \param pDmaExt - Pointer to the DMA Engine Context
+ *  \param pPool - Send pool
+ *  \return None
+ */
+VOID FreeSendPool(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PSEND_POOL pPool)
+{
+        if (pPool->ppChunkSgLists != NULL) {
+                PutPoolSgLists(pDmaExt, pPool);
+                ExFreePoolWithTag(pPool->ppChunkSgLists, 'lgSP');
+                pPool->ppChunkSgLists = NULL;
         }
+        if (pPool->pSgList != NULL) {
+                ExFreePoolWithTag(pPool->pSgList, 'lgSP');
+                pPool->pSgList = NULL;
+        }
+        if (pPool->pMdl != NULL) {
+                MmUnlockPages(pPool->pMdl);
+                IoFreeMdl(pPool->pMdl);
+                pPool->pMdl = NULL;
+        }
+        pPool->UserVa = NULL;
+        pPool->Length = 0;
+        pPool->FileObject = NULL;
+        pPool->NumberOfChunks = 0;
+        pPool->bMapped = FALSE;
+        pPool->SendsOutstanding = 0;
+}
+
+/*! FreeCompRing
+ *
+ *     \brief This routine detaches the completion ring from the
+ *   C2S DMA Engine, returns the descriptors of the entries the
+ *   application had not consumed and unlocks the ring.
+ *   This routine is called at IRQL < DISPATCH_LEVEL.
+ *  \param pDmaExt - Pointer to the DMA Engine Context
+ *  \return None
+ */
+VOID FreeCompRing(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt)
+{
+        PCOMP_RING pCompRing = &pDmaExt->CompRing;
+        PUINT32 pTokens;
+        UINT32 Token;
 
+        // Stop the DPC from filling the ring
+        WdfSpinLockAcquire(pDmaExt->DmaSpinLock);
+        if (pCompRing->pTokens != NULL) {
+                while (pCompRing->Consumer != pCompRing->Producer) {
+                        Token = pCompRing->pTokens[pCompRing->Consumer & (pCompRing->NumEntries - 1)];
+                        if (Token != INVALID_RELEASE_TOKEN) {
+                                PacketRingReturnDescriptors(&pDmaExt->Ring, Token);
+                        }
+                        pCompRing->Consumer++;
+                }
+                PacketRingFlushDoorbell(&pDmaExt->Ring, TRUE);
+        }
+        pCompRing->pRing = NULL;
+        pTokens = pCompRing->pTokens;
+        pCompRing->pTokens = NULL;
+        pCompRing->NumEntries = 0;
+        pCompRing->Producer = 0;
+        pCompRing->Consumer = 0;
         WdfSpinLockRelease(pDmaExt->DmaSpinLock);
-        return status;
+
+        if (pTokens != NULL) {
+                ExFreePoolWithTag(pTokens, 'gRCP');
+        }
+        if (pCompRing->pMdl != NULL) {
+                MmUnlockPages(pCompRing->pMdl);
+                IoFreeMdl(pCompRing->pMdl);
+                pCompRing->pMdl = NULL;
+        }
+        pCompRing->FileObject = NULL;
 }
 
 /*! ShutdownDMAEngine
@@ -0,0 +1,1404 @@
+// -------------------------------------------------------------------------
+//
+// PRODUCT:            DMA Driver
+// MODULE NAME:        PacketRing.c
+//
+// MODULE DESCRIPTION:
+//
+// Contains the OS neutral Packet Mode DMA descriptor ring routines shared by
+// the Windows driver, the Linux driver and the PM40Sim host benchmark.
+//
+// $Revision:  $
+//
+// ------------------------- CONFIDENTIAL ----------------------------------
+//
+//              Copyright (c) 2017 by Northwest Logic, Inc.
+//                       All rights reserved.
+//
+// Trade Secret of Northwest Logic, Inc.  Do not disclose.
+//
+// Use of this source code in any form or means is permitted only
+// with a valid, written license agreement with Northwest Logic, Inc.
+//
+// Licensee shall keep all information contained herein confidential
+// and shall protect same in whole or in part from disclosure and
+// dissemination to all third parties.
+//
+//
+//                        Northwest Logic, Inc.
+//                  1100 NW Compton Drive, Suite 100
+//                      Beaverton, OR 97006, USA
+//
+//                        Ph:  +1 503 533 5800
+//                        Fax: +1 503 533 5900
+//                      E-Mail: info@nwlogic.com
+//                           www.nwlogic.com
+//
+// -------------------------------------------------------------------------
+
+#ifdef _WIN32
+#include "precomp.h"
+#else
+#include "PacketRingPlatform.h"
+#endif                          // _WIN32
+
+/*
+ * Calculate how much of this buffer that a HW descriptor can handle.
+ */
+static inline UINT64 PacketProgramDescFrag(UINT32 SGLength)
+{
+    return (SGLength > PACKET_DESC_BYTE_COUNT_MASK) ? PACKET_DESC_BYTE_COUNT_MASK : (UINT64)SGLength;
+}
+
+/*
+ * Interrupt bit for the EOP descriptor of the last of NumPackets S2C packets,
+ * only every IrqPacketCount packets interrupt on completion.
+ */
+static inline UINT32 PacketRingS2CEopIrq(PPACKET_RING pRing, UINT32 NumPackets)
+{
+    pRing->IrqPacketsPending += NumPackets;
+    if (pRing->IrqPacketsPending >= pRing->IrqPacketCount) {
+        pRing->IrqPacketsPending = 0;
+        return PACKET_DESC_S2C_CTRL_IRQ_ON_COMPLETE;
+    }
+    return 0;
+}
+
+/*
+ * Free S2C descriptors, the consumer only ever makes more of them free.
+ */
+static inline UINT32 PacketRingS2CFree(PPACKET_RING pRing)
+{
+    return (pRing->IndexMask + 1) - (pRing->Head - PacketRingReadIndex(&pRing->Tail));
+}
+
+/*
+ * Account for Packets more packets the engine has not been pointed at, the
+ * SoftwareDescriptorPtr is only written once DoorbellBatch of them are held.
+ */
+static inline void PacketRingDoorbell(PPACKET_RING pRing, UINT32 DescPhys, UINT32 Packets)
+{
+    pRing->DoorbellPending += Packets;
+    if (pRing->DoorbellPending >= pRing->DoorbellBatch) {
+        pRing->DoorbellPending = 0;
+        pRing->pDmaEng->SoftwareDescriptorPtr = DescPhys;
+    }
+}
+
+/*
+ * Interrupt bit for C2S descriptor DescNum, only every IrqPacketCount
+ * descriptors interrupt on completion.
+ */
+static inline UINT32 PacketRingC2SIrq(PPACKET_RING pRing, UINT32 DescNum)
+{
+    if ((pRing->IrqPacketCount <= 1) || (((DescNum + 1) % pRing->IrqPacketCount) == 0)) {
+        return PACKET_DESC_C2S_CTRL_IRQ_ON_COMPLETE;
+    }
+    return 0;
+}
+
+//--------------------------------------------------------
+//  Ring setup
+//--------------------------------------------------------
+
+/*! PacketRingSizeTx
+ *
+ *  \brief Rounds the size of an S2C ring up to the power of two
+ *   PacketRingInitializeTx requires, so a ring sized for the largest
+ *   transfer still holds it.
+ *  \param NumberDescriptors - Descriptors the ring must hold
+ *  \return Descriptors to allocate
+ */
+UINT32 PacketRingSizeTx(IN UINT32 NumberDescriptors)
+{
+        UINT32 Size = MINIMUM_NUMBER_DESCRIPTORS;
+
+        while (Size < NumberDescriptors) {
+                Size <<= 1;
+        }
+        return Size;
+}
+
+/*! PacketRingInitialize
+ *
+ *  \brief Provides the basic DMA Descriptors intialization
+ *   sets up physical linkages, etc.
+ *  \param pRing - Descriptor ring, pDmaEng and the descriptor memory must be set
+ *  \param NumberDescriptors - Number of descriptors to initialize and link
+ *  \param DescFlags - Initial DescFlags of every descriptor
+ *  \return PACKET_RING_SUCCESS if it works, an error if it fails.
+ */
+INT32 PacketRingInitialize(IN PPACKET_RING pRing, IN UINT32 NumberDescriptors, IN UINT32 DescFlags)
+{
+        PDRIVER_DESC_STRUCT pDrvDesc;
+        PDMA_DESCRIPTOR_STRUCT pHWDesc;
+        UINT32 descNum;
+
+        // Setup the Next and tail indices to start at the base.
+        pRing->NextIndex = 0;
+        pRing->TailIndex = 0;
+        pRing->IrqIndex = PACKET_RING_NO_INDEX;
+
+        if (NumberDescriptors < MINIMUM_NUMBER_DESCRIPTORS)
+                return PACKET_RING_INVALID_PARAMETER;
+        if (NumberDescriptors > pRing->NumberOfDescriptors)
+                return PACKET_RING_INVALID_PARAMETER;
+
+        // Set the DMA Engine back to a restarted state
+        pRing->NumberOfUsedDescriptors = 0;
+        pRing->S2CBytesTransferred = 0;
+        pRing->S2CPacketStatus = 0;
+        pRing->IrqPacketsPending = 0;
+        pRing->DoorbellPending = 0;
+        pRing->IndexMask = 0;
+        pRing->Head = 0;
+        pRing->Tail = 0;
+        pRing->RingSize = NumberDescriptors;
+
+        pDrvDesc = pRing->pDrvDescBase;
+        pHWDesc = pRing->pHWDescriptorBase;
+
+        // setup each of the descriptors
+        for (descNum = 0; descNum < NumberDescriptors; descNum++, pDrvDesc++, pHWDesc++) {
+                // Initialize the Hardware DMA Descriptor
+                pHWDesc->C2S.StatusFlags_BytesCompleted = 0;
+                pHWDesc->C2S.UserStatus = 0;
+                pHWDesc->C2S.CardAddress = 0;
+                pHWDesc->C2S.ControlFlags_ByteCount = 0;
+                pHWDesc->C2S.SystemAddressPhys = 0;
+
+                // Initialize the Drivers shadow of the Hardware DMA Descriptor
+                pDrvDesc->DescriptorNumber = descNum;
+                pDrvDesc->DescFlags = DescFlags;
+                PACKET_RING_DESC_RESET(pDrvDesc);
+                if (pRing->pDrvDescCold != NULL) {
+                        PacketRingDescCold(pRing, descNum)->pScatterGatherList = NULL;
+                }
+
+                // If this is the last descriptor...
+                if (descNum == (NumberDescriptors - 1)) {
+                        // Link back to the top of the Descriptor pool
+                        pHWDesc->S2C.NextDescriptorPhys = PACKET_RING_PHYS_LOW(pRing->pHWDescriptorBasePhysical);
+                } else {
+                        // Link to the Next Descriptor, the driver side follows by index
+                        pHWDesc->S2C.NextDescriptorPhys = PacketRingHWDescPhys(pRing, descNum + 1);
+                }
+        }
+
+        // setup the descriptor pointers
+        pRing->pDmaEng->NextDescriptorPtr = PACKET_RING_PHYS_LOW(pRing->pHWDescriptorBasePhysical);
+        pRing->pDmaEng->SoftwareDescriptorPtr = PACKET_RING_PHYS_LOW(pRing->pHWDescriptorBasePhysical);
+        pRing->pDmaEng->CompletedDescriptorPtr = 0;
+
+        return PACKET_RING_SUCCESS;
+}
+
+/*! PacketRingInitializeTx
+ *
+ *  \brief Links every descriptor of the ring and sets them up as empty
+ *   S2C descriptors.  The caller enables the DMA Engine.
+ *  \param pRing - Descriptor ring, its size a power of two (PacketRingSizeTx)
+ *  \return PACKET_RING_SUCCESS if it works, an error if it fails.
+ */
+INT32 PacketRingInitializeTx(IN PPACKET_RING pRing)
+{
+        PDMA_DESCRIPTOR_STRUCT pHWDesc;
+        UINT32 descNum;
+        INT32 status;
+
+        if ((pRing->NumberOfDescriptors & (pRing->NumberOfDescriptors - 1)) != 0) {
+                PacketRingPrint("S2C ring size %d is not a power of two", pRing->NumberOfDescriptors);
+                return PACKET_RING_INVALID_PARAMETER;
+        }
+        status = PacketRingInitialize(pRing, pRing->NumberOfDescriptors, 0);
+        if (PACKET_RING_OK(status)) {
+                pRing->IndexMask = pRing->NumberOfDescriptors - 1;
+                pHWDesc = pRing->pHWDescriptorBase;
+                for (descNum = 0; descNum < pRing->NumberOfDescriptors; descNum++, pHWDesc++) {
+                        pHWDesc->S2C.ControlFlags_ByteCount = (0 |
+                                                               PACKET_DESC_S2C_CTRL_IRQ_ON_COMPLETE |
+                                                               PACKET_DESC_S2C_CTRL_IRQ_ON_ERROR | PACKET_DESC_S2C_CTRL_END_OF_PACKET | PACKET_DESC_S2C_CTRL_START_OF_PACKET);
+                        pHWDesc->S2C.SystemAddressPhys = (UINT64) - 1;
+                }
+        }
+        return status;
+}
+
+/*! PacketRingBeginRx
+ *
+ *  \brief Starts (re)building the C2S ring, descriptors are then added
+ *   in order with PacketRingAddRxDescriptor and PacketRingEndRx closes the ring.
+ *  \param pRing - Descriptor ring
+ *  \return none
+ */
+VOID PacketRingBeginRx(IN PPACKET_RING pRing)
+{
+        // Set the DMA Engine back to a restarted state
+        pRing->NumberOfUsedDescriptors = 0;
+        pRing->IrqIndex = PACKET_RING_NO_INDEX;
+        pRing->DoorbellPending = 0;
+
+        // Setup the Next index to start at the base, it counts the descriptors added.
+        pRing->NextIndex = 0;
+}
+
+/*! PacketRingAddRxDescriptor
+ *
+ *  \brief Sets up the next C2S descriptor of the ring for one receive buffer.
+ *  \param pRing - Descriptor ring
+ *  \param SystemAddressPhys - Bus address of the buffer
+ *  \param Length - Length of the buffer in bytes
+ *  \param SystemAddressVirt - Address returned to the application for the buffer
+ *  \param bFreeRun - TRUE if the descriptor does not interrupt
+ *  \return PACKET_RING_SUCCESS if it works, an error if it fails.
+ */
+INT32 PacketRingAddRxDescriptor(IN PPACKET_RING pRing, IN UINT64 SystemAddressPhys, IN UINT32 Length, IN PVOID SystemAddressVirt, IN BOOLEAN bFreeRun)
+{
+        PDRIVER_DESC_STRUCT pDrvDesc;
+        PDMA_DESCRIPTOR_STRUCT pHWDesc;
+
+        if ((UINT32) pRing->NumberOfUsedDescriptors >= pRing->NumberOfDescriptors) {
+                return PACKET_RING_INSUFFICIENT_RESOURCES;
+        }
+        // Make sure we get a valid address
+        if ((SystemAddressPhys == 0) || (Length == 0) || (Length > PACKET_DESC_BYTE_COUNT_MASK)) {
+                PacketRingPrint("PacketRingAddRxDescriptor bad buffer, desc # %d\n", pRing->NumberOfUsedDescriptors);
+                return PACKET_RING_INVALID_PARAMETER;
+        }
+
+        pDrvDesc = PacketRingDesc(pRing, pRing->NextIndex);
+        pHWDesc = PacketRingHWDesc(pRing, pRing->NextIndex);
+
+        // setup the descriptor
+        pHWDesc->C2S.StatusFlags_BytesCompleted = 0;
+        pHWDesc->C2S.UserStatus = 0;
+        pHWDesc->C2S.CardAddress = 0;
+
+        if (bFreeRun) {
+                pHWDesc->C2S.ControlFlags_ByteCount = Length;
+        } else {
+                pHWDesc->C2S.ControlFlags_ByteCount = (Length | PacketRingC2SIrq(pRing, pRing->NumberOfUsedDescriptors) | PACKET_DESC_S2C_CTRL_IRQ_ON_ERROR);
+        }
+        pHWDesc->C2S.SystemAddressPhys = SystemAddressPhys;
+        pDrvDesc->SystemAddressVirt = SystemAddressVirt;
+        PACKET_RING_DESC_COOKIE(pDrvDesc) = NULL;
+
+        // On the Rx Side we use the UsedDescriptors as a total allocated count
+        pDrvDesc->DescriptorNumber = pRing->NumberOfUsedDescriptors++;
+        pDrvDesc->DescFlags = DESC_FLAGS_HW_OWNED;
+
+        // Move on to the next driver descriptor
+        pRing->NextIndex++;
+        return PACKET_RING_SUCCESS;
+}
+
+/*! PacketRingEndRx
+ *
+ *  \brief Closes the C2S ring after the last PacketRingAddRxDescriptor and
+ *   hands the descriptors to the DMA Engine.  The caller enables the engine.
+ *  \param pRing - Descriptor ring
+ *  \param bFreeRun - TRUE if the engine may use every descriptor without
+ *   waiting for them to be returned
+ *  \return none
+ */
+VOID PacketRingEndRx(IN PPACKET_RING pRing, IN BOOLEAN bFreeRun)
+{
+        // Make sure we have at least one completed descriptor
+        if (pRing->NextIndex != 0) {
+                // At this point the 'Next' index is at the last Desc + 1, which is the ring size
+                pRing->RingSize = pRing->NextIndex;
+                pRing->TailIndex = pRing->NextIndex - 1;
+
+                // Last Descriptor, link back to the top of the Descriptor pool.
+                PacketRingHWDesc(pRing, pRing->TailIndex)->C2S.NextDescriptorPhys = PACKET_RING_PHYS_LOW(pRing->pHWDescriptorBasePhysical);
+
+                if (bFreeRun) {
+                        pRing->pDmaEng->SoftwareDescriptorPtr = 0;
+                } else {
+                        pRing->pDmaEng->SoftwareDescriptorPtr = PacketRingHWDescPhys(pRing, pRing->TailIndex);
+                }
+
+                // Reset the 'Next' index to start at the base.
+                pRing->NextIndex = 0;
+        }
+        // setup the DMA Engine descriptor pointers
+        pRing->pDmaEng->NextDescriptorPtr = PACKET_RING_PHYS_LOW(pRing->pHWDescriptorBasePhysical);
+        pRing->pDmaEng->CompletedDescriptorPtr = 0;
+}
+
+/*! PacketRingSetIrqCount
+ *
+ *  \brief Sets how many packets complete per completion interrupt.  S2C
+ *   packets already on the ring keep their interrupt bits, the C2S FIFO
+ *   ring is re-marked in place since its descriptors are reused as is.
+ *   Completions that do not interrupt are left for the caller to poll.
+ *  \param pRing - Descriptor ring
+ *  \param PacketCount - Packets per interrupt, 0 or 1 interrupts on every packet
+ *  \param bRx - TRUE for a FIFO mode C2S ring set up by PacketRingAddRxDescriptor,
+ *   C2S descriptors are counted rather than packets
+ *  \return none
+ */
+VOID PacketRingSetIrqCount(IN PPACKET_RING pRing, IN UINT32 PacketCount, IN BOOLEAN bRx)
+{
+        PDMA_DESCRIPTOR_STRUCT pHWDesc;
+        UINT32 descNum;
+
+        pRing->IrqPacketCount = PacketCount;
+        pRing->IrqPacketsPending = 0;
+
+        if (bRx && (pRing->pHWDescriptorBase != NULL)) {
+                pHWDesc = pRing->pHWDescriptorBase;
+                for (descNum = 0; descNum < (UINT32) pRing->NumberOfUsedDescriptors; descNum++, pHWDesc++) {
+                        pHWDesc->C2S.ControlFlags_ByteCount =
+                            (pHWDesc->C2S.ControlFlags_ByteCount & ~PACKET_DESC_C2S_CTRL_IRQ_ON_COMPLETE) | PacketRingC2SIrq(pRing, descNum);
+                }
+        }
+}
+
+/*! PacketRingFlushDoorbell
+ *
+ *  \brief Moves the SoftwareDescriptorPtr over the packets a DoorbellBatch
+ *   has held back.  Callers that set DoorbellBatch call this at the end of
+ *   each burst of PacketRingProgramS2C* or PacketRingReturnDescriptors calls,
+ *   with the lock of that side held.
+ *  \param pRing - Descriptor ring
+ *  \param bRx - TRUE for a FIFO mode C2S ring, FALSE for an S2C ring
+ *  \return none
+ */
+VOID PacketRingFlushDoorbell(IN PPACKET_RING pRing, IN BOOLEAN bRx)
+{
+        if (pRing->DoorbellPending != 0) {
+                pRing->DoorbellPending = 0;
+                if (bRx) {
+                        pRing->pDmaEng->SoftwareDescriptorPtr = PacketRingHWDescPhys(pRing, pRing->TailIndex);
+                } else {
+                        pRing->pDmaEng->SoftwareDescriptorPtr = PacketRingHWDescPhys(pRing, pRing->Head & pRing->IndexMask);
+                }
+        }
+}
+
+//--------------------------------------------------------
+//  S2C Packet Mode routines
+//--------------------------------------------------------
+
+/*! PacketRingProgramS2C
+ *
+ *  \brief Places one packet on the S2C ring and moves the SoftwareDescriptorPtr
+ *   past it, see PacketRingFlushDoorbell.  The S/G list is walked once: physically contiguous elements
+ *   are merged into one descriptor of up to PACKET_DESC_BYTE_COUNT_MASK bytes
+ *   and descriptors are written as they are found, against the free count
+ *   read on entry.  If the ring runs out part way the descriptors written
+ *   are dropped again, Head and the SoftwareDescriptorPtr have not moved.
+ *  \param pRing - Descriptor ring
+ *  \param Cookie - Owner of the packet, handed back by PacketRingCompleteS2C
+ *  \param UserControl - UserControl of the SOP descriptor
+ *  \param CardAddress - Card address of the packet
+ *  \param SgList - Scatter/Gather list of the packet
+ *  \return PACKET_RING_SUCCESS, PACKET_RING_INSUFFICIENT_RESOURCES if the ring is full.
+ *  \note This function is in the transfer sequence.
+ *   It should be optimized to be as fast as possible.
+ */
+INT32 PacketRingProgramS2C(IN PPACKET_RING pRing, IN PACKET_RING_COOKIE Cookie, IN UINT64 UserControl, IN UINT64 CardAddress, IN PPACKET_RING_SG_LIST SgList)
+{
+        UINT32 SGCount = PACKET_RING_SG_COUNT(SgList);
+        UINT32 SGIndex;
+        UINT64 RunAddr;         // Physically contiguous part of the S/G list not yet programmed
+        UINT64 RunLength;
+        UINT32 FragLength;
+        UINT32 numAvailDescriptors;
+        UINT32 Control;
+        UINT32 Index;
+
+        if (SGCount == 0) {
+                return PACKET_RING_SUCCESS;
+        }
+
+        // Determine number of available descriptors, only the consumer changes it and only upwards
+        numAvailDescriptors = PacketRingS2CFree(pRing);
+
+        // Setup descriptor control, Interrupt when the DMA is stopped short
+        Control = PACKET_DESC_S2C_CTRL_START_OF_PACKET;
+
+        RunAddr = PACKET_RING_SG_ADDRESS(SgList, 0);
+        RunLength = PACKET_RING_SG_LENGTH(SgList, 0);
+        SGIndex = 1;
+        Index = pRing->Head;
+
+        for (;;) {
+                // Take in the following elements while they continue the run
+                while ((SGIndex < SGCount) && (RunLength < PACKET_DESC_BYTE_COUNT_MASK) &&
+                       (PACKET_RING_SG_ADDRESS(SgList, SGIndex) == (RunAddr + RunLength))) {
+                        RunLength += PACKET_RING_SG_LENGTH(SgList, SGIndex);
+                        SGIndex++;
+                }
+                FragLength = (RunLength > PACKET_DESC_BYTE_COUNT_MASK) ? PACKET_DESC_BYTE_COUNT_MASK : (UINT32) RunLength;
+
+                if ((Index - pRing->Head) == numAvailDescriptors) {
+                        PacketRingPrint("Too many desc, Available = %d", numAvailDescriptors);
+                        // Drop what was written, the engine has not been given any of it
+                        while (Index != pRing->Head) {
+                                Index--;
+                                PACKET_RING_DESC_COOKIE(PacketRingDesc(pRing, Index & pRing->IndexMask)) = NULL;
+                        }
+                        return PACKET_RING_INSUFFICIENT_RESOURCES;
+                }
+                if ((FragLength == RunLength) && (SGIndex == SGCount)) {
+                        /*
+                           End the processing here only interrupt on completion of the
+                           last DMA descriptor and when the DMA is stopped short.
+                         */
+                        Control |= PACKET_DESC_S2C_CTRL_END_OF_PACKET | PacketRingS2CEopIrq(pRing, 1) | PACKET_DESC_S2C_CTRL_IRQ_ON_ERROR;
+                }
+
+                // Setup the descriptor, the User Control field goes in the first one only
+                PacketRingStoreDesc(PacketRingHWDesc(pRing, Index & pRing->IndexMask), FragLength, UserControl, (UINT32) (CardAddress & 0xFFFFFFFF),
+                                    ((UINT32) ((CardAddress & 0xF00000000) >> 12)) | FragLength | Control, RunAddr,
+                                    PacketRingHWDescPhys(pRing, (Index + 1) & pRing->IndexMask));
+                UserControl = 0;
+                PACKET_RING_DESC_COOKIE(PacketRingDesc(pRing, Index & pRing->IndexMask)) = Cookie;
+                Index++;
+
+                if (Control & PACKET_DESC_S2C_CTRL_END_OF_PACKET) {
+                        break;
+                }
+                // Remove the start of packet bit for next descriptor and move the card offset.
+                Control &= ~PACKET_DESC_S2C_CTRL_START_OF_PACKET;
+                CardAddress += FragLength;
+
+                // Move past this descriptor, on to the next element once the run is used up
+                RunAddr += FragLength;
+                RunLength -= FragLength;
+                if (RunLength == 0) {
+                        RunAddr = PACKET_RING_SG_ADDRESS(SgList, SGIndex);
+                        RunLength = PACKET_RING_SG_LENGTH(SgList, SGIndex);
+                        SGIndex++;
+                }
+        }
+
+        // Account for the packet once, then setup the descriptor pointer
+        pRing->Head = Index;
+        PacketRingDoorbell(pRing, PacketRingHWDescPhys(pRing, Index & pRing->IndexMask), 1);
+        return PACKET_RING_SUCCESS;
+}
+
+/*
+ * Count the descriptors needed for Length bytes of the S/G list starting
+ * SGOffset bytes into element SGIndex, 0 if they run past its end.
+ */
+static UINT32 PacketRingCountRangeFragments(PPACKET_RING_SG_LIST SgList, UINT32 SGIndex, UINT32 SGOffset, UINT32 Length)
+{
+        UINT32 SGFragments = 0;
+        UINT32 SGLength;
+
+        while (Length) {
+                if (SGIndex >= PACKET_RING_SG_COUNT(SgList)) {
+                        return 0;
+                }
+                SGLength = PACKET_RING_SG_LENGTH(SgList, SGIndex) - SGOffset;
+                if (SGLength > Length) {
+                        SGLength = Length;
+                }
+                Length -= SGLength;
+                while (SGLength) {
+                        SGFragments++;
+                        SGLength -= (UINT32)PacketProgramDescFrag(SGLength);
+                }
+                SGIndex++;
+                SGOffset = 0;
+        }
+        return SGFragments;
+}
+
+/*
+ * Write the SGFragments descriptors of one packet taken from a range of the
+ * S/G list, see PacketRingCountRangeFragments, starting at ring position
+ * Index.  Moving Head and the SoftwareDescriptorPtr is left to the caller.
+ */
+static PDMA_DESCRIPTOR_STRUCT PacketRingProgramS2CRange(PPACKET_RING pRing, UINT32 Index, PACKET_RING_COOKIE Cookie, UINT64 UserControl,
+                                                        PPACKET_RING_SG_LIST SgList, UINT32 SGIndex, UINT32 SGOffset, UINT32 Length, UINT32 SGFragments)
+{
+        PDRIVER_DESC_STRUCT pDrvDesc;
+        PDMA_DESCRIPTOR_STRUCT pHWDesc;
+        PDMA_DESCRIPTOR_STRUCT pLastHWDesc = NULL;
+        UINT32 SGLength;
+        UINT64 SGAddr;
+        UINT32 FragLength;
+        UINT32 Control;
+        UINT32 descNum;
+
+        pDrvDesc = PacketRingDesc(pRing, Index & pRing->IndexMask);
+        pHWDesc = PacketRingHWDesc(pRing, Index & pRing->IndexMask);
+
+        Control = PACKET_DESC_S2C_CTRL_START_OF_PACKET;
+
+        SGAddr = PACKET_RING_SG_ADDRESS(SgList, SGIndex) + SGOffset;
+        SGLength = PACKET_RING_SG_LENGTH(SgList, SGIndex) - SGOffset;
+
+        for (descNum = 0; descNum < SGFragments; descNum++) {
+                // Skip to the element holding the rest of the packet
+                while (SGLength == 0) {
+                        SGIndex++;
+                        SGAddr = PACKET_RING_SG_ADDRESS(SgList, SGIndex);
+                        SGLength = PACKET_RING_SG_LENGTH(SgList, SGIndex);
+                }
+                if (SGLength > Length) {
+                        SGLength = Length;
+                }
+                FragLength = (UINT32)PacketProgramDescFrag(SGLength);
+
+                if (descNum == (SGFragments - 1)) {
+                        Control |= PACKET_DESC_S2C_CTRL_END_OF_PACKET | PACKET_DESC_S2C_CTRL_IRQ_ON_ERROR;
+                }
+                // Set the User Control field in the first descriptor only
+                PacketRingStoreDesc(pHWDesc, FragLength, UserControl, 0, FragLength | Control, SGAddr,
+                                    PacketRingHWDescPhys(pRing, (Index + 1) & pRing->IndexMask));
+                UserControl = 0;
+                PACKET_RING_DESC_COOKIE(pDrvDesc) = Cookie;
+
+                Control &= ~PACKET_DESC_S2C_CTRL_START_OF_PACKET;
+
+                pLastHWDesc = pHWDesc;
+                Index++;
+                pDrvDesc = PacketRingDesc(pRing, Index & pRing->IndexMask);
+                pHWDesc = PacketRingHWDesc(pRing, Index & pRing->IndexMask);
+
+                SGAddr += FragLength;
+                SGLength -= FragLength;
+                Length -= FragLength;
+        }
+        return pLastHWDesc;
+}
+
+/*! PacketRingProgramS2CSends
+ *
+ *  \brief Places a batch of packets, all taken from one S/G list, on the S2C
+ *   ring and moves the SoftwareDescriptorPtr past the last of them with a
+ *   single register write, see PacketRingFlushDoorbell.  Only the last
+ *   packet can interrupt on completion.
+ *  \param pRing - Descriptor ring
+ *  \param Cookie - Owner of the packets, handed back by PacketRingCompleteS2C
+ *  \param SgList - Scatter/Gather list of the whole send buffer
+ *  \param pEntries - BufferOffset, Length and UserControl of each packet
+ *  \param NumEntries - Number of packets in pEntries
+ *  \param pNumProgrammed - Returns the number of packets placed on the ring,
+ *   packets are taken in order until the ring is full
+ *  \return PACKET_RING_SUCCESS if at least one packet was placed on the ring,
+ *   PACKET_RING_INSUFFICIENT_RESOURCES if the ring is full or
+ *   PACKET_RING_INVALID_PARAMETER if the first packet is not in the S/G list.
+ *  \note This function is in the transfer sequence.
+ *   It should be optimized to be as fast as possible.
+ */
+INT32 PacketRingProgramS2CSends(IN PPACKET_RING pRing, IN PACKET_RING_COOKIE Cookie, IN PPACKET_RING_SG_LIST SgList,
+                                IN PPACKET_SEND_ENTRY_STRUCT pEntries, IN UINT32 NumEntries, OUT UINT32 * pNumProgrammed)
+{
+        PDMA_DESCRIPTOR_STRUCT pLastHWDesc = NULL;
+        UINT32 numAvailDescriptors;
+        UINT32 SGFragments;
+        UINT32 SGIndex = 0;
+        UINT64 SGBase = 0;      // Buffer offset of element SGIndex
+        UINT64 BufferOffset;
+        UINT64 UserControl;
+        UINT32 Length;
+        UINT32 Index = pRing->Head;
+        UINT32 i;
+        INT32 status = PACKET_RING_SUCCESS;
+
+        // Determine number of available descriptors
+        numAvailDescriptors = PacketRingS2CFree(pRing);
+
+        for (i = 0; i < NumEntries; i++) {
+                // Read each entry once, the application can still see the array
+                BufferOffset = pEntries[i].BufferOffset;
+                Length = pEntries[i].Length;
+                UserControl = pEntries[i].UserControl;
+
+                // Packets normally follow each other in the buffer, only rewind for one that does not
+                if (BufferOffset < SGBase) {
+                        SGIndex = 0;
+                        SGBase = 0;
+                }
+                while ((SGIndex < PACKET_RING_SG_COUNT(SgList)) && (BufferOffset >= (SGBase + PACKET_RING_SG_LENGTH(SgList, SGIndex)))) {
+                        SGBase += PACKET_RING_SG_LENGTH(SgList, SGIndex);
+                        SGIndex++;
+                }
+
+                SGFragments = PacketRingCountRangeFragments(SgList, SGIndex, (UINT32) (BufferOffset - SGBase), Length);
+                if (SGFragments == 0) {
+                        PacketRingPrint("Packet %d outside the send buffer, Offset = 0x%llx, Length = %d", i, BufferOffset, Length);
+                        status = PACKET_RING_INVALID_PARAMETER;
+                        break;
+                }
+                if (numAvailDescriptors < SGFragments) {
+                        status = PACKET_RING_INSUFFICIENT_RESOURCES;
+                        break;
+                }
+                pLastHWDesc = PacketRingProgramS2CRange(pRing, Index, Cookie, UserControl, SgList, SGIndex, (UINT32) (BufferOffset - SGBase), Length, SGFragments);
+                Index += SGFragments;
+                numAvailDescriptors -= SGFragments;
+        }
+        *pNumProgrammed = i;
+
+        if (pLastHWDesc == NULL) {
+                return status;
+        }
+        // Interrupt once the last packet of the batch is done, then hand the batch to the engine
+        pLastHWDesc->S2C.ControlFlags_ByteCount |= PacketRingS2CEopIrq(pRing, i);
+        pRing->Head = Index;
+        PacketRingDoorbell(pRing, pLastHWDesc->S2C.NextDescriptorPhys, i);
+        return PACKET_RING_SUCCESS;
+}
+
+/*! PacketRingProgramS2CPoolPacket
+ *
+ *  \brief Places one packet, taken from a range of a registered send pool's
+ *   S/G list, on the S2C ring, see PacketRingFlushDoorbell.
+ *  \param pRing - Descriptor ring
+ *  \param Cookie - Owner of the packet, handed back by PacketRingCompleteS2C
+ *  \param UserControl - UserControl of the SOP descriptor
+ *  \param SgList - Scatter/Gather list of the pool
+ *  \param SGIndex - Element holding the start of the packet
+ *  \param SGOffset - Offset of the packet in that element
+ *  \param Length - Length of the packet
+ *  \return PACKET_RING_SUCCESS, PACKET_RING_INSUFFICIENT_RESOURCES if the ring is full
+ *   or PACKET_RING_INVALID_PARAMETER if the packet is not in the S/G list.
+ *  \note This function is in the transfer sequence.
+ *   It should be optimized to be as fast as possible.
+ */
+INT32 PacketRingProgramS2CPoolPacket(IN PPACKET_RING pRing, IN PACKET_RING_COOKIE Cookie, IN UINT64 UserControl, IN PPACKET_RING_SG_LIST SgList,
+                                     IN UINT32 SGIndex, IN UINT32 SGOffset, IN UINT32 Length)
+{
+        PDMA_DESCRIPTOR_STRUCT pLastHWDesc;
+        UINT32 numAvailDescriptors;
+        UINT32 SGFragments;
+
+        SGFragments = PacketRingCountRangeFragments(SgList, SGIndex, SGOffset, Length);
+        if (SGFragments == 0) {
+                return PACKET_RING_INVALID_PARAMETER;
+        }
+
+        // Determine number of available descriptors
+        numAvailDescriptors = PacketRingS2CFree(pRing);
+        if (numAvailDescriptors < SGFragments) {
+                PacketRingPrint("Too many desc, Available = %d, Required = %d", numAvailDescriptors, SGFragments);
+                return PACKET_RING_INSUFFICIENT_RESOURCES;
+        }
+
+        pLastHWDesc = PacketRingProgramS2CRange(pRing, pRing->Head, Cookie, UserControl, SgList, SGIndex, SGOffset, Length, SGFragments);
+        pLastHWDesc->S2C.ControlFlags_ByteCount |= PacketRingS2CEopIrq(pRing, 1);
+        pRing->Head += SGFragments;
+        PacketRingDoorbell(pRing, pLastHWDesc->S2C.NextDescriptorPhys, 1);
+        return PACKET_RING_SUCCESS;
+}
+
+/*! PacketRingCompleteS2C
+ *
+ *  \brief Retires the completed S2C descriptors at the tail of the ring
+ *   and reports every completed packet to pfnComplete.  The retired
+ *   descriptors are given back to the producer side with a single Tail
+ *   update at the end, so this can run alongside the PacketRingProgramS2C*
+ *   routines.
+ *  \param pRing - Descriptor ring
+ *  \param pfnComplete - Called with the packet's Cookie at its EOP descriptor
+ *  \param Context - Passed to pfnComplete
+ *  \return Number of packets completed
+ */
+UINT32 PacketRingCompleteS2C(IN PPACKET_RING pRing, IN PPACKET_RING_S2C_COMPLETE pfnComplete, IN PVOID Context)
+{
+        PDRIVER_DESC_STRUCT pDrvDesc;
+        PDMA_DESCRIPTOR_STRUCT pHWDesc;
+        PACKET_RING_COOKIE Cookie;
+        UINT32 Index = pRing->Tail;
+        UINT32 Packets = 0;
+
+        // Make sure we have completed descriptor(s)
+        pDrvDesc = PacketRingDesc(pRing, Index & pRing->IndexMask);
+        pHWDesc = PacketRingHWDesc(pRing, Index & pRing->IndexMask);
+
+        while (pHWDesc->S2C.StatusFlags_BytesCompleted & (PACKET_DESC_S2C_STAT_COMPLETE|PACKET_DESC_S2C_STAT_ERROR)) {
+                // At this point we know we have a completed Send DMA Descriptor
+                if (pHWDesc->S2C.ControlFlags_ByteCount & PACKET_DESC_S2C_CTRL_START_OF_PACKET) {
+                        pRing->S2CBytesTransferred = 0;
+                        pRing->S2CPacketStatus = 0;
+                }
+                pRing->S2CBytesTransferred += (pHWDesc->S2C.StatusFlags_BytesCompleted & PACKET_DESC_COMPLETE_BYTE_COUNT_MASK);
+                pRing->S2CPacketStatus |= (pHWDesc->S2C.StatusFlags_BytesCompleted & PACKET_DESC_S2C_STAT_ERROR);
+
+                // Indicate we processed this descriptor by clearing Complete and Error flags
+                pHWDesc->S2C.StatusFlags_BytesCompleted &= ~(PACKET_DESC_S2C_STAT_COMPLETE | PACKET_DESC_S2C_STAT_ERROR);
+
+                if (pHWDesc->S2C.ControlFlags_ByteCount & PACKET_DESC_S2C_CTRL_END_OF_PACKET) {
+                        // The Cookie is in every descriptor for a given packet
+                        Cookie = PACKET_RING_DESC_COOKIE(pDrvDesc);
+                        PACKET_RING_DESC_COOKIE(pDrvDesc) = NULL;
+                        Packets++;
+                        if (pfnComplete != NULL) {
+                                pfnComplete(Context, Cookie, pRing->S2CBytesTransferred, pRing->S2CPacketStatus);
+                        }
+                }
+
+                // Link to the next packets
+                Index++;
+                pDrvDesc = PacketRingDesc(pRing, Index & pRing->IndexMask);
+                pHWDesc = PacketRingHWDesc(pRing, Index & pRing->IndexMask);
+        }
+        // Hand the retired descriptors back to the producer side in one go
+        if (Index != pRing->Tail) {
+                PacketRingPublishIndex(&pRing->Tail, Index);
+        }
+        return Packets;
+}
+
+//--------------------------------------------------------
+//  C2S Addressable Packet Mode routines
+//--------------------------------------------------------
+
+/*! PacketRingProgramC2S
+ *
+ *  \brief Places one Addressable Packet Mode read on the C2S ring, one
+ *   descriptor per PACKET_DESC_BYTE_COUNT_MASK bytes of each S/G element,
+ *   and moves the SoftwareDescriptorPtr past it.  Only the last descriptor
+ *   interrupts on completion.
+ *  \param pRing - Descriptor ring
+ *  \param Cookie - Owner of the packet, kept on each of its descriptors
+ *  \param CardAddress - Card address of the packet, contiguous over its descriptors
+ *  \param SgList - Scatter/Gather list of the packet
+ *  \return PACKET_RING_SUCCESS, PACKET_RING_INSUFFICIENT_RESOURCES if the ring is full.
+ *  \note This function is in the transfer sequence.
+ *   It should be optimized to be as fast as possible.
+ */
+INT32 PacketRingProgramC2S(IN PPACKET_RING pRing, IN PACKET_RING_COOKIE Cookie, IN UINT64 CardAddress, IN PPACKET_RING_SG_LIST SgList)
+{
+        UINT32 SGCount = PACKET_RING_SG_COUNT(SgList);
+        UINT32 SGFragments = 0;
+        UINT32 SGIndex;
+        UINT32 SGLength;
+        UINT64 SGAddr;
+        UINT32 FragLength;
+        UINT32 Control;
+        UINT32 descNum;
+        UINT32 Index;
+
+        // Count the fragments, including the fragments bigger than one DMA Descriptor size
+        for (SGIndex = 0; SGIndex < SGCount; SGIndex++) {
+                SGLength = PACKET_RING_SG_LENGTH(SgList, SGIndex);
+                while (SGLength) {
+                        SGFragments++;
+                        SGLength -= (UINT32)PacketProgramDescFrag(SGLength);
+                }
+        }
+        if (SGFragments == 0) {
+                return PACKET_RING_SUCCESS;
+        }
+        if ((pRing->NumberOfDescriptors - (UINT32) pRing->NumberOfUsedDescriptors) < SGFragments) {
+                PacketRingPrint("Too many desc, Available = %d, Required = %d", pRing->NumberOfDescriptors - pRing->NumberOfUsedDescriptors, SGFragments);
+                return PACKET_RING_INSUFFICIENT_RESOURCES;
+        }
+
+        // Setup descriptor control, Set for the first descriptor
+        Control = PACKET_DESC_C2S_CTRL_START_OF_PACKET;
+
+        SGIndex = 0;
+        SGAddr = PACKET_RING_SG_ADDRESS(SgList, 0);
+        SGLength = PACKET_RING_SG_LENGTH(SgList, 0);
+        Index = pRing->NextIndex;
+
+        for (descNum = 0; descNum < SGFragments; descNum++) {
+                // Skip to the element holding the rest of the packet
+                while (SGLength == 0) {
+                        SGIndex++;
+                        SGAddr = PACKET_RING_SG_ADDRESS(SgList, SGIndex);
+                        SGLength = PACKET_RING_SG_LENGTH(SgList, SGIndex);
+                }
+                FragLength = (UINT32)PacketProgramDescFrag(SGLength);
+
+                if (descNum == (SGFragments - 1)) {
+                        // Only interrupt on completion of the last DMA descriptor and when the DMA is stopped short.
+                        Control |= PACKET_DESC_C2S_CTRL_END_OF_PACKET | PACKET_DESC_C2S_CTRL_IRQ_ON_COMPLETE | PACKET_DESC_C2S_CTRL_IRQ_ON_ERROR;
+                }
+                PacketRingStoreDesc(PacketRingHWDesc(pRing, Index), FragLength, 0, (UINT32) (CardAddress & 0xFFFFFFFF),
+                                    ((UINT32) ((CardAddress & 0xF00000000) >> 12)) | FragLength | Control, SGAddr,
+                                    PacketRingHWDescPhys(pRing, PacketRingNextIndex(pRing, Index)));
+                PACKET_RING_DESC_COOKIE(PacketRingDesc(pRing, Index)) = Cookie;
+
+                // Remove the start of packet bit for next descriptor.  Card Address must
+                // be contiguous between Descriptors in the same packet.
+                Control &= ~PACKET_DESC_C2S_CTRL_START_OF_PACKET;
+                CardAddress += FragLength;
+
+                SGAddr += FragLength;
+                SGLength -= FragLength;
+                Index = PacketRingNextIndex(pRing, Index);
+        }
+
+        // Account for the whole packet at once, then setup the descriptor pointer
+        pRing->NumberOfUsedDescriptors += SGFragments;
+        pRing->NextIndex = Index;
+        pRing->pDmaEng->SoftwareDescriptorPtr = PacketRingHWDescPhys(pRing, Index);
+        return PACKET_RING_SUCCESS;
+}
+
+//-----------------------------------------------------------
+// C2S FIFO Packet Mode routines
+//-----------------------------------------------------------
+
+/*! PacketRingCheckForCompletedPacket
+ *
+ *  \brief Checks for a complete packet, SOP to EOP, at the head of the C2S ring.
+ *  \param pRing - Descriptor ring
+ *  \param Completed - Set to TRUE if a complete packet is waiting
+ *  \return PACKET_RING_SUCCESS if the ring is sane, an error if it is not.
+ */
+INT32 PacketRingCheckForCompletedPacket(IN PPACKET_RING pRing, OUT BOOLEAN * Completed)
+{
+    PDRIVER_DESC_STRUCT pDrvDesc;
+    PDMA_DESCRIPTOR_STRUCT pHWDesc;
+    UINT32 CachedDescStatus;
+    LONG NumberOfCheckedDescriptors=0;
+    UINT32 Index = pRing->NextIndex;
+
+    *Completed = FALSE;
+
+    pDrvDesc = PacketRingDesc(pRing, Index);
+    pHWDesc = PacketRingHWDesc(pRing, Index);
+
+    if (pHWDesc->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_COMPLETE) {
+
+        if (!(pHWDesc->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_START_OF_PACKET)) {
+            PacketRingPrint("Missing SOP at Head descriptor 0x%p (0x%x)\n", pHWDesc, pHWDesc->C2S.StatusFlags_BytesCompleted);
+            return PACKET_RING_UNSUCCESSFUL;
+        }
+
+        // Walk the descriptors looking for the EOP descriptor. It could be this descriptor
+        do {
+            // Save a copy of the status flags for later loop while test
+            CachedDescStatus = pHWDesc->C2S.StatusFlags_BytesCompleted;
+            if (CachedDescStatus & (PACKET_DESC_C2S_STAT_COMPLETE | PACKET_DESC_C2S_STAT_ERROR)) {
+                if (pDrvDesc->DescFlags == DESC_FLAGS_HW_OWNED) {
+                    // Move to the next descriptor
+                    Index = PacketRingNextIndex(pRing, Index);
+                    pDrvDesc = PacketRingDesc(pRing, Index);
+                    pHWDesc = PacketRingHWDesc(pRing, Index);
+                } else {  // This is an ERROR! It means we overran the queue
+                    PacketRingPrint("Descriptor is NOT owned by hardware");
+                    return PACKET_RING_INTERNAL_ERROR;
+                }
+            } else {  // This Packet is not complete, exit out.
+                return PACKET_RING_SUCCESS;
+            }
+        } while ((!(CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET)) && ((++NumberOfCheckedDescriptors) < pRing->NumberOfUsedDescriptors));
+
+        if (NumberOfCheckedDescriptors >= pRing->NumberOfUsedDescriptors) {
+            PacketRingPrint("Overran the ring");
+            return PACKET_RING_UNSUCCESSFUL;
+        }
+
+        // If we exit the while loop then we have a completed packet
+        *Completed = TRUE;
+    }
+    // Otherwise this is not necessarily an error. We could be looping past a completed packet
+    // to the next DMA Descriptor that has not started to be DMA'd yet.
+    return PACKET_RING_SUCCESS;
+}
+
+/*! PacketRingCompleteReceivedPacket
+ *
+ *  \brief Hands the packet at the head of the C2S ring to software.  The
+ *   descriptors stay software owned until PacketRingReturnDescriptors is
+ *   called with the returned RxToken.
+ *  \param pRing - Descriptor ring
+ *  \param pRecvPacketRet - Receive to fill in, zeroed with RxToken = INVALID_RELEASE_TOKEN
+ *  \return PACKET_RING_SUCCESS if it works, an error if it fails.
+ *  \note Call only after PacketRingCheckForCompletedPacket found a packet.
+ */
+INT32 PacketRingCompleteReceivedPacket(IN PPACKET_RING pRing, IN PPACKET_RING_RECEIVE pRecvPacketRet)
+{
+    PDRIVER_DESC_STRUCT pDrvDesc;
+    PDMA_DESCRIPTOR_STRUCT pHWDesc;
+    UINT32 CachedDescStatus;
+    INT32 status = PACKET_RING_INTERNAL_ERROR;
+    LONG NumberOfCheckedDescriptors=0;
+    UINT32 Index = pRing->NextIndex;
+
+    pDrvDesc = PacketRingDesc(pRing, Index);
+    pHWDesc = PacketRingHWDesc(pRing, Index);
+
+    // Walk the descriptors again looking for the EOP descriptor. It could be this descriptor
+    do {
+        // Save a copy of the status flags for later loop while test
+        CachedDescStatus = pHWDesc->C2S.StatusFlags_BytesCompleted;
+
+        // Get the bytes transfered before we clear this field below
+        pRecvPacketRet->Length += (CachedDescStatus & PACKET_DESC_COMPLETE_BYTE_COUNT_MASK);
+
+        // The descriptor is now "owned" by software and will not get it back until
+        // the application does another PACKET_RECEIVE_IOCTL with this "token"
+        // Indicate we processed this descriptor by clearing all but the SOP and EOP flags
+        pHWDesc->C2S.StatusFlags_BytesCompleted &= (PACKET_DESC_C2S_STAT_START_OF_PACKET | PACKET_DESC_C2S_STAT_END_OF_PACKET);
+        pDrvDesc->DescFlags = DESC_FLAGS_SW_OWNED;
+
+        if (CachedDescStatus & PACKET_DESC_C2S_STAT_START_OF_PACKET) {
+            pRecvPacketRet->RxToken = pDrvDesc->DescriptorNumber;
+            pRecvPacketRet->Address = (UINT64)(size_t)pDrvDesc->SystemAddressVirt;
+        }
+        if (CachedDescStatus & PACKET_DESC_C2S_STAT_ERROR) {
+            // Indicate a bad packet by zeroing out the address and Length fields
+            pRecvPacketRet->Address = 0;
+            pRecvPacketRet->Length = 0;
+            pDrvDesc->DescFlags = DESC_FLAGS_SW_FREED;
+            PacketRingPrint("Received a bad packet");
+        }
+
+        if (CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET) {
+
+            // Return the EOP UserStatus to the application
+            pRecvPacketRet->UserStatus = pHWDesc->C2S.UserStatus;
+
+            // Make sure the return token is valid
+            if (pRecvPacketRet->RxToken == INVALID_RELEASE_TOKEN) {
+                PacketRingPrint("Bad Token Return in Receive Process");
+            } else if (pRecvPacketRet->Address) {
+                status = PACKET_RING_SUCCESS;
+            } else {
+                PacketRingPrint("Found an error during the End of packet. The address is zero.");
+            }
+        }
+
+        // Move to the next descriptor in the ring
+        Index = PacketRingNextIndex(pRing, Index);
+        pDrvDesc = PacketRingDesc(pRing, Index);
+        pHWDesc = PacketRingHWDesc(pRing, Index);
+
+    } while ((!(CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET)) && ((++NumberOfCheckedDescriptors) < pRing->NumberOfUsedDescriptors));
+
+    if (NumberOfCheckedDescriptors >= pRing->NumberOfUsedDescriptors) {
+        PacketRingPrint("Overran the ring");
+        status = PACKET_RING_INTERNAL_ERROR;
+    }
+
+    // We consider this descriptor processed at this point, move to the next descriptor in the ring
+    pRing->NextIndex = Index;
+
+    return status;
+}
+
+/*! PacketRingReleasePacket
+ *
+ *  \brief Gives the descriptors of a received packet back to hardware
+ *   ownership.  A packet returned out of order is marked freed and given
+ *   back when the packets ahead of it are returned.  Only TailIndex is
+ *   moved, the caller writes SoftwareDescriptorPtr once it has returned
+ *   all the packets it has.
+ *  \param pRing - Descriptor ring
+ *  \param ReturnToken - Token (Index) for the starting DMA Descriptor to be
+ *     recycled back to the DMA Engine to be re-used
+ *  \return PACKET_RING_SUCCESS if it works, an error if it fails.
+ */
+static INT32 PacketRingReleasePacket(IN PPACKET_RING pRing, IN UINT32 ReturnToken)
+{
+        PDRIVER_DESC_STRUCT pDrvDesc;
+        PDMA_DESCRIPTOR_STRUCT pHWDesc;
+        UINT32 Index;
+        UINT32 PrevIndex;
+        UINT32 DescriptorState = DESC_FLAGS_HW_OWNED;
+        UINT32 CachedDescStatus = 0;
+        LONG NumberOfCheckedDescriptors=0;
+
+        // Stage 1: Determine if this token is at the tail or will create a 'hole' in the list
+        // Get the descriptor that is at the tail of the queue
+        Index = PacketRingNextIndex(pRing, pRing->TailIndex);
+        pDrvDesc = PacketRingDesc(pRing, Index);
+        pHWDesc = PacketRingHWDesc(pRing, Index);
+        if (pDrvDesc->DescFlags != DESC_FLAGS_SW_OWNED) {
+                PacketRingPrint("Returned Token %d is NOT owned by Software (Flags:0x%x)", ReturnToken, pDrvDesc->DescFlags);
+                return PACKET_RING_INVALID_PARAMETER;
+        }
+        if ((pHWDesc->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_START_OF_PACKET) != PACKET_DESC_C2S_STAT_START_OF_PACKET) {
+                PacketRingPrint("Descriptor at Token %d is not SOP", ReturnToken);
+                return PACKET_RING_INVALID_PARAMETER;
+        }
+
+        PrevIndex = Index;
+
+        // See if the Returned decscriptor (token) is next in line.
+        if (pDrvDesc->DescriptorNumber != ReturnToken) {
+                if (ReturnToken >= pRing->RingSize) {
+                        PacketRingPrint("Return Token %d out of range", ReturnToken);
+                        return PACKET_RING_INVALID_PARAMETER;
+                }
+                // In this case we are not at the tail, hence we just "free" the descriptor
+                // Get the Descriptor at the Token Index into the descriptor array
+                Index = ReturnToken;
+                pDrvDesc = PacketRingDesc(pRing, Index);
+                pHWDesc = PacketRingHWDesc(pRing, Index);
+                // Make sure the Token matches the Desciptor
+                if (pDrvDesc->DescriptorNumber != ReturnToken) {
+                        PacketRingPrint("Descriptor %d number does not match ReturnToken %d", pDrvDesc->DescriptorNumber, ReturnToken);
+                        return PACKET_RING_INVALID_PARAMETER;
+                }
+                if ((pHWDesc->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_START_OF_PACKET) != PACKET_DESC_C2S_STAT_START_OF_PACKET) {
+                        PacketRingPrint("Descriptor at Return Token %d is not SOP", ReturnToken);
+                        return PACKET_RING_INVALID_PARAMETER;
+                }
+                DescriptorState = DESC_FLAGS_SW_FREED;
+        }
+
+        // Stage 2: Walk the list starting at the token and either Free or mark for HW the descriptor(s)
+        // Walk the descriptors looking for the EOP descriptor. It could be this descriptor
+        do {
+                if (pDrvDesc->DescFlags != DESC_FLAGS_HW_OWNED) {
+                        // We can change ownership back to hardware since we sill be setting the SwDescPtr
+                        pDrvDesc->DescFlags = DescriptorState;
+                        // Save a copy of the status flags for later loop while test
+                        CachedDescStatus = pHWDesc->C2S.StatusFlags_BytesCompleted;
+                        // Clear the status just in case
+                        pHWDesc->C2S.StatusFlags_BytesCompleted = 0;
+                        // Cache the current Descriptor
+                        PrevIndex = Index;
+                        // Move to the next descriptor
+                        Index = PacketRingNextIndex(pRing, Index);
+                        pDrvDesc = PacketRingDesc(pRing, Index);
+                        pHWDesc = PacketRingHWDesc(pRing, Index);
+                } else {
+                        PacketRingPrint("Returned Token %d descriptor is owned by hardware (Flags:0x%x)", ReturnToken, pDrvDesc->DescFlags);
+                        return PACKET_RING_INVALID_PARAMETER;
+                }
+        } while ((!(CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET)) && ((++NumberOfCheckedDescriptors) < pRing->NumberOfUsedDescriptors));
+
+        if (NumberOfCheckedDescriptors >= pRing->NumberOfUsedDescriptors) {
+                PacketRingPrint("Overran the receive ring");
+                return PACKET_RING_INTERNAL_ERROR;
+        }
+
+        // Stage 3: If not a 'freed hole' then advance the list, look for freed descriptors ahead first
+        if (DescriptorState == DESC_FLAGS_HW_OWNED) {
+                // Index is the descriptor following the EOP
+                // Now see if there are any previously 'freed' descriptors ahead of us.
+                NumberOfCheckedDescriptors = 0;
+                while ((pDrvDesc->DescFlags == DESC_FLAGS_SW_FREED) && ((++NumberOfCheckedDescriptors) < pRing->NumberOfUsedDescriptors)) {
+                        // And mark it as HW Owned
+                        pDrvDesc->DescFlags = DESC_FLAGS_HW_OWNED;
+                        // Cache the current Descriptor
+                        PrevIndex = Index;
+                        // Move to the next descriptor
+                        Index = PacketRingNextIndex(pRing, Index);
+                        pDrvDesc = PacketRingDesc(pRing, Index);
+                }
+
+                if (NumberOfCheckedDescriptors >= pRing->NumberOfUsedDescriptors) {
+                        PacketRingPrint("Overran the receive ring");
+                        return PACKET_RING_INTERNAL_ERROR;
+                }
+
+                // Set the last descriptor as the new end
+                pRing->TailIndex = PrevIndex;
+        }
+        return PACKET_RING_SUCCESS;
+}
+
+/*! PacketRingReturnDescriptors
+ *
+ *  \brief Returns the descriptors of a received packet to the DMA Engine.
+ *   A packet returned out of order is marked freed and given back when
+ *   the packets ahead of it are returned.  The SoftwareDescriptorPtr may be
+ *   held back, see PacketRingFlushDoorbell.
+ *  \param pRing - Descriptor ring
+ *  \param ReturnToken - Token (Index) for the starting DMA Descriptor to be
+ *     recycled back to the DMA Engine to be re-used
+ *  \return PACKET_RING_SUCCESS if it works, an error if it fails.
+ */
+INT32 PacketRingReturnDescriptors(IN PPACKET_RING pRing, IN UINT32 ReturnToken)
+{
+        UINT32 TailIndex = pRing->TailIndex;
+        INT32 status;
+
+        status = PacketRingReleasePacket(pRing, ReturnToken);
+        if (pRing->TailIndex != TailIndex) {
+                PacketRingDoorbell(pRing, PacketRingHWDescPhys(pRing, pRing->TailIndex), 1);
+        }
+        return status;
+}
+
+/*! PacketRingReturnDescriptorsBatch
+ *
+ *  \brief Returns the descriptors of several received packets to the DMA
+ *   Engine, in any order, and moves SoftwareDescriptorPtr once.
+ *   INVALID_RELEASE_TOKEN entries are skipped, a bad token does not stop
+ *   the tokens after it from being returned.
+ *  \param pRing - Descriptor ring
+ *  \param pTokens - Tokens of the packets to return
+ *  \param NumTokens - Number of tokens
+ *  \param pNumReturned - Returns the number of packets returned
+ *  \return PACKET_RING_SUCCESS if every token was returned, else the first error.
+ */
+INT32 PacketRingReturnDescriptorsBatch(IN PPACKET_RING pRing, IN UINT32 * pTokens, IN UINT32 NumTokens, OUT UINT32 * pNumReturned)
+{
+        UINT32 TailIndex = pRing->TailIndex;
+        INT32 status = PACKET_RING_SUCCESS;
+        INT32 tokenStatus;
+        UINT32 i;
+
+        *pNumReturned = 0;
+        for (i = 0; i < NumTokens; i++) {
+                if (pTokens[i] == INVALID_RELEASE_TOKEN) {
+                        continue;
+                }
+                tokenStatus = PacketRingReleasePacket(pRing, pTokens[i]);
+                if (PACKET_RING_OK(tokenStatus)) {
+                        (*pNumReturned)++;
+                } else if (PACKET_RING_OK(status)) {
+                        status = tokenStatus;
+                }
+        }
+        if ((pRing->TailIndex != TailIndex) || (pRing->DoorbellPending != 0)) {
+                pRing->DoorbellPending = 0;
+                pRing->pDmaEng->SoftwareDescriptorPtr = PacketRingHWDescPhys(pRing, pRing->TailIndex);
+        }
+        return status;
+}
+
+/*! PacketRingReturnDescriptorsThrough
+ *
+ *  \brief Returns the descriptors of every received packet from the tail of
+ *   the C2S ring up to and including the packet of LastToken, and moves
+ *   SoftwareDescriptorPtr once.  Packets are handed out in ring order so
+ *   this releases every packet received up to LastToken.
+ *  \param pRing - Descriptor ring
+ *  \param LastToken - Token of the last packet to return
+ *  \param pNumReturned - Returns the number of packets returned
+ *  \return PACKET_RING_SUCCESS if it works, an error if it fails.
+ */
+INT32 PacketRingReturnDescriptorsThrough(IN PPACKET_RING pRing, IN UINT32 LastToken, OUT UINT32 * pNumReturned)
+{
+        UINT32 TailIndex = pRing->TailIndex;
+        PDRIVER_DESC_STRUCT pDrvDesc;
+        UINT32 Token;
+        UINT32 NumberOfCheckedPackets = 0;
+        INT32 status = PACKET_RING_SUCCESS;
+
+        *pNumReturned = 0;
+
+        // The application must hold the packet, check before anything is returned
+        if (LastToken >= pRing->RingSize) {
+                PacketRingPrint("Return Token %d out of range", LastToken);
+                return PACKET_RING_INVALID_PARAMETER;
+        }
+        pDrvDesc = PacketRingDesc(pRing, LastToken);
+        if ((pDrvDesc->DescFlags != DESC_FLAGS_SW_OWNED) ||
+            ((PacketRingHWDesc(pRing, LastToken)->C2S.StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_START_OF_PACKET) != PACKET_DESC_C2S_STAT_START_OF_PACKET)) {
+                PacketRingPrint("Returned Token %d is NOT a received packet (Flags:0x%x)", LastToken, pDrvDesc->DescFlags);
+                return PACKET_RING_INVALID_PARAMETER;
+        }
+
+        // Return the packets in ring order, each one moves the tail up to the next
+        do {
+                Token = PacketRingDesc(pRing, PacketRingNextIndex(pRing, pRing->TailIndex))->DescriptorNumber;
+                status = PacketRingReleasePacket(pRing, Token);
+                if (!PACKET_RING_OK(status)) {
+                        break;
+                }
+                (*pNumReturned)++;
+        } while ((Token != LastToken) && ((++NumberOfCheckedPackets) < pRing->RingSize));
+
+        if ((pRing->TailIndex != TailIndex) || (pRing->DoorbellPending != 0)) {
+                pRing->DoorbellPending = 0;
+                pRing->pDmaEng->SoftwareDescriptorPtr = PacketRingHWDescPhys(pRing, pRing->TailIndex);
+        }
+        return status;
+}
+
+//-----------------------------------------------------------
+// C2S Free Run FIFO Packet Mode routines
+//-----------------------------------------------------------
+
+static BOOLEAN PacketRingFreeRunFindEOP(PPACKET_RING pRing)
+{
+    PDMA_DESCRIPTOR_STRUCT pHWDesc;
+    UINT32 StatusFlags_BytesCompleted;
+    UINT32 Index = pRing->NextIndex;
+
+    pHWDesc = PacketRingHWDesc(pRing, Index);
+
+    /*
+     * Don't go around the descriptor ring more then once.
+     */
+    do
+    {
+        StatusFlags_BytesCompleted = pHWDesc->C2S.StatusFlags_BytesCompleted;
+        if (!(StatusFlags_BytesCompleted & (PACKET_DESC_C2S_STAT_COMPLETE | PACKET_DESC_C2S_STAT_ERROR))) {
+            return FALSE;
+        }
+        if (StatusFlags_BytesCompleted & PACKET_DESC_C2S_STAT_END_OF_PACKET)
+        {
+            return TRUE;
+        }
+
+        Index = PacketRingNextIndex(pRing, Index);
+        pHWDesc = PacketRingHWDesc(pRing, Index);
+
+    } while (Index != pRing->NextIndex);
+
+    return FALSE;
+}
+
+/*
+ * Setting the IRQ bits in a HW descriptor will cause an interrupt if the
+ * DMA engine processes that descriptor. When this happens you know there has been a
+ * DMA overrun. The detection algorithm is to set the IRQ bits in the first descriptor
+ * of a group of packets, then clear them the next time PacketRingProcessFreeRun() is
+ * called to process a packet. Wash rinse repeat...
+*/
+#define PACKET_RECVS_IRQ_BITS (PACKET_DESC_S2C_CTRL_IRQ_ON_COMPLETE | PACKET_DESC_S2C_CTRL_IRQ_ON_ERROR)
+
+static void PacketRingFreeRunClearIRQ(PPACKET_RING pRing)
+{
+    if (pRing->IrqIndex != PACKET_RING_NO_INDEX)
+    {
+        PacketRingHWDesc(pRing, pRing->IrqIndex)->C2S.ControlFlags_ByteCount &= (~PACKET_RECVS_IRQ_BITS);
+        pRing->IrqIndex = PACKET_RING_NO_INDEX;
+    }
+}
+
+static void PacketRingFreeRunSetIRQ(PPACKET_RING pRing, UINT32 Index)
+{
+    PacketRingFreeRunClearIRQ(pRing);
+
+    PacketRingHWDesc(pRing, Index)->C2S.ControlFlags_ByteCount |= PACKET_RECVS_IRQ_BITS;
+    pRing->IrqIndex = Index;
+}
+
+/*
+ * Move the overrun IRQ bits up to the descriptor just before NextIndex,
+ * the last one the application has been handed.
+ */
+static void PacketRingFreeRunResetLastIRQ(PPACKET_RING pRing)
+{
+    UINT32 LastIndex = PacketRingPrevIndex(pRing, pRing->NextIndex);
+
+    if ((pRing->IrqIndex != PACKET_RING_NO_INDEX) && (pRing->IrqIndex != LastIndex))
+    {
+        PacketRingFreeRunSetIRQ(pRing, LastIndex);
+    }
+}
+
+/*! PacketRingProcessFreeRun
+ *
+ * \brief Fills in pPacketRecvs with the completed packets at the head of
+ *  the C2S ring and gives their descriptors straight back to the DMA Engine.
+ *  EngineStatus is left to the caller.
+ * \param pRing - Descriptor ring
+ * \param pPacketRecvs - PACKET_RECVS_STRUCT to fill in
+ * \param bAdvanceTail - TRUE to move the SoftwareDescriptorPtr past the packets, once
+ *  for the call (FIFO mode), FALSE when the engine is free running (streaming mode)
+ * \return PACKET_RING_SUCCESS if it works, an error if it fails.
+ */
+INT32 PacketRingProcessFreeRun(IN PPACKET_RING pRing, IN PPACKET_RECVS_STRUCT pPacketRecvs, IN BOOLEAN bAdvanceTail)
+{
+        PDRIVER_DESC_STRUCT pDrvDesc;
+        PDMA_DESCRIPTOR_STRUCT pHWDesc;
+        PPACKET_ENTRY_STRUCT pPacket;
+        UINT32 Index;
+        UINT32 PrevIndex = 0;
+        UINT32 TailIndex = pRing->TailIndex;
+        UINT32 CachedDescStatus = 0;
+        LONG NumberOfCheckedDescriptors=0;
+        INT32 status = PACKET_RING_SUCCESS;
+
+        pPacketRecvs->RetNumEntries = 0;
+        // Loop to file out the packet receives.
+        while (pPacketRecvs->RetNumEntries < pPacketRecvs->AvailNumEntries) {
+                // Zero out the return length, address, etc
+                pPacket = &pPacketRecvs->Packets[pPacketRecvs->RetNumEntries];
+                pPacket->Length = 0;
+                pPacket->Address = 0;
+                pPacket->Status = PACKET_ERROR_MALFORMED;
+                pPacket->UserStatus = 0;
+
+                if (PacketRingFreeRunFindEOP(pRing) != TRUE)
+                {
+                    /*
+                     * We can usually assume the previous packets have been processed by the application
+                     * and can now be released from DMA overrun detection. Note that this may not be an accurate
+                     * assumption if there are multiple threads calling this IOCTL handler.
+                     */
+                    if (pPacketRecvs->RetNumEntries == 0)
+                    {
+                        PacketRingFreeRunResetLastIRQ(pRing);
+                    }
+                    break;
+                }
+
+                /*
+                 * If this is the first loop, and there is an EOP, then set the IRQ bits to detect
+                 * DMA overrun.
+                 */
+                if (pPacketRecvs->RetNumEntries == 0)
+                {
+                    PacketRingFreeRunSetIRQ(pRing, pRing->NextIndex);
+                }
+
+                Index = pRing->NextIndex;
+                pDrvDesc = PacketRingDesc(pRing, Index);
+                pHWDesc = PacketRingHWDesc(pRing, Index);
+                // Walk the descriptors again retrieving length, address etc. and looking for
+                //   the EOP descriptor, it could be this one.
+                do {
+                        CachedDescStatus = pHWDesc->C2S.StatusFlags_BytesCompleted;
+                        // Make sure we have a completed DMA Descriptor.
+                        if (CachedDescStatus & (PACKET_DESC_C2S_STAT_COMPLETE | PACKET_DESC_C2S_STAT_ERROR)) {
+                                // Get the bytes transfered before we clear this field below
+                                pPacket->Length += (CachedDescStatus & PACKET_DESC_COMPLETE_BYTE_COUNT_MASK);
+                                pHWDesc->C2S.StatusFlags_BytesCompleted = 0;
+                                if (CachedDescStatus & PACKET_DESC_C2S_STAT_START_OF_PACKET) {
+                                        pPacket->Address = (UINT64) (size_t) pDrvDesc->SystemAddressVirt;
+                                }
+                                if (CachedDescStatus & PACKET_DESC_C2S_STAT_ERROR) {
+                                        pPacket->Status = CachedDescStatus & (PACKET_DESC_C2S_STAT_ERROR | PACKET_DESC_C2S_STAT_SHORT);
+                                }
+                                if (CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET) {
+                                        // Return the EOP UserStatus to the application
+                                        pPacket->UserStatus = pHWDesc->C2S.UserStatus;
+                                        // Since we found the EOP remove the Malformed packet indicator.
+                                        pPacket->Status &= ~PACKET_ERROR_MALFORMED;
+                                        pPacketRecvs->RetNumEntries++;
+                                }
+                                // Mark the descriptor as HW Owned
+                                pDrvDesc->DescFlags = DESC_FLAGS_HW_OWNED;
+                                // Cache the current Descriptor
+                                PrevIndex = Index;
+                                // Move to the next descriptor
+                                Index = PacketRingNextIndex(pRing, Index);
+                                pDrvDesc = PacketRingDesc(pRing, Index);
+                                pHWDesc = PacketRingHWDesc(pRing, Index);
+                        } else  // This descriptor is not complete and it should be, exit out.
+                        {
+                                PacketRingPrint("Packet is not complete, exiting");
+                                status = PACKET_RING_INTERNAL_ERROR;
+                                break;
+                        }
+                } while ((!(CachedDescStatus & PACKET_DESC_C2S_STAT_END_OF_PACKET)) && ((++NumberOfCheckedDescriptors) < pRing->NumberOfUsedDescriptors));
+
+                if (!PACKET_RING_OK(status)) {
+                        break;
+                }
+                if (NumberOfCheckedDescriptors >= pRing->NumberOfUsedDescriptors) {
+                        PacketRingPrint("Overran the ring");
+                        status = PACKET_RING_INTERNAL_ERROR;
+                        break;
+                }
+
+                // We consider this Packet processed at this point, move to the next descriptor in the ring
+                pRing->NextIndex = Index;
+
+                if (bAdvanceTail) {
+                        // Set the last descriptor as the new end, the engine is given the packets below
+                        pRing->TailIndex = PrevIndex;
+                }
+        }                       // while more packets available to return in the struct...
+
+        // Hand every packet taken back to the engine with one register write
+        if (bAdvanceTail && (pRing->TailIndex != TailIndex)) {
+                pRing->DoorbellPending = 0;
+                pRing->pDmaEng->SoftwareDescriptorPtr = PacketRingHWDescPhys(pRing, pRing->TailIndex);
+        }
+        return status;
+}
@@ -42,6 +42,7 @@
 
 #include <stdarg.h>
 #include <wdf.h>
+#include <ntstrsafe.h>
 
 #pragma warning(default:4201)
 
@@ -59,5 +60,6 @@
 #include "Include/StdTypes.h"
 #include "Include/DmaDriverHw.h"
 #include "Public.h"
+#include "Include/PacketRing.h"
 #include "Private.h"
 #include "pci_version.h"
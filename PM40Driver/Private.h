@@ -61,6 +61,21 @@
 #define PBA_OFFSET_MASK                0xFFFFFFF8
 #define PBA_BIR_MASK                0x00000007
 
+#define CARD_INTERRUPT_STATUS_NONE  0xFFFFFFFF  // DMA Engine has no common interrupt status bit
+
+// Poll mode receive passes are run by a timer, see DMADriverPollTimerStart.
+// Past the per second cap the engine interrupt paces the DPC again.
+#define POLL_PASS_INTERVAL_US       100
+#define POLL_MAX_PASSES_PER_SECOND  4000
+
+// A DO_MEM_VECTOR_IOCTL MEM_OP_POLL spins between reads for its first
+// MEM_OP_POLL_SPIN_US, then sleeps MEM_OP_POLL_SLEEP_US (at least a clock tick).
+#define MEM_OP_POLL_SPIN_US         10
+#define MEM_OP_POLL_SLEEP_US        100
+
+// Longest wait for the sends of a pool whose handle is closed, see PacketFileCleanup
+#define SEND_POOL_DRAIN_TIMEOUT_MS  1000
+
 #define _NELEM(arr)                 (sizeof(arr) / sizeof(arr[0]))
 #ifdef CONFIG_X86_64
 #define _OFFSETOF(t,m)              ((UINT64) &((t *)0)->m)
@@ -83,6 +98,62 @@ static _inline void mdelay(UINT32 msec)
         }
 }
 
+/*!
+ * \struct SG_MAP
+ * \brief Scatter/Gather list of the send or receive pool chunk being mapped.
+ *  It is kept in the engine context as the HAL may call PacketGetSgListComplete
+ *  after GetScatterGatherList has returned, see InitializeSendPool and
+ *  InitializeRxDescriptors.
+ */
+typedef struct _SG_MAP {
+        PSCATTER_GATHER_LIST pSgList;   // Set by PacketGetSgListComplete
+        KEVENT Mapped;                  // Signaled once pSgList is set
+} SG_MAP, *PSG_MAP;
+
+/*!
+ * \struct SEND_POOL
+ * \brief Send buffer pool registered with an S2C DMA Engine.  The pool stays
+ *  locked and mapped until it is released, so sends from it need no MDL or
+ *  Scatter/Gather list of their own.
+ */
+typedef struct _SEND_POOL {
+        PMDL pMdl;                      // MDL locking the pool, NULL if the slot is free
+        PVOID UserVa;                   // Application address of the pool
+        UINT32 Length;                  // Length of the pool
+        WDFFILEOBJECT FileObject;       // Handle that registered the pool, released when it is closed
+        UINT32 NumberOfChunks;          // Scatter/Gather lists the pool was mapped with
+        PSCATTER_GATHER_LIST *ppChunkSgLists;   // Held until the pool is released
+        PSCATTER_GATHER_LIST pSgList;   // The pool split into one element per page
+        BOOLEAN bMapped;                // Sends may use the pool, under DmaSpinLock
+        UINT32 SendsOutstanding;        // Sends from the pool on the ring, under DmaSpinLock
+} SEND_POOL, *PSEND_POOL;
+
+/*!
+ * \struct COMP_RING
+ * \brief Completion ring registered with a FIFO mode C2S DMA Engine.  The
+ *  driver fills it with received packets from the DPC and returns the
+ *  descriptors of the entries the application has consumed, so receives
+ *  need no IOCtl while the application keeps up.
+ */
+typedef struct _COMP_RING {
+        PMDL pMdl;                      // MDL locking the ring, NULL if none is registered
+        PPACKET_COMP_RING_STRUCT pRing; // System address of the ring, NULL if none is registered
+        PUINT32 pTokens;                // RxToken of each entry, the application's copy is not trusted
+        WDFFILEOBJECT FileObject;       // Handle that registered the ring, released when it is closed
+        UINT32 NumEntries;              // Entries in the ring, a power of 2
+        UINT32 Producer;                // Entries filled in, under DmaSpinLock
+        UINT32 Consumer;                // Entries whose descriptors were returned, under DmaSpinLock
+} COMP_RING, *PCOMP_RING;
+
+/*!
+ * \struct DMA_XFER_POOL_ENTRY
+ * \brief Free list link of a pre-created DMA Transaction, see DmaDriverCreateTransactionPool.
+ */
+typedef struct _DMA_XFER_POOL_ENTRY {
+        SLIST_ENTRY ListEntry;
+        WDFDMATRANSACTION DmaTransaction;
+} DMA_XFER_POOL_ENTRY, *PDMA_XFER_POOL_ENTRY;
+
 typedef struct _DMA_XFER {
         WDFREQUEST Request;
         SIZE_T bytesTransferred;
@@ -91,18 +162,37 @@ typedef struct _DMA_XFER {
         PMDL pMdl;
         UINT32 Mode;
         UINT32 PacketStatus;
+        PPACKET_SENDS_STRUCT pPacketSends;      // PACKET_SENDS_IOCTL batch, NULL for a single packet
+        UINT32 SendsProgrammed;         // Packets of the batch, then the ones placed on the ring
+        UINT32 SendsCompleted;          // Packets of the batch completed so far
+        PSEND_POOL pSendPool;           // PACKET_POOL_SEND_IOCTL pool, NULL if the transaction maps the buffer
+        PDMA_XFER_POOL_ENTRY pPoolEntry;        // Entry of this transaction in the engine's pool
+        LIST_ENTRY OutstandingEntry;    // Link on OutstandingRequests while Request is outstanding
+        // Set by PacketS2CComplete, PacketS2CDpc finishes the transfer after DmaSpinLock is released
+        WDFREQUEST CompleteRequest;     // Retired request to complete, NULL if canceled
+        NTSTATUS CompleteStatus;
 } DMA_XFER, *PDMA_XFER;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DMA_XFER, DMAXferContext)
 
-/* The device extension for a DMA Engine */
+#pragma warning(push)
+#pragma warning(disable:4324)   // Padded for DECLSPEC_CACHEALIGN
+
+/* The device extension for a DMA Engine, allocated cache aligned.  State
+ * written by the submit path and state written by the ISR / DPCs are kept on
+ * separate cache lines, the read mostly configuration sits in front of them.
+ */
 typedef struct _DMA_ENGINE_DEVICE_EXTENSION {
         UINT8 DmaEngine;
         UINT8 DmaType;          // Block or Packet
         WDF_DMA_DIRECTION DmaDirection;
-        UINT32 NumberOfDescriptors;
-        LONG NumberOfUsedDescriptors;
         UINT32 DMAEngineMSIVector;
+        UINT32 IrqStatusIndex;          // Common interrupt status bit, CARD_INTERRUPT_STATUS_NONE for none
+
+        // Processor / NUMA placement, see DMADriverResolveAffinity
+        UINT32 Affinity;                // InterruptAffinity<n> setting of the engine's vector
+        UINT32 DpcProcessor;            // Processor index the DPCs are targeted at or ENGINE_AFFINITY_ANY
+        UINT32 NumaNode;                // Node the descriptor memory was allocated on or ENGINE_AFFINITY_ANY
         WDFINTERRUPT Interrupt;
         size_t MaximumTransferLength;
 
@@ -112,53 +202,92 @@ typedef struct _DMA_ENGINE_DEVICE_EXTENSION {
         WDFDMAENABLER DmaEnabler32BitOnly;
         WDFDMATRANSACTION DmaTransaction;
         WDFREQUEST DmaRequest;
+        SLIST_HEADER TransactionPool;   // Free pre-created DMA Transactions
+        PDMA_XFER_POOL_ENTRY pTransactionPoolEntries;
+        UINT32 TransactionPoolSize;
+        LIST_ENTRY OutstandingRequests; // DMA_XFERs of the requests on the ring, in ring order, under DmaSpinLock
         WDFDPC CompletionDpc;
 
         PDMA_ENGINE_STRUCT pDmaEng;     // Pointer to the DMA Control registers in BAR 0
 
-        PDMA_DESCRIPTOR_STRUCT pHWDescriptorBase;
-        PHYSICAL_ADDRESS pHWDescriptorBasePhysical;     // Shared for both Block and Packet Modes
-        PDRIVER_DESC_STRUCT pDrvDescBase;       // Pointer to the base memory of the Driver Descs
-        PDRIVER_DESC_STRUCT pNextDesc;  // Pointer to the front of the queue
-        PDRIVER_DESC_STRUCT pTailDesc;  // Pointer to the back of the queue
-        PDRIVER_DESC_STRUCT pIrqDesc; // last descriptor in which IRQ bits were set to detect DMA overrun
+        PACKET_RING Ring;               // Descriptor ring, see PacketRing.c
 
         WDFSPINLOCK DmaSpinLock;       // For protecting HW queues
-
-        KMUTEX ThreadMutex;             // Block multiple threads from entering a critical region.
+        // S2C rings are split: SubmitSpinLock serializes the producers (ring head, interrupt
+        // marking, SoftwareDescriptorPtr), DmaSpinLock the completion DPC (ring tail) and
+        // OutstandingRequests.  The two sides share only the ring's Head / Tail, see PacketRing.h.
+        // When both are needed DmaSpinLock is taken first.
+        WDFSPINLOCK SubmitSpinLock;
 
         PDMA_ADAPTER pReadDmaAdapter;
+        PDMA_ADAPTER pWriteDmaAdapter;
+
+        SEND_POOL SendPool[MAX_SEND_POOLS];     // Registered send buffer pools (S2C)
+        COMP_RING CompRing;             // Registered completion ring (C2S FIFO)
+        SG_MAP SgMap;                   // Send or receive pool chunk being mapped, under DMADriverLock
 
         UINT8 TimeoutCount;
         UINT8 bAddressablePacketMode;
-        BOOLEAN bDescriptorAllocSuccess;
         UINT32 PacketMode;
 
         BOOLEAN bFreeRun;
         UINT16 DMAEngineStatus;
+        UINT32 InterruptControl;        // InterruptControl register value outside of free run mode
+
+        // Completion interrupt coalescing, see SetInterruptCoalescing
+        UINT32 CoalesceTimeoutUs;       // Poll period for completions that did not interrupt, 0 if off
+        KTIMER CoalesceTimer;
+        KDPC CoalesceDpc;
+
+        // Adaptive interrupt / poll receive mode, see SetPollMode
+        UINT32 PollBudget;              // Packets per DPC pass while polling, 0 if off
+        UINT32 PollIdlePasses;          // Passes with an empty ring before the interrupt is enabled again
+        KTIMER PollTimer;
+        KDPC PollDpc;
+
+        PVOID UserVa;           // Mapped VA for the process
+        PMDL PMdl;              // MDL used to map memory
+
+        // Submit side, taken by every application thread
+        DECLSPEC_CACHEALIGN KMUTEX ThreadMutex; // Block multiple threads from entering a critical region.
 
-        // Performance counters
+        // ISR / DPC side
+        DECLSPEC_CACHEALIGN UINT32 PollIdleCount;       // Consecutive poll passes that found the ring empty
+        UINT32 PollPassesInCurrentSecond;       // Poll timer passes, capped at POLL_MAX_PASSES_PER_SECOND
+        BOOLEAN bIrqMasked;             // Interrupt masked by the ISR, the poll timer runs the DPC
+        BOOLEAN bPollPass;              // The queued DPC pass was queued by the poll timer
+        BOOLEAN bPollParked;            // Poll stopped with completed packets and no receive queued
+
+        // Performance counters, written by the ISR, the DPCs and the watchdog
         UINT64 BytesInLastSecond;
         UINT64 BytesInCurrentSecond;
         UINT64 HardwareTimeInLastSecond;
         UINT64 HardwareTimeInCurrentSecond;
         UINT64 DMAInactiveTime;
         UINT64 IntsInLastSecond;
+        UINT64 IntsInCurrentSecond;
         UINT64 DPCsInLastSecond;
-
-        PVOID UserVa;           // Mapped VA for the process
-        PMDL PMdl;              // MDL used to map memory
+        UINT64 DPCsInCurrentSecond;
+        UINT64 PollTimeInLastSecond;    // DPC time spent polling, performance counter ticks
+        UINT64 PollTimeInCurrentSecond;
+        UINT64 IntTimeInLastSecond;     // DPC time spent after an interrupt, performance counter ticks
+        UINT64 IntTimeInCurrentSecond;
 } DMA_ENGINE_DEVICE_EXTENSION, *PDMA_ENGINE_DEVICE_EXTENSION;
 
+#pragma warning(pop)
+
 /* The device extension for the device object */
 typedef struct _DEVICE_EXTENSION {
         WDFDEVICE Device;
 
         // IOCTL Queue
         WDFQUEUE IoctlQueue;
+        WDFQUEUE MemVectorQueue;        // DO_MEM_VECTOR_IOCTL, sequential at PASSIVE_LEVEL
 
         // Interrupt Object
         WDFINTERRUPT Interrupt[MAX_NUM_DMA_ENGINES+1];
+        KSPIN_LOCK IsrCommonLock;       // Common ControlStatus read and the shared dispatch tables, at IsrCommonIrql
+        KIRQL IsrCommonIrql;            // Highest DIRQL of the interrupt vectors
 
         // Board Configuration Structure
         BOARD_CONFIG_STRUCT BoardConfig;
@@ -176,6 +305,12 @@ typedef struct _DEVICE_EXTENSION {
         UINT64 BarLength[MAX_NUMBER_OF_BARS];
         PVOID BarVirtualAddress[MAX_NUMBER_OF_BARS];
 
+        // BAR windows mapped into applications, see BarMapUser
+        BOOLEAN bAllowBarMapping;       // AllowBarMapping registry value
+        KMUTEX BarMapMutex;             // Serializes the mapping, unmapping and file cleanup
+        LIST_ENTRY BarWindowFiles;      // FILE_CONTEXTs with a window mapped, by BarWindowLink
+        UINT32 BarWindowCount;          // Windows mapped, stop / remove is refused while not 0
+
         // DMA Resources
         UINT32 NumberOfDescriptors;
         size_t MaximumDmaTransferLength;
@@ -188,6 +323,13 @@ typedef struct _DEVICE_EXTENSION {
         UINT32 NumberDMAEngines;
         UINT32 MSINumberVectors;
 
+        // Interrupt dispatch, see DMADriverInterruptMapEngines
+        BOOLEAN bMsiDirect;             // Each DMA Engine has its own MSI / MSI-X vector
+        UINT32 NumIrqScanEngines;       // Engines without a common interrupt status bit
+        PDMA_ENGINE_DEVICE_EXTENSION pIrqStatusEngine[CARD_INTERRUPT_STATUS_ENGINES];
+        PDMA_ENGINE_DEVICE_EXTENSION pIrqScanEngine[MAX_NUM_DMA_ENGINES];
+        UINT32 VectorAffinity[MAX_NUM_DMA_ENGINES];     // InterruptAffinity<n> registry values, vector n serves the n-th engine found
+
         // Watchdog timer Resources
         WDFTIMER WatchdogTimer;
 
@@ -260,6 +402,17 @@ WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(REQUEST_CONTEXT, RequestContext)
 
 void FreeReqCtx(PREQUEST_CONTEXT reqContext);
 
+/* The file object context, the BAR windows mapped through this handle */
+typedef struct _FILE_CONTEXT {
+        PMDL BarMdl[MAX_NUMBER_OF_BARS];        // MDL of the mapped window, NULL if none
+        PVOID BarUserVa[MAX_NUMBER_OF_BARS];    // Address of the window in BarProcess
+        PEPROCESS BarProcess[MAX_NUMBER_OF_BARS];       // Process the window is mapped into, referenced
+        LIST_ENTRY BarWindowLink;       // In BarWindowFiles while BarWindowCount is not 0
+        UINT32 BarWindowCount;          // Windows mapped through this handle
+} FILE_CONTEXT, *PFILE_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(FILE_CONTEXT, DMADriverGetFileContext)
+
 // Init.c Prototypes
 EVT_WDF_IO_QUEUE_IO_READ DMADriverEvtIoRead;
 EVT_WDF_IO_QUEUE_IO_WRITE DMADriverEvtIoWrite;
@@ -280,6 +433,12 @@ NTSTATUS GetDmaEngineCapabilities(IN WDFDEVICE device, IN WDFREQUEST Request, IN
 
 NTSTATUS GetDmaPerfNumbers(IN WDFDEVICE device, IN WDFREQUEST Request, IN size_t * pInfoSize);
 
+NTSTATUS SetInterruptCoalescing(IN WDFDEVICE device, IN WDFREQUEST Request, IN size_t * pInfoSize);
+
+NTSTATUS SetPollMode(IN WDFDEVICE device, IN WDFREQUEST Request, IN size_t * pInfoSize);
+
+NTSTATUS GetEngineAffinity(IN WDFDEVICE device, IN WDFREQUEST Request, IN size_t * pInfoSize);
+
 // Init.c Prototypes
 
 NTSTATUS DMADriverBoardDmaInit(PDEVICE_EXTENSION pDevExt);
@@ -290,8 +449,30 @@ NTSTATUS DMADriverBoardConfigInit(PDEVICE_EXTENSION pDevExt);
 
 NTSTATUS DMADriverInterruptCreate(IN PDEVICE_EXTENSION pDevExt);
 
+VOID DMADriverInterruptMapEngines(IN PDEVICE_EXTENSION pDevExt);
+
+VOID DMADriverInterruptSetCommonIrql(IN PDEVICE_EXTENSION pDevExt);
+
+VOID DMADriverInterruptUnmapEngine(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
+
 VOID DMADriverAckDmaInterrupt(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
 
+VOID DMADriverMaskDmaInterrupt(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
+
+VOID DMADriverCoalesceTimerInit(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
+
+VOID DMADriverCoalesceTimerStart(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN UINT32 TimeoutUs);
+
+VOID DMADriverCoalesceTimerStop(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
+
+VOID DMADriverPollTimerStart(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
+
+VOID DMADriverPollTimerStop(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
+
+BOOLEAN DMADriverAffinityToGroup(IN UINT32 Affinity, OUT PGROUP_AFFINITY pGroupAffinity);
+
+VOID DMADriverResolveAffinity(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN UINT32 Affinity);
+
 EVT_WDF_INTERRUPT_ISR DMADriverInterruptIsr;
 EVT_WDF_INTERRUPT_ISR DMADriverInterruptUserIRQMSIIsr;
 EVT_WDF_INTERRUPT_DPC DMADriverInterruptDpc;
@@ -305,7 +486,11 @@ EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL DMADriverDmaEvtIoDeviceControl;
 
 INT32 GetDMAEngineContext(PDEVICE_EXTENSION pDevExt, UINT32 EngineNum, PDMA_ENGINE_DEVICE_EXTENSION * ppDmaExt);
 
-WDFREQUEST FindRequestByRequest(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN WDFREQUEST MatchReq);
+NTSTATUS PacketTrackRequest(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PDMA_XFER pDmaXfer, IN WDFREQUEST Request);
+
+WDFREQUEST PacketRetireRequest(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PDMA_XFER pDmaXfer);
+
+EVT_WDF_REQUEST_CANCEL PacketRequestCancel;
 
 // PacketIoctl.c Prototypes
 
@@ -317,13 +502,25 @@ NTSTATUS PacketFlushRequests(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request
 
 NTSTATUS ResetDMAEngineIoctlHandler(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request);
 
+NTSTATUS PacketSendPoolRegister(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request, OUT size_t * pInfoSize);
+
+NTSTATUS PacketSendPoolRelease(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request);
+
+VOID PacketFileCleanup(IN PDEVICE_EXTENSION pDevExt, IN WDFFILEOBJECT FileObject);
+
+NTSTATUS PacketCompRingRegister(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request);
+
+NTSTATUS PacketCompRingRelease(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request);
+
+NTSTATUS PacketCompRingSync(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request);
+
 // PacketInit.c Prototypes
 
 NTSTATUS DMADriverIntiializeDMADescriptors(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN UINT32 NumberDescriptors, IN UINT32 DescFlags);
 
 NTSTATUS AllocateRxBuffer(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
 
-NTSTATUS InitializeRxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PVOID RetVirtAddr, IN UINT32 AllocSize);
+NTSTATUS InitializeRxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PVOID RetVirtAddr, IN UINT32 AllocSize, IN UINT32 MaxPacketSize);
 
 NTSTATUS InitializeAddressablePacketDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
 
@@ -335,11 +532,23 @@ VOID FreeRxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTEN
 
 VOID FreeDriverRxDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
 
+NTSTATUS InitializeSendPool(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PSEND_POOL pPool);
+
+VOID FreeSendPool(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PSEND_POOL pPool);
+
+VOID FreeCompRing(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
+
 VOID ShutdownDMAEngine(IN PDEVICE_EXTENSION, IN PDMA_ENGINE_DEVICE_EXTENSION);
 
 VOID HardResetDMAEngine(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
 
 // PacketDMA.c Prototypes
+NTSTATUS PacketRingStatus(IN INT32 RingStatus);
+
+WDFDMATRANSACTION PacketGetTransaction(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
+
+VOID PacketPutTransaction(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN WDFDMATRANSACTION DmaTransaction);
+
 EVT_WDF_DPC PacketS2CDpc;
 EVT_WDF_DPC PacketC2SDpc;
 
@@ -349,16 +558,26 @@ VOID PacketC2SDpc(IN WDFDPC Dpc);
 
 NTSTATUS PacketStartSend(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN PPACKET_SEND_STRUCT pSendPacket);
 
+NTSTATUS PacketStartSends(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN PPACKET_SENDS_STRUCT pPacketSends, IN size_t BufferSize);
+
+NTSTATUS PacketStartPoolSend(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN PPACKET_POOL_SEND_STRUCT pPoolSend);
+
 NTSTATUS PacketStartWrite(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN PPACKET_WRITE_STRUCT pWritePacket);
 
 NTSTATUS PacketStartRead(IN WDFREQUEST Request, IN PDEVICE_EXTENSION pDevExt, IN PPACKET_READ_STRUCT pReadPacket);
 
-NTSTATUS PacketProcessCompletedReceives(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
+NTSTATUS PacketProcessCompletedReceives(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN OUT PUINT32 pBudget OPTIONAL);
 
 NTSTATUS PacketProcessCompletedReceiveNB(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN WDFREQUEST Request);
 
+VOID PacketPollResume(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
+
 NTSTATUS PacketProcessReturnedDescriptors(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN UINT32 ReturnToken);
 
+NTSTATUS PacketProcessReturnedDescriptorsBatch(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN PPACKET_RETURN_RECVS_STRUCT pReturnRecvs);
+
+NTSTATUS PacketProcessCompRing(IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt, IN OUT PUINT32 pBudget OPTIONAL);
+
 NTSTATUS PacketReadComplete(IN PDEVICE_EXTENSION pDevExt, IN PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
 
 EVT_WDF_IO_QUEUE_IO_CANCELED_ON_QUEUE PacketReadRequestCancel;
@@ -396,8 +615,20 @@ VOID UserIrqComplete(PDEVICE_EXTENSION pDevExt, NTSTATUS Status);
 
 VOID ReadWriteMemAccess(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request, IN WDF_DMA_DIRECTION Rd_Wr_n);
 
+VOID ReadWriteMemVector(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request);
+
+EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL DMADriverEvtIoMemVector;
+
 VOID ReadWritePCIConfig(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request, WDF_DMA_DIRECTION Rd_Wr_n);
 
+NTSTATUS BarMapUser(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request, OUT size_t * pInfoSize);
+
+NTSTATUS BarUnmapUser(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request);
+
+VOID BarUnmapAll(IN PDEVICE_EXTENSION pDevExt);
+
+EVT_WDF_FILE_CLEANUP DMADriverEvtFileCleanup;
+
 // Thread blocking routine
 VOID DMADriverLockInit(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
 VOID DMADriverLock(PDMA_ENGINE_DEVICE_EXTENSION pDmaExt);
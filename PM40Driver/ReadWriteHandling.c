@@ -252,6 +252,249 @@ VOID ReadWriteMemAccess(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request, WDF
         }
 }
 
+/*! MemOpRead
+ *
+ * \brief Reads the register of one DO_MEM_VECTOR_IOCTL operation
+ * \param pDevExt
+ * \param pOp - Validated operation
+ * \return Register value
+ */
+static UINT32 MemOpRead(IN PDEVICE_EXTENSION pDevExt, IN PMEM_OP_STRUCT pOp)
+{
+        PUINT8 cardAddress = (PUINT8) pDevExt->BarVirtualAddress[pOp->BarNum] + pOp->CardOffset;
+
+        if (pDevExt->BarType[pOp->BarNum] == CmResourceTypePort) {
+                switch (pOp->Width) {
+                case 4:
+                        return READ_PORT_ULONG((PULONG) cardAddress);
+                case 2:
+                        return READ_PORT_USHORT((PUINT16) cardAddress);
+                default:
+                        return READ_PORT_UCHAR(cardAddress);
+                }
+        }
+        switch (pOp->Width) {
+        case 4:
+                return READ_REGISTER_ULONG((PULONG) cardAddress);
+        case 2:
+                return READ_REGISTER_USHORT((PUINT16) cardAddress);
+        default:
+                return READ_REGISTER_UCHAR(cardAddress);
+        }
+}
+
+/*! MemOpWrite
+ *
+ * \brief Writes the register of one DO_MEM_VECTOR_IOCTL operation
+ * \param pDevExt
+ * \param pOp - Validated operation
+ * \param Value - Value to write, truncated to the operation width
+ */
+static VOID MemOpWrite(IN PDEVICE_EXTENSION pDevExt, IN PMEM_OP_STRUCT pOp, IN UINT32 Value)
+{
+        PUINT8 cardAddress = (PUINT8) pDevExt->BarVirtualAddress[pOp->BarNum] + pOp->CardOffset;
+
+        if (pDevExt->BarType[pOp->BarNum] == CmResourceTypePort) {
+                switch (pOp->Width) {
+                case 4:
+                        WRITE_PORT_ULONG((PULONG) cardAddress, Value);
+                        break;
+                case 2:
+                        WRITE_PORT_USHORT((PUINT16) cardAddress, (UINT16) Value);
+                        break;
+                default:
+                        WRITE_PORT_UCHAR(cardAddress, (UINT8) Value);
+                        break;
+                }
+                return;
+        }
+        switch (pOp->Width) {
+        case 4:
+                WRITE_REGISTER_ULONG((PULONG) cardAddress, Value);
+                break;
+        case 2:
+                WRITE_REGISTER_USHORT((PUINT16) cardAddress, (UINT16) Value);
+                break;
+        default:
+                WRITE_REGISTER_UCHAR(cardAddress, (UINT8) Value);
+                break;
+        }
+}
+
+/*! ReadWriteMemVector
+ *
+ * \brief Does the register accesses of a DO_MEM_VECTOR_IOCTL in order, the
+ *  vectored form of ReadWriteMemAccess.  All the operations are checked
+ *  first so a bad one fails the request before any register is touched,
+ *  as does a total MEM_OP_POLL Timeout over MEM_OP_MAX_POLL_TIMEOUT.
+ *  MEM_OP_WRITE and MEM_OP_RMW may not touch the DMA Engine registers.
+ *  A MEM_OP_POLL that times out stops the vector, the request still
+ *  succeeds so RetNumOps and the values read so far get back to the caller.
+ * \param pDevExt
+ * \param Request
+ * \note Called from MemVectorQueue at PASSIVE_LEVEL, a MEM_OP_POLL
+ *  sleeps between reads once it has spun for MEM_OP_POLL_SPIN_US.
+ */
+VOID ReadWriteMemVector(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request)
+{
+        NTSTATUS status = STATUS_SUCCESS;
+        size_t bufferSize;
+        size_t outputSize;
+        size_t transferSize = 0;
+        PDO_MEM_VECTOR_STRUCT pMemVector;
+        PDO_MEM_VECTOR_STRUCT pRetMemVector;
+        PMEM_OP_STRUCT pOp;
+        LARGE_INTEGER Frequency;
+        LARGE_INTEGER Now;
+        LARGE_INTEGER SpinEnd;
+        LARGE_INTEGER Deadline;
+        LARGE_INTEGER SleepTime;
+        UINT64 PollTime = 0;
+        BOOLEAN bTimedOut = FALSE;
+        UINT32 Value;
+        UINT32 i;
+
+        PAGED_CODE();
+
+       KdPrintEx((1, DPFLTR_INFO_LEVEL, "--> ReadWriteMemVector, Request %p, IRQL=%d\n", Request, KeGetCurrentIrql()));
+
+        // Get the input buffer pointer
+        status = WdfRequestRetrieveInputBuffer(Request, FIELD_OFFSET(DO_MEM_VECTOR_STRUCT, Ops),  // Min size
+                                               (PVOID *) & pMemVector, &bufferSize);
+        if (!NT_SUCCESS(status)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfRequestRetrieveInputBuffer failed 0x%x\n", status));
+                goto DOMEMVECTORDONE;
+        } else if (pMemVector == NULL) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Input buffer is NULL"));
+                status = STATUS_INVALID_PARAMETER;
+                goto DOMEMVECTORDONE;
+        } else if ((pMemVector->NumOps == 0) || (pMemVector->NumOps > MEM_OP_MAX_OPS) ||
+                   (bufferSize < DO_MEM_VECTOR_SIZE(pMemVector->NumOps))) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Invalid NumOps %d for an input buffer of %Id bytes\n", pMemVector->NumOps, bufferSize));
+                status = STATUS_INVALID_PARAMETER;
+                goto DOMEMVECTORDONE;
+        }
+        bufferSize = DO_MEM_VECTOR_SIZE(pMemVector->NumOps);
+
+        // The values read go back in place, in the same buffered memory
+        status = WdfRequestRetrieveOutputBuffer(Request, bufferSize,    // Min size
+                                                (PVOID *) & pRetMemVector, &outputSize);
+        if (!NT_SUCCESS(status)) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "WdfRequestRetrieveOutputBuffer failed 0x%x\n", status));
+                goto DOMEMVECTORDONE;
+        }
+
+        // validate every MEM_OP_STRUCT before doing any of them
+        for (i = 0; i < pMemVector->NumOps; i++) {
+                pOp = &pMemVector->Ops[i];
+                if ((pOp->BarNum >= pDevExt->NumberOfBARS) ||
+                    (pDevExt->BarVirtualAddress[pOp->BarNum] == NULL) ||
+                    (pOp->Op > MEM_OP_POLL) ||
+                    ((pOp->Width != 1) && (pOp->Width != 2) && (pOp->Width != 4)) ||
+                    ((pOp->CardOffset % pOp->Width) != 0) ||
+                    (pOp->CardOffset >= pDevExt->BarLength[pOp->BarNum]) ||
+                    ((pDevExt->BarLength[pOp->BarNum] - pOp->CardOffset) < pOp->Width)) {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Invalid operation %d in DoMemVectorStruct: BAR %d, Op %d, Width %d, Card Offset 0x%llx\n",
+                                  i, pOp->BarNum, pOp->Op, pOp->Width, pOp->CardOffset));
+                        status = STATUS_INVALID_PARAMETER;
+                        goto DOMEMVECTORDONE;
+                }
+                // The DMA Engine registers are read only here, as they are not mapped by BarMapUser
+                if (((pOp->Op == MEM_OP_WRITE) || (pOp->Op == MEM_OP_RMW)) &&
+                    (pOp->BarNum == DMA_REG_BAR) && (pDevExt->pDmaRegisters != NULL) &&
+                    (pOp->CardOffset < ROUND_TO_PAGES(sizeof(BAR0_REGISTER_MAP_STRUCT)))) {
+                       KdPrintEx((1, DPFLTR_ERROR_LEVEL, "Operation %d in DoMemVectorStruct writes the DMA registers, Card Offset 0x%llx\n",
+                                  i, pOp->CardOffset));
+                        status = STATUS_ACCESS_DENIED;
+                        goto DOMEMVECTORDONE;
+                }
+                if (pOp->Op == MEM_OP_POLL) {
+                        PollTime += pOp->Timeout;
+                }
+        }
+        // The whole vector may poll for MEM_OP_MAX_POLL_TIMEOUT, not each operation
+        if (PollTime > MEM_OP_MAX_POLL_TIMEOUT) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "DoMemVectorStruct polls for %llu usec in total, more than %d\n", PollTime, MEM_OP_MAX_POLL_TIMEOUT));
+                status = STATUS_INVALID_PARAMETER;
+                goto DOMEMVECTORDONE;
+        }
+        SleepTime.QuadPart = -10 * MEM_OP_POLL_SLEEP_US;        // Relative, 100 nsec units
+
+        for (i = 0; i < pMemVector->NumOps; i++) {
+                pOp = &pMemVector->Ops[i];
+                switch (pOp->Op) {
+                case MEM_OP_READ:
+                        pOp->Value = MemOpRead(pDevExt, pOp);
+                        break;
+                case MEM_OP_WRITE:
+                        MemOpWrite(pDevExt, pOp, pOp->Value);
+                        break;
+                case MEM_OP_RMW:
+                        Value = MemOpRead(pDevExt, pOp);
+                        MemOpWrite(pDevExt, pOp, (Value & ~pOp->Mask) | (pOp->Value & pOp->Mask));
+                        pOp->Value = Value;
+                        break;
+                case MEM_OP_POLL:
+                        Now = KeQueryPerformanceCounter(&Frequency);
+                        SpinEnd.QuadPart = Now.QuadPart + (Frequency.QuadPart * MEM_OP_POLL_SPIN_US) / 1000000;
+                        Deadline.QuadPart = Now.QuadPart + (Frequency.QuadPart * pOp->Timeout) / 1000000;
+                        for (;;) {
+                                Value = MemOpRead(pDevExt, pOp);
+                                if ((Value & pOp->Mask) == (pOp->Value & pOp->Mask)) {
+                                        break;
+                                }
+                                Now = KeQueryPerformanceCounter(NULL);
+                                if (Now.QuadPart >= Deadline.QuadPart) {
+                                       KdPrintEx((1, DPFLTR_WARNING_LEVEL, "MEM_OP_POLL %d timed out after %d usec, BAR %d, Card Offset 0x%llx, Value 0x%x\n",
+                                                  i, pOp->Timeout, pOp->BarNum, pOp->CardOffset, Value));
+                                        bTimedOut = TRUE;
+                                        break;
+                                }
+                                // Short waits spin, longer ones give the processor up
+                                if (Now.QuadPart < SpinEnd.QuadPart) {
+                                        KeStallExecutionProcessor(1);
+                                } else {
+                                        KeDelayExecutionThread(KernelMode, FALSE, &SleepTime);
+                                }
+                        }
+                        // Hand back the last value read, matching or not
+                        pOp->Value = Value;
+                        break;
+                }
+                if (bTimedOut) {
+                        break;
+                }
+        }
+        pMemVector->RetNumOps = i;
+        transferSize = bufferSize;
+
+ DOMEMVECTORDONE:
+        WdfRequestCompleteWithInformation(Request, status, transferSize);
+}
+
+/*! DMADriverEvtIoMemVector
+ *
+ * \brief MemVectorQueue dispatch, the DO_MEM_VECTOR_IOCTL requests
+ *  DMADriverEvtIoDeviceControl forwards.
+ * \param Queue
+ * \param Request
+ * \param OutputBufferLength
+ * \param InputBufferLength
+ * \param IoControlCode
+ * \note Called at PASSIVE_LEVEL, one request at a time.
+ */
+VOID DMADriverEvtIoMemVector(IN WDFQUEUE Queue, IN WDFREQUEST Request, IN size_t OutputBufferLength, IN size_t InputBufferLength, IN unsigned long IoControlCode)
+{
+        UNREFERENCED_PARAMETER(OutputBufferLength);
+        UNREFERENCED_PARAMETER(InputBufferLength);
+
+        if (IoControlCode != DO_MEM_VECTOR_IOCTL) {
+                WdfRequestComplete(Request, STATUS_INVALID_DEVICE_REQUEST);
+                return;
+        }
+        ReadWriteMemVector(DMADriverGetDeviceContext(WdfIoQueueGetDevice(Queue)), Request);
+}
+
 /*! ReadWritePCIConfig 
  *
  * \brief Provides Read and Write access to the boards PCI Configuration space
@@ -312,4 +555,263 @@ VOID ReadWritePCIConfig(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request, WDF
         WdfRequestCompleteWithInformation(Request, status, transferSize);
 }
 
+/*! BarTrackWindow
+ *
+ * \brief Counts a window BarMapUser just mapped.  The first window of the
+ *  device makes stop and remove fail until the last one is unmapped, the
+ *  first of a handle puts it on BarWindowFiles for BarUnmapAll.
+ * \param pDevExt
+ * \param pFileCtx - File object context holding the window
+ * \note Called with BarMapMutex held.
+ */
+static VOID BarTrackWindow(IN PDEVICE_EXTENSION pDevExt, IN PFILE_CONTEXT pFileCtx)
+{
+        if (pFileCtx->BarWindowCount++ == 0) {
+                InsertTailList(&pDevExt->BarWindowFiles, &pFileCtx->BarWindowLink);
+        }
+        if (pDevExt->BarWindowCount++ == 0) {
+                WdfDeviceSetStaticStopRemove(pDevExt->Device, FALSE);
+        }
+}
+
+/*! BarUnmapWindow
+ *
+ * \brief Unmaps a BAR window from the process it was mapped into, attaching
+ *  to that process if the caller is another one.
+ * \param pDevExt
+ * \param pFileCtx - File object context holding the window
+ * \param BarNum
+ * \note Called with BarMapMutex held.
+ */
+static VOID BarUnmapWindow(IN PDEVICE_EXTENSION pDevExt, IN PFILE_CONTEXT pFileCtx, IN UINT32 BarNum)
+{
+        KAPC_STATE ApcState;
+        BOOLEAN bAttached = FALSE;
+
+        if (pFileCtx->BarProcess[BarNum] != PsGetCurrentProcess()) {
+                KeStackAttachProcess(pFileCtx->BarProcess[BarNum], &ApcState);
+                bAttached = TRUE;
+        }
+        MmUnmapLockedPages(pFileCtx->BarUserVa[BarNum], pFileCtx->BarMdl[BarNum]);
+        if (bAttached) {
+                KeUnstackDetachProcess(&ApcState);
+        }
+        ObDereferenceObject(pFileCtx->BarProcess[BarNum]);
+        IoFreeMdl(pFileCtx->BarMdl[BarNum]);
+
+        pFileCtx->BarMdl[BarNum] = NULL;
+        pFileCtx->BarUserVa[BarNum] = NULL;
+        pFileCtx->BarProcess[BarNum] = NULL;
+
+        if (--pFileCtx->BarWindowCount == 0) {
+                RemoveEntryList(&pFileCtx->BarWindowLink);
+        }
+        if (--pDevExt->BarWindowCount == 0) {
+                WdfDeviceSetStaticStopRemove(pDevExt->Device, TRUE);
+        }
+}
+
+/*! BarMapUser
+ *
+ * \brief Maps a window of a memory BAR into the calling process so the
+ *  application can access its registers without an IOCTL per access.
+ *  Refused unless the AllowBarMapping registry value is set.  The window is
+ *  page aligned and, in the DMA register BAR, starts past the DMA Engine
+ *  registers.  One window per BAR per handle; it stays mapped until
+ *  BAR_UNMAP_IOCTL, the handle is closed or BarUnmapAll.
+ * \param pDevExt
+ * \param Request - BAR_MAP_IOCTL request
+ * \param pInfoSize - Returned size of the output
+ * \return NTSTATUS
+ * \note Must be called in the context of the calling process
+ *  (DMADriverIoInCallerContext), at PASSIVE_LEVEL.
+ */
+NTSTATUS BarMapUser(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request, OUT size_t * pInfoSize)
+{
+        NTSTATUS status;
+        PFILE_CONTEXT pFileCtx;
+        PBAR_MAP_STRUCT pBarMap;
+        PBAR_MAP_STRUCT pRetBarMap;
+        size_t bufferSize;
+        UINT32 BarNum;
+        UINT64 CardOffset;
+        UINT64 Length;
+        PMDL pMdl;
+        PVOID UserVa = NULL;
+
+        *pInfoSize = 0;
+        if (!pDevExt->bAllowBarMapping) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL BarMapUser: BAR mapping is not enabled (AllowBarMapping)\n"));
+                return STATUS_ACCESS_DENIED;
+        }
+        if (WdfRequestGetFileObject(Request) == NULL) {
+                return STATUS_INVALID_DEVICE_REQUEST;
+        }
+        pFileCtx = DMADriverGetFileContext(WdfRequestGetFileObject(Request));
+
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(BAR_MAP_STRUCT), (PVOID *) & pBarMap, &bufferSize);
+        if (!NT_SUCCESS(status)) {
+                return status;
+        }
+        status = WdfRequestRetrieveOutputBuffer(Request, sizeof(BAR_MAP_STRUCT), (PVOID *) & pRetBarMap, &bufferSize);
+        if (!NT_SUCCESS(status)) {
+                return status;
+        }
+        BarNum = pBarMap->BarNum;
+        CardOffset = pBarMap->CardOffset;
+        Length = pBarMap->Length;
+
+        // Memory BARs only, the window must be whole pages inside the BAR
+        if ((BarNum >= pDevExt->NumberOfBARS) || (pDevExt->BarVirtualAddress[BarNum] == NULL) ||
+            ((pDevExt->BarType[BarNum] != CmResourceTypeMemory) && (pDevExt->BarType[BarNum] != CmResourceTypeMemoryLarge))) {
+                return STATUS_INVALID_PARAMETER;
+        }
+        if ((BYTE_OFFSET(CardOffset) != 0) || (CardOffset >= pDevExt->BarLength[BarNum])) {
+                return STATUS_INVALID_PARAMETER;
+        }
+        if (Length == 0) {
+                Length = pDevExt->BarLength[BarNum] - CardOffset;
+        }
+        Length = ROUND_TO_PAGES(Length);
+        if ((Length > (pDevExt->BarLength[BarNum] - CardOffset)) || (Length > MAXULONG - PAGE_SIZE)) {
+                return STATUS_INVALID_PARAMETER;
+        }
+        // Never hand out the DMA Engine registers, they can point the card at any memory
+        if ((BarNum == DMA_REG_BAR) && (pDevExt->pDmaRegisters != NULL) && (CardOffset < ROUND_TO_PAGES(sizeof(BAR0_REGISTER_MAP_STRUCT)))) {
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL BarMapUser: window 0x%llx overlaps the DMA registers\n", CardOffset));
+                return STATUS_ACCESS_DENIED;
+        }
+
+        KeWaitForSingleObject(&pDevExt->BarMapMutex, Executive, KernelMode, FALSE, NULL);
+        if (pFileCtx->BarMdl[BarNum] != NULL) {
+                status = STATUS_INVALID_DEVICE_STATE;
+        } else {
+                status = STATUS_INSUFFICIENT_RESOURCES;
+                pMdl = IoAllocateMdl((PUINT8) pDevExt->BarVirtualAddress[BarNum] + CardOffset, (ULONG) Length, FALSE, FALSE, NULL);
+                if (pMdl != NULL) {
+                        MmBuildMdlForNonPagedPool(pMdl);
+                        // A user mode mapping raises an exception on failure
+                        __try {
+                                UserVa = MmMapLockedPagesSpecifyCache(pMdl, UserMode, MmNonCached, NULL, FALSE, NormalPagePriority);
+                        }
+                        __except(EXCEPTION_EXECUTE_HANDLER) {
+                                UserVa = NULL;
+                        }
+                        if (UserVa != NULL) {
+                                pFileCtx->BarMdl[BarNum] = pMdl;
+                                pFileCtx->BarUserVa[BarNum] = UserVa;
+                                pFileCtx->BarProcess[BarNum] = PsGetCurrentProcess();
+                                ObReferenceObject(pFileCtx->BarProcess[BarNum]);
+                                BarTrackWindow(pDevExt, pFileCtx);
+
+                                pRetBarMap->BarNum = BarNum;
+                                pRetBarMap->CardOffset = CardOffset;
+                                pRetBarMap->Length = Length;
+                                pRetBarMap->UserAddress = (UINT64) (ULONG_PTR) UserVa;
+                                *pInfoSize = sizeof(BAR_MAP_STRUCT);
+                                status = STATUS_SUCCESS;
+                        } else {
+                                IoFreeMdl(pMdl);
+                        }
+                }
+        }
+        KeReleaseMutex(&pDevExt->BarMapMutex, FALSE);
+
+       KdPrintEx((1, DPFLTR_INFO_LEVEL, "USL BarMapUser: BAR %u, Offset 0x%llx, Length 0x%llx, Va 0x%p, status 0x%x\n",
+                   BarNum, CardOffset, Length, UserVa, status));
+        return status;
+}
+
+/*! BarUnmapUser
+ *
+ * \brief Unmaps the window of a BAR that BarMapUser mapped through this handle.
+ * \param pDevExt
+ * \param Request - BAR_UNMAP_IOCTL request
+ * \return NTSTATUS
+ */
+NTSTATUS BarUnmapUser(IN PDEVICE_EXTENSION pDevExt, IN WDFREQUEST Request)
+{
+        NTSTATUS status;
+        PFILE_CONTEXT pFileCtx;
+        PBAR_MAP_STRUCT pBarMap;
+        size_t bufferSize;
+
+        if (WdfRequestGetFileObject(Request) == NULL) {
+                return STATUS_INVALID_DEVICE_REQUEST;
+        }
+        pFileCtx = DMADriverGetFileContext(WdfRequestGetFileObject(Request));
+
+        status = WdfRequestRetrieveInputBuffer(Request, sizeof(BAR_MAP_STRUCT), (PVOID *) & pBarMap, &bufferSize);
+        if (!NT_SUCCESS(status)) {
+                return status;
+        }
+        if (pBarMap->BarNum >= MAX_NUMBER_OF_BARS) {
+                return STATUS_INVALID_PARAMETER;
+        }
+
+        KeWaitForSingleObject(&pDevExt->BarMapMutex, Executive, KernelMode, FALSE, NULL);
+        status = STATUS_INVALID_PARAMETER;
+        if (pFileCtx->BarMdl[pBarMap->BarNum] != NULL) {
+                BarUnmapWindow(pDevExt, pFileCtx, pBarMap->BarNum);
+                status = STATUS_SUCCESS;
+        }
+        KeReleaseMutex(&pDevExt->BarMapMutex, FALSE);
+        return status;
+}
+
+/*! DMADriverEvtFileCleanup
+ *
+ * \brief Called when the last handle to a file object is closed, in the
+ *  context of the closing process.  Unmaps the BAR windows still mapped
+ *  through it and releases the buffers it registered.
+ * \param FileObject
+ * \return None
+ */
+VOID DMADriverEvtFileCleanup(IN WDFFILEOBJECT FileObject)
+{
+        PDEVICE_EXTENSION pDevExt = DMADriverGetDeviceContext(WdfFileObjectGetDevice(FileObject));
+        PFILE_CONTEXT pFileCtx = DMADriverGetFileContext(FileObject);
+        UINT32 BarNum;
+
+        KeWaitForSingleObject(&pDevExt->BarMapMutex, Executive, KernelMode, FALSE, NULL);
+        for (BarNum = 0; BarNum < MAX_NUMBER_OF_BARS; BarNum++) {
+                if (pFileCtx->BarMdl[BarNum] != NULL) {
+                        BarUnmapWindow(pDevExt, pFileCtx, BarNum);
+                }
+        }
+        KeReleaseMutex(&pDevExt->BarMapMutex, FALSE);
+
+        PacketFileCleanup(pDevExt, FileObject);
+}
+
+/*! BarUnmapAll
+ *
+ * \brief Unmaps every BAR window still mapped into an application, before
+ *  the BARs are unmapped.  Stop and remove are refused while a window is
+ *  mapped, so this only finds windows after a surprise removal; the
+ *  application then faults on its next access instead of reaching a
+ *  released BAR.
+ * \param pDevExt
+ * \return None
+ * \note Called from DMADriverEvtDeviceReleaseHardware at PASSIVE_LEVEL.
+ */
+VOID BarUnmapAll(IN PDEVICE_EXTENSION pDevExt)
+{
+        PFILE_CONTEXT pFileCtx;
+        UINT32 BarNum;
+
+        KeWaitForSingleObject(&pDevExt->BarMapMutex, Executive, KernelMode, FALSE, NULL);
+        while (!IsListEmpty(&pDevExt->BarWindowFiles)) {
+                pFileCtx = CONTAINING_RECORD(pDevExt->BarWindowFiles.Flink, FILE_CONTEXT, BarWindowLink);
+               KdPrintEx((1, DPFLTR_ERROR_LEVEL, "USL BarUnmapAll: %u window(s) still mapped\n", pFileCtx->BarWindowCount));
+                // The last window of the handle takes it off the list
+                for (BarNum = 0; BarNum < MAX_NUMBER_OF_BARS; BarNum++) {
+                        if (pFileCtx->BarMdl[BarNum] != NULL) {
+                                BarUnmapWindow(pDevExt, pFileCtx, BarNum);
+                        }
+                }
+        }
+        KeReleaseMutex(&pDevExt->BarMapMutex, FALSE);
+}
+
 #pragma warning(default:4127)
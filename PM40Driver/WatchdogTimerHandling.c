@@ -92,7 +92,21 @@ VOID DMADriverWatchdogTimerCall(IN WDFTIMER Timer)
                         pDevExt->pDmaEngineDevExt[dmaEngine]->HardwareTimeInLastSecond = (UINT64) pDmaExt->pDmaEng->DMAActiveTime;
                         pDevExt->pDmaEngineDevExt[dmaEngine]->DMAInactiveTime = (UINT64) pDmaExt->pDmaEng->DMAWaitTime;
                         pDevExt->pDmaEngineDevExt[dmaEngine]->BytesInLastSecond = (UINT64) pDmaExt->pDmaEng->DMACompletedByteCount;
+                        pDmaExt->IntsInLastSecond = pDmaExt->IntsInCurrentSecond;
+                        pDmaExt->IntsInCurrentSecond = 0;
+                        pDmaExt->DPCsInLastSecond = pDmaExt->DPCsInCurrentSecond;
+                        pDmaExt->DPCsInCurrentSecond = 0;
+                        pDmaExt->PollTimeInLastSecond = pDmaExt->PollTimeInCurrentSecond;
+                        pDmaExt->PollTimeInCurrentSecond = 0;
+                        pDmaExt->IntTimeInLastSecond = pDmaExt->IntTimeInCurrentSecond;
+                        pDmaExt->IntTimeInCurrentSecond = 0;
+                        pDmaExt->PollPassesInCurrentSecond = 0;
                         WdfSpinLockRelease(pDmaExt->DmaSpinLock);
+                        // A completion ring the application drained while every descriptor
+                        // was in use gets no interrupt to recycle them, pick it up here.
+                        if (pDmaExt->CompRing.pRing != NULL) {
+                                PacketProcessCompRing(pDmaExt, NULL);
+                        }
                 }
         }
 }
@@ -11,8 +11,14 @@
 //  800   Get Board Config            None                      BOARD_CONFIG_STRUCT
 //  802   Memory Read                 DO_MEM_STRUCT              data
 //  803   Memory Write                DO_MEM_STRUCT              data
+//  804   Memory Vector               DO_MEM_VECTOR_STRUCT       DO_MEM_VECTOR_STRUCT
 //  806   Get DMA Engine Cap          EngineNum (UINT32)         DMA_CAP_STRUCT
 //  808   Get DMA Performance         EngineNum (UINT32)         DMA_STAT_STRUCT
+//  80B   Set Int Coalescing          INT_COALESCE_STRUCT        INT_COALESCE_STRUCT
+//  80C   Set Poll Mode               POLL_MODE_STRUCT           POLL_MODE_STRUCT
+//  80D   Get Engine Affinity         ENGINE_AFFINITY_STRUCT     ENGINE_AFFINITY_STRUCT
+//  80E   Map BAR                     BAR_MAP_STRUCT             BAR_MAP_STRUCT
+//  80F   Unmap BAR                   BAR_MAP_STRUCT             None
 //
 //       Common Packet Mode APIs
 //  820   Packet DMA Buf Alloc        BUF_ALLOC_STRUCT           RET_BUF_ALLOC_STRUCT
@@ -22,6 +28,14 @@
 //  822   Packet Receive            PACKET_RECEIVE_STRUCT      PACKET_RET_RECEIVE
 //  824   Packet Send                PACKET_SEND_STRUCT        data
 //  826   Packet Receives            PACKET_RECEIVES_STRUCT     PACKET_RECEIVES_STRUCT
+//  828   Packet Sends               PACKET_SENDS_STRUCT        PACKET_SENDS_STRUCT
+//  829   Packet Send Pool Register  SEND_POOL_STRUCT           SEND_POOL_STRUCT
+//  82A   Packet Send Pool Release   SEND_POOL_STRUCT           None
+//  82B   Packet Pool Send           PACKET_POOL_SEND_STRUCT    None
+//  82C   Completion Ring Register   COMP_RING_STRUCT           None
+//  82D   Completion Ring Release    COMP_RING_STRUCT           None
+//  82E   Completion Ring Sync       COMP_RING_STRUCT           None
+//  82F   Packet Return Receives     PACKET_RETURN_RECVS_STRUCT PACKET_RETURN_RECVS_STRUCT
 //
 //        Addressable Packet Mode APIs
 //  830   Packet Read                PACKET_READ_STRUCT      data
@@ -67,12 +81,18 @@
 #define GET_BOARD_CONFIG_IOCTL_BASE         0x800
 #define DO_MEM_READ_ACCESS_IOCTL_BASE       0x802
 #define DO_MEM_WRITE_ACCESS_IOCTL_BASE      0x803
+#define DO_MEM_VECTOR_IOCTL_BASE            0x804
 #define GET_DMA_ENGINE_CAP_IOCTL_BASE       0x806
 // Packet Gen / Chk control ioctl removed in version 4.9.x.x
 #define GET_PERF_IOCTL_BASE                 0x808
 // Added as of version 4.6.x.x
 #define WRITE_PCI_CONFIG_IOCTL              0x809
 #define READ_PCI_CONFIG_IOCTL               0x80A
+#define SET_INT_COALESCE_IOCTL_BASE         0x80B
+#define SET_POLL_MODE_IOCTL_BASE            0x80C
+#define GET_ENGINE_AFFINITY_IOCTL_BASE      0x80D
+#define BAR_MAP_IOCTL_BASE                  0x80E
+#define BAR_UNMAP_IOCTL_BASE                0x80F
 // Added in version 4.9.x.x
 #define RESET_DMA_ENGINE_IOCTL_BASE         0x858
 
@@ -84,6 +104,14 @@
 #define PACKET_RECEIVE_IOCTL_BASE           0x822
 #define PACKET_SEND_IOCTL_BASE              0x824
 #define PACKET_RECEIVES_IOCTL_BASE          0x826
+#define PACKET_SENDS_IOCTL_BASE             0x828
+#define PACKET_POOL_REGISTER_IOCTL_BASE     0x829
+#define PACKET_POOL_RELEASE_IOCTL_BASE      0x82A
+#define PACKET_POOL_SEND_IOCTL_BASE         0x82B
+#define PACKET_COMP_RING_REGISTER_IOCTL_BASE 0x82C
+#define PACKET_COMP_RING_RELEASE_IOCTL_BASE 0x82D
+#define PACKET_COMP_RING_SYNC_IOCTL_BASE    0x82E
+#define PACKET_RETURN_RECEIVES_IOCTL_BASE   0x82F
 
 // Addressable Packet Mode IOCTLs
 #define PACKET_READ_IOCTL_BASE              0x830
@@ -104,6 +132,7 @@
 #define GET_BOARD_CONFIG_IOCTL          CTL_CODE(FILE_DEVICE_UNKNOWN, 0x800, METHOD_BUFFERED,   FILE_ANY_ACCESS)
 #define DO_MEM_READ_ACCESS_IOCTL        CTL_CODE(FILE_DEVICE_UNKNOWN, 0x802, METHOD_OUT_DIRECT, FILE_ANY_ACCESS)
 #define DO_MEM_WRITE_ACCESS_IOCTL       CTL_CODE(FILE_DEVICE_UNKNOWN, 0x803, METHOD_IN_DIRECT,  FILE_ANY_ACCESS)
+#define DO_MEM_VECTOR_IOCTL             CTL_CODE(FILE_DEVICE_UNKNOWN, 0x804, METHOD_BUFFERED,   FILE_ANY_ACCESS)
 #define GET_DMA_ENGINE_CAP_IOCTL        CTL_CODE(FILE_DEVICE_UNKNOWN, 0x806, METHOD_BUFFERED,   FILE_ANY_ACCESS)
 // Packet Gen / Chk control ioctl removed in version 4.9.x.x
 #define GET_PERF_IOCTL                  CTL_CODE(FILE_DEVICE_UNKNOWN, 0x808, METHOD_BUFFERED,   FILE_ANY_ACCESS)
@@ -111,6 +140,11 @@
 // Added as of version 4.6.x.x
 #define WRITE_PCI_CONFIG_IOCTL          CTL_CODE(FILE_DEVICE_UNKNOWN, 0x809, METHOD_BUFFERED,   FILE_ANY_ACCESS)
 #define READ_PCI_CONFIG_IOCTL           CTL_CODE(FILE_DEVICE_UNKNOWN, 0x80A, METHOD_BUFFERED,   FILE_ANY_ACCESS)
+#define SET_INT_COALESCE_IOCTL          CTL_CODE(FILE_DEVICE_UNKNOWN, 0x80B, METHOD_BUFFERED,   FILE_ANY_ACCESS)
+#define SET_POLL_MODE_IOCTL             CTL_CODE(FILE_DEVICE_UNKNOWN, 0x80C, METHOD_BUFFERED,   FILE_ANY_ACCESS)
+#define GET_ENGINE_AFFINITY_IOCTL       CTL_CODE(FILE_DEVICE_UNKNOWN, 0x80D, METHOD_BUFFERED,   FILE_ANY_ACCESS)
+#define BAR_MAP_IOCTL                   CTL_CODE(FILE_DEVICE_UNKNOWN, 0x80E, METHOD_BUFFERED,   FILE_ANY_ACCESS)
+#define BAR_UNMAP_IOCTL                 CTL_CODE(FILE_DEVICE_UNKNOWN, 0x80F, METHOD_BUFFERED,   FILE_ANY_ACCESS)
 
 // Packet DMA IOCTLs
 #define PACKET_BUF_ALLOC_IOCTL          CTL_CODE(FILE_DEVICE_UNKNOWN, 0x820, METHOD_IN_DIRECT,     FILE_ANY_ACCESS)
@@ -120,6 +154,14 @@
 #define PACKET_RECEIVE_IOCTL            CTL_CODE(FILE_DEVICE_UNKNOWN, 0x822, METHOD_OUT_DIRECT,    FILE_ANY_ACCESS)
 #define PACKET_SEND_IOCTL               CTL_CODE(FILE_DEVICE_UNKNOWN, 0x824, METHOD_IN_DIRECT,    FILE_ANY_ACCESS)
 #define PACKET_RECEIVES_IOCTL           CTL_CODE(FILE_DEVICE_UNKNOWN, 0x826, METHOD_OUT_DIRECT,    FILE_ANY_ACCESS)
+#define PACKET_SENDS_IOCTL              CTL_CODE(FILE_DEVICE_UNKNOWN, 0x828, METHOD_OUT_DIRECT,    FILE_ANY_ACCESS)
+#define PACKET_POOL_REGISTER_IOCTL      CTL_CODE(FILE_DEVICE_UNKNOWN, 0x829, METHOD_BUFFERED,      FILE_ANY_ACCESS)
+#define PACKET_POOL_RELEASE_IOCTL       CTL_CODE(FILE_DEVICE_UNKNOWN, 0x82A, METHOD_BUFFERED,      FILE_ANY_ACCESS)
+#define PACKET_POOL_SEND_IOCTL          CTL_CODE(FILE_DEVICE_UNKNOWN, 0x82B, METHOD_BUFFERED,      FILE_ANY_ACCESS)
+#define PACKET_COMP_RING_REGISTER_IOCTL CTL_CODE(FILE_DEVICE_UNKNOWN, 0x82C, METHOD_BUFFERED,      FILE_ANY_ACCESS)
+#define PACKET_COMP_RING_RELEASE_IOCTL  CTL_CODE(FILE_DEVICE_UNKNOWN, 0x82D, METHOD_BUFFERED,      FILE_ANY_ACCESS)
+#define PACKET_COMP_RING_SYNC_IOCTL     CTL_CODE(FILE_DEVICE_UNKNOWN, 0x82E, METHOD_BUFFERED,      FILE_ANY_ACCESS)
+#define PACKET_RETURN_RECEIVES_IOCTL    CTL_CODE(FILE_DEVICE_UNKNOWN, 0x82F, METHOD_BUFFERED,      FILE_ANY_ACCESS)
 
 // Addressable Packet Mode IOCTLs
 #define PACKET_READ_IOCTL               CTL_CODE(FILE_DEVICE_UNKNOWN, 0x830, METHOD_OUT_DIRECT,    FILE_ANY_ACCESS)
@@ -255,6 +297,7 @@ typedef struct _BOARD_CONFIG_STRUCT {
 #define STATUS_BAD_PARAMETER                    0x40        // Passed an invalid parameter
 #define STATUS_DEVICEDRIVER_INCOMPATABLE_VER    0x80
 #define STATUS_HANDLE_INVALID                   0x100
+#define STATUS_OPERATION_CANCELLED              0x200    // Asynchronous operation cancelled, see AsyncCancel
 
 // Return DMA status defines
 #define STATUS_DMA_SUCCESSFUL               0x00
@@ -319,8 +362,74 @@ typedef struct _DMA_STAT_STRUCT {
     UINT64 HardwareTime;    // Number of nanoseconds for hardware
     UINT64 IntsPerSecond;   // Number of interrupts per second
     UINT64 DPCsPerSecond;   // Number of DPCs/Tasklets per second
+    UINT64 PollTime;        // Nanoseconds per second the DPC spent polling (poll mode)
+    UINT64 InterruptTime;   // Nanoseconds per second the DPC spent after an interrupt
 } DMA_STAT_STRUCT, * PDMA_STAT_STRUCT;
 
+#define INT_COALESCE_KEEP_MODE              0xFFFFFFFF      // Leave the InterruptControl register as it is
+
+/*!
+ * \struct INT_COALESCE_STRUCT
+ * \brief Interrupt Coalescing Structure - Completion interrupt moderation of one
+ *  DMA Engine.  The effective settings are returned.
+ */
+typedef struct _INT_COALESCE_STRUCT {
+    UINT32 EngineNum;       // DMA Engine number to use
+    UINT32 InterruptMode;   // InterruptControl register value (0 = IRQ on completion, 2 = IRQ on EOP) or INT_COALESCE_KEEP_MODE
+    UINT32 PacketCount;     // Packets per completion interrupt, 0 or 1 interrupts on every packet
+    UINT32 TimeoutUs;       // Microseconds a completion may wait for its interrupt, required with PacketCount > 1
+    UINT64 IntsPerSecond;   // Returned: interrupts in the last second
+} INT_COALESCE_STRUCT, * PINT_COALESCE_STRUCT;
+
+/*!
+ * \struct POLL_MODE_STRUCT
+ * \brief Poll Mode Structure - Adaptive interrupt / poll receive mode of a
+ *  FIFO C2S DMA Engine.  The interrupt is masked while the ring has completed
+ *  packets, a timer runs the DPC passes, and it is re-enabled after IdlePasses
+ *  passes find the ring empty.  While no PACKET_RECEIVE is waiting the passes
+ *  stop, the next PACKET_RECEIVE starts them again.
+ *  The effective settings are returned.
+ */
+typedef struct _POLL_MODE_STRUCT {
+    UINT32 EngineNum;       // DMA Engine number to use
+    UINT32 Budget;          // Packets per DPC pass, 0 turns poll mode off
+    UINT32 IdlePasses;      // Passes with an empty ring before the interrupt is enabled again
+    UINT32 Reserved;
+} POLL_MODE_STRUCT, * PPOLL_MODE_STRUCT;
+
+// Engine affinity values, the InterruptAffinity<n> registry values use the same encoding
+#define ENGINE_AFFINITY_ANY                 0xFFFFFFFF      // No preference, the system chooses
+#define ENGINE_AFFINITY_NODE_FLAG           0x80000000      // Low bits are a NUMA node, otherwise a processor index
+
+/*!
+ * \struct ENGINE_AFFINITY_STRUCT
+ * \brief Engine Affinity Structure - Processor and NUMA node placement of a
+ *  DMA Engine's interrupt, DPC and descriptor memory.  Allocate the
+ *  engine's data buffers on Node too.
+ */
+typedef struct _ENGINE_AFFINITY_STRUCT {
+    UINT32 EngineNum;       // DMA Engine number to use
+    UINT32 Affinity;        // Configured affinity, processor index, ENGINE_AFFINITY_NODE_FLAG | node or ENGINE_AFFINITY_ANY
+    UINT32 Processor;       // Processor index the DPC runs on or ENGINE_AFFINITY_ANY
+    UINT32 Node;            // NUMA node of the descriptor memory or ENGINE_AFFINITY_ANY
+} ENGINE_AFFINITY_STRUCT, * PENGINE_AFFINITY_STRUCT;
+
+/*!
+ * \struct BAR_MAP_STRUCT
+ * \brief BAR Map Structure - A window of a BAR mapped into the calling
+ *  process for direct register access.  Only allowed when the AllowBarMapping
+ *  registry value is set.  The window is page aligned and never covers the
+ *  DMA Engine registers; it is unmapped by BAR_UNMAP_IOCTL or when the
+ *  handle is closed.  The device cannot be stopped or removed while a
+ *  window is mapped; a surprise removal unmaps them all.
+ */
+typedef struct _BAR_MAP_STRUCT {
+    UINT32 BarNum;          // Base Address Register (BAR) to map
+    UINT64 CardOffset;      // Byte starting offset of the window in the BAR, page aligned
+    UINT64 Length;          // Length of the window in bytes, 0 for the rest of the BAR
+    UINT64 UserAddress;     // Returned address of the window in the calling process
+} BAR_MAP_STRUCT, * PBAR_MAP_STRUCT;
+
 // DO_MEM_STRUCT
 // Do Memory Structure - Information for performing a Memory Transfer
 typedef struct _DO_MEM_STRUCT {
@@ -333,6 +442,46 @@ typedef struct _DO_MEM_STRUCT {
 #endif                          // Linux Only
 } DO_MEM_STRUCT, * PDO_MEM_STRUCT;
 
+// Operations of a MEM_OP_STRUCT
+#define MEM_OP_READ                         0       // Value returns the register
+#define MEM_OP_WRITE                        1       // Writes Value to the register
+#define MEM_OP_RMW                          2       // Writes (register & ~Mask) | (Value & Mask), Value returns the register before the write
+#define MEM_OP_POLL                         3       // Reads until (register & Mask) == (Value & Mask) or Timeout, Value returns the last read
+
+#define MEM_OP_MAX_OPS                      1024    // Most operations in one DO_MEM_VECTOR_IOCTL
+#define MEM_OP_MAX_POLL_TIMEOUT             50000   // Longest total of the MEM_OP_POLL Timeouts in one DO_MEM_VECTOR_IOCTL, 50 msec
+
+// MEM_OP_STRUCT
+//
+//  Memory Operation Structure - One register access of a DO_MEM_VECTOR_IOCTL
+typedef struct _MEM_OP_STRUCT {
+    UINT32 BarNum;          // Base Address Register (BAR) to access
+    UINT16 Op;              // MEM_OP_READ, MEM_OP_WRITE, MEM_OP_RMW or MEM_OP_POLL
+    UINT16 Width;           // Access width in bytes, 1, 2 or 4
+    UINT64 CardOffset;      // Byte offset of the register in the BAR, Width aligned
+    UINT32 Value;           // Value to write or compare to, returns the value read
+    UINT32 Mask;            // MEM_OP_RMW bits to change, MEM_OP_POLL bits to compare
+    UINT32 Timeout;         // MEM_OP_POLL timeout in microseconds
+    UINT32 Reserved;        // Reserved
+} MEM_OP_STRUCT, * PMEM_OP_STRUCT;
+
+// DO_MEM_VECTOR_STRUCT
+//
+//  Do Memory Vector Structure - Several register accesses, anywhere in any
+//    BAR, done in order in one call.  Every operation is checked before the
+//    first one runs; MEM_OP_WRITE and MEM_OP_RMW are refused on the DMA
+//    Engine registers.  A MEM_OP_POLL that times out ends the vector early,
+//    RetNumOps then is the index of that operation.
+typedef struct _DO_MEM_VECTOR_STRUCT {
+    UINT32 NumOps;          // Number of operations in Ops
+    UINT32 RetNumOps;       // Returned Number of operations done
+    MEM_OP_STRUCT Ops[1];   // Operations, Value is filled in
+} DO_MEM_VECTOR_STRUCT, * PDO_MEM_VECTOR_STRUCT;
+
+// Bytes needed for a DO_MEM_VECTOR_STRUCT of NumOps operations
+#define DO_MEM_VECTOR_SIZE(NumOps)  \
+    (FIELD_OFFSET(DO_MEM_VECTOR_STRUCT, Ops) + ((NumOps) * sizeof(MEM_OP_STRUCT)))
+
 // DMA_CAP_STRUCT
 // DMA Capabilities Structure
 typedef struct _DMA_CAP_STRUCT {
@@ -359,6 +508,13 @@ typedef struct _RW_PCI_CONFIG_STRUCT {
 #define PACKET_MODE_ADDRESSABLE         0x02
 #define PACKET_MODE_STREAMING           0x40
 
+// BUF_ALLOC_STRUCT.AllocationMode flags, or'd with PACKET_MODE_FIFO or PACKET_MODE_STREAMING
+// PACKET_ALLOC_MAX_PACKET_DESC - size the Rx descriptors from MaxPacketSize, see
+//   InitializeRxDescriptors.  Without it MaxPacketSize is ignored and each
+//   descriptor covers one page, which applications built before the flag expect.
+#define PACKET_ALLOC_MAX_PACKET_DESC    0x100
+#define PACKET_ALLOC_FLAGS              0x100
+
 /* DMA_MODE_NOT_SET - DMA Mode not set, uses default DMA Engine behavior */
 #define DMA_MODE_NOT_SET                0xFFFFFFFF
 
@@ -372,8 +528,8 @@ typedef struct _RW_PCI_CONFIG_STRUCT {
  */
 typedef struct _BUF_ALLOC_STRUCT {
     UINT32 EngineNum;       // DMA Engine number to use
-    UINT32 AllocationMode;  // Allocation type Flags
-    UINT32 MaxPacketSize;   // Maximum Packet Size (Must be dividable into PoolSize) (FIFO mode)
+    UINT32 AllocationMode;  // Allocation type Flags, PACKET_MODE_* | PACKET_ALLOC_*
+    UINT32 MaxPacketSize;   // Maximum Packet Size, used with PACKET_ALLOC_MAX_PACKET_DESC (FIFO mode)
     UINT32 Length;          // Length of Application buffer or size to Allocate (FIFO mode)
     UINT32 NumberDescriptors;       // Number of C2S Descriptors to allocate (Addressable)
 #ifndef __WINNT__               // Linux variant
@@ -541,6 +697,121 @@ typedef struct _PACKET_RECVS_STRUCT {
     PACKET_ENTRY_STRUCT Packets[1]; // Packet Entries
 } PACKET_RECVS_STRUCT, * PPACKET_RECVS_STRUCT;
 
+// PACKET_RETURN_RECVS_STRUCT Flags
+#define PACKET_RETURN_THROUGH           0x1     // Return every packet received up to and including Tokens[0]
+
+// PACKET_RETURN_RECVS_STRUCT
+//
+//  Packet Return Receives Structure - Gives the buffers of several FIFO mode
+//    receives back to the DMA Engine in one call
+typedef struct _PACKET_RETURN_RECVS_STRUCT {
+    UINT32 EngineNum;       // DMA Engine number to use
+    UINT32 Flags;           // PACKET_RETURN_THROUGH or 0
+    UINT32 NumTokens;       // Number of tokens in Tokens
+    UINT32 RetNumTokens;    // Returned Number of packets given back
+    UINT32 Tokens[1];       // Receive Tokens of the packets to release
+} PACKET_RETURN_RECVS_STRUCT, * PPACKET_RETURN_RECVS_STRUCT;
+
+// PACKET_SEND_ENTRY_STRUCT
+//
+//  Packet Send Entry Structure - Per packet structure to be included into
+//        The PACKET_SENDS_STRUCT
+typedef struct _PACKET_SEND_ENTRY_STRUCT {
+    UINT64 BufferOffset;    // Byte offset of the packet in the send buffer
+    UINT64 UserControl;     // Contents to write to UserControl field of SOP Descriptor
+    UINT32 Length;          // Length of packet, returns the bytes sent
+    UINT32 Status;          // Returned Packet Status
+} PACKET_SEND_ENTRY_STRUCT, * PPACKET_SEND_ENTRY_STRUCT;
+
+// PACKET_SENDS_STRUCT
+//
+//  Packet Sends Structure - Superstructure that sends multiple packets
+//    out of one buffer with a single request
+typedef struct _PACKET_SENDS_STRUCT {
+    UINT16 EngineNum;       // DMA Engine number to use
+    UINT16 AvailNumEntries; // Number of packet entries to send
+    UINT16 RetNumEntries;   // Returned Number of packet entries sent
+    UINT16 Reserved;        // Reserved
+    UINT32 Length;          // Length of the send buffer
+    UINT64 BufferAddress;   // Buffer Address for data transfer
+    PACKET_SEND_ENTRY_STRUCT Packets[1];    // Packet Entries
+} PACKET_SENDS_STRUCT, * PPACKET_SENDS_STRUCT;
+
+// Number of send buffer pools each S2C DMA Engine can have registered
+#define MAX_SEND_POOLS                  8
+
+// SEND_POOL_STRUCT
+//
+//  Send Pool Structure - Registers a send buffer pool with an S2C DMA Engine,
+//    returns the PoolId the Packet Pool Sends use.  Also used to release it.
+//    A pool still registered when its handle is closed is released then.
+typedef struct _SEND_POOL_STRUCT {
+    UINT32 EngineNum;       // DMA Engine number to use
+    UINT32 PoolId;          // Returned Pool Id, Pool to release
+    UINT32 Length;          // Length of the pool
+    UINT32 Reserved;        // Reserved
+    UINT64 BufferAddress;   // Buffer Address of the pool
+} SEND_POOL_STRUCT, * PSEND_POOL_STRUCT;
+
+// PACKET_POOL_SEND_STRUCT
+//
+//  Packet Pool Send Structure - Information for the PacketPoolSend function,
+//    the packet is taken from a registered send buffer pool
+typedef struct _PACKET_POOL_SEND_STRUCT {
+    UINT32 EngineNum;       // DMA Engine number to use
+    UINT32 PoolId;          // Pool holding the packet
+    UINT64 BufferOffset;    // Byte offset of the packet in the pool
+    UINT64 UserControl;     // Contents to write to UserControl field of SOP Descriptor
+    UINT32 Length;          // Length of packet
+} PACKET_POOL_SEND_STRUCT, * PPACKET_POOL_SEND_STRUCT;
+
+// PACKET_COMP_ENTRY_STRUCT
+//
+//  Completion Entry Structure - One received packet in a PACKET_COMP_RING_STRUCT.
+//    The descriptors stay with the application until it moves the
+//    ConsumerIndex past the entry.
+typedef struct _PACKET_COMP_ENTRY_STRUCT {
+    UINT64 Address;         // Address of data buffer for the receive
+    UINT32 Length;          // Length of packet
+    UINT32 Status;          // Packet Status, 0 or PACKET_ERROR_MALFORMED
+    UINT64 UserStatus;      // Contents of UserStatus from the EOP Descriptor
+    UINT32 RxToken;         // Receive Token of the packet
+    UINT32 Reserved;        // Reserved
+} PACKET_COMP_ENTRY_STRUCT, * PPACKET_COMP_ENTRY_STRUCT;
+
+// PACKET_COMP_RING_STRUCT
+//
+//  Completion Ring Structure - Application allocated ring a FIFO mode C2S DMA
+//    Engine fills with received packets.  Both indexes are free running,
+//    entry (Index & (NumEntries - 1)) holds the packet.  The driver writes
+//    ProducerIndex only, the application writes ConsumerIndex only.  Each
+//    index has a cache line of its own.
+typedef struct _PACKET_COMP_RING_STRUCT {
+    volatile UINT32 ProducerIndex;  // Entries the driver has filled in
+    UINT32 Reserved0[15];           // Reserved
+    volatile UINT32 ConsumerIndex;  // Entries the application is done with
+    UINT32 Reserved1[15];           // Reserved
+    PACKET_COMP_ENTRY_STRUCT Entries[1];       // NumEntries entries
+} PACKET_COMP_RING_STRUCT, * PPACKET_COMP_RING_STRUCT;
+
+// Bytes needed for a completion ring of NumEntries entries
+#define PACKET_COMP_RING_SIZE(NumEntries)   \
+    (FIELD_OFFSET(PACKET_COMP_RING_STRUCT, Entries) + ((NumEntries) * sizeof(PACKET_COMP_ENTRY_STRUCT)))
+
+// COMP_RING_STRUCT
+//
+//  Completion Ring Structure - Registers a completion ring with a FIFO mode
+//    C2S DMA Engine.  Also used to release the ring and to have the driver
+//    update it when the application finds it empty.  A ring still
+//    registered when its handle is closed is released then.
+typedef struct _COMP_RING_STRUCT {
+    UINT32 EngineNum;       // DMA Engine number to use
+    UINT32 NumEntries;      // Number of entries, a power of 2
+    UINT32 Length;          // Length of the ring buffer
+    UINT32 Reserved;        // Reserved
+    UINT64 BufferAddress;   // Buffer Address of the ring
+} COMP_RING_STRUCT, * PCOMP_RING_STRUCT;
+
 // USER_IRQ_WAIT_STRUCT - Information passed in the DeviceIOControl (ioctl)
 //        that waits for the interrupt or times out after duration defined by <dwTimeoutMilliSec>.
 // 
@@ -21,6 +21,37 @@
 //
 //--------------------------------------------------------------------
 
+// Event for the OVERLAPPED calls of each thread, created on first use and then reused by
+// every call instead of a CreateEvent / CloseHandle pair per call.  The I/O manager resets
+// the event when each IOCTL starts, so a signal left over from an earlier call does no harm.
+static thread_local HANDLE ThreadEvent = NULL;
+
+/*! GetThreadEvent
+ *
+ * \brief Returns the event of the calling thread for an OVERLAPPED call.
+ * \return The event, NULL if it could not be created.
+ */
+HANDLE GetThreadEvent(VOID)
+{
+    if (ThreadEvent == NULL) {
+        ThreadEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    }
+    return ThreadEvent;
+}
+
+/*! ReleaseThreadEvent
+ *
+ * \brief Closes the event of the calling thread, called from DllMain as the
+ *  thread (or the process) detaches.
+ */
+VOID ReleaseThreadEvent(VOID)
+{
+    if (ThreadEvent != NULL) {
+        CloseHandle(ThreadEvent);
+        ThreadEvent = NULL;
+    }
+}
+
 /*! CDmaDriverDll Default Constructor
  *
  * \brief This defaults to connecting to BoardNum == 0.
@@ -32,6 +63,12 @@ CDmaDriverDll::CDmaDriverDll()
     hDevInfo = NULL;
     pDeviceInterfaceDetailData = NULL;
     hDevice = INVALID_HANDLE_VALUE;
+    hAsyncDevice = INVALID_HANDLE_VALUE;
+    hCompletionPort = NULL;
+    AsyncOutstanding = 0;
+    memset(BarWindow, 0, sizeof(BarWindow));
+    memset(BarWindowOffset, 0, sizeof(BarWindowOffset));
+    memset(BarWindowLength, 0, sizeof(BarWindowLength));
     // Assume no DMA Engines found
     DmaInfo.PacketRecvEngineCount = 0;
     DmaInfo.PacketSendEngineCount = 0;
@@ -51,6 +88,12 @@ CDmaDriverDll::CDmaDriverDll(UINT32 BoardNum)
     hDevInfo = NULL;
     pDeviceInterfaceDetailData = NULL;
     hDevice = INVALID_HANDLE_VALUE;
+    hAsyncDevice = INVALID_HANDLE_VALUE;
+    hCompletionPort = NULL;
+    AsyncOutstanding = 0;
+    memset(BarWindow, 0, sizeof(BarWindow));
+    memset(BarWindowOffset, 0, sizeof(BarWindowOffset));
+    memset(BarWindowLength, 0, sizeof(BarWindowLength));
 
     // Assume no DMA Engines found
     DmaInfo.PacketRecvEngineCount = 0;
@@ -192,6 +235,16 @@ UINT32 CDmaDriverDll::ConnectToBoard(PDMA_INFO_STRUCT pDmaInfo)
             printf("%s: Error opening device.  Error = %d\n", __func__, GetLastError());
             return STATUS_HANDLE_INVALID;
         }
+        // The asynchronous calls use a handle of their own, every completion on a handle bound
+        // to a completion port goes to the port and the synchronous calls wait on their event.
+        hAsyncDevice = CreateFile(pDeviceInterfaceDetailData->DevicePath,
+            GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED, INVALID_HANDLE_VALUE);
+        if (hAsyncDevice != INVALID_HANDLE_VALUE) {
+            hCompletionPort = CreateIoCompletionPort(hAsyncDevice, NULL, 0, 0);
+        }
+        if (hCompletionPort == NULL) {
+            printf("%s: No completion port, asynchronous calls are not available.  Error = %d\n", __func__, GetLastError());
+        }
         // set flag for other function calls
         this->AttachedToDriver = true;
 
@@ -243,13 +296,46 @@ UINT32 CDmaDriverDll::ConnectToBoard(PDMA_INFO_STRUCT pDmaInfo)
 /*! DisconnectFromBoard
  *
  * \brief Disconnects from a board.
- * Cleanup any global data structures that have been created.
+ * Cleanup any global data structures that have been created.  Asynchronous
+ * operations still in flight are cancelled and their Callbacks run here.
  * \return STATUS_SUCCESSFUL
  */
 UINT32 CDmaDriverDll::DisconnectFromBoard()
 {
     AttachedToDriver = false;
 
+    // Closing hDevice unmaps the BAR windows
+    memset(BarWindow, 0, sizeof(BarWindow));
+
+    // Cancel the asynchronous operations still in flight and take their
+    // completions before the port goes, their buffers may be freed after this
+    if (hAsyncDevice != INVALID_HANDLE_VALUE) {
+        if (AsyncOutstanding > 0) {
+            CancelIoEx(hAsyncDevice, NULL);
+        }
+        while (AsyncOutstanding > 0) {
+            LPOVERLAPPED pOverlapped = NULL;
+            ULONG_PTR CompletionKey = 0;
+            DWORD bytesReturned = 0;
+            UINT32 status = STATUS_SUCCESSFUL;
+
+            // Other threads in AsyncWait may take some of them, check the count again
+            if (!GetQueuedCompletionStatus(hCompletionPort, &bytesReturned, &CompletionKey, &pOverlapped, 100)) {
+                DWORD LastErrorStatus = GetLastError();
+
+                status = (LastErrorStatus == ERROR_OPERATION_ABORTED) ? STATUS_OPERATION_CANCELLED : LastErrorStatus;
+            }
+            if (pOverlapped != NULL) {
+                _AsyncComplete(pOverlapped, bytesReturned, status);
+            }
+        }
+        CloseHandle(hAsyncDevice);
+        hAsyncDevice = INVALID_HANDLE_VALUE;
+    }
+    if (hCompletionPort != NULL) {
+        CloseHandle(hCompletionPort);
+        hCompletionPort = NULL;
+    }
     if (hDevice != INVALID_HANDLE_VALUE) {
         CloseHandle(hDevice);
         hDevice = INVALID_HANDLE_VALUE;
@@ -276,7 +362,7 @@ UINT32 CDmaDriverDll::GetBoardCfg(PBOARD_CONFIG_STRUCT Board)
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
 
     // Send GET_BOARD_CONFIG_IOCTL
     if (!DeviceIoControl(hDevice, GET_BOARD_CONFIG_IOCTL, NULL, 0, (LPVOID)Board, sizeof(BOARD_CONFIG_STRUCT), &bytesReturned, &os)) {
@@ -300,7 +386,6 @@ UINT32 CDmaDriverDll::GetBoardCfg(PBOARD_CONFIG_STRUCT Board)
         status = STATUS_INCOMPLETE;
     }
 
-    CloseHandle(os.hEvent);
     return status;
 }
 
@@ -318,7 +403,7 @@ UINT32 CDmaDriverDll::GetDMAEngineCap(INT32 EngineNum, PDMA_CAP_STRUCT DMACap)
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
 
     // Send BLOCK_DIRECT_GET_PERF_IOCTL IOCTL
     if (DeviceIoControl(hDevice, GET_DMA_ENGINE_CAP_IOCTL, (LPVOID)&EngineNum, sizeof(UINT32), (LPVOID)DMACap, sizeof(DMA_CAP_STRUCT), &bytesReturned, &os) == 0) {
@@ -342,7 +427,6 @@ UINT32 CDmaDriverDll::GetDMAEngineCap(INT32 EngineNum, PDMA_CAP_STRUCT DMACap)
         status = STATUS_INCOMPLETE;
     }
 
-    CloseHandle(os.hEvent);
     return status;
 }
 
@@ -362,7 +446,7 @@ UINT32 CDmaDriverDll::WritePCIConfig(PUINT8 Buffer, UINT32 Offset, UINT32 Length
     DWORD LastErrorStatus = 0;
     UINT status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
 
     // fill in the WritePCIConfig Structure
     WrPCIStruct.Offset = Offset;
@@ -393,7 +477,6 @@ UINT32 CDmaDriverDll::WritePCIConfig(PUINT8 Buffer, UINT32 Offset, UINT32 Length
         status = STATUS_INCOMPLETE;
     }
 
-    CloseHandle(os.hEvent);
     return status;
 }
 
@@ -413,7 +496,7 @@ UINT32 CDmaDriverDll::ReadPCIConfig(PUINT8 Buffer, UINT32 Offset, UINT32 Length,
     DWORD LastErrorStatus = 0;
     UINT status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
 
     // fill in the WritePCIConfig Structure
     RdPCIStruct.Offset = Offset;
@@ -444,7 +527,6 @@ UINT32 CDmaDriverDll::ReadPCIConfig(PUINT8 Buffer, UINT32 Offset, UINT32 Length,
         status = STATUS_INCOMPLETE;
     }
 
-    CloseHandle(os.hEvent);
     return status;
 }
 
@@ -468,7 +550,7 @@ UINT32 CDmaDriverDll::DoMem(UINT32 Rd_Wr_n, UINT32 BarNum, PUINT8 Buffer, UINT64
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
 
     // fill in the doMem Structure
     doMemStruct.BarNum = BarNum;
@@ -511,7 +593,213 @@ UINT32 CDmaDriverDll::DoMem(UINT32 Rd_Wr_n, UINT32 BarNum, PUINT8 Buffer, UINT64
         status = STATUS_INCOMPLETE;
     }
 
-    CloseHandle(os.hEvent);
+    return status;
+}
+
+/*! MapBar
+ *
+ * \brief Sends a BAR_MAP_IOCTL call to the driver to map a window of a BAR
+ *  into this process.  BarRead32 / BarWrite32 inside the window are then
+ *  plain loads and stores.
+ * \param BarNum
+ * \param CardOffset - Start of the window, page aligned
+ * \param Length - Length of the window, 0 for the rest of the BAR
+ * \param ppWindow - Returned address of the window (optional)
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::MapBar(UINT32 BarNum, UINT64 CardOffset, UINT64 Length, PVOID * ppWindow)
+{
+    BAR_MAP_STRUCT BarMap;
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
+
+    if (BarNum >= MAX_BARS) {
+        return STATUS_INVALID_BARNUM;
+    }
+    os.hEvent = GetThreadEvent();
+
+    BarMap.BarNum = BarNum;
+    BarMap.CardOffset = CardOffset;
+    BarMap.Length = Length;
+    BarMap.UserAddress = 0;
+
+    if (!DeviceIoControl(hDevice, BAR_MAP_IOCTL, &BarMap, sizeof(BAR_MAP_STRUCT), &BarMap, sizeof(BAR_MAP_STRUCT), &bytesReturned, &os)) {
+        LastErrorStatus = GetLastError();
+        if (LastErrorStatus == ERROR_IO_PENDING) {
+            // Wait here (forever) for the Overlapped I/O to complete
+            if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                LastErrorStatus = GetLastError();
+                printf("%s: Map BAR overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                status = LastErrorStatus;
+            }
+        }
+        else {
+            printf("%s: Map BAR IOCTL call failed. Error = %d\n", __func__, LastErrorStatus);
+            status = LastErrorStatus;
+        }
+    }
+    if ((status == STATUS_SUCCESSFUL) && (bytesReturned != sizeof(BAR_MAP_STRUCT))) {
+        printf("%s: Map BAR IOCTL returned invalid size (%d)\n", __func__, bytesReturned);
+        status = STATUS_INCOMPLETE;
+    }
+    if (status == STATUS_SUCCESSFUL) {
+        BarWindow[BarNum] = (volatile UINT8 *)(ULONG_PTR)BarMap.UserAddress;
+        BarWindowOffset[BarNum] = BarMap.CardOffset;
+        BarWindowLength[BarNum] = BarMap.Length;
+        if (ppWindow != NULL) {
+            *ppWindow = (PVOID)BarWindow[BarNum];
+        }
+    }
+    return status;
+}
+
+/*! UnmapBar
+ *
+ * \brief Sends a BAR_UNMAP_IOCTL call to the driver to unmap the window
+ *  MapBar mapped.  Closing the board unmaps it as well.
+ * \param BarNum
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::UnmapBar(UINT32 BarNum)
+{
+    BAR_MAP_STRUCT BarMap;
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
+
+    if (BarNum >= MAX_BARS) {
+        return STATUS_INVALID_BARNUM;
+    }
+    // Stop using the window before it goes away
+    BarWindow[BarNum] = NULL;
+    BarWindowOffset[BarNum] = 0;
+    BarWindowLength[BarNum] = 0;
+
+    os.hEvent = GetThreadEvent();
+    memset(&BarMap, 0, sizeof(BAR_MAP_STRUCT));
+    BarMap.BarNum = BarNum;
+
+    if (!DeviceIoControl(hDevice, BAR_UNMAP_IOCTL, &BarMap, sizeof(BAR_MAP_STRUCT), NULL, 0, &bytesReturned, &os)) {
+        LastErrorStatus = GetLastError();
+        if (LastErrorStatus == ERROR_IO_PENDING) {
+            // Wait here (forever) for the Overlapped I/O to complete
+            if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                LastErrorStatus = GetLastError();
+                printf("%s: Unmap BAR overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                status = LastErrorStatus;
+            }
+        }
+        else {
+            printf("%s: Unmap BAR IOCTL call failed. Error = %d\n", __func__, LastErrorStatus);
+            status = LastErrorStatus;
+        }
+    }
+    return status;
+}
+
+/*! BarRead32
+ *
+ * \brief Reads a 32 bit register.  A load from the mapped window when
+ *  CardOffset is inside it, a DoMem call otherwise.
+ * \param BarNum
+ * \param CardOffset
+ * \param Value
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::BarRead32(UINT32 BarNum, UINT64 CardOffset, PUINT32 Value)
+{
+    STAT_STRUCT Status;
+
+    if (BarNum >= MAX_BARS) {
+        return STATUS_INVALID_BARNUM;
+    }
+    if ((BarWindow[BarNum] != NULL) && (CardOffset >= BarWindowOffset[BarNum]) &&
+        ((CardOffset - BarWindowOffset[BarNum]) <= (BarWindowLength[BarNum] - sizeof(UINT32)))) {
+        *Value = *(volatile UINT32 *)(BarWindow[BarNum] + (CardOffset - BarWindowOffset[BarNum]));
+        return STATUS_SUCCESSFUL;
+    }
+    return DoMem(READ_FROM_CARD, BarNum, (PUINT8)Value, 0, CardOffset, sizeof(UINT32), &Status);
+}
+
+/*! BarWrite32
+ *
+ * \brief Writes a 32 bit register.  A store to the mapped window when
+ *  CardOffset is inside it, a DoMem call otherwise.
+ * \param BarNum
+ * \param CardOffset
+ * \param Value
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::BarWrite32(UINT32 BarNum, UINT64 CardOffset, UINT32 Value)
+{
+    STAT_STRUCT Status;
+
+    if (BarNum >= MAX_BARS) {
+        return STATUS_INVALID_BARNUM;
+    }
+    if ((BarWindow[BarNum] != NULL) && (CardOffset >= BarWindowOffset[BarNum]) &&
+        ((CardOffset - BarWindowOffset[BarNum]) <= (BarWindowLength[BarNum] - sizeof(UINT32)))) {
+        *(volatile UINT32 *)(BarWindow[BarNum] + (CardOffset - BarWindowOffset[BarNum])) = Value;
+        return STATUS_SUCCESSFUL;
+    }
+    return DoMem(WRITE_TO_CARD, BarNum, (PUINT8)&Value, 0, CardOffset, sizeof(UINT32), &Status);
+}
+
+/*! DoMemVector
+ *
+ * \brief Sends a DO_MEM_VECTOR_IOCTL call to the driver, NumOps register
+ *  accesses in one call.  The Value of each operation done is filled in.
+ * \param pMemVector - Operations, DO_MEM_VECTOR_SIZE(NumOps) bytes
+ * \return Completion status, STATUS_INCOMPLETE if a MEM_OP_POLL timed out
+ *  (RetNumOps is its index).
+ */
+UINT32 CDmaDriverDll::DoMemVector(PDO_MEM_VECTOR_STRUCT pMemVector)
+{
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD VectorSize;
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
+
+    if ((pMemVector->NumOps == 0) || (pMemVector->NumOps > MEM_OP_MAX_OPS)) {
+        return STATUS_BAD_PARAMETER;
+    }
+
+    os.hEvent = GetThreadEvent();
+    if (os.hEvent == NULL) {
+        return GetLastError();
+    }
+
+    pMemVector->RetNumOps = 0;
+    VectorSize = (DWORD)DO_MEM_VECTOR_SIZE(pMemVector->NumOps);
+
+    // Send DO_MEM_VECTOR_IOCTL IOCTL
+    if (!DeviceIoControl(hDevice, DO_MEM_VECTOR_IOCTL, pMemVector, VectorSize, pMemVector, VectorSize, &bytesReturned, &os)) {
+        LastErrorStatus = GetLastError();
+        if (LastErrorStatus == ERROR_IO_PENDING) {
+            // Wait here (forever) for the Overlapped I/O to complete
+            if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                LastErrorStatus = GetLastError();
+                printf("%s: Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                status = LastErrorStatus;
+            }
+        }
+        else {
+            printf("%s: DoMemVector IOCTL call failed. Error = %d\n", __func__, LastErrorStatus);
+            status = LastErrorStatus;
+        }
+    }
+    // check returned structure size
+    if ((bytesReturned != VectorSize) && (status == STATUS_SUCCESSFUL)) {
+        printf("%s: DoMemVector IOCTL returned invalid size (%d), expected %d\n", __func__, bytesReturned, VectorSize);
+        status = STATUS_INCOMPLETE;
+    }
+    else if ((pMemVector->RetNumOps != pMemVector->NumOps) && (status == STATUS_SUCCESSFUL)) {
+        status = STATUS_INCOMPLETE;
+    }
     return status;
 }
 
@@ -532,7 +820,7 @@ UINT32 CDmaDriverDll::GetDmaPerf(INT32 EngineNumOffset, UINT32 TypeDirection,
     INT32 EngineNum = 0;
     UINT32 status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
 
     // determine the ioctl code
     if ((TypeDirection & DMA_CAP_DIRECTION_MASK) == DMA_CAP_CARD_TO_SYSTEM) {
@@ -573,263 +861,873 @@ UINT32 CDmaDriverDll::GetDmaPerf(INT32 EngineNumOffset, UINT32 TypeDirection,
         printf("%s: GetDmaPerf IOCTL returned invalid size (%d)\n", __func__, bytesReturned);
         status = STATUS_INCOMPLETE;
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
-//**************************************************
-// FIFO Packet Mode Function calls
-//**************************************************
-
-/*! PacketSendEx - Includes User Control
+/*! SetInterruptCoalescing
  *
- * \brief Send a PACKET_SEND_IOCTL call to the driver.
- *        Includes 64-bit UserControl.
+ * \brief Send a SET_INT_COALESCE_IOCTL call to the driver.
  * \param EngineOffset - DMA Engine number offset to use
- * \param UserControl - User Control to set in the first DMA Descriptor
- * \param CardOffset
- * \param Buffer
- * \param Length
- * \return Completion status.
+ * \param TypeDirection - DMA Type & Direction Flags
+ * \param pCoalesce - Settings, returns the effective ones
+ * \return Completion Status
  */
-UINT32 CDmaDriverDll::PacketSendEx(INT32 EngineOffset,  // DMA Engine number offset to use
-    UINT64 UserControl,  // User Control to set in the first DMA Descriptor
-    UINT64 CardOffset, PUINT8 Buffer, UINT32 Length)
+UINT32 CDmaDriverDll::SetInterruptCoalescing(INT32 EngineOffset, UINT32 TypeDirection,   // DMA Type & Direction Flags
+    PINT_COALESCE_STRUCT pCoalesce)
 {
-    PACKET_SEND_STRUCT PacketSend;
     OVERLAPPED os;          // OVERLAPPED structure for the operation
     DWORD bytesReturned = 0;
     DWORD LastErrorStatus = 0;
-    UINT status = STATUS_SUCCESSFUL;
+    UINT32 status = STATUS_SUCCESSFUL;
+
+    if ((TypeDirection & DMA_CAP_DIRECTION_MASK) == DMA_CAP_CARD_TO_SYSTEM) {
+        if (EngineOffset >= DmaInfo.PacketRecvEngineCount) {
+            return STATUS_INVALID_MODE;
+        }
+        pCoalesce->EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
+    }
+    else                  // Direction is S2C
+    {
+        if (EngineOffset >= DmaInfo.PacketSendEngineCount) {
+            return STATUS_INVALID_MODE;
+        }
+        pCoalesce->EngineNum = DmaInfo.PacketSendEngine[EngineOffset];
+    }
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
     if (os.hEvent == NULL) {
         return GetLastError();
     }
 
-    if (EngineOffset < DmaInfo.PacketSendEngineCount) {
-        // Select a Packet Send DMA Engine
-        PacketSend.EngineNum = DmaInfo.PacketSendEngine[EngineOffset];
-        PacketSend.CardOffset = CardOffset;
-        PacketSend.Length = Length;
-        PacketSend.UserControl = UserControl;
-
-        if (!DeviceIoControl(hDevice, PACKET_SEND_IOCTL, &PacketSend, sizeof(PACKET_SEND_STRUCT), (LPVOID)Buffer, (DWORD)Length, &bytesReturned, &os)) {
-            LastErrorStatus = GetLastError();
-#ifdef TIMEOUT_IO
-            while ((LastErrorStatus == ERROR_IO_PENDING) || (LastErrorStatus == ERROR_IO_INCOMPLETE)) {
-                // Wait here (forever) for the Overlapped I/O to complete
-                if (!GetOverlappedResult(hDevice, &os, &bytesReturned, FALSE)) {
-                    LastErrorStatus = GetLastError();
-                    if ((LastErrorStatus == ERROR_IO_PENDING) || (LastErrorStatus == ERROR_IO_INCOMPLETE)) {
-                        if (!--TimeoutCount) {
-                            printf("Packet Send Overlapped Timed Out. Error = %d\n", LastErrorStatus);
-                            status = LastErrorStatus;
-                            break;
-                        }
-                    }
-                    else {
-                        printf("%s: Packet Send Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
-                        status = LastErrorStatus;
-                        break;
-                    }
-                }
-                else {
-                    break;
-                }
-                // Make sure we returned something useful
-            }
-#else
-            if (LastErrorStatus == ERROR_IO_PENDING) {
-                // Wait here (forever) for the Overlapped I/O to complete
-                if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
-                    LastErrorStatus = GetLastError();
-                    printf("%s: Packet Send overlapped failed. Error = %d\n", __func__, LastErrorStatus);
-                    status = LastErrorStatus;
-                }
+    // Send SET_INT_COALESCE_IOCTL IOCTL
+    if (!DeviceIoControl(hDevice, SET_INT_COALESCE_IOCTL, pCoalesce, sizeof(INT_COALESCE_STRUCT), pCoalesce, sizeof(INT_COALESCE_STRUCT), &bytesReturned, &os)) {
+        LastErrorStatus = GetLastError();
+        if (LastErrorStatus == ERROR_IO_PENDING) {
+            // Wait here (forever) for the Overlapped I/O to complete
+            if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                LastErrorStatus = GetLastError();
+                printf("%s: Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                status = LastErrorStatus;
             }
-#endif                          // TIME OUT I/O
+        }
+        else {
+            printf("%s: SetInterruptCoalescing IOCTL call failed. Error = %d\n", __func__, LastErrorStatus);
+            status = LastErrorStatus;
         }
     }
-    else {
-        printf("%s: DLL: Packet Send failed. No Packet Send Engine\n", __func__);
-        status = STATUS_INVALID_MODE;
+    // check returned structure size
+    if ((bytesReturned != sizeof(INT_COALESCE_STRUCT) && status == STATUS_SUCCESSFUL)) {
+        printf("%s: SetInterruptCoalescing IOCTL returned invalid size (%d)\n", __func__, bytesReturned);
+        status = STATUS_INCOMPLETE;
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
-UINT32 CDmaDriverDll::_PacketReceive(
-    INT32 EngineOffset,       // DMA Engine number offset to use
-    PUINT64 UserStatus,       // User Status returned from the last DMA Descriptor
-    PUINT32 BufferToken,
-    PVOID Buffer,
-    PUINT32 Length,
-    BOOLEAN Blocking)
+/*! SetPollMode
+ *
+ * \brief Send a SET_POLL_MODE_IOCTL call to the driver.
+ * \param EngineOffset - C2S DMA Engine number offset to use
+ * \param pPollMode - Settings, returns the effective ones
+ * \return Completion Status
+ */
+UINT32 CDmaDriverDll::SetPollMode(INT32 EngineOffset, PPOLL_MODE_STRUCT pPollMode)
 {
-    PACKET_RECEIVE_STRUCT PacketRecv;
-    PACKET_RET_RECEIVE_STRUCT PacketRecvRet;
     OVERLAPPED os;          // OVERLAPPED structure for the operation
     DWORD bytesReturned = 0;
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_SUCCESSFUL;
-#ifdef PLATFORM_X64
-    PUINT64 pBuffer = (PUINT64)Buffer;
-#else                           // 32 bit code
-    PUINT32 pBuffer = (PUINT32)Buffer;
-#endif                          // 64 Bit version
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (EngineOffset >= DmaInfo.PacketRecvEngineCount) {
+        return STATUS_INVALID_MODE;
+    }
+    pPollMode->EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
+
+    os.hEvent = GetThreadEvent();
     if (os.hEvent == NULL) {
         return GetLastError();
     }
 
-    if (EngineOffset < DmaInfo.PacketRecvEngineCount) {
-        PacketRecv.EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
-        // Indicate Rx Token (if any)
-        PacketRecv.RxReleaseToken = *BufferToken;
-        PacketRecv.Block = Blocking;
-
-        *BufferToken = INVALID_RELEASE_TOKEN;
-        *Length = 0;
-        if (UserStatus != NULL) {
-            *UserStatus = 0;
-        }
-        // Send Packet Mode Release space
-        if (!DeviceIoControl(hDevice, PACKET_RECEIVE_IOCTL, &PacketRecv, sizeof(PACKET_RECEIVE_STRUCT), &PacketRecvRet, sizeof(PACKET_RET_RECEIVE_STRUCT), &bytesReturned, &os)) {
+    // Send SET_POLL_MODE_IOCTL IOCTL
+    if (!DeviceIoControl(hDevice, SET_POLL_MODE_IOCTL, pPollMode, sizeof(POLL_MODE_STRUCT), pPollMode, sizeof(POLL_MODE_STRUCT), &bytesReturned, &os)) {
+        LastErrorStatus = GetLastError();
+        if (LastErrorStatus == ERROR_IO_PENDING) {
+            // Wait here (forever) for the Overlapped I/O to complete
+            if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                LastErrorStatus = GetLastError();
+                printf("%s: Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                status = LastErrorStatus;
+            }
+        }
+        else {
+            printf("%s: SetPollMode IOCTL call failed. Error = %d\n", __func__, LastErrorStatus);
+            status = LastErrorStatus;
+        }
+    }
+    // check returned structure size
+    if ((bytesReturned != sizeof(POLL_MODE_STRUCT) && status == STATUS_SUCCESSFUL)) {
+        printf("%s: SetPollMode IOCTL returned invalid size (%d)\n", __func__, bytesReturned);
+        status = STATUS_INCOMPLETE;
+    }
+    return status;
+}
+
+/*! GetEngineAffinity
+ *
+ * \brief Send a GET_ENGINE_AFFINITY_IOCTL call to the driver.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param TypeDirection - DMA Type & Direction Flags
+ * \param pAffinity - Returned placement
+ * \return Completion Status
+ */
+UINT32 CDmaDriverDll::GetEngineAffinity(INT32 EngineOffset, UINT32 TypeDirection,        // DMA Type & Direction Flags
+    PENGINE_AFFINITY_STRUCT pAffinity)
+{
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
+
+    if ((TypeDirection & DMA_CAP_DIRECTION_MASK) == DMA_CAP_CARD_TO_SYSTEM) {
+        if (EngineOffset >= DmaInfo.PacketRecvEngineCount) {
+            return STATUS_INVALID_MODE;
+        }
+        pAffinity->EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
+    }
+    else                  // Direction is S2C
+    {
+        if (EngineOffset >= DmaInfo.PacketSendEngineCount) {
+            return STATUS_INVALID_MODE;
+        }
+        pAffinity->EngineNum = DmaInfo.PacketSendEngine[EngineOffset];
+    }
+
+    os.hEvent = GetThreadEvent();
+    if (os.hEvent == NULL) {
+        return GetLastError();
+    }
+
+    // Send GET_ENGINE_AFFINITY_IOCTL IOCTL
+    if (!DeviceIoControl(hDevice, GET_ENGINE_AFFINITY_IOCTL, pAffinity, sizeof(ENGINE_AFFINITY_STRUCT), pAffinity, sizeof(ENGINE_AFFINITY_STRUCT), &bytesReturned, &os)) {
+        LastErrorStatus = GetLastError();
+        if (LastErrorStatus == ERROR_IO_PENDING) {
+            // Wait here (forever) for the Overlapped I/O to complete
+            if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                LastErrorStatus = GetLastError();
+                printf("%s: Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                status = LastErrorStatus;
+            }
+        }
+        else {
+            printf("%s: GetEngineAffinity IOCTL call failed. Error = %d\n", __func__, LastErrorStatus);
+            status = LastErrorStatus;
+        }
+    }
+    // check returned structure size
+    if ((bytesReturned != sizeof(ENGINE_AFFINITY_STRUCT) && status == STATUS_SUCCESSFUL)) {
+        printf("%s: GetEngineAffinity IOCTL returned invalid size (%d)\n", __func__, bytesReturned);
+        status = STATUS_INCOMPLETE;
+    }
+    return status;
+}
+
+/*! LargePageSize
+ *
+ * \brief Enables SeLockMemoryPrivilege for the process, on the first call,
+ *  so buffers can be allocated with MEM_LARGE_PAGES.
+ * \return Large page size, 0 if the account does not hold the privilege
+ *  or the processor has no large pages.
+ */
+static SIZE_T LargePageSize(void)
+{
+    static volatile LONG LargePagesState = 0;   // 0 not checked, 1 usable, -1 not usable
+    TOKEN_PRIVILEGES Privileges;
+    HANDLE hToken;
+    LONG State = -1;
+
+    if (LargePagesState == 0) {
+        if ((GetLargePageMinimum() != 0) && OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken)) {
+            Privileges.PrivilegeCount = 1;
+            Privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            // AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED if the privilege is not held
+            if (LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &Privileges.Privileges[0].Luid) &&
+                AdjustTokenPrivileges(hToken, FALSE, &Privileges, 0, NULL, NULL) && (GetLastError() == ERROR_SUCCESS)) {
+                State = 1;
+            }
+            CloseHandle(hToken);
+        }
+        LargePagesState = State;
+    }
+    return (LargePagesState > 0) ? GetLargePageMinimum() : 0;
+}
+
+/*! AllocEngineBuffer
+ *
+ * \brief Allocate a data buffer on the NUMA node of a DMA Engine.  Falls back
+ *  to any node if the engine has no node or the node has no free memory.
+ *  Buffers of at least one large page (2MB on x64) are allocated with large
+ *  pages when the account holds "Lock pages in memory", rounded up to whole
+ *  large pages.  The pages are physically contiguous, so the driver covers
+ *  them with fewer, longer descriptors, and the application takes fewer TLB
+ *  misses walking them.  Falls back to normal pages otherwise.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param TypeDirection - DMA Type & Direction Flags
+ * \param Size - Bytes to allocate
+ * \return Buffer address, NULL on failure
+ */
+PVOID CDmaDriverDll::AllocEngineBuffer(INT32 EngineOffset, UINT32 TypeDirection, SIZE_T Size)
+{
+    ENGINE_AFFINITY_STRUCT Affinity;
+    SIZE_T LargePage = LargePageSize();
+    BOOLEAN bNode;
+    PVOID Buffer = NULL;
+
+    bNode = (GetEngineAffinity(EngineOffset, TypeDirection, &Affinity) == STATUS_SUCCESSFUL) && (Affinity.Node != ENGINE_AFFINITY_ANY);
+
+    if ((LargePage != 0) && (Size >= LargePage)) {
+        SIZE_T LargeSize = (Size + (LargePage - 1)) & ~(LargePage - 1);
+
+        if (bNode) {
+            Buffer = VirtualAllocExNuma(GetCurrentProcess(), NULL, LargeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, Affinity.Node);
+        }
+        else {
+            Buffer = VirtualAlloc(NULL, LargeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        }
+    }
+    if ((Buffer == NULL) && bNode) {
+        Buffer = VirtualAllocExNuma(GetCurrentProcess(), NULL, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, Affinity.Node);
+    }
+    if (Buffer == NULL) {
+        Buffer = VirtualAlloc(NULL, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    return Buffer;
+}
+
+//**************************************************
+// FIFO Packet Mode Function calls
+//**************************************************
+
+/*! PacketSendEx - Includes User Control
+ *
+ * \brief Send a PACKET_SEND_IOCTL call to the driver.
+ *        Includes 64-bit UserControl.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param UserControl - User Control to set in the first DMA Descriptor
+ * \param CardOffset
+ * \param Buffer
+ * \param Length
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::PacketSendEx(INT32 EngineOffset,  // DMA Engine number offset to use
+    UINT64 UserControl,  // User Control to set in the first DMA Descriptor
+    UINT64 CardOffset, PUINT8 Buffer, UINT32 Length)
+{
+    PACKET_SEND_STRUCT PacketSend;
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT status = STATUS_SUCCESSFUL;
+
+    os.hEvent = GetThreadEvent();
+    if (os.hEvent == NULL) {
+        return GetLastError();
+    }
+
+    if (EngineOffset < DmaInfo.PacketSendEngineCount) {
+        // Select a Packet Send DMA Engine
+        PacketSend.EngineNum = DmaInfo.PacketSendEngine[EngineOffset];
+        PacketSend.CardOffset = CardOffset;
+        PacketSend.Length = Length;
+        PacketSend.UserControl = UserControl;
+
+        if (!DeviceIoControl(hDevice, PACKET_SEND_IOCTL, &PacketSend, sizeof(PACKET_SEND_STRUCT), (LPVOID)Buffer, (DWORD)Length, &bytesReturned, &os)) {
+            LastErrorStatus = GetLastError();
+#ifdef TIMEOUT_IO
+            while ((LastErrorStatus == ERROR_IO_PENDING) || (LastErrorStatus == ERROR_IO_INCOMPLETE)) {
+                // Wait here (forever) for the Overlapped I/O to complete
+                if (!GetOverlappedResult(hDevice, &os, &bytesReturned, FALSE)) {
+                    LastErrorStatus = GetLastError();
+                    if ((LastErrorStatus == ERROR_IO_PENDING) || (LastErrorStatus == ERROR_IO_INCOMPLETE)) {
+                        if (!--TimeoutCount) {
+                            printf("Packet Send Overlapped Timed Out. Error = %d\n", LastErrorStatus);
+                            status = LastErrorStatus;
+                            break;
+                        }
+                    }
+                    else {
+                        printf("%s: Packet Send Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                        status = LastErrorStatus;
+                        break;
+                    }
+                }
+                else {
+                    break;
+                }
+                // Make sure we returned something useful
+            }
+#else
+            if (LastErrorStatus == ERROR_IO_PENDING) {
+                // Wait here (forever) for the Overlapped I/O to complete
+                if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                    LastErrorStatus = GetLastError();
+                    printf("%s: Packet Send overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                    status = LastErrorStatus;
+                }
+            }
+#endif                          // TIME OUT I/O
+        }
+    }
+    else {
+        printf("%s: DLL: Packet Send failed. No Packet Send Engine\n", __func__);
+        status = STATUS_INVALID_MODE;
+    }
+    return status;
+}
+
+UINT32 CDmaDriverDll::_PacketReceive(
+    INT32 EngineOffset,       // DMA Engine number offset to use
+    PUINT64 UserStatus,       // User Status returned from the last DMA Descriptor
+    PUINT32 BufferToken,
+    PVOID Buffer,
+    PUINT32 Length,
+    BOOLEAN Blocking)
+{
+    PACKET_RECEIVE_STRUCT PacketRecv;
+    PACKET_RET_RECEIVE_STRUCT PacketRecvRet;
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
+#ifdef PLATFORM_X64
+    PUINT64 pBuffer = (PUINT64)Buffer;
+#else                           // 32 bit code
+    PUINT32 pBuffer = (PUINT32)Buffer;
+#endif                          // 64 Bit version
+
+    os.hEvent = GetThreadEvent();
+    if (os.hEvent == NULL) {
+        return GetLastError();
+    }
+
+    if (EngineOffset < DmaInfo.PacketRecvEngineCount) {
+        PacketRecv.EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
+        // Indicate Rx Token (if any)
+        PacketRecv.RxReleaseToken = *BufferToken;
+        PacketRecv.Block = Blocking;
+
+        *BufferToken = INVALID_RELEASE_TOKEN;
+        *Length = 0;
+        if (UserStatus != NULL) {
+            *UserStatus = 0;
+        }
+        // Send Packet Mode Release space
+        if (!DeviceIoControl(hDevice, PACKET_RECEIVE_IOCTL, &PacketRecv, sizeof(PACKET_RECEIVE_STRUCT), &PacketRecvRet, sizeof(PACKET_RET_RECEIVE_STRUCT), &bytesReturned, &os)) {
+            LastErrorStatus = GetLastError();
+            if (LastErrorStatus == ERROR_IO_PENDING) {
+                // Wait here (forever) for the Overlapped I/O to complete
+                if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                    LastErrorStatus = GetLastError();
+                    printf("%s: Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                    status = LastErrorStatus;
+                }
+            }
+            else {
+                printf("%s: failed, Error = %d\n", __func__, LastErrorStatus);
+                status = LastErrorStatus;
+            }
+        }
+
+        if (status == STATUS_SUCCESSFUL) {
+            if (bytesReturned != sizeof(PACKET_RET_RECEIVE_STRUCT)) {
+                printf("%s: IOCTL returned invalid size (%d)\n", __func__, bytesReturned);
+                status = STATUS_INVALID_MODE;
+            }
+            else {
+                if (PacketRecvRet.RxToken != INVALID_RELEASE_TOKEN) {
+                    if (UserStatus != NULL) {
+                        *UserStatus = PacketRecvRet.UserStatus;
+                    }
+                    *BufferToken = PacketRecvRet.RxToken;
+#ifdef PLATFORM_X64
+                    * pBuffer = PacketRecvRet.Address;
+#else                           // 32 bit code
+                    * pBuffer = (UINT32)PacketRecvRet.Address;
+#endif                          // 64 Bit version
+                    * Length = PacketRecvRet.Length;
+                }
+                else {
+                    status = STATUS_INCOMPLETE;
+                }
+            }
+        }
+    }
+    else {
+        status = STATUS_INVALID_MODE;
+    }
+    return status;
+}
+
+/*! PacketReceiveEx -
+ *
+ * \brief Send a PACKET_RECEIVE_IOCTL call to the driver and waits for a completion.
+ *  Includes 64-bit User Status.
+ * \param EngineOffset
+ * \param UserStatus
+ * \param BufferToken
+ * \param Buffer
+ * \param Length
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::PacketReceiveEx(INT32 EngineOffset,       // DMA Engine number offset to use
+    PUINT64 UserStatus,       // User Status returned from the last DMA Descriptor
+    PUINT32 BufferToken, PVOID Buffer, PUINT32 Length)
+{
+    return _PacketReceive(EngineOffset, UserStatus, BufferToken, Buffer, Length, TRUE);
+}
+
+/*! PacketReceiveNB -
+*
+* \brief Send a PACKET_RECEIVE_IOCTL call to the driver and waits for a completion.
+*   Includes 64-bit User Status.
+* \param EngineOffset
+* \param UserStatus
+* \param BufferToken
+* \param Buffer
+* \param Length
+* \return Completion status.
+*/
+UINT32 CDmaDriverDll::PacketReceiveNB(INT32 EngineOffset,       // DMA Engine number offset to use
+    PUINT64 UserStatus,       // User Status returned from the last DMA Descriptor
+    PUINT32 BufferToken, PVOID Buffer, PUINT32 Length)
+{
+    return _PacketReceive(EngineOffset, UserStatus, BufferToken, Buffer, Length, FALSE);
+}
+
+/*! PacketReturnReceive
+ *
+ * \brief Send a PACKET_RECEIVE_IOCTL call to the driver to return a buffer token
+ * \param EngineOffset
+ * \param BufferToken
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::PacketReturnReceive(INT32 EngineOffset,   // DMA Engine number offset to use
+    PUINT32 BufferToken)
+{
+    PACKET_RECEIVE_STRUCT PacketRecv;
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
+
+    os.hEvent = GetThreadEvent();
+    if (os.hEvent == NULL) {
+        return GetLastError();
+    }
+
+    if (EngineOffset < DmaInfo.PacketRecvEngineCount) {
+        PacketRecv.EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
+        // Indicate Rx Token
+        PacketRecv.RxReleaseToken = *BufferToken;
+
+        // For the Packet Return we use the standard Packet Receive call but
+        // we do not specify a Out or Return buffer
+        if (!DeviceIoControl(hDevice, PACKET_RECEIVE_IOCTL, &PacketRecv, sizeof(PACKET_RECEIVE_STRUCT), NULL, 0, &bytesReturned, &os)) {
+            LastErrorStatus = GetLastError();
+            if (LastErrorStatus == ERROR_IO_PENDING) {
+                // Wait here (forever) for the Overlapped I/O to complete
+                if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                    LastErrorStatus = GetLastError();
+                    printf("%s: Packet Return Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                    status = LastErrorStatus;
+                }
+            }
+            else {
+                printf("%s: Packet Return Rx failed for Token %d. Error = %d\n", __func__, PacketRecv.RxReleaseToken, LastErrorStatus);
+                status = LastErrorStatus;
+            }
+        }
+    }
+    else {
+        status = STATUS_INVALID_MODE;
+    }
+    return status;
+}
+
+/*! PacketReturnReceives
+ *
+ * \brief Send a PACKET_RETURN_RECEIVES_IOCTL call to the driver to return
+ *        NumTokens buffer tokens, or with PACKET_RETURN_THROUGH every token
+ *        up to and including Tokens[0], in one call.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param pReturnRecvs - Tokens to return, RetNumTokens is filled in
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::PacketReturnReceives(INT32 EngineOffset,  // DMA Engine number offset to use
+    PPACKET_RETURN_RECVS_STRUCT pReturnRecvs)
+{
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD ReturnSize = 0;
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
+
+    os.hEvent = GetThreadEvent();
+    if (os.hEvent == NULL) {
+        return GetLastError();
+    }
+
+    if (EngineOffset < DmaInfo.PacketRecvEngineCount) {
+        pReturnRecvs->EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
+        pReturnRecvs->RetNumTokens = 0;
+
+        ReturnSize = FIELD_OFFSET(PACKET_RETURN_RECVS_STRUCT, Tokens) + (pReturnRecvs->NumTokens * sizeof(UINT32));
+        if (ReturnSize < sizeof(PACKET_RETURN_RECVS_STRUCT)) {
+            ReturnSize = sizeof(PACKET_RETURN_RECVS_STRUCT);
+        }
+
+        // Only the header comes back, with RetNumTokens set
+        if (!DeviceIoControl(hDevice, PACKET_RETURN_RECEIVES_IOCTL, pReturnRecvs, ReturnSize, pReturnRecvs,
+            FIELD_OFFSET(PACKET_RETURN_RECVS_STRUCT, Tokens), &bytesReturned, &os)) {
+            LastErrorStatus = GetLastError();
+            if (LastErrorStatus == ERROR_IO_PENDING) {
+                // Wait here (forever) for the Overlapped I/O to complete
+                if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                    LastErrorStatus = GetLastError();
+                    printf("%s: Packet Return Rxs Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                    status = LastErrorStatus;
+                }
+            }
+            else {
+                printf("%s: Packet Return Rxs failed for %d Tokens. Error = %d\n", __func__, pReturnRecvs->NumTokens, LastErrorStatus);
+                status = LastErrorStatus;
+            }
+        }
+    }
+    else {
+        status = STATUS_INVALID_MODE;
+    }
+    return status;
+}
+
+/*! PacketSends
+ *
+ * \brief Send a PACKET_SENDS_IOCTL call to the driver and waits for a completion.
+ *        Sends AvailNumEntries packets from one buffer, each entry gives the
+ *        offset, length and User Control of one packet.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param Buffer - Buffer holding the packets
+ * \param Length - Length of Buffer
+ * \param pPacketSends - Packet entries, returns the number sent and their status
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::PacketSends(INT32 EngineOffset,   // DMA Engine number offset to use
+    PUINT8 Buffer, UINT32 Length, PPACKET_SENDS_STRUCT pPacketSends)
+{
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD PacketSize = 0;
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
+
+    os.hEvent = GetThreadEvent();
+    if (os.hEvent == NULL) {
+        return GetLastError();
+    }
+
+    if (EngineOffset < DmaInfo.PacketSendEngineCount) {
+        pPacketSends->EngineNum = DmaInfo.PacketSendEngine[EngineOffset];
+        pPacketSends->BufferAddress = (UINT64)Buffer;
+        pPacketSends->Length = Length;
+
+        PacketSize = sizeof(PACKET_SENDS_STRUCT) + (pPacketSends->AvailNumEntries * sizeof(PACKET_SEND_ENTRY_STRUCT));
+
+        // Send Packet Send multiples request
+        if (!DeviceIoControl(hDevice, PACKET_SENDS_IOCTL, NULL, 0, pPacketSends, PacketSize, &bytesReturned, &os)) {
+            LastErrorStatus = GetLastError();
+            if (LastErrorStatus == ERROR_IO_PENDING) {
+                // Wait here (forever) for the Overlapped I/O to complete
+                if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                    LastErrorStatus = GetLastError();
+                    printf("%s: Packet Sends Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                    status = LastErrorStatus;
+                }
+            }
+            else {
+                printf("%s: Packet Sends failed, Error = %d\n", __func__, LastErrorStatus);
+                status = LastErrorStatus;
+            }
+        }
+    }
+    else {
+        printf("%s: DLL: Packet Sends failed. No Packet Send Engine\n", __func__);
+        status = STATUS_INVALID_MODE;
+    }
+    return status;
+}
+
+/*! PacketRegisterSendPool
+ *
+ * \brief Send a PACKET_POOL_REGISTER_IOCTL call to the driver.  The driver
+ *        locks and maps Buffer once, packets are then sent from it with
+ *        PacketPoolSend until PacketReleaseSendPool is called.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param Buffer - Buffer to register
+ * \param Length - Length of Buffer
+ * \param PoolId - Returns the Pool Id to use with PacketPoolSend
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::PacketRegisterSendPool(INT32 EngineOffset,       // DMA Engine number offset to use
+    PUINT8 Buffer, UINT32 Length, PUINT32 PoolId)
+{
+    SEND_POOL_STRUCT SendPool;
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
+
+    os.hEvent = GetThreadEvent();
+    if (os.hEvent == NULL) {
+        return GetLastError();
+    }
+
+    if (EngineOffset < DmaInfo.PacketSendEngineCount) {
+        SendPool.EngineNum = DmaInfo.PacketSendEngine[EngineOffset];
+        SendPool.PoolId = 0;
+        SendPool.Length = Length;
+        SendPool.Reserved = 0;
+        SendPool.BufferAddress = (UINT64)Buffer;
+
+        if (!DeviceIoControl(hDevice, PACKET_POOL_REGISTER_IOCTL, &SendPool, sizeof(SEND_POOL_STRUCT),
+            &SendPool, sizeof(SEND_POOL_STRUCT), &bytesReturned, &os)) {
+            LastErrorStatus = GetLastError();
+            if (LastErrorStatus == ERROR_IO_PENDING) {
+                // Wait here (forever) for the Overlapped I/O to complete
+                if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                    LastErrorStatus = GetLastError();
+                    printf("%s: Send Pool Register Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                    status = LastErrorStatus;
+                }
+            }
+            else {
+                printf("%s: Send Pool Register failed, Error = %d\n", __func__, LastErrorStatus);
+                status = LastErrorStatus;
+            }
+        }
+        if (status == STATUS_SUCCESSFUL) {
+            *PoolId = SendPool.PoolId;
+        }
+    }
+    else {
+        printf("%s: DLL: Send Pool Register failed. No Packet Send Engine\n", __func__);
+        status = STATUS_INVALID_MODE;
+    }
+    return status;
+}
+
+/*! PacketReleaseSendPool
+ *
+ * \brief Send a PACKET_POOL_RELEASE_IOCTL call to the driver to unlock a
+ *        registered send pool.  Fails while packets from the pool are in flight.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param PoolId - Pool Id returned by PacketRegisterSendPool
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::PacketReleaseSendPool(INT32 EngineOffset,        // DMA Engine number offset to use
+    UINT32 PoolId)
+{
+    SEND_POOL_STRUCT SendPool;
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
+
+    os.hEvent = GetThreadEvent();
+    if (os.hEvent == NULL) {
+        return GetLastError();
+    }
+
+    if (EngineOffset < DmaInfo.PacketSendEngineCount) {
+        SendPool.EngineNum = DmaInfo.PacketSendEngine[EngineOffset];
+        SendPool.PoolId = PoolId;
+        SendPool.Length = 0;
+        SendPool.Reserved = 0;
+        SendPool.BufferAddress = 0;
+
+        if (!DeviceIoControl(hDevice, PACKET_POOL_RELEASE_IOCTL, &SendPool, sizeof(SEND_POOL_STRUCT), NULL, 0, &bytesReturned, &os)) {
             LastErrorStatus = GetLastError();
             if (LastErrorStatus == ERROR_IO_PENDING) {
                 // Wait here (forever) for the Overlapped I/O to complete
                 if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
                     LastErrorStatus = GetLastError();
-                    printf("%s: Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                    printf("%s: Send Pool Release Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
                     status = LastErrorStatus;
                 }
             }
             else {
-                printf("%s: failed, Error = %d\n", __func__, LastErrorStatus);
+                printf("%s: Send Pool Release failed for Pool %d, Error = %d\n", __func__, PoolId, LastErrorStatus);
                 status = LastErrorStatus;
             }
         }
-
-        if (status == STATUS_SUCCESSFUL) {
-            if (bytesReturned != sizeof(PACKET_RET_RECEIVE_STRUCT)) {
-                printf("%s: IOCTL returned invalid size (%d)\n", __func__, bytesReturned);
-                status = STATUS_INVALID_MODE;
-            }
-            else {
-                if (PacketRecvRet.RxToken != INVALID_RELEASE_TOKEN) {
-                    if (UserStatus != NULL) {
-                        *UserStatus = PacketRecvRet.UserStatus;
-                    }
-                    *BufferToken = PacketRecvRet.RxToken;
-#ifdef PLATFORM_X64
-                    * pBuffer = PacketRecvRet.Address;
-#else                           // 32 bit code
-                    * pBuffer = (UINT32)PacketRecvRet.Address;
-#endif                          // 64 Bit version
-                    * Length = PacketRecvRet.Length;
-                }
-                else {
-                    status = STATUS_INCOMPLETE;
-                }
-            }
-        }
     }
     else {
         status = STATUS_INVALID_MODE;
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
-/*! PacketReceiveEx -
+/*! PacketPoolSend
  *
- * \brief Send a PACKET_RECEIVE_IOCTL call to the driver and waits for a completion.
- *  Includes 64-bit User Status.
- * \param EngineOffset
- * \param UserStatus
- * \param BufferToken
- * \param Buffer
- * \param Length
+ * \brief Send a PACKET_POOL_SEND_IOCTL call to the driver and waits for a completion.
+ *        Sends one packet from a registered send pool, nothing is locked or
+ *        mapped per packet.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param PoolId - Pool Id returned by PacketRegisterSendPool
+ * \param UserControl - User Control value to set in the first DMA Descriptor
+ * \param BufferOffset - Offset of the packet in the pool
+ * \param Length - Length of the packet
  * \return Completion status.
  */
-UINT32 CDmaDriverDll::PacketReceiveEx(INT32 EngineOffset,       // DMA Engine number offset to use
-    PUINT64 UserStatus,       // User Status returned from the last DMA Descriptor
-    PUINT32 BufferToken, PVOID Buffer, PUINT32 Length)
+UINT32 CDmaDriverDll::PacketPoolSend(INT32 EngineOffset,       // DMA Engine number offset to use
+    UINT32 PoolId, UINT64 UserControl, UINT64 BufferOffset, UINT32 Length)
 {
-    return _PacketReceive(EngineOffset, UserStatus, BufferToken, Buffer, Length, TRUE);
-}
+    PACKET_POOL_SEND_STRUCT PoolSend;
+    OVERLAPPED os;          // OVERLAPPED structure for the operation
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
 
-/*! PacketReceiveNB -
-*
-* \brief Send a PACKET_RECEIVE_IOCTL call to the driver and waits for a completion.
-*   Includes 64-bit User Status.
-* \param EngineOffset
-* \param UserStatus
-* \param BufferToken
-* \param Buffer
-* \param Length
-* \return Completion status.
-*/
-UINT32 CDmaDriverDll::PacketReceiveNB(INT32 EngineOffset,       // DMA Engine number offset to use
-    PUINT64 UserStatus,       // User Status returned from the last DMA Descriptor
-    PUINT32 BufferToken, PVOID Buffer, PUINT32 Length)
-{
-    return _PacketReceive(EngineOffset, UserStatus, BufferToken, Buffer, Length, FALSE);
+    os.hEvent = GetThreadEvent();
+    if (os.hEvent == NULL) {
+        return GetLastError();
+    }
+
+    if (EngineOffset < DmaInfo.PacketSendEngineCount) {
+        PoolSend.EngineNum = DmaInfo.PacketSendEngine[EngineOffset];
+        PoolSend.PoolId = PoolId;
+        PoolSend.BufferOffset = BufferOffset;
+        PoolSend.UserControl = UserControl;
+        PoolSend.Length = Length;
+
+        if (!DeviceIoControl(hDevice, PACKET_POOL_SEND_IOCTL, &PoolSend, sizeof(PACKET_POOL_SEND_STRUCT), NULL, 0, &bytesReturned, &os)) {
+            LastErrorStatus = GetLastError();
+            if (LastErrorStatus == ERROR_IO_PENDING) {
+                // Wait here (forever) for the Overlapped I/O to complete
+                if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
+                    LastErrorStatus = GetLastError();
+                    printf("%s: Pool Send Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                    status = LastErrorStatus;
+                }
+            }
+            else {
+                printf("%s: Pool Send failed, Error = %d\n", __func__, LastErrorStatus);
+                status = LastErrorStatus;
+            }
+        }
+    }
+    else {
+        printf("%s: DLL: Pool Send failed. No Packet Send Engine\n", __func__);
+        status = STATUS_INVALID_MODE;
+    }
+    return status;
 }
 
-/*! PacketReturnReceive
+/*! _PacketCompletionRing
  *
- * \brief Send a PACKET_RECEIVE_IOCTL call to the driver to return a buffer token
- * \param EngineOffset
- * \param BufferToken
+ * \brief Send one of the completion ring IOCTLs to the driver for the
+ *        Packet Receive engine.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param IoctlCode - PACKET_COMP_RING_REGISTER/RELEASE/SYNC_IOCTL
+ * \param Ring - Ring to register, NULL otherwise
+ * \param NumEntries - Entries in Ring, 0 otherwise
  * \return Completion status.
  */
-UINT32 CDmaDriverDll::PacketReturnReceive(INT32 EngineOffset,   // DMA Engine number offset to use
-    PUINT32 BufferToken)
+UINT32 CDmaDriverDll::_PacketCompletionRing(INT32 EngineOffset,        // DMA Engine number offset to use
+    DWORD IoctlCode, PPACKET_COMP_RING_STRUCT Ring, UINT32 NumEntries)
 {
-    PACKET_RECEIVE_STRUCT PacketRecv;
+    COMP_RING_STRUCT CompRing;
     OVERLAPPED os;          // OVERLAPPED structure for the operation
     DWORD bytesReturned = 0;
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
     if (os.hEvent == NULL) {
         return GetLastError();
     }
 
     if (EngineOffset < DmaInfo.PacketRecvEngineCount) {
-        PacketRecv.EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
-        // Indicate Rx Token
-        PacketRecv.RxReleaseToken = *BufferToken;
+        CompRing.EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
+        CompRing.NumEntries = NumEntries;
+        CompRing.Length = (Ring != NULL) ? (UINT32)PACKET_COMP_RING_SIZE(NumEntries) : 0;
+        CompRing.Reserved = 0;
+        CompRing.BufferAddress = (UINT64)Ring;
 
-        // For the Packet Return we use the standard Packet Receive call but
-        // we do not specify a Out or Return buffer
-        if (!DeviceIoControl(hDevice, PACKET_RECEIVE_IOCTL, &PacketRecv, sizeof(PACKET_RECEIVE_STRUCT), NULL, 0, &bytesReturned, &os)) {
+        if (!DeviceIoControl(hDevice, IoctlCode, &CompRing, sizeof(COMP_RING_STRUCT), NULL, 0, &bytesReturned, &os)) {
             LastErrorStatus = GetLastError();
             if (LastErrorStatus == ERROR_IO_PENDING) {
                 // Wait here (forever) for the Overlapped I/O to complete
                 if (!GetOverlappedResult(hDevice, &os, &bytesReturned, TRUE)) {
                     LastErrorStatus = GetLastError();
-                    printf("%s: Packet Return Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
+                    printf("%s: Completion Ring Overlapped failed. Error = %d\n", __func__, LastErrorStatus);
                     status = LastErrorStatus;
                 }
             }
             else {
-                printf("%s: Packet Return Rx failed for Token %d. Error = %d\n", __func__, PacketRecv.RxReleaseToken, LastErrorStatus);
+                printf("%s: Completion Ring IOCTL 0x%x failed, Error = %d\n", __func__, IoctlCode, LastErrorStatus);
                 status = LastErrorStatus;
             }
         }
     }
     else {
+        printf("%s: DLL: Completion Ring failed. No Packet Receive Engine\n", __func__);
         status = STATUS_INVALID_MODE;
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
+/*! PacketRegisterCompletionRing
+ *
+ * \brief Send a PACKET_COMP_RING_REGISTER_IOCTL call to the driver.  The
+ *        driver locks Ring and fills it with received packets until
+ *        PacketReleaseCompletionRing is called.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param Ring - Ring of PACKET_COMP_RING_SIZE(NumEntries) bytes
+ * \param NumEntries - Entries in Ring, a power of 2
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::PacketRegisterCompletionRing(INT32 EngineOffset, // DMA Engine number offset to use
+    PPACKET_COMP_RING_STRUCT Ring, UINT32 NumEntries)
+{
+    if ((Ring == NULL) || (NumEntries == 0)) {
+        return STATUS_BAD_PARAMETER;
+    }
+    return _PacketCompletionRing(EngineOffset, PACKET_COMP_RING_REGISTER_IOCTL, Ring, NumEntries);
+}
+
+/*! PacketReleaseCompletionRing
+ *
+ * \brief Send a PACKET_COMP_RING_RELEASE_IOCTL call to the driver to unlock
+ *        the completion ring.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::PacketReleaseCompletionRing(INT32 EngineOffset)
+{
+    return _PacketCompletionRing(EngineOffset, PACKET_COMP_RING_RELEASE_IOCTL, NULL, 0);
+}
+
+/*! PacketSyncCompletionRing
+ *
+ * \brief Send a PACKET_COMP_RING_SYNC_IOCTL call to the driver to have the
+ *        consumed entries taken back and the ring filled without waiting
+ *        for an interrupt.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::PacketSyncCompletionRing(INT32 EngineOffset)
+{
+    return _PacketCompletionRing(EngineOffset, PACKET_COMP_RING_SYNC_IOCTL, NULL, 0);
+}
+
 /*! PacketReceives
  *
  * \brief Send a PACKET_RECEIVES_IOCTL call to the driver and waits for a completion
@@ -846,7 +1744,7 @@ UINT32 CDmaDriverDll::PacketReceives(INT32 EngineOffset,        // DMA Engine nu
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
     if (os.hEvent == NULL) {
         return GetLastError();
     }
@@ -884,7 +1782,6 @@ UINT32 CDmaDriverDll::PacketReceives(INT32 EngineOffset,        // DMA Engine nu
     else {
         status = STATUS_INVALID_MODE;
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
@@ -910,7 +1807,7 @@ UINT32 CDmaDriverDll::PacketWriteEx(INT32 EngineOffset, UINT64 UserControl, UINT
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
     if (os.hEvent == NULL) {
         return GetLastError();
     }
@@ -950,7 +1847,6 @@ UINT32 CDmaDriverDll::PacketWriteEx(INT32 EngineOffset, UINT64 UserControl, UINT
         printf("%s: DLL: Packet Write failed. No Packet Send Engine\n", __func__);
         status = STATUS_INVALID_MODE;
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
@@ -977,7 +1873,7 @@ UINT CDmaDriverDll::PacketReadEx(INT32 EngineOffset,
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
     if (os.hEvent == NULL) {
         return GetLastError();
     }
@@ -1023,10 +1919,313 @@ UINT CDmaDriverDll::PacketReadEx(INT32 EngineOffset,
         printf("%s: DLL: Packet Read failed. No Packet Read Engine\n", __func__);
         status = STATUS_INVALID_MODE;
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
+//-------------------------------------------------------------------------
+// Asynchronous Packet Mode Function calls
+//-------------------------------------------------------------------------
+
+/*! _AsyncSubmit
+ *
+ * \brief Sends an IOCTL on the asynchronous handle without waiting for it.
+ *  Whether it pends or completes at once, the completion is queued to the
+ *  completion port.
+ * \param IoctlCode - IOCTL to send
+ * \param pIn - Input structure, copied by the system before the call returns
+ * \param InSize
+ * \param pOut - Output buffer, must stay valid until the completion
+ * \param OutSize
+ * \param pAsync - Operation, Operation and Length must be set
+ * \return STATUS_SUCCESSFUL if the operation is in flight, an error if it
+ *  was refused, then there is no completion.
+ */
+UINT32 CDmaDriverDll::_AsyncSubmit(DWORD IoctlCode, PVOID pIn, DWORD InSize, PVOID pOut, DWORD OutSize, PDMA_ASYNC_STRUCT pAsync)
+{
+    DWORD LastErrorStatus = 0;
+
+    // Refused once DisconnectFromBoard has started draining the port
+    if ((hCompletionPort == NULL) || !AttachedToDriver) {
+        return STATUS_HANDLE_INVALID;
+    }
+    memset(&pAsync->Overlapped, 0, sizeof(OVERLAPPED));
+    pAsync->Status = STATUS_INCOMPLETE;
+
+    InterlockedIncrement(&AsyncOutstanding);
+    if (!DeviceIoControl(hAsyncDevice, IoctlCode, pIn, InSize, pOut, OutSize, NULL, &pAsync->Overlapped)) {
+        LastErrorStatus = GetLastError();
+        if (LastErrorStatus != ERROR_IO_PENDING) {
+            // Refused, nothing is queued to the port
+            InterlockedDecrement(&AsyncOutstanding);
+            printf("%s: IOCTL call failed. Error = %d\n", __func__, LastErrorStatus);
+            return LastErrorStatus;
+        }
+    }
+    return STATUS_SUCCESSFUL;
+}
+
+/*! _AsyncComplete
+ *
+ * \brief Fill in the results of an operation taken from the completion port
+ *  and run its Callback.
+ * \param pOverlapped - Overlapped of the operation
+ * \param bytesReturned - Bytes the driver returned
+ * \param status - STATUS_SUCCESSFUL, or the error the operation failed with
+ * \return The completed operation
+ */
+PDMA_ASYNC_STRUCT CDmaDriverDll::_AsyncComplete(LPOVERLAPPED pOverlapped, DWORD bytesReturned, UINT32 status)
+{
+    PDMA_ASYNC_STRUCT pAsync;
+
+    pAsync = CONTAINING_RECORD(pOverlapped, DMA_ASYNC_STRUCT, Overlapped);
+
+    switch (pAsync->Operation) {
+    case DMA_ASYNC_PACKET_WRITE:
+        // Make sure we returned something useful
+        if ((status == STATUS_SUCCESSFUL) && (bytesReturned != pAsync->Length)) {
+            printf("%s: Packet Write failed. Return size does not equal request (Ret=%d)\n", __func__, bytesReturned);
+            status = STATUS_INCOMPLETE;
+        }
+        pAsync->Length = bytesReturned;
+        break;
+    case DMA_ASYNC_PACKET_READ:
+        pAsync->UserStatus = 0;
+        pAsync->Length = 0;
+        if (status == STATUS_SUCCESSFUL) {
+            if (bytesReturned == sizeof(PACKET_RET_READ_STRUCT)) {
+                pAsync->UserStatus = pAsync->Ret.Read.UserStatus;
+                pAsync->Length = pAsync->Ret.Read.Length;
+            }
+            else {
+                printf("%s: Packet Read failed. Return structure size is mismatched (Ret=%d)\n", __func__, bytesReturned);
+                status = STATUS_INCOMPLETE;
+            }
+        }
+        break;
+    case DMA_ASYNC_PACKET_RECEIVE:
+        pAsync->BufferToken = INVALID_RELEASE_TOKEN;
+        pAsync->UserStatus = 0;
+        pAsync->Buffer = NULL;
+        pAsync->Length = 0;
+        if (status == STATUS_SUCCESSFUL) {
+            if ((bytesReturned == sizeof(PACKET_RET_RECEIVE_STRUCT)) && (pAsync->Ret.Receive.RxToken != INVALID_RELEASE_TOKEN)) {
+                pAsync->BufferToken = pAsync->Ret.Receive.RxToken;
+                pAsync->UserStatus = pAsync->Ret.Receive.UserStatus;
+                pAsync->Buffer = (PVOID)(ULONG_PTR)pAsync->Ret.Receive.Address;
+                pAsync->Length = pAsync->Ret.Receive.Length;
+            }
+            else {
+                status = STATUS_INCOMPLETE;
+            }
+        }
+        break;
+    default:
+        pAsync->Length = bytesReturned;
+        break;
+    }
+    pAsync->Status = status;
+    InterlockedDecrement(&AsyncOutstanding);
+
+    if (pAsync->Callback != NULL) {
+        pAsync->Callback(pAsync);
+    }
+    return pAsync;
+}
+
+/*! PacketSendAsync
+ *
+ * \brief Queue a PACKET_SEND_IOCTL call to the driver without waiting for it.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param UserControl - User Control to set in the first DMA Descriptor
+ * \param CardOffset
+ * \param Buffer
+ * \param Length
+ * \param pAsync - Operation, returned by AsyncWait
+ * \return Submit status.
+ */
+UINT32 CDmaDriverDll::PacketSendAsync(INT32 EngineOffset, UINT64 UserControl, UINT64 CardOffset, PUINT8 Buffer, UINT32 Length, PDMA_ASYNC_STRUCT pAsync)
+{
+    PACKET_SEND_STRUCT PacketSend;
+
+    if (pAsync == NULL) {
+        return STATUS_BAD_PARAMETER;
+    }
+    if (EngineOffset >= DmaInfo.PacketSendEngineCount) {
+        printf("%s: DLL: Packet Send failed. No Packet Send Engine\n", __func__);
+        return STATUS_INVALID_MODE;
+    }
+    // Select a Packet Send DMA Engine
+    PacketSend.EngineNum = DmaInfo.PacketSendEngine[EngineOffset];
+    PacketSend.CardOffset = CardOffset;
+    PacketSend.Length = Length;
+    PacketSend.UserControl = UserControl;
+
+    pAsync->Operation = DMA_ASYNC_PACKET_SEND;
+    pAsync->Length = Length;
+    return _AsyncSubmit(PACKET_SEND_IOCTL, &PacketSend, sizeof(PACKET_SEND_STRUCT), Buffer, Length, pAsync);
+}
+
+/*! PacketReceiveAsync
+ *
+ * \brief Queue a blocking PACKET_RECEIVE_IOCTL call to the driver without
+ *  waiting for it.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param BufferToken - Token of a buffer to return first, INVALID_RELEASE_TOKEN for none
+ * \param pAsync - Operation, returned by AsyncWait
+ * \return Submit status.
+ */
+UINT32 CDmaDriverDll::PacketReceiveAsync(INT32 EngineOffset, UINT32 BufferToken, PDMA_ASYNC_STRUCT pAsync)
+{
+    PACKET_RECEIVE_STRUCT PacketRecv;
+
+    if (pAsync == NULL) {
+        return STATUS_BAD_PARAMETER;
+    }
+    if (EngineOffset >= DmaInfo.PacketRecvEngineCount) {
+        return STATUS_INVALID_MODE;
+    }
+    PacketRecv.EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
+    // Indicate Rx Token (if any)
+    PacketRecv.RxReleaseToken = BufferToken;
+    PacketRecv.Block = TRUE;
+
+    pAsync->Operation = DMA_ASYNC_PACKET_RECEIVE;
+    pAsync->Length = 0;
+    return _AsyncSubmit(PACKET_RECEIVE_IOCTL, &PacketRecv, sizeof(PACKET_RECEIVE_STRUCT), &pAsync->Ret.Receive, sizeof(PACKET_RET_RECEIVE_STRUCT), pAsync);
+}
+
+/*! PacketWriteAsync
+ *
+ * \brief Queue a PACKET_WRITE_IOCTL call to the driver without waiting for it.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param UserControl - User Control to set in the first DMA Descriptor
+ * \param CardOffset
+ * \param Mode - Control Mode Flags
+ * \param Buffer
+ * \param Length
+ * \param pAsync - Operation, returned by AsyncWait
+ * \return Submit status.
+ */
+UINT32 CDmaDriverDll::PacketWriteAsync(INT32 EngineOffset, UINT64 UserControl, UINT64 CardOffset, UINT32 Mode, PUINT8 Buffer, UINT32 Length,
+    PDMA_ASYNC_STRUCT pAsync)
+{
+    PACKET_WRITE_STRUCT sPacketWrite;
+
+    if (pAsync == NULL) {
+        return STATUS_BAD_PARAMETER;
+    }
+    if (EngineOffset >= DmaInfo.PacketSendEngineCount) {
+        printf("%s: DLL: Packet Write failed. No Packet Send Engine\n", __func__);
+        return STATUS_INVALID_MODE;
+    }
+    // Select a Packet Send DMA Engine
+    sPacketWrite.EngineNum = DmaInfo.PacketSendEngine[EngineOffset];
+    sPacketWrite.UserControl = UserControl;
+    sPacketWrite.ModeFlags = Mode;
+    sPacketWrite.CardOffset = CardOffset;
+    sPacketWrite.Length = Length;
+
+    pAsync->Operation = DMA_ASYNC_PACKET_WRITE;
+    pAsync->Length = Length;
+    return _AsyncSubmit(PACKET_WRITE_IOCTL, &sPacketWrite, sizeof(PACKET_WRITE_STRUCT), Buffer, Length, pAsync);
+}
+
+/*! PacketReadAsync
+ *
+ * \brief Queue a PACKET_READ_IOCTL call to the driver without waiting for it.
+ * \param EngineOffset - DMA Engine number offset to use
+ * \param CardOffset
+ * \param Mode - Control Mode Flags
+ * \param Buffer
+ * \param Length
+ * \param pAsync - Operation, returned by AsyncWait
+ * \return Submit status.
+ */
+UINT32 CDmaDriverDll::PacketReadAsync(INT32 EngineOffset, UINT64 CardOffset, UINT32 Mode, PUINT8 Buffer, UINT32 Length, PDMA_ASYNC_STRUCT pAsync)
+{
+    PACKET_READ_STRUCT sPacketRead;
+
+    if (pAsync == NULL) {
+        return STATUS_BAD_PARAMETER;
+    }
+    if (EngineOffset >= DmaInfo.PacketRecvEngineCount) {
+        printf("%s: DLL: Packet Read failed. No Packet Read Engine\n", __func__);
+        return STATUS_INVALID_MODE;
+    }
+    // Select a Packet Read DMA Engine
+    sPacketRead.EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
+    sPacketRead.CardOffset = CardOffset;
+    sPacketRead.ModeFlags = Mode;
+    sPacketRead.BufferAddress = (UINT64)Buffer;
+    sPacketRead.Length = Length;
+
+    pAsync->Operation = DMA_ASYNC_PACKET_READ;
+    pAsync->Length = Length;
+    return _AsyncSubmit(PACKET_READ_IOCTL, &sPacketRead, sizeof(PACKET_READ_STRUCT), &pAsync->Ret.Read, sizeof(PACKET_RET_READ_STRUCT), pAsync);
+}
+
+/*! AsyncWait
+ *
+ * \brief Take the next completion from the completion port, fill in the
+ *  results of its operation and run its Callback.
+ * \param dwTimeoutMilliSec - INFINITE to wait forever, 0 to poll
+ * \param ppAsync - Returned completed operation, NULL on timeout
+ * \return STATUS_SUCCESSFUL if an operation completed, STATUS_INCOMPLETE
+ *  on timeout, or an error.
+ */
+UINT32 CDmaDriverDll::AsyncWait(DWORD dwTimeoutMilliSec, PDMA_ASYNC_STRUCT * ppAsync)
+{
+    LPOVERLAPPED pOverlapped = NULL;
+    ULONG_PTR CompletionKey = 0;
+    DWORD bytesReturned = 0;
+    DWORD LastErrorStatus = 0;
+    UINT32 status = STATUS_SUCCESSFUL;
+
+    if (ppAsync == NULL) {
+        return STATUS_BAD_PARAMETER;
+    }
+    *ppAsync = NULL;
+    if (hCompletionPort == NULL) {
+        return STATUS_HANDLE_INVALID;
+    }
+
+    if (!GetQueuedCompletionStatus(hCompletionPort, &bytesReturned, &CompletionKey, &pOverlapped, dwTimeoutMilliSec)) {
+        LastErrorStatus = GetLastError();
+        if (pOverlapped == NULL) {
+            // Nothing was taken from the port
+            return (LastErrorStatus == WAIT_TIMEOUT) ? STATUS_INCOMPLETE : LastErrorStatus;
+        }
+        // The operation itself failed
+        status = (LastErrorStatus == ERROR_OPERATION_ABORTED) ? STATUS_OPERATION_CANCELLED : LastErrorStatus;
+    }
+    *ppAsync = _AsyncComplete(pOverlapped, bytesReturned, status);
+    return STATUS_SUCCESSFUL;
+}
+
+/*! AsyncCancel
+ *
+ * \brief Cancel the asynchronous operations that have not completed, each
+ *  still completes through AsyncWait.
+ * \return Completion status.
+ */
+UINT32 CDmaDriverDll::AsyncCancel(VOID)
+{
+    DWORD LastErrorStatus = 0;
+
+    if (hAsyncDevice == INVALID_HANDLE_VALUE) {
+        return STATUS_HANDLE_INVALID;
+    }
+    if (!CancelIoEx(hAsyncDevice, NULL)) {
+        LastErrorStatus = GetLastError();
+        // ERROR_NOT_FOUND, nothing was in flight
+        if (LastErrorStatus != ERROR_NOT_FOUND) {
+            printf("%s: CancelIoEx failed. Error = %d\n", __func__, LastErrorStatus);
+            return LastErrorStatus;
+        }
+    }
+    return STATUS_SUCCESSFUL;
+}
+
 //-------------------------------------------------------------------------
 // Common Packet Mode Function calls
 //-------------------------------------------------------------------------
@@ -1047,12 +2246,13 @@ UINT32 CDmaDriverDll::SetupPacket(INT32 EngineOffset,   // DMA Engine number off
     PUINT8 Buffer, PUINT32 BufferSize, PUINT32 MaxPacketSize, INT32 PacketModeSetting, INT32 NumberDescriptors)
 {
     BUF_ALLOC_STRUCT BufAlloc;
+    INT32 PacketMode = PacketModeSetting & ~PACKET_ALLOC_FLAGS;
     OVERLAPPED os;          // OVERLAPPED structure for the operation
     DWORD bytesReturned = 0;
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
     if (os.hEvent == NULL) {
         return GetLastError();
     }
@@ -1061,7 +2261,7 @@ UINT32 CDmaDriverDll::SetupPacket(INT32 EngineOffset,   // DMA Engine number off
         // Set the DMA Engine we want to allocate for
         BufAlloc.EngineNum = DmaInfo.PacketRecvEngine[EngineOffset];
 
-        if ((PacketModeSetting == PACKET_MODE_FIFO) || (PacketModeSetting == PACKET_MODE_STREAMING)) {
+        if ((PacketMode == PACKET_MODE_FIFO) || (PacketMode == PACKET_MODE_STREAMING)) {
             // This is an application allocated the buffer
             BufAlloc.AllocationMode = PacketModeSetting;
             // Allocate the size of...
@@ -1087,9 +2287,9 @@ UINT32 CDmaDriverDll::SetupPacket(INT32 EngineOffset,   // DMA Engine number off
                 }
             }
         }
-        else if (PacketModeSetting == PACKET_MODE_ADDRESSABLE) {
+        else if (PacketMode == PACKET_MODE_ADDRESSABLE) {
             // Setup in Addressable Packet mode
-            BufAlloc.AllocationMode = PacketModeSetting;
+            BufAlloc.AllocationMode = PacketMode;
             BufAlloc.Length = 0;
             BufAlloc.MaxPacketSize = 0;
             BufAlloc.NumberDescriptors = NumberDescriptors;
@@ -1119,7 +2319,6 @@ UINT32 CDmaDriverDll::SetupPacket(INT32 EngineOffset,   // DMA Engine number off
         printf("%s: No Packet Mode DMA Engines found\n", __func__);
         status = STATUS_INVALID_MODE;
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
@@ -1138,7 +2337,7 @@ UINT32 CDmaDriverDll::ReleasePacketBuffers(INT32 EngineOffset)
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_INVALID_MODE;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
     if (os.hEvent == NULL) {
         return GetLastError();
     }
@@ -1175,7 +2374,6 @@ UINT32 CDmaDriverDll::ReleasePacketBuffers(INT32 EngineOffset)
             status = STATUS_SUCCESSFUL;
         }
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
@@ -1215,7 +2413,7 @@ UINT32 CDmaDriverDll::ResetDMAEngine(INT32 EngineOffset, UINT32 TypeDirection)
     }
 
     if (ResetDMA.EngineNum != -1) {
-        os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        os.hEvent = GetThreadEvent();
         if (os.hEvent == NULL) {
             return GetLastError();
         }
@@ -1240,7 +2438,6 @@ UINT32 CDmaDriverDll::ResetDMAEngine(INT32 EngineOffset, UINT32 TypeDirection)
         else {
             status = STATUS_SUCCESSFUL;
         }
-        CloseHandle(os.hEvent);
     }
     else {
         printf("%s: Reset DMA called with bad Engine offset.\n", __func__);
@@ -1271,7 +2468,7 @@ UINT32 CDmaDriverDll::UserIRQWait(DWORD dwTimeoutMilliSec       // Timeout in ms
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
 
     UIRQWait.dwTimeoutMilliSec = dwTimeoutMilliSec;
 
@@ -1290,7 +2487,6 @@ UINT32 CDmaDriverDll::UserIRQWait(DWORD dwTimeoutMilliSec       // Timeout in ms
             status = LastErrorStatus;
         }
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
@@ -1307,7 +2503,7 @@ UINT32 CDmaDriverDll::UserIRQCancel(VOID)
     DWORD LastErrorStatus = 0;
     UINT32 status = STATUS_SUCCESSFUL;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
 
     // Send User IRQ Cancel message
     if (!DeviceIoControl(hDevice, USER_IRQ_CANCEL_IOCTL, NULL, 0, NULL, 0, &bytesReturned, &os)) {
@@ -1324,7 +2520,6 @@ UINT32 CDmaDriverDll::UserIRQCancel(VOID)
             status = LastErrorStatus;
         }
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
@@ -1345,7 +2540,7 @@ UINT32 CDmaDriverDll::UserIRQControl(UINT32 userIrqEnable)
 
     userIrqControl.dwEnableUserIRQ = userIrqEnable;
 
-    os.hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    os.hEvent = GetThreadEvent();
 
     // Send User IRQ Cancel message
     if (!DeviceIoControl(hDevice, USER_IRQ_CONTROL_IOCTL, &userIrqControl, sizeof(userIrqControl), NULL, 0, &bytesReturned, &os)) {
@@ -1362,7 +2557,6 @@ UINT32 CDmaDriverDll::UserIRQControl(UINT32 userIrqEnable)
             status = LastErrorStatus;
         }
     }
-    CloseHandle(os.hEvent);
     return status;
 }
 
@@ -90,7 +90,8 @@ PM40DRIVERDLL_API UINT32 ConnectToBoard(UINT32 board,    // Board to target
  *
  * \brief Disconnects from a board.
  *  Cleanup any global data structures that have been created.
- *  Does not delete the board class.
+ *  Does not delete the board class.  Asynchronous operations still in
+ *  flight are cancelled and waited for, their Callbacks run on this thread.
  * \return STATUS_SUCCESSFUL
  */
 PM40DRIVERDLL_API UINT32 DisconnectFromBoard(UINT32 board        // Board to target
@@ -182,6 +183,89 @@ PM40DRIVERDLL_API UINT32 GetDmaPerf(UINT32 board,        // Board number to targ
     PDMA_STAT_STRUCT Status      // Returned performance metrics
 );
 
+/*! SetInterruptCoalescing
+*
+* \brief Sets the completion interrupt coalescing of a DMA Engine.
+*  With PacketCount > 1 only every PacketCount packets interrupt and the
+*  driver polls for the rest every TimeoutUs.  The effective settings and
+*  the interrupts in the last second are returned in pCoalesce.
+* \param board
+* \param EngineOffset
+* \param TypeDirection
+* \param pCoalesce
+* \return DriverList[board]->SetInterruptCoalescing(EngineOffset, TypeDirection, pCoalesce);
+*/
+PM40DRIVERDLL_API UINT32 SetInterruptCoalescing(UINT32 board,    // Board number to target
+    INT32 EngineOffset,  // DMA Engine number offset to use
+    UINT32 TypeDirection,        // DMA Type (Block / Packet) & Direction Flags
+    PINT_COALESCE_STRUCT pCoalesce       // Settings, returns the effective ones
+);
+
+/*! SetPollMode
+*
+* \brief Sets the receive poll mode of a C2S Packet DMA Engine.
+*  With Budget != 0 the engine interrupt stays masked while the ring has
+*  completed packets and the driver completes up to Budget packets per timer
+*  pass, it is enabled again after IdlePasses passes find the ring empty.
+*  The passes stop while no PacketReceive is waiting for a packet.
+*  Budget 0 restores interrupt mode.
+* \param board
+* \param EngineOffset
+* \param pPollMode
+* \return DriverList[board]->SetPollMode(EngineOffset, pPollMode);
+*/
+PM40DRIVERDLL_API UINT32 SetPollMode(UINT32 board,       // Board number to target
+    INT32 EngineOffset,  // DMA Engine number offset to use
+    PPOLL_MODE_STRUCT pPollMode  // Settings, returns the effective ones
+);
+
+/*! GetEngineAffinity
+*
+* \brief Gets the processor and NUMA node a DMA Engine was placed on.
+*  The placement is set with the driver's InterruptAffinity<n> registry
+*  values.
+* \param board
+* \param EngineOffset
+* \param TypeDirection
+* \param pAffinity
+* \return DriverList[board]->GetEngineAffinity(EngineOffset, TypeDirection, pAffinity);
+*/
+PM40DRIVERDLL_API UINT32 GetEngineAffinity(UINT32 board,         // Board number to target
+    INT32 EngineOffset,  // DMA Engine number offset to use
+    UINT32 TypeDirection,        // DMA Type (Block / Packet) & Direction Flags
+    PENGINE_AFFINITY_STRUCT pAffinity    // Returned placement
+);
+
+/*! AllocEngineBuffer
+*
+* \brief Allocates a data buffer on the NUMA node of a DMA Engine, for use
+*  with SetupPacket, PacketSendPoolRegister etc.  Release it with
+*  FreeEngineBuffer.  Sizes of a large page or more use large pages when the
+*  account holds "Lock pages in memory" (SeLockMemoryPrivilege).
+*  Use these buffers for a FIFO receive pool, pass the largest packet size
+*  as MaxPacketSize and or PACKET_ALLOC_MAX_PACKET_DESC into the PacketMode.
+*  Then the driver covers the pool with descriptors of MaxPacketSize instead
+*  of one per 4K page.
+* \param board
+* \param EngineOffset
+* \param TypeDirection
+* \param Size
+* \return Buffer address, NULL on failure
+*/
+PM40DRIVERDLL_API PVOID AllocEngineBuffer(UINT32 board,  // Board number to target
+    INT32 EngineOffset,  // DMA Engine number offset to use
+    UINT32 TypeDirection,        // DMA Type (Block / Packet) & Direction Flags
+    SIZE_T Size          // Bytes to allocate
+);
+
+/*! FreeEngineBuffer
+*
+* \brief Releases a buffer from AllocEngineBuffer.
+* \param Buffer
+* \return none
+*/
+PM40DRIVERDLL_API VOID FreeEngineBuffer(PVOID Buffer);
+
 /*! WritePCIConfig
 *
 * \brief Sends a WRITE_PCI_CONFIG_IOCTL call to the driver.
@@ -263,6 +347,88 @@ PM40DRIVERDLL_API UINT32 DoMem(UINT32 board,     // Board number to target
 );
 
 
+/*! MapBar
+*
+* \brief Maps a window of a memory BAR into the application for direct
+*  register access, through BarRead32 / BarWrite32 or the returned pointer
+*  (use volatile 32 bit accesses).  Needs the AllowBarMapping registry value
+*  of the driver.  The window is page aligned and never covers the DMA
+*  Engine registers.  It is unmapped by UnmapBar or DisconnectFromBoard.
+* \param board
+* \param BarNum
+* \param CardOffset - Start of the window in the BAR, page aligned
+* \param Length - Length of the window, 0 for the rest of the BAR
+* \param ppWindow - Returned address of the window (optional)
+* \return Status
+*/
+PM40DRIVERDLL_API UINT32 MapBar(UINT32 board,    // Board number to target
+    UINT32 BarNum,    // Base Address Register (BAR) to map
+    UINT64 CardOffset,        // Offset in BAR of the window
+    UINT64 Length,    // Byte length of the window
+    PVOID * ppWindow  // Returned window address
+);
+
+/*! UnmapBar
+*
+* \brief Unmaps the window MapBar mapped.
+* \param board
+* \param BarNum
+* \return Status
+*/
+PM40DRIVERDLL_API UINT32 UnmapBar(UINT32 board,  // Board number to target
+    UINT32 BarNum     // Base Address Register (BAR) to unmap
+);
+
+/*! BarRead32
+*
+* \brief Reads a 32 bit register, a load when CardOffset is inside the
+*  window MapBar mapped, a DoMem call otherwise.
+* \param board
+* \param BarNum
+* \param CardOffset
+* \param Value
+* \return Status
+*/
+PM40DRIVERDLL_API UINT32 BarRead32(UINT32 board, // Board number to target
+    UINT32 BarNum,    // Base Address Register (BAR) to access
+    UINT64 CardOffset,        // Offset in BAR of the register
+    PUINT32 Value     // Returned register value
+);
+
+/*! BarWrite32
+*
+* \brief Writes a 32 bit register, a store when CardOffset is inside the
+*  window MapBar mapped, a DoMem call otherwise.
+* \param board
+* \param BarNum
+* \param CardOffset
+* \param Value
+* \return Status
+*/
+PM40DRIVERDLL_API UINT32 BarWrite32(UINT32 board,        // Board number to target
+    UINT32 BarNum,    // Base Address Register (BAR) to access
+    UINT64 CardOffset,        // Offset in BAR of the register
+    UINT32 Value      // Value to write
+);
+
+/*! DoMemVector
+*
+* \brief Sends a DO_MEM_VECTOR_IOCTL call to the driver.
+*  Does NumOps register accesses (MEM_OP_READ, MEM_OP_WRITE, MEM_OP_RMW
+*  read-modify-write or MEM_OP_POLL poll until the masked value matches),
+*  anywhere in any BAR, in order in one call instead of one DoMem call
+*  each.  Each operation's Value returns the register value read.  The
+*  MEM_OP_POLL Timeouts of one call add up to MEM_OP_MAX_POLL_TIMEOUT at
+*  most, and the DMA Engine registers can only be read or polled.
+* \param board
+* \param pMemVector - Operations, DO_MEM_VECTOR_SIZE(NumOps) bytes
+* \return Status, STATUS_INCOMPLETE if a MEM_OP_POLL timed out, RetNumOps
+*  then is its index.
+*/
+PM40DRIVERDLL_API UINT32 DoMemVector(UINT32 board,       // Board number to target
+    PDO_MEM_VECTOR_STRUCT pMemVector  // Operations to do
+);
+
 PM40DRIVERDLL_API UINT32 Bar0Write(UINT nAddrs,
     PUINT32 nValue
 );
@@ -346,6 +512,21 @@ PM40DRIVERDLL_API UINT32 PacketReturnReceive(UINT32 board,       // Board number
     PUINT32 BufferToken // Token for the buffer to return
 );
 
+/*! PacketReturnReceives
+*
+* \brief Returns several Recieve buffer tokens back to the driver in one call.
+*  With PACKET_RETURN_THROUGH set in Flags, Tokens[0] is returned along with
+*  every token received before it.  RetNumTokens gives the number returned:
+* \param board
+* \param EngineOffset
+* \param pReturnRecvs
+* \return DriverList[board]->PacketReturnReceives(EngineOffset, pReturnRecvs);
+*/
+PM40DRIVERDLL_API UINT32 PacketReturnReceives(UINT32 board,      // Board number to target
+    INT32 EngineOffset, // DMA Engine number offset to use
+    PPACKET_RETURN_RECVS_STRUCT pReturnRecvs        // Tokens to return
+);
+
 /*! PacketReceives
 *
 * \brief Multiple Packet receive function for use with FIFO Packet DMA only:
@@ -397,6 +578,126 @@ PM40DRIVERDLL_API UINT32 PacketSendEx(UINT32 board,      // Board to target
     UINT32 Length      // Length of the send packet
 );
 
+/*! PacketSends
+*
+* \brief Send multiple packets from 'Buffer' with one request.  Each entry of
+*  pPacketSends gives the offset in Buffer, length and User Control of one
+*  packet.  Returns with the number of packets sent in RetNumEntries and the
+*  length and status of each.  Use for FIFO Packet DMA only:
+* \param board
+* \param EngineOffset
+* \param Buffer
+* \param Length
+* \param pPacketSends
+* \return DriverList[board]->PacketSends(EngineOffset, Buffer, Length, pPacketSends);
+*/
+PM40DRIVERDLL_API UINT32 PacketSends(UINT32 board,       // Board to target
+    INT32 EngineOffset,        // DMA Engine number offset to use
+    PUINT8 Buffer,     // Pointer to the buffer holding the packets
+    UINT32 Length,     // Length of the buffer
+    PPACKET_SENDS_STRUCT pPacketSends  // Pointer to Packet Sends struct
+);
+
+/*! PacketRegisterSendPool
+*
+* \brief Register 'Buffer' as a send pool of the Packet Send engine.  The
+*  driver locks and maps the buffer once, PacketPoolSend then sends packets
+*  from it without a lock and map per packet.  Use for FIFO Packet DMA only:
+* \param board
+* \param EngineOffset
+* \param Buffer
+* \param Length
+* \param PoolId
+* \return DriverList[board]->PacketRegisterSendPool(EngineOffset, Buffer, Length, PoolId);
+*/
+PM40DRIVERDLL_API UINT32 PacketRegisterSendPool(UINT32 board,      // Board to target
+    INT32 EngineOffset,        // DMA Engine number offset to use
+    PUINT8 Buffer,     // Pointer to the buffer to register
+    UINT32 Length,     // Length of the buffer
+    PUINT32 PoolId     // Returned Pool Id
+);
+
+/*! PacketReleaseSendPool
+*
+* \brief Unlock a send pool.  Fails while packets sent from it are in flight.
+*  DisconnectFromBoard releases the pools still registered:
+* \param board
+* \param EngineOffset
+* \param PoolId
+* \return DriverList[board]->PacketReleaseSendPool(EngineOffset, PoolId);
+*/
+PM40DRIVERDLL_API UINT32 PacketReleaseSendPool(UINT32 board,       // Board to target
+    INT32 EngineOffset,        // DMA Engine number offset to use
+    UINT32 PoolId      // Pool Id returned by PacketRegisterSendPool
+);
+
+/*! PacketPoolSend
+*
+* \brief Send one packet of 'Length' bytes starting at 'BufferOffset' in a
+*  registered send pool:
+* \param board
+* \param EngineOffset
+* \param PoolId
+* \param UserControl
+* \param BufferOffset
+* \param Length
+* \return DriverList[board]->PacketPoolSend(EngineOffset, PoolId, UserControl, BufferOffset, Length);
+*/
+PM40DRIVERDLL_API UINT32 PacketPoolSend(UINT32 board,      // Board to target
+    INT32 EngineOffset,        // DMA Engine number offset to use
+    UINT32 PoolId,     // Pool Id returned by PacketRegisterSendPool
+    UINT64 UserControl,        // User Control to set in the first DMA Descriptor
+    UINT64 BufferOffset,       // Offset of the packet in the pool
+    UINT32 Length      // Length of the packet
+);
+
+/*! PacketRegisterCompletionRing
+*
+* \brief Register 'Ring' as the completion ring of the Packet Receive engine.
+*  The driver fills Ring->Entries with received packets and advances
+*  Ring->ProducerIndex from its DPC.  The application reads the entries up
+*  to ProducerIndex and advances Ring->ConsumerIndex when it is done with
+*  the packets, which gives their buffers back to the engine.  Both indexes
+*  are free running, entry (Index & (NumEntries - 1)) holds the packet.
+*  PacketReceive and PacketReceives are refused while a ring is registered.
+*  Use after SetupPacketMode, for FIFO Packet DMA only:
+* \param board
+* \param EngineOffset
+* \param Ring
+* \param NumEntries
+* \return DriverList[board]->PacketRegisterCompletionRing(EngineOffset, Ring, NumEntries);
+*/
+PM40DRIVERDLL_API UINT32 PacketRegisterCompletionRing(UINT32 board,        // Board to target
+    INT32 EngineOffset,        // DMA Engine number offset to use
+    PPACKET_COMP_RING_STRUCT Ring,     // Ring of PACKET_COMP_RING_SIZE(NumEntries) bytes
+    UINT32 NumEntries  // Number of entries, a power of 2
+);
+
+/*! PacketReleaseCompletionRing
+*
+* \brief Unlock the completion ring.  Packets not yet consumed are given
+*  back to the engine:
+* \param board
+* \param EngineOffset
+* \return DriverList[board]->PacketReleaseCompletionRing(EngineOffset);
+*/
+PM40DRIVERDLL_API UINT32 PacketReleaseCompletionRing(UINT32 board, // Board to target
+    INT32 EngineOffset         // DMA Engine number offset to use
+);
+
+/*! PacketSyncCompletionRing
+*
+* \brief Have the driver take back the consumed entries and fill the ring
+*  now.  Only needed when the ring is found empty after every entry was
+*  consumed, the driver otherwise does this on the next interrupt:
+* \param board
+* \param EngineOffset
+* \return DriverList[board]->PacketSyncCompletionRing(EngineOffset);
+*/
+PM40DRIVERDLL_API UINT32 PacketSyncCompletionRing(UINT32 board,    // Board to target
+    INT32 EngineOffset         // DMA Engine number offset to use
+);
+
 //**************************************************
 // Addressable Packet Mode Function calls
 //**************************************************
@@ -485,6 +786,177 @@ PM40DRIVERDLL_API UINT32 PacketWriteEx(UINT32 board,     // Board to target
     UINT32 Length     // Length of data packet
 );
 
+//**************************************************
+// Asynchronous Packet Mode Function calls
+//**************************************************
+
+#ifdef WIN32
+
+/*! \note
+ * The asynchronous calls queue a request to the driver and return without
+ * waiting for it.  Each completion is delivered through the board's I/O
+ * completion port, and AsyncWait takes it from there.  Keep enough sends
+ * or receives in flight, and resubmit each one from its completion, to
+ * keep a DMA Engine busy from a single thread.
+ */
+
+// DMA_ASYNC_STRUCT Operation values
+#define DMA_ASYNC_PACKET_SEND       1
+#define DMA_ASYNC_PACKET_RECEIVE    2
+#define DMA_ASYNC_PACKET_WRITE      3
+#define DMA_ASYNC_PACKET_READ       4
+
+typedef struct _DMA_ASYNC_STRUCT DMA_ASYNC_STRUCT, * PDMA_ASYNC_STRUCT;
+
+/*! PDMA_ASYNC_CALLBACK
+*
+* \brief Completion callback, run by AsyncWait on the thread that took the
+*  completion.  It may resubmit or free the operation.
+*/
+typedef VOID(*PDMA_ASYNC_CALLBACK)(PDMA_ASYNC_STRUCT pAsync);
+
+/*!
+ * \struct DMA_ASYNC_STRUCT
+ * \brief Asynchronous operation - one request in flight to the driver.
+ *  The application allocates it and sets Callback and Context, the submit
+ *  call sets the rest.  It must stay allocated and untouched from a
+ *  successful submit until AsyncWait returns it.  Any number may be in
+ *  flight per DMA Engine.
+ */
+struct _DMA_ASYNC_STRUCT {
+    OVERLAPPED Overlapped;          // Used by the DLL
+    UINT32 Operation;               // DMA_ASYNC_PACKET_xxx, set by the submit call
+    UINT32 Status;                  // Completion status, STATUS_SUCCESSFUL, STATUS_OPERATION_CANCELLED or an error
+    UINT32 Length;                  // Length requested, on completion the length transferred
+    UINT32 BufferToken;             // PacketReceiveAsync: token to return the buffer with
+    UINT64 UserStatus;              // PacketReceiveAsync / PacketReadAsync: User Status from the EOP DMA Descriptor
+    PVOID Buffer;                   // PacketReceiveAsync: Address of the packet in the receive buffer
+    PDMA_ASYNC_CALLBACK Callback;   // Optional, run by AsyncWait
+    PVOID Context;                  // Application context, not used by the DLL
+    union {
+        PACKET_RET_RECEIVE_STRUCT Receive;
+        PACKET_RET_READ_STRUCT Read;
+    } Ret;                          // Driver output, used by the DLL
+};
+
+/*! PacketSendAsync
+*
+* \brief Queues a PacketSendEx without waiting for it.  Buffer must stay
+*  valid until the completion.
+* \param board
+* \param EngineOffset
+* \param UserControl
+* \param CardOffset
+* \param Buffer
+* \param Length
+* \param pAsync
+* \return STATUS_SUCCESSFUL if the send is in flight, an error if it was
+*  refused, then there is no completion.
+*/
+PM40DRIVERDLL_API UINT32 PacketSendAsync(UINT32 board,   // Board to target
+    INT32 EngineOffset,     // DMA Engine number offset to use
+    UINT64 UserControl,     // User Control to set in the first DMA Descriptor
+    UINT64 CardOffset,      // Address of Memory on the card
+    PUINT8 Buffer,  // Address of data buffer
+    UINT32 Length,  // Length of data packet
+    PDMA_ASYNC_STRUCT pAsync        // Operation, returned by AsyncWait
+);
+
+/*! PacketReceiveAsync
+*
+* \brief Queues a blocking PacketReceiveEx without waiting for it.  The
+*  completion returns BufferToken, UserStatus, Buffer and Length.
+* \param board
+* \param EngineOffset
+* \param BufferToken - Token of a buffer to return first, INVALID_RELEASE_TOKEN for none
+* \param pAsync
+* \return STATUS_SUCCESSFUL if the receive is in flight, an error if it was
+*  refused, then there is no completion.
+*/
+PM40DRIVERDLL_API UINT32 PacketReceiveAsync(UINT32 board,        // Board to target
+    INT32 EngineOffset,     // DMA Engine number offset to use
+    UINT32 BufferToken,     // Token of a buffer to return
+    PDMA_ASYNC_STRUCT pAsync        // Operation, returned by AsyncWait
+);
+
+/*! PacketWriteAsync
+*
+* \brief Queues a PacketWriteEx without waiting for it.  Buffer must stay
+*  valid until the completion.
+* \param board
+* \param EngineOffset
+* \param UserControl
+* \param CardOffset
+* \param Mode
+* \param Buffer
+* \param Length
+* \param pAsync
+* \return STATUS_SUCCESSFUL if the write is in flight, an error if it was
+*  refused, then there is no completion.
+*/
+PM40DRIVERDLL_API UINT32 PacketWriteAsync(UINT32 board,  // Board to target
+    INT32 EngineOffset,     // DMA Engine number offset to use
+    UINT64 UserControl,     // User Control to set in the first DMA Descriptor
+    UINT64 CardOffset,      // Card Address to start write to
+    UINT32 Mode,    // Control Mode Flags
+    PUINT8 Buffer,  // Address of data buffer
+    UINT32 Length,  // Length of data packet
+    PDMA_ASYNC_STRUCT pAsync        // Operation, returned by AsyncWait
+);
+
+/*! PacketReadAsync
+*
+* \brief Queues a PacketReadEx without waiting for it.  Buffer must stay
+*  valid until the completion, which returns UserStatus and Length.
+* \param board
+* \param EngineOffset
+* \param CardOffset
+* \param Mode
+* \param Buffer
+* \param Length
+* \param pAsync
+* \return STATUS_SUCCESSFUL if the read is in flight, an error if it was
+*  refused, then there is no completion.
+*/
+PM40DRIVERDLL_API UINT32 PacketReadAsync(UINT32 board,   // Board to target
+    INT32 EngineOffset,     // DMA Engine number offset to use
+    UINT64 CardOffset,      // Card Address to start read from
+    UINT32 Mode,    // Control Mode Flags
+    PUINT8 Buffer,  // Address of data buffer
+    UINT32 Length,  // Length to Read
+    PDMA_ASYNC_STRUCT pAsync        // Operation, returned by AsyncWait
+);
+
+/*! AsyncWait
+*
+* \brief Waits for the next asynchronous operation of the board to complete,
+*  fills in its results and runs its Callback.  Any number of threads may
+*  wait.
+* \param board
+* \param TimeoutMilliSec - INFINITE to wait forever, 0 to poll
+* \param ppAsync - Returns the completed operation, NULL on timeout.  Once
+*  a Callback has run the operation belongs to the callback.
+* \return STATUS_SUCCESSFUL if an operation completed (its own result is in
+*  Status), STATUS_INCOMPLETE on timeout, or an error.
+*/
+PM40DRIVERDLL_API UINT32 AsyncWait(UINT32 board, // Board to target
+    DWORD TimeoutMilliSec,  // Timeout if nothing completes
+    PDMA_ASYNC_STRUCT * ppAsync     // Returned completed operation
+);
+
+/*! AsyncCancel
+*
+* \brief Cancels the asynchronous operations of the board that have not
+*  completed.  Each still completes through AsyncWait, cancelled ones with
+*  Status STATUS_OPERATION_CANCELLED.
+* \param board
+* \return Status
+*/
+PM40DRIVERDLL_API UINT32 AsyncCancel(UINT32 board        // Board to target
+);
+
+#endif                          // WIN32
+
 //**************************************************
 // Common Packet Mode Function calls
 //**************************************************
@@ -498,8 +970,10 @@ PM40DRIVERDLL_API UINT32 PacketWriteEx(UINT32 board,     // Board to target
 * \param EngineOffset
 * \param Buffer
 * \param BufferSize
-* \param MaxPacketSize
-* \param PacketMode
+* \param MaxPacketSize - FIFO Mode: largest packet, rounded up to whole pages
+*  it sizes the descriptors over physically contiguous (large page) memory.
+*  Only used when PacketMode includes PACKET_ALLOC_MAX_PACKET_DESC.
+* \param PacketMode - PACKET_MODE_*, FIFO and Streaming may or in PACKET_ALLOC_MAX_PACKET_DESC
 * \param NumberDescriptors
 * \return DriverList[board]->SetupPacket(EngineOffset, Buffer, BufferSize,
                             MaxPacketSize, PacketMode, NumberDescriptors);
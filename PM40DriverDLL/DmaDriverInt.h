@@ -1,7 +1,14 @@
 #pragma once
 
+// Per thread event for the synchronous (OVERLAPPED) calls
+HANDLE GetThreadEvent(VOID);
+VOID ReleaseThreadEvent(VOID);
+
 class CDmaDriverDll {
     UINT32 _PacketReceive(INT32 EngineOffset, PUINT64 UserStatus, PUINT32 BufferToken, PVOID Buffer, PUINT32 Length, BOOLEAN Blocking);
+    UINT32 _PacketCompletionRing(INT32 EngineOffset, DWORD IoctlCode, PPACKET_COMP_RING_STRUCT Ring, UINT32 NumEntries);
+    UINT32 _AsyncSubmit(DWORD IoctlCode, PVOID pIn, DWORD InSize, PVOID pOut, DWORD OutSize, PDMA_ASYNC_STRUCT pAsync);
+    PDMA_ASYNC_STRUCT _AsyncComplete(LPOVERLAPPED pOverlapped, DWORD bytesReturned, UINT32 status);
 public:
     CDmaDriverDll(VOID);
     CDmaDriverDll(UINT32 BoardNum);
@@ -17,26 +24,69 @@ public:
 
     UINT32 DoMem(UINT32 Rd_Wr_n, UINT32 BarNum, PUINT8 Buffer, UINT64 Offset, UINT64 CardOffset, UINT64 Length, PSTAT_STRUCT Status);
 
+    UINT32 MapBar(UINT32 BarNum, UINT64 CardOffset, UINT64 Length, PVOID * ppWindow);
+
+    UINT32 UnmapBar(UINT32 BarNum);
+
+    UINT32 BarRead32(UINT32 BarNum, UINT64 CardOffset, PUINT32 Value);
+
+    UINT32 BarWrite32(UINT32 BarNum, UINT64 CardOffset, UINT32 Value);
+
+    UINT32 DoMemVector(PDO_MEM_VECTOR_STRUCT pMemVector);
+
     UINT32 WritePCIConfig(PUINT8 Buffer, UINT32 Offset, UINT32 Length, PSTAT_STRUCT Status);
 
     UINT32 ReadPCIConfig(PUINT8 Buffer, UINT32 Offset, UINT32 Length, PSTAT_STRUCT Status);
 
     UINT32 GetDmaPerf(INT32 EngineNum, UINT32 TypeDirection, PDMA_STAT_STRUCT Status);
 
+    UINT32 SetInterruptCoalescing(INT32 EngineOffset, UINT32 TypeDirection, PINT_COALESCE_STRUCT pCoalesce);
+    UINT32 SetPollMode(INT32 EngineOffset, PPOLL_MODE_STRUCT pPollMode);
+    UINT32 GetEngineAffinity(INT32 EngineOffset, UINT32 TypeDirection, PENGINE_AFFINITY_STRUCT pAffinity);
+    PVOID AllocEngineBuffer(INT32 EngineOffset, UINT32 TypeDirection, SIZE_T Size);
+
     UINT32 PacketReceiveEx(INT32 EngineOffset, PUINT64 UserStatus, PUINT32 BufferToken, PVOID Buffer, PUINT32 Length);
 
     UINT32 PacketReturnReceive(INT32 EngineOffset, PUINT32 BufferToken);
 
+    UINT32 PacketReturnReceives(INT32 EngineOffset, PPACKET_RETURN_RECVS_STRUCT pReturnRecvs);
+
     UINT32 PacketReceives(INT32 EngineOffset, PPACKET_RECVS_STRUCT pPacketRecvs);
 
     UINT32 PacketSendEx(INT32 EngineOffset, UINT64 UserControl, UINT64 CardOffset, PUINT8 Buffer, UINT32 Length);
 
+    UINT32 PacketSends(INT32 EngineOffset, PUINT8 Buffer, UINT32 Length, PPACKET_SENDS_STRUCT pPacketSends);
+
+    UINT32 PacketRegisterSendPool(INT32 EngineOffset, PUINT8 Buffer, UINT32 Length, PUINT32 PoolId);
+
+    UINT32 PacketReleaseSendPool(INT32 EngineOffset, UINT32 PoolId);
+
+    UINT32 PacketPoolSend(INT32 EngineOffset, UINT32 PoolId, UINT64 UserControl, UINT64 BufferOffset, UINT32 Length);
+
+    UINT32 PacketRegisterCompletionRing(INT32 EngineOffset, PPACKET_COMP_RING_STRUCT Ring, UINT32 NumEntries);
+
+    UINT32 PacketReleaseCompletionRing(INT32 EngineOffset);
+
+    UINT32 PacketSyncCompletionRing(INT32 EngineOffset);
+
     UINT32 PacketReceiveNB(INT32 EngineOffset, PUINT64 UserStatus, PUINT32 BufferToken, PVOID Buffer, PUINT32 Length);
 
     UINT32 PacketWriteEx(INT32 EngineOffset, UINT64 UserControl, UINT64 CardOffset, UINT32 Mode, PUINT8 Buffer, UINT32 Length);
 
     UINT32 PacketReadEx(INT32 EngineOffset, PUINT64 UserStatus, UINT64 CardOffset, UINT32 Mode, PUINT8 Buffer, PUINT32 Length);
 
+    UINT32 PacketSendAsync(INT32 EngineOffset, UINT64 UserControl, UINT64 CardOffset, PUINT8 Buffer, UINT32 Length, PDMA_ASYNC_STRUCT pAsync);
+
+    UINT32 PacketReceiveAsync(INT32 EngineOffset, UINT32 BufferToken, PDMA_ASYNC_STRUCT pAsync);
+
+    UINT32 PacketWriteAsync(INT32 EngineOffset, UINT64 UserControl, UINT64 CardOffset, UINT32 Mode, PUINT8 Buffer, UINT32 Length, PDMA_ASYNC_STRUCT pAsync);
+
+    UINT32 PacketReadAsync(INT32 EngineOffset, UINT64 CardOffset, UINT32 Mode, PUINT8 Buffer, UINT32 Length, PDMA_ASYNC_STRUCT pAsync);
+
+    UINT32 AsyncWait(DWORD dwTimeoutMilliSec, PDMA_ASYNC_STRUCT * ppAsync);
+
+    UINT32 AsyncCancel(VOID);
+
     UINT32 SetupPacket(INT32 EngineOffset, PUINT8 Buffer, PUINT32 BufferSize, PUINT32 MaxPacketSize, INT32 PacketModeSetting, INT32 NumberDescriptors);
 
     UINT32 ReleasePacketBuffers(INT32 EngineOffset);
@@ -55,6 +105,12 @@ private:
     UINT32 BoardNumber;
     BOOLEAN AttachedToDriver;
     HANDLE hDevice;
+    HANDLE hAsyncDevice;            // Second handle, its completions go to hCompletionPort
+    HANDLE hCompletionPort;
+    volatile LONG AsyncOutstanding; // Operations submitted whose completion has not been taken from hCompletionPort
+    volatile UINT8 * BarWindow[MAX_BARS];   // BAR windows mapped by MapBar, NULL if none
+    UINT64 BarWindowOffset[MAX_BARS];
+    UINT64 BarWindowLength[MAX_BARS];
     HDEVINFO hDevInfo;
     DMA_INFO_STRUCT DmaInfo;
     PSP_DEVICE_INTERFACE_DETAIL_DATA pDeviceInterfaceDetailData;
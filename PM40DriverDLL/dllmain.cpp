@@ -22,9 +22,11 @@ BOOLEAN APIENTRY DllMain(HMODULE hModule, DWORD ul_reason_for_call, LPVOID lpRes
     case DLL_THREAD_ATTACH:
         break;
     case DLL_THREAD_DETACH:
+        ReleaseThreadEvent();
         break;
     case DLL_PROCESS_DETACH:
         CleanupDll();
+        ReleaseThreadEvent();
         break;
     }
     return TRUE;
@@ -256,23 +258,141 @@ PM40DRIVERDLL_API UINT32 DoMem(UINT32 board,     // Board number to target
 }
 
 
-PM40DRIVERDLL_API UINT32 Bar0Write(UINT nAddrs, PUINT32 nValue)
+/*! MapBar
+ *
+ * \brief Maps a window of a BAR into the application
+ * \param board
+ * \param BarNum
+ * \param CardOffset
+ * \param Length
+ * \param ppWindow
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 MapBar(UINT32 board,    // Board number to target
+    UINT32 BarNum, UINT64 CardOffset, UINT64 Length, PVOID * ppWindow)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->MapBar(BarNum, CardOffset, Length, ppWindow);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! UnmapBar
+ *
+ * \brief Unmaps the window MapBar mapped
+ * \param board
+ * \param BarNum
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 UnmapBar(UINT32 board,  // Board number to target
+    UINT32 BarNum)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->UnmapBar(BarNum);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! BarRead32
+ *
+ * \brief Reads a 32 bit register
+ * \param board
+ * \param BarNum
+ * \param CardOffset
+ * \param Value
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 BarRead32(UINT32 board, // Board number to target
+    UINT32 BarNum, UINT64 CardOffset, PUINT32 Value)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    if (Value == NULL) {
+        return STATUS_BAD_PARAMETER;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->BarRead32(BarNum, CardOffset, Value);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! BarWrite32
+ *
+ * \brief Writes a 32 bit register
+ * \param board
+ * \param BarNum
+ * \param CardOffset
+ * \param Value
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 BarWrite32(UINT32 board,        // Board number to target
+    UINT32 BarNum, UINT64 CardOffset, UINT32 Value)
 {
-    static int nArray[32];
-    int	nBoard = 0;
-    int nRdWr = 0;	//Write;
-    int nBarNum = 0;
-    UINT64 n64MemOffset = 0;
-    UINT64 n64Length = 4;
-    UINT64 n64CardAddrs = (UINT64)nAddrs;
-    STAT_STRUCT Status;
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->BarWrite32(BarNum, CardOffset, Value);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
 
-    ZeroMemory((void*)&Status, sizeof Status);
+/*! DoMemVector
+ *
+ * \brief Sends a DO_MEM_VECTOR_IOCTL call to the driver
+ * \param board
+ * \param pMemVector
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 DoMemVector(UINT32 board,       // Board number to target
+    PDO_MEM_VECTOR_STRUCT pMemVector)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    if (pMemVector == NULL) {
+        return STATUS_BAD_PARAMETER;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->DoMemVector(pMemVector);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
 
-    int nStatus = DoMem(nBoard, nRdWr, nBarNum, (UINT8*)nValue, n64MemOffset, n64CardAddrs, n64Length, &Status);
+// Bar0Write / Bar0Read go through the board 0 BAR 0 window when MapBar mapped one
+PM40DRIVERDLL_API UINT32 Bar0Write(UINT nAddrs, PUINT32 nValue)
+{
+    UINT32 nStatus = BarWrite32(0, 0, (UINT64)nAddrs, *nValue);
 
     if (nStatus) {
-        printf("%s Failed to Write to BAR 0 nAddrs %x Value %x", __func__, nAddrs, nArray[0]);
+        printf("%s Failed to Write to BAR 0 nAddrs %x Value %x", __func__, nAddrs, *nValue);
         return STATUS_INCOMPLETE;
     }
     return 0;
@@ -280,25 +400,14 @@ PM40DRIVERDLL_API UINT32 Bar0Write(UINT nAddrs, PUINT32 nValue)
 
 PM40DRIVERDLL_API UINT32 Bar0Read(UINT nAddrs, PUINT32 nValue)
 {
-    static int nArray[32];
-    int	nBoard = 0;
-    int nRdWr = 1;	//Read;
-    int nBarNum = 0;
-    UINT8* pcArray = (UINT8*)nArray;
-    UINT64 n64MemOffset = 0;
-    UINT64 n64Length = 4;
-    UINT64 n64CardAddrs = (UINT64)nAddrs;
-    STAT_STRUCT Status;
-
-    ZeroMemory((void*)&Status, sizeof Status);
-
-    int nStatus = DoMem(nBoard, nRdWr, nBarNum, pcArray, n64MemOffset, n64CardAddrs, n64Length, &Status);
+    UINT32 nData = 0;
+    UINT32 nStatus = BarRead32(0, 0, (UINT64)nAddrs, &nData);
 
     if (nStatus) {
-        printf("%s Failed to Read from BAR 0 nAddrs %x Value %x", __func__, nAddrs, nArray[0]);
+        printf("%s Failed to Read from BAR 0 nAddrs %x Value %x", __func__, nAddrs, nData);
         return STATUS_INCOMPLETE;
     }
-    if (nValue != NULL) *nValue = nArray[0];
+    if (nValue != NULL) *nValue = nData;
     return 0;
 }
 
@@ -373,6 +482,133 @@ PM40DRIVERDLL_API UINT32 GetDmaPerf(UINT32 board,        // Board number to targ
     }
 }
 
+/*! SetInterruptCoalescing
+ *
+ * \brief Sets the completion interrupt coalescing of DMA Engine 'EngineOffset'
+ *  on board 'board'.
+ * \param board
+ * \param EngineOffset
+ * \param TypeDirection
+ * \param pCoalesce
+ * \returns Status, the effective settings are returned in pCoalesce.
+ */
+PM40DRIVERDLL_API UINT32 SetInterruptCoalescing(UINT32 board,    // Board number to target
+    INT32 EngineOffset,  // DMA Engine number offset to use
+    UINT32 TypeDirection,        // DMA Type & Direction Flags
+    PINT_COALESCE_STRUCT pCoalesce       // Settings, returns the effective ones
+)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->SetInterruptCoalescing(EngineOffset, TypeDirection, pCoalesce);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! SetPollMode
+ *
+ * \brief Sets the receive poll mode of C2S DMA Engine 'EngineOffset'
+ *  on board 'board'.
+ * \param board
+ * \param EngineOffset
+ * \param pPollMode
+ * \returns Status, the effective settings are returned in pPollMode.
+ */
+PM40DRIVERDLL_API UINT32 SetPollMode(UINT32 board,       // Board number to target
+    INT32 EngineOffset,  // DMA Engine number offset to use
+    PPOLL_MODE_STRUCT pPollMode  // Settings, returns the effective ones
+)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->SetPollMode(EngineOffset, pPollMode);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! GetEngineAffinity
+ *
+ * \brief Gets the processor and NUMA node of DMA Engine 'EngineOffset'
+ *  on board 'board'.
+ * \param board
+ * \param EngineOffset
+ * \param TypeDirection
+ * \param pAffinity
+ * \returns Status, the placement is returned in pAffinity.
+ */
+PM40DRIVERDLL_API UINT32 GetEngineAffinity(UINT32 board,         // Board number to target
+    INT32 EngineOffset,  // DMA Engine number offset to use
+    UINT32 TypeDirection,        // DMA Type & Direction Flags
+    PENGINE_AFFINITY_STRUCT pAffinity    // Returned placement
+)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->GetEngineAffinity(EngineOffset, TypeDirection, pAffinity);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! AllocEngineBuffer
+ *
+ * \brief Allocates a data buffer on the NUMA node of DMA Engine 'EngineOffset'
+ *  on board 'board'.
+ * \param board
+ * \param EngineOffset
+ * \param TypeDirection
+ * \param Size
+ * \returns Buffer address, NULL on failure.
+ */
+PM40DRIVERDLL_API PVOID AllocEngineBuffer(UINT32 board,  // Board number to target
+    INT32 EngineOffset,  // DMA Engine number offset to use
+    UINT32 TypeDirection,        // DMA Type & Direction Flags
+    SIZE_T Size          // Bytes to allocate
+)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return NULL;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->AllocEngineBuffer(EngineOffset, TypeDirection, Size);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return NULL;
+    }
+}
+
+/*! FreeEngineBuffer
+ *
+ * \brief Releases a buffer from AllocEngineBuffer.
+ * \param Buffer
+ * \returns none
+ */
+PM40DRIVERDLL_API VOID FreeEngineBuffer(PVOID Buffer)
+{
+    if (Buffer != NULL) {
+        VirtualFree(Buffer, 0, MEM_RELEASE);
+    }
+}
+
 /*! WritePCIConfig
 //
 // \brief Sends a WRITE_PCI_CONFIG_IOCTL call to the driver.
@@ -554,6 +790,33 @@ PM40DRIVERDLL_API UINT32 PacketReturnReceive(UINT32 board,       // Board number
     }
 }
 
+/*! PacketReturnReceives
+ *
+ * \brief Returns several Recieve buffer tokens back to the driver in one call.
+ *  Returns Processing status of the call.
+ * \param board
+ * \param EngineOffset
+ * \param pReturnRecvs
+ * \return DriverList[board]->PacketReturnReceives(EngineOffset, pReturnRecvs);
+ */
+PM40DRIVERDLL_API UINT32 PacketReturnReceives(UINT32 board,      // Board number to target
+    INT32 EngineOffset, // DMA Engine number offset to use
+    PPACKET_RETURN_RECVS_STRUCT pReturnRecvs        // Tokens to return
+)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketReturnReceives(EngineOffset, pReturnRecvs);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
 PM40DRIVERDLL_API UINT32 PacketReceives(UINT32 board,    // Board number to target
     INT32 EngineOffset,      // DMA Engine number offset to use
     PPACKET_RECVS_STRUCT pPacketRecvs)
@@ -622,6 +885,185 @@ PM40DRIVERDLL_API UINT32 PacketSendEx(UINT32 board,      // Board number to targ
     }
 }
 
+/*! PacketSends
+ *
+ * \brief Send multiple packets from 'Buffer' with one request
+ * \param board
+ * \param EngineOffset
+ * \param Buffer
+ * \param Length
+ * \param pPacketSends
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 PacketSends(UINT32 board,       // Board number to target
+    INT32 EngineOffset,        // DMA Engine number offset to use
+    PUINT8 Buffer, UINT32 Length, PPACKET_SENDS_STRUCT pPacketSends)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketSends(EngineOffset, Buffer, Length, pPacketSends);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! PacketRegisterSendPool
+ *
+ * \brief Register 'Buffer' as a send pool, it stays locked until released
+ * \param board
+ * \param EngineOffset
+ * \param Buffer
+ * \param Length
+ * \param PoolId
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 PacketRegisterSendPool(UINT32 board,      // Board number to target
+    INT32 EngineOffset,        // DMA Engine number offset to use
+    PUINT8 Buffer, UINT32 Length, PUINT32 PoolId)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketRegisterSendPool(EngineOffset, Buffer, Length, PoolId);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! PacketReleaseSendPool
+ *
+ * \brief Release a send pool registered with PacketRegisterSendPool
+ * \param board
+ * \param EngineOffset
+ * \param PoolId
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 PacketReleaseSendPool(UINT32 board,       // Board number to target
+    INT32 EngineOffset,        // DMA Engine number offset to use
+    UINT32 PoolId)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketReleaseSendPool(EngineOffset, PoolId);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! PacketPoolSend
+ *
+ * \brief Send a packet of 'Length' bytes at 'BufferOffset' in a send pool
+ * \param board
+ * \param EngineOffset
+ * \param PoolId
+ * \param UserControl
+ * \param BufferOffset
+ * \param Length
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 PacketPoolSend(UINT32 board,      // Board number to target
+    INT32 EngineOffset,        // DMA Engine number offset to use
+    UINT32 PoolId, UINT64 UserControl, UINT64 BufferOffset, UINT32 Length)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketPoolSend(EngineOffset, PoolId, UserControl, BufferOffset, Length);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! PacketRegisterCompletionRing
+ *
+ * \brief Register 'Ring' as the completion ring of the Packet Receive engine
+ * \param board
+ * \param EngineOffset
+ * \param Ring
+ * \param NumEntries
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 PacketRegisterCompletionRing(UINT32 board,      // Board number to target
+    INT32 EngineOffset,        // DMA Engine number offset to use
+    PPACKET_COMP_RING_STRUCT Ring, UINT32 NumEntries)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketRegisterCompletionRing(EngineOffset, Ring, NumEntries);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! PacketReleaseCompletionRing
+ *
+ * \brief Release the completion ring registered with PacketRegisterCompletionRing
+ * \param board
+ * \param EngineOffset
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 PacketReleaseCompletionRing(UINT32 board,      // Board number to target
+    INT32 EngineOffset)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketReleaseCompletionRing(EngineOffset);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! PacketSyncCompletionRing
+ *
+ * \brief Have the driver update the completion ring now
+ * \param board
+ * \param EngineOffset
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 PacketSyncCompletionRing(UINT32 board,      // Board number to target
+    INT32 EngineOffset)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketSyncCompletionRing(EngineOffset);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
 //--------------------------------------------------------------------
 // Addressable Packet Mode Function calls
 //--------------------------------------------------------------------
@@ -750,6 +1192,179 @@ PM40DRIVERDLL_API UINT32 PacketWriteEx(UINT32 board,     // Board number to targ
     }
 }
 
+//--------------------------------------------------------------------
+// Asynchronous Packet Mode Function calls
+//--------------------------------------------------------------------
+
+#ifdef WIN32
+
+/*! PacketSendAsync
+ *
+ * \brief Queues a packet send without waiting for it
+ * \param board
+ * \param EngineOffset
+ * \param UserControl
+ * \param CardOffset
+ * \param Buffer
+ * \param Length
+ * \param pAsync
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 PacketSendAsync(UINT32 board,   // Board number to target
+    INT32 EngineOffset,       // DMA Engine number offset to use
+    UINT64 UserControl, UINT64 CardOffset, PUINT8 Buffer, UINT32 Length, PDMA_ASYNC_STRUCT pAsync)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketSendAsync(EngineOffset, UserControl, CardOffset, Buffer, Length, pAsync);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! PacketReceiveAsync
+ *
+ * \brief Queues a blocking packet receive without waiting for it
+ * \param board
+ * \param EngineOffset
+ * \param BufferToken
+ * \param pAsync
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 PacketReceiveAsync(UINT32 board,        // Board number to target
+    INT32 EngineOffset,       // DMA Engine number offset to use
+    UINT32 BufferToken, PDMA_ASYNC_STRUCT pAsync)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketReceiveAsync(EngineOffset, BufferToken, pAsync);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! PacketWriteAsync
+ *
+ * \brief Queues a packet write without waiting for it
+ * \param board
+ * \param EngineOffset
+ * \param UserControl
+ * \param CardOffset
+ * \param Mode
+ * \param Buffer
+ * \param Length
+ * \param pAsync
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 PacketWriteAsync(UINT32 board,  // Board number to target
+    INT32 EngineOffset,       // DMA Engine number offset to use
+    UINT64 UserControl, UINT64 CardOffset, UINT32 Mode,       // Control Mode Flags
+    PUINT8 Buffer, UINT32 Length, PDMA_ASYNC_STRUCT pAsync)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketWriteAsync(EngineOffset, UserControl, CardOffset, Mode, Buffer, Length, pAsync);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! PacketReadAsync
+ *
+ * \brief Queues a packet read without waiting for it
+ * \param board
+ * \param EngineOffset
+ * \param CardOffset
+ * \param Mode
+ * \param Buffer
+ * \param Length
+ * \param pAsync
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 PacketReadAsync(UINT32 board,   // Board number to target
+    INT32 EngineOffset,       // DMA Engine number offset to use
+    UINT64 CardOffset, UINT32 Mode,   // Control Mode Flags
+    PUINT8 Buffer, UINT32 Length, PDMA_ASYNC_STRUCT pAsync)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->PacketReadAsync(EngineOffset, CardOffset, Mode, Buffer, Length, pAsync);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! AsyncWait
+ *
+ * \brief Waits for the next asynchronous operation of the board to complete
+ * \param board
+ * \param TimeoutMilliSec
+ * \param ppAsync
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 AsyncWait(UINT32 board, // Board number to target
+    DWORD TimeoutMilliSec, PDMA_ASYNC_STRUCT * ppAsync)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    if (ppAsync == NULL) {
+        return STATUS_BAD_PARAMETER;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->AsyncWait(TimeoutMilliSec, ppAsync);
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+/*! AsyncCancel
+ *
+ * \brief Cancels the asynchronous operations of the board that have not completed
+ * \param board
+ * \return Status
+ */
+PM40DRIVERDLL_API UINT32 AsyncCancel(UINT32 board        // Board number to target
+)
+{
+    if (board >= MAXIMUM_NUMBER_OF_BOARDS) {
+        return STATUS_INVALID_BOARDNUM;
+    }
+    // Connect to board
+    if (DriverList[board] != NULL) {
+        return DriverList[board]->AsyncCancel();
+    }
+    else {
+        printf("%s: No driver class instance.\n", __func__);
+        return STATUS_INCOMPLETE;
+    }
+}
+
+#endif                          // WIN32
+
 //--------------------------------------------------------------------
 // Common Packet Mode Function calls
 //--------------------------------------------------------------------
@@ -0,0 +1,68 @@
+// -------------------------------------------------------------------------
+//
+// PRODUCT:            DMA Driver
+// MODULE NAME:        PacketRingPlatform.h
+//
+// MODULE DESCRIPTION:
+//
+// Simulator glue for the OS neutral descriptor ring in
+// PM40Driver/PacketRing.c: the host stand-in for the WDM
+// SCATTER_GATHER_LIST and its PACKET_RING_SG_* accessors.
+//
+// $Revision:  $
+//
+// ------------------------- CONFIDENTIAL ----------------------------------
+//
+//              Copyright (c) 2017 by Northwest Logic, Inc.
+//                       All rights reserved.
+//
+// Trade Secret of Northwest Logic, Inc.  Do not disclose.
+//
+// Use of this source code in any form or means is permitted only
+// with a valid, written license agreement with Northwest Logic, Inc.
+//
+// Licensee shall keep all information contained herein confidential
+// and shall protect same in whole or in part from disclosure and
+// dissemination to all third parties.
+//
+//
+//                        Northwest Logic, Inc.
+//                  1100 NW Compton Drive, Suite 100
+//                      Beaverton, OR 97006, USA
+//
+//                        Ph:  +1 503 533 5800
+//                        Fax: +1 503 533 5900
+//                      E-Mail: info@nwlogic.com
+//                           www.nwlogic.com
+//
+// -------------------------------------------------------------------------
+
+#ifndef _PACKET_RING_PLATFORM_H_
+#define _PACKET_RING_PLATFORM_H_
+
+#include "SimHost.h"
+
+#define SIM_MAX_SG_ELEMENTS         64
+
+/*!
+ * \struct SIM_SG_LIST
+ * \brief Host stand-in for the WDM SCATTER_GATHER_LIST.
+ */
+typedef struct _SIM_SG_ELEMENT {
+        UINT64 Address;
+        UINT32 Length;
+} SIM_SG_ELEMENT, *PSIM_SG_ELEMENT;
+
+typedef struct _SIM_SG_LIST {
+        UINT32 NumberOfElements;
+        SIM_SG_ELEMENT Elements[SIM_MAX_SG_ELEMENTS];
+} SIM_SG_LIST, *PSIM_SG_LIST;
+
+#define PACKET_RING_SG_LIST                     SIM_SG_LIST
+#define PACKET_RING_SG_COUNT(SgList)            ((SgList)->NumberOfElements)
+#define PACKET_RING_SG_ADDRESS(SgList, i)       ((SgList)->Elements[i].Address)
+#define PACKET_RING_SG_LENGTH(SgList, i)        ((SgList)->Elements[i].Length)
+
+#include "PacketRing.h"
+
+#endif                          // _PACKET_RING_PLATFORM_H_
@@ -0,0 +1,569 @@
+// -------------------------------------------------------------------------
+//
+// PRODUCT:            DMA Driver
+// MODULE NAME:        SimBench.c
+//
+// MODULE DESCRIPTION:
+//
+// Packet DMA benchmark running the driver ring routines against the
+// software model of the engine.  The host time spent in the driver
+// routines is measured with the monotonic clock and charged to the
+// simulated clock, so the card keeps moving data while the driver runs
+// and the result is limited by whichever side is slower.
+//
+// $Revision:  $
+//
+// ------------------------- CONFIDENTIAL ----------------------------------
+//
+//              Copyright (c) 2017 by Northwest Logic, Inc.
+//                       All rights reserved.
+//
+// Trade Secret of Northwest Logic, Inc.  Do not disclose.
+//
+// Use of this source code in any form or means is permitted only
+// with a valid, written license agreement with Northwest Logic, Inc.
+//
+// Licensee shall keep all information contained herein confidential
+// and shall protect same in whole or in part from disclosure and
+// dissemination to all third parties.
+//
+//
+//                        Northwest Logic, Inc.
+//                  1100 NW Compton Drive, Suite 100
+//                      Beaverton, OR 97006, USA
+//
+//                        Ph:  +1 503 533 5800
+//                        Fax: +1 503 533 5900
+//                      E-Mail: info@nwlogic.com
+//                           www.nwlogic.com
+//
+// -------------------------------------------------------------------------
+
+#include <unistd.h>
+
+#include "SimDriver.h"
+
+#define SIM_S2C_ENGINE              0
+#define SIM_C2S_ENGINE              32
+#define SIM_PAGE_SIZE               4096
+//! Fake physical address of the application buffers, pages are never contiguous
+#define SIM_BUFFER_PHYS_BASE        0x200000000ULL
+#define SIM_RX_VIRT_BASE            ((PUINT8) (size_t) 0x10000000000ULL)
+
+/*!
+ * \struct BENCH_CONFIG
+ * \brief Command line options.
+ */
+typedef struct _BENCH_CONFIG {
+        BOOLEAN RunS2C;
+        BOOLEAN RunC2S;
+        BOOLEAN RunC2SFifo;
+        BOOLEAN RunDesc;
+        UINT64 Packets;
+        UINT32 PacketSize;
+        UINT32 Descriptors;
+        UINT32 QueueDepth;
+        UINT32 RxDescBytes;
+        UINT32 RxBatch;
+        UINT32 PollNs;
+        UINT32 DpcLatencyNs;
+        BOOLEAN CreateTransactions;
+        BOOLEAN ContiguousSends;        // S2C buffer pages physically contiguous
+        UINT32 DoorbellBatch;           // S2C packets the SoftwareDescriptorPtr may be held back for
+        SIM_ENGINE_CONFIG Link;
+} BENCH_CONFIG, *PBENCH_CONFIG;
+
+/*!
+ * \struct BENCH_RESULT
+ * \brief Counters collected by one run.
+ */
+typedef struct _BENCH_RESULT {
+        UINT64 Packets;
+        UINT64 Bytes;
+        UINT64 Errors;
+        UINT64 Lost;
+        UINT64 Overruns;
+        UINT64 SubmitNs;        // Host time in the programming / receive routine
+        UINT64 CompleteNs;      // Host time in the DPC
+        UINT64 SimNs;           // Simulated time for the run
+        UINT64 LinkNs;          // Simulated time the engine was moving data
+} BENCH_RESULT, *PBENCH_RESULT;
+
+/*!
+ * \struct S2C_BENCH
+ * \brief Application side state of the send benchmark.
+ */
+typedef struct _S2C_BENCH {
+        PSIM_SG_LIST pSgLists;
+        UINT32 *pFreeSlots;
+        UINT32 NumFree;
+        PBENCH_RESULT pResult;
+} S2C_BENCH, *PS2C_BENCH;
+
+static VOID BenchIsr(PVOID Context, UINT32 EngineNum)
+{
+        PSIM_DMA_EXT pDmaExt = (PSIM_DMA_EXT) Context;
+
+        if (pDmaExt->DmaEngine == EngineNum) {
+                SimDriverIsr(pDmaExt);
+        }
+}
+
+static VOID BenchSendComplete(PSIM_DMA_EXT pDmaExt, PVOID Request, UINT32 BytesTransferred, INT32 Status)
+{
+        PS2C_BENCH pBench = (PS2C_BENCH) pDmaExt->Context;
+
+        if (Status != SIM_STATUS_SUCCESS) {
+                pBench->pResult->Errors++;
+        }
+        pBench->pResult->Packets++;
+        pBench->pResult->Bytes += BytesTransferred;
+        // The request of a send is the S/G list of its slot
+        pBench->pFreeSlots[pBench->NumFree++] = (UINT32) ((PSIM_SG_LIST) Request - pBench->pSgLists);
+}
+
+/*
+ * Build the S/G list the DMA adapter would return for a page aligned user buffer,
+ * one element per page, the pages scattered or physically contiguous.
+ */
+static void BenchBuildSgList(PSIM_SG_LIST pSgList, UINT32 Slot, UINT32 Length, BOOLEAN bContiguous)
+{
+        UINT32 PagesPerSlot = (Length + SIM_PAGE_SIZE - 1) / SIM_PAGE_SIZE;
+        UINT32 i;
+
+        pSgList->NumberOfElements = PagesPerSlot;
+        for (i = 0; i < PagesPerSlot; i++) {
+                pSgList->Elements[i].Address = SIM_BUFFER_PHYS_BASE + (((UINT64) Slot * PagesPerSlot * 2 + (bContiguous ? i : (i * 2))) * SIM_PAGE_SIZE);
+                pSgList->Elements[i].Length = (Length > SIM_PAGE_SIZE) ? SIM_PAGE_SIZE : Length;
+                Length -= pSgList->Elements[i].Length;
+        }
+}
+
+static INT32 BenchCreate(PBENCH_CONFIG pConfig, UINT32 EngineNum, PSIM_DEVICE * ppDev, PSIM_DMA_EXT pDmaExt)
+{
+        SIM_ENGINE_CONFIG Link = pConfig->Link;
+        INT32 status;
+
+        status = SimDeviceCreate(ppDev, (pConfig->Descriptors + 1) * sizeof(DMA_DESCRIPTOR_STRUCT));
+        if (status == SIM_STATUS_SUCCESS) {
+                Link.C2SPacketSize = pConfig->PacketSize;
+                status = SimEngineAdd(*ppDev, EngineNum, &Link);
+        }
+        if (status == SIM_STATUS_SUCCESS) {
+                status = SimDmaExtCreate(*ppDev, EngineNum, pConfig->Descriptors, pDmaExt);
+        }
+        if (status == SIM_STATUS_SUCCESS) {
+                SimDeviceSetIsr(*ppDev, BenchIsr, pDmaExt);
+                (*ppDev)->pRegs->commonControl.ControlStatus = CARD_IRQ_ENABLE;
+        }
+        return status;
+}
+
+/*
+ * Run the card while the driver was busy for HostNs.
+ */
+static void BenchChargeHostTime(PSIM_DEVICE pDev, UINT64 HostNs)
+{
+        SimDeviceRun(pDev, pDev->NowNs + HostNs, FALSE);
+}
+
+/*
+ * PACKET_SEND loop: the application keeps QueueDepth packets outstanding.
+ */
+static INT32 BenchS2C(PBENCH_CONFIG pConfig, PBENCH_RESULT pResult)
+{
+        PSIM_DEVICE pDev = NULL;
+        SIM_DMA_EXT DmaExt;
+        S2C_BENCH Bench;
+        UINT64 Issued = 0;
+        UINT64 t0, t1;
+        UINT32 i;
+        INT32 status;
+
+        memset(pResult, 0, sizeof(BENCH_RESULT));
+        memset(&Bench, 0, sizeof(Bench));
+
+        status = BenchCreate(pConfig, SIM_S2C_ENGINE, &pDev, &DmaExt);
+        if (status == SIM_STATUS_SUCCESS) {
+                Bench.pSgLists = calloc(pConfig->QueueDepth, sizeof(SIM_SG_LIST));
+                Bench.pFreeSlots = calloc(pConfig->QueueDepth, sizeof(UINT32));
+                if ((Bench.pSgLists == NULL) || (Bench.pFreeSlots == NULL)) {
+                        status = SIM_STATUS_NO_MEMORY;
+                }
+        }
+        if (status != SIM_STATUS_SUCCESS) {
+                goto BenchS2CExit;
+        }
+
+        Bench.pResult = pResult;
+        for (i = 0; i < pConfig->QueueDepth; i++) {
+                BenchBuildSgList(&Bench.pSgLists[i], i, pConfig->PacketSize, pConfig->ContiguousSends);
+                Bench.pFreeSlots[Bench.NumFree++] = pConfig->QueueDepth - 1 - i;
+        }
+        DmaExt.pfnSendComplete = BenchSendComplete;
+        DmaExt.Context = &Bench;
+        DmaExt.bCreateTransactions = pConfig->CreateTransactions;
+        SimInitializeTxDescriptors(&DmaExt);
+        DmaExt.Ring.DoorbellBatch = pConfig->DoorbellBatch;
+
+        while (pResult->Packets < pConfig->Packets) {
+                UINT32 Submitted = 0;
+
+                // Submit everything the application has room for
+                t0 = SimHostNowNs();
+                while ((Bench.NumFree != 0) && (Issued < pConfig->Packets)) {
+                        UINT32 Slot = Bench.pFreeSlots[Bench.NumFree - 1];
+
+                        if (SimPacketStartSend(&DmaExt, &Bench.pSgLists[Slot], Issued, &Bench.pSgLists[Slot]) != SIM_STATUS_SUCCESS) {
+                                break;
+                        }
+                        Bench.NumFree--;
+                        Issued++;
+                        Submitted++;
+                }
+                SimPacketFlushSends(&DmaExt);
+                t1 = SimHostNowNs();
+                if (Submitted != 0) {
+                        pResult->SubmitNs += t1 - t0;
+                        BenchChargeHostTime(pDev, t1 - t0);
+                }
+
+                if (!DmaExt.DpcPending && (Submitted == 0)) {
+                        // Nothing to do until the card interrupts
+                        if (SimDeviceRun(pDev, SIM_TIME_INFINITE, TRUE) == 0) {
+                                fprintf(stderr, "S2C engine stalled with %u descriptors in use\n", PacketRingS2CInUse(&DmaExt.Ring));
+                                status = SIM_STATUS_INTERNAL_ERROR;
+                                break;
+                        }
+                        SimDeviceRun(pDev, pDev->NowNs + pConfig->DpcLatencyNs, FALSE);
+                }
+
+                if (DmaExt.DpcPending) {
+                        t0 = SimHostNowNs();
+                        SimPacketS2CDpc(&DmaExt);
+                        t1 = SimHostNowNs();
+                        pResult->CompleteNs += t1 - t0;
+                        BenchChargeHostTime(pDev, t1 - t0);
+                }
+        }
+        pResult->SimNs = pDev->NowNs;
+        pResult->LinkNs = pDev->Engines[SIM_S2C_ENGINE].ActiveNs;
+        printf("S2C      %llu packets x %u bytes, %u descriptors, %u outstanding, transactions %s, %s pages, doorbell batch %u\n",
+               (unsigned long long) pResult->Packets, pConfig->PacketSize, pConfig->Descriptors, pConfig->QueueDepth,
+               pConfig->CreateTransactions ? "created per packet" : "pooled", pConfig->ContiguousSends ? "contiguous" : "scattered",
+               pConfig->DoorbellBatch);
+        printf("  interrupts %llu, DPCs %llu\n", (unsigned long long) DmaExt.IntsInLastSecond, (unsigned long long) DmaExt.DPCsInLastSecond);
+
+BenchS2CExit:
+        free(Bench.pFreeSlots);
+        free(Bench.pSgLists);
+        SimDmaExtDestroy(&DmaExt);
+        SimDeviceDestroy(pDev);
+        return status;
+}
+
+/*
+ * PACKET_RECEIVES loop, streaming (free run) or FIFO mode.
+ */
+static INT32 BenchC2S(PBENCH_CONFIG pConfig, BOOLEAN bFreeRun, PBENCH_RESULT pResult)
+{
+        PSIM_DEVICE pDev = NULL;
+        SIM_DMA_EXT DmaExt;
+        PPACKET_RECVS_STRUCT pPacketRecvs = NULL;
+        UINT64 Expected = pConfig->Link.C2SUserStatus;
+        UINT64 t0, t1;
+        UINT32 i;
+        INT32 status;
+
+        memset(pResult, 0, sizeof(BENCH_RESULT));
+
+        status = BenchCreate(pConfig, SIM_C2S_ENGINE, &pDev, &DmaExt);
+        if (status == SIM_STATUS_SUCCESS) {
+                pPacketRecvs = calloc(1, sizeof(PACKET_RECVS_STRUCT) + (pConfig->RxBatch * sizeof(PACKET_ENTRY_STRUCT)));
+                if (pPacketRecvs == NULL) {
+                        status = SIM_STATUS_NO_MEMORY;
+                }
+        }
+        if (status == SIM_STATUS_SUCCESS) {
+                DmaExt.bFreeRun = bFreeRun;
+                DmaExt.PacketMode = bFreeRun ? PACKET_MODE_STREAMING : PACKET_MODE_FIFO;
+                status = SimInitializeRxDescriptors(&DmaExt, SIM_BUFFER_PHYS_BASE, SIM_RX_VIRT_BASE, pConfig->RxDescBytes, PACKET_DMA_INT_CTRL_INT_EOP);
+        }
+        if (status != SIM_STATUS_SUCCESS) {
+                goto BenchC2SExit;
+        }
+
+        while (pResult->Packets < pConfig->Packets) {
+                pPacketRecvs->EngineNum = SIM_C2S_ENGINE;
+                pPacketRecvs->AvailNumEntries = (UINT16) pConfig->RxBatch;
+
+                t0 = SimHostNowNs();
+                status = SimPacketProcessCompletedFreeRunDescriptors(&DmaExt, pPacketRecvs);
+                t1 = SimHostNowNs();
+                pResult->SubmitNs += t1 - t0;
+                if (status != SIM_STATUS_SUCCESS) {
+                        // The card lapped the driver, resynchronize like the application would
+                        pResult->Errors++;
+                        status = SIM_STATUS_SUCCESS;
+                }
+
+                if (pPacketRecvs->EngineStatus & DMA_OVERRUN_ERROR) {
+                        pResult->Overruns++;
+                }
+                for (i = 0; i < pPacketRecvs->RetNumEntries; i++) {
+                        PPACKET_ENTRY_STRUCT pEntry = &pPacketRecvs->Packets[i];
+
+                        if (pEntry->Status != 0) {
+                                pResult->Errors++;
+                        }
+                        if (pEntry->UserStatus != Expected) {
+                                pResult->Lost += pEntry->UserStatus - Expected;
+                        }
+                        Expected = pEntry->UserStatus + 1;
+                        pResult->Bytes += pEntry->Length;
+                }
+                pResult->Packets += pPacketRecvs->RetNumEntries;
+
+                if (pPacketRecvs->RetNumEntries == 0) {
+                        // Poll again later
+                        BenchChargeHostTime(pDev, (t1 - t0) + pConfig->PollNs);
+                } else {
+                        BenchChargeHostTime(pDev, t1 - t0);
+                }
+
+                if (DmaExt.DpcPending) {
+                        t0 = SimHostNowNs();
+                        SimPacketC2SDpc(&DmaExt);
+                        t1 = SimHostNowNs();
+                        pResult->CompleteNs += t1 - t0;
+                        BenchChargeHostTime(pDev, t1 - t0);
+                }
+        }
+        pResult->SimNs = pDev->NowNs;
+        pResult->LinkNs = pDev->Engines[SIM_C2S_ENGINE].ActiveNs;
+        printf("C2S %-4s %llu packets x %u bytes, %u descriptors x %u bytes, %u per call\n", bFreeRun ? "str" : "fifo",
+               (unsigned long long) pResult->Packets, pConfig->PacketSize, pConfig->Descriptors, pConfig->RxDescBytes, pConfig->RxBatch);
+        printf("  interrupts %llu, DPCs %llu, overrun indications %llu, lost %llu, errors %llu\n", (unsigned long long) DmaExt.IntsInLastSecond,
+               (unsigned long long) DmaExt.DPCsInLastSecond, (unsigned long long) pResult->Overruns, (unsigned long long) pResult->Lost,
+               (unsigned long long) pResult->Errors);
+
+BenchC2SExit:
+        free(pPacketRecvs);
+        SimDmaExtDestroy(&DmaExt);
+        SimDeviceDestroy(pDev);
+        return status;
+}
+
+/*
+ * Descriptor programming alone: PacketRingProgramS2C fills the S2C ring from
+ * QueueDepth S/G lists in turn.  The engine never runs, the whole ring is
+ * retired by hand each time it is full.
+ */
+static INT32 BenchDesc(PBENCH_CONFIG pConfig, PBENCH_RESULT pResult)
+{
+        PSIM_DEVICE pDev = NULL;
+        SIM_DMA_EXT DmaExt;
+        PSIM_SG_LIST pSgLists = NULL;
+        UINT64 Descriptors = 0;
+        UINT64 t0, t1;
+        UINT32 Head;
+        UINT32 Slot = 0;
+        UINT32 i;
+        INT32 status;
+
+        memset(pResult, 0, sizeof(BENCH_RESULT));
+
+        status = BenchCreate(pConfig, SIM_S2C_ENGINE, &pDev, &DmaExt);
+        if (status == SIM_STATUS_SUCCESS) {
+                pSgLists = calloc(pConfig->QueueDepth, sizeof(SIM_SG_LIST));
+                if (pSgLists == NULL) {
+                        status = SIM_STATUS_NO_MEMORY;
+                }
+        }
+        if (status != SIM_STATUS_SUCCESS) {
+                goto BenchDescExit;
+        }
+        for (i = 0; i < pConfig->QueueDepth; i++) {
+                BenchBuildSgList(&pSgLists[i], i, pConfig->PacketSize, pConfig->ContiguousSends);
+        }
+        SimInitializeTxDescriptors(&DmaExt);
+
+        while (pResult->Packets < pConfig->Packets) {
+                Head = DmaExt.Ring.Head;
+                t0 = SimHostNowNs();
+                while ((pResult->Packets < pConfig->Packets) &&
+                       PACKET_RING_OK(PacketRingProgramS2C(&DmaExt.Ring, &DmaExt.pTransactionPool[Slot].Trans, pResult->Packets, 0, &pSgLists[Slot]))) {
+                        pResult->Packets++;
+                        pResult->Bytes += pConfig->PacketSize;
+                        Slot = ((Slot + 1) == pConfig->QueueDepth) ? 0 : (Slot + 1);
+                }
+                t1 = SimHostNowNs();
+                if (DmaExt.Ring.Head == Head) {
+                        status = SIM_STATUS_INTERNAL_ERROR;
+                        break;
+                }
+                pResult->SubmitNs += t1 - t0;
+                Descriptors += DmaExt.Ring.Head - Head;
+                // Stand in for PacketS2CDpc, every descriptor is free again
+                DmaExt.Ring.Tail = DmaExt.Ring.Head;
+        }
+        printf("Desc     %llu packets x %u bytes, %llu descriptors, %s pages\n", (unsigned long long) pResult->Packets, pConfig->PacketSize,
+               (unsigned long long) Descriptors, pConfig->ContiguousSends ? "contiguous" : "scattered");
+        printf("  %-22s %8.1f ns/desc %8.3f Mdesc/s\n", "descriptors", Descriptors ? (double) pResult->SubmitNs / Descriptors : 0.0,
+               pResult->SubmitNs ? (Descriptors * 1000.0) / pResult->SubmitNs : 0.0);
+
+BenchDescExit:
+        free(pSgLists);
+        SimDmaExtDestroy(&DmaExt);
+        SimDeviceDestroy(pDev);
+        return status;
+}
+
+static void BenchReport(PBENCH_RESULT pResult, const char *SubmitName, const char *CompleteName)
+{
+        double Packets = pResult->Packets ? (double) pResult->Packets : 1.0;
+        double DriverNs = (double) (pResult->SubmitNs + pResult->CompleteNs);
+        double SimSec = (double) pResult->SimNs / SIM_NSEC_PER_SEC;
+
+        printf("  %-22s %8.1f ns/pkt\n", SubmitName, pResult->SubmitNs / Packets);
+        if (CompleteName != NULL) {
+                printf("  %-22s %8.1f ns/pkt\n", CompleteName, pResult->CompleteNs / Packets);
+        }
+        printf("  %-22s %8.1f ns/pkt  %8.3f Mpkt/s host limited\n", "driver total", DriverNs / Packets, DriverNs ? (Packets * 1000.0) / DriverNs : 0.0);
+        if (SimSec > 0.0) {
+                printf("  %-22s %8.3f Mpkt/s  %8.1f MB/s, link busy %.1f%%\n", "simulated", (Packets / SimSec) / 1e6, ((double) pResult->Bytes / SimSec) / 1e6,
+                       (100.0 * pResult->LinkNs) / pResult->SimNs);
+        }
+}
+
+static void BenchUsage(const char *Name)
+{
+        printf("Usage: %s [options]\n", Name);
+        printf("  -m s2c|c2s|fifo|desc|all  benchmark to run (all), desc times descriptor programming alone\n");
+        printf("  -n packets           packets per benchmark (1000000)\n");
+        printf("  -s bytes             packet size (1024)\n");
+        printf("  -d descriptors       descriptors per engine, a power of two for s2c (8192)\n");
+        printf("  -q depth             S2C packets kept outstanding (256)\n");
+        printf("  -x bytes             C2S bytes per receive descriptor (4096)\n");
+        printf("  -r entries           C2S PACKET_RECVS entries per call (64)\n");
+        printf("  -b MB/s              link bandwidth (3200)\n");
+        printf("  -l ns                per descriptor latency (200)\n");
+        printf("  -p ns                C2S poll interval when nothing arrived (1000)\n");
+        printf("  -i ns                interrupt to DPC latency (2000)\n");
+        printf("  -t pool|create       S2C transactions from the pool or created per packet (pool)\n");
+        printf("  -c                   S2C buffers physically contiguous instead of scattered pages\n");
+        printf("  -g packets           S2C packets a doorbell write may be held back for in a burst (0)\n");
+}
+
+int main(int argc, char *argv[])
+{
+        BENCH_CONFIG Config;
+        BENCH_RESULT Result;
+        INT32 status = SIM_STATUS_SUCCESS;
+        int opt;
+
+        memset(&Config, 0, sizeof(Config));
+        Config.RunS2C = Config.RunC2S = Config.RunC2SFifo = Config.RunDesc = TRUE;
+        Config.Packets = 1000000;
+        Config.PacketSize = 1024;
+        Config.Descriptors = NUM_DESCRIPTORS_PER_ENGINE;
+        Config.QueueDepth = 256;
+        Config.RxDescBytes = SIM_PAGE_SIZE;
+        Config.RxBatch = 64;
+        Config.PollNs = 1000;
+        Config.DpcLatencyNs = 2000;
+        Config.Link.LinkBytesPerSec = 3200ULL * 1000000ULL;
+        Config.Link.DescLatencyNs = 200;
+        Config.Link.C2SUserStatus = 0x1000;
+
+        while ((opt = getopt(argc, argv, "m:n:s:d:q:x:r:b:l:p:i:t:cg:h")) != -1) {
+                switch (opt) {
+                case 'm':
+                        Config.RunS2C = (strcmp(optarg, "s2c") == 0) || (strcmp(optarg, "all") == 0);
+                        Config.RunC2S = (strcmp(optarg, "c2s") == 0) || (strcmp(optarg, "all") == 0);
+                        Config.RunC2SFifo = (strcmp(optarg, "fifo") == 0) || (strcmp(optarg, "all") == 0);
+                        Config.RunDesc = (strcmp(optarg, "desc") == 0) || (strcmp(optarg, "all") == 0);
+                        break;
+                case 'n':
+                        Config.Packets = strtoull(optarg, NULL, 0);
+                        break;
+                case 's':
+                        Config.PacketSize = (UINT32) strtoul(optarg, NULL, 0);
+                        break;
+                case 'd':
+                        Config.Descriptors = (UINT32) strtoul(optarg, NULL, 0);
+                        break;
+                case 'q':
+                        Config.QueueDepth = (UINT32) strtoul(optarg, NULL, 0);
+                        break;
+                case 'x':
+                        Config.RxDescBytes = (UINT32) strtoul(optarg, NULL, 0);
+                        break;
+                case 'r':
+                        Config.RxBatch = (UINT32) strtoul(optarg, NULL, 0);
+                        break;
+                case 'b':
+                        Config.Link.LinkBytesPerSec = strtoull(optarg, NULL, 0) * 1000000ULL;
+                        break;
+                case 'l':
+                        Config.Link.DescLatencyNs = (UINT32) strtoul(optarg, NULL, 0);
+                        break;
+                case 'p':
+                        Config.PollNs = (UINT32) strtoul(optarg, NULL, 0);
+                        break;
+                case 'i':
+                        Config.DpcLatencyNs = (UINT32) strtoul(optarg, NULL, 0);
+                        break;
+                case 't':
+                        Config.CreateTransactions = (strcmp(optarg, "create") == 0);
+                        break;
+                case 'c':
+                        Config.ContiguousSends = TRUE;
+                        break;
+                case 'g':
+                        Config.DoorbellBatch = (UINT32) strtoul(optarg, NULL, 0);
+                        break;
+                default:
+                        BenchUsage(argv[0]);
+                        return (opt == 'h') ? 0 : 1;
+                }
+        }
+        if ((Config.PacketSize == 0) || (Config.PacketSize > (SIM_MAX_SG_ELEMENTS * SIM_PAGE_SIZE)) || (Config.QueueDepth == 0) ||
+            (Config.RxBatch == 0) || (Config.RxBatch > 0xFFFF) || (Config.Link.LinkBytesPerSec == 0) ||
+            ((UINT64) Config.QueueDepth * ((Config.PacketSize + SIM_PAGE_SIZE - 1) / SIM_PAGE_SIZE) > Config.Descriptors) ||
+            ((Config.RunS2C || Config.RunDesc) && (Config.Descriptors != PacketRingSizeTx(Config.Descriptors)))) {
+                fprintf(stderr, "Invalid parameters\n");
+                BenchUsage(argv[0]);
+                return 1;
+        }
+
+        if (Config.RunS2C && (status == SIM_STATUS_SUCCESS)) {
+                status = BenchS2C(&Config, &Result);
+                if (status == SIM_STATUS_SUCCESS) {
+                        BenchReport(&Result, "PacketStartSend", "PacketS2CDpc");
+                }
+        }
+        if (Config.RunC2S && (status == SIM_STATUS_SUCCESS)) {
+                status = BenchC2S(&Config, TRUE, &Result);
+                if (status == SIM_STATUS_SUCCESS) {
+                        BenchReport(&Result, "ProcessCompletedFreeRun", "PacketC2SDpc");
+                }
+        }
+        if (Config.RunC2SFifo && (status == SIM_STATUS_SUCCESS)) {
+                status = BenchC2S(&Config, FALSE, &Result);
+                if (status == SIM_STATUS_SUCCESS) {
+                        BenchReport(&Result, "ProcessCompletedFreeRun", "PacketC2SDpc");
+                }
+        }
+        if (Config.RunDesc && (status == SIM_STATUS_SUCCESS)) {
+                status = BenchDesc(&Config, &Result);
+                if (status == SIM_STATUS_SUCCESS) {
+                        BenchReport(&Result, "PacketRingProgramS2C", NULL);
+                }
+        }
+        if (status != SIM_STATUS_SUCCESS) {
+                fprintf(stderr, "Benchmark failed, status %d\n", status);
+                return 1;
+        }
+        return 0;
+}
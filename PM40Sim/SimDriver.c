@@ -0,0 +1,352 @@
+// -------------------------------------------------------------------------
+//
+// PRODUCT:            DMA Driver
+// MODULE NAME:        SimDriver.c
+//
+// MODULE DESCRIPTION:
+//
+// Contains the host side of the packet DMA routines from PacketDMA.c and
+// PacketInit.c.  The descriptor programming and completion logic is the
+// driver's own PacketRing.c; the WDF calls around it (transactions,
+// requests, MDLs, spinlocks) are reduced to what the simulator needs.
+//
+// $Revision:  $
+//
+// ------------------------- CONFIDENTIAL ----------------------------------
+//
+//              Copyright (c) 2017 by Northwest Logic, Inc.
+//                       All rights reserved.
+//
+// Trade Secret of Northwest Logic, Inc.  Do not disclose.
+//
+// Use of this source code in any form or means is permitted only
+// with a valid, written license agreement with Northwest Logic, Inc.
+//
+// Licensee shall keep all information contained herein confidential
+// and shall protect same in whole or in part from disclosure and
+// dissemination to all third parties.
+//
+//
+//                        Northwest Logic, Inc.
+//                  1100 NW Compton Drive, Suite 100
+//                      Beaverton, OR 97006, USA
+//
+//                        Ph:  +1 503 533 5800
+//                        Fax: +1 503 533 5900
+//                      E-Mail: info@nwlogic.com
+//                           www.nwlogic.com
+//
+// -------------------------------------------------------------------------
+
+#include "SimDriver.h"
+
+/*
+ * Map a PacketRing.c return code to a simulator status, as PacketRingStatus does in the driver.
+ */
+static INT32 SimRingStatus(INT32 RingStatus)
+{
+        switch (RingStatus) {
+        case PACKET_RING_SUCCESS:
+                return SIM_STATUS_SUCCESS;
+        case PACKET_RING_INVALID_PARAMETER:
+                return SIM_STATUS_BAD_PARAMETER;
+        case PACKET_RING_INSUFFICIENT_RESOURCES:
+                return SIM_STATUS_INSUFFICIENT_RESOURCES;
+        default:
+                return SIM_STATUS_INTERNAL_ERROR;
+        }
+}
+
+/*! SimDmaExtCreate
+ *
+ * \brief Allocate the descriptor rings for one engine, as DMADriverInitDmaEngines does.
+ * \param pDev - Simulated card
+ * \param DmaEngine - DMA engine number
+ * \param NumberOfDescriptors - Ring size
+ * \param pDmaExt - Engine context to initialize
+ * \return SIM_STATUS_SUCCESS or an error
+ */
+INT32 SimDmaExtCreate(IN PSIM_DEVICE pDev, IN UINT32 DmaEngine, IN UINT32 NumberOfDescriptors, OUT PSIM_DMA_EXT pDmaExt)
+{
+        UINT32 i;
+
+        memset(pDmaExt, 0, sizeof(SIM_DMA_EXT));
+        if ((DmaEngine >= MAX_NUM_DMA_ENGINES) || (NumberOfDescriptors < MINIMUM_NUMBER_DESCRIPTORS)) {
+                return SIM_STATUS_BAD_PARAMETER;
+        }
+        pDmaExt->pDev = pDev;
+        pDmaExt->DmaEngine = DmaEngine;
+        pDmaExt->pDmaEng = &pDev->pRegs->dmaEngine[DmaEngine];
+        pDmaExt->Ring.pDmaEng = pDmaExt->pDmaEng;
+        pDmaExt->Ring.NumberOfDescriptors = NumberOfDescriptors;
+        pDmaExt->Ring.pHWDescriptorBase = SimAllocDescriptors(pDev, NumberOfDescriptors, &pDmaExt->Ring.pHWDescriptorBasePhysical);
+        pDmaExt->Ring.pDrvDescBase = calloc(NumberOfDescriptors, sizeof(DRIVER_DESC_STRUCT));
+        pDmaExt->pTransactionPool = calloc(NumberOfDescriptors, sizeof(SIM_DMA_XFER));
+        if ((pDmaExt->Ring.pHWDescriptorBase == NULL) || (pDmaExt->Ring.pDrvDescBase == NULL) || (pDmaExt->pTransactionPool == NULL)) {
+                SimDmaExtDestroy(pDmaExt);
+                return SIM_STATUS_NO_MEMORY;
+        }
+        for (i = 0; i < NumberOfDescriptors; i++) {
+                pDmaExt->pTransactionPool[i].pNextFree = pDmaExt->pFreeTransactions;
+                pDmaExt->pFreeTransactions = &pDmaExt->pTransactionPool[i];
+        }
+        return SimRingStatus(PacketRingInitialize(&pDmaExt->Ring, NumberOfDescriptors, 0));
+}
+
+/*! SimDmaExtDestroy
+ *
+ * \brief Free the driver descriptors of one engine.
+ * \param pDmaExt - Engine context
+ * \return none
+ */
+VOID SimDmaExtDestroy(IN PSIM_DMA_EXT pDmaExt)
+{
+        free(pDmaExt->pTransactionPool);
+        pDmaExt->pTransactionPool = NULL;
+        pDmaExt->pFreeTransactions = NULL;
+        free(pDmaExt->Ring.pDrvDescBase);
+        pDmaExt->Ring.pDrvDescBase = NULL;
+}
+
+/*
+ * Port of PacketGetTransaction, or of WdfDmaTransactionCreate when bCreateTransactions is set.
+ */
+static PSIM_DMA_XFER SimGetTransaction(PSIM_DMA_EXT pDmaExt)
+{
+        PSIM_DMA_XFER pDmaXfer;
+
+        if (pDmaExt->bCreateTransactions) {
+                // WDF zeroes the object context
+                return calloc(1, sizeof(SIM_DMA_XFER));
+        }
+        pDmaXfer = pDmaExt->pFreeTransactions;
+        if (pDmaXfer != NULL) {
+                pDmaExt->pFreeTransactions = pDmaXfer->pNextFree;
+        }
+        return pDmaXfer;
+}
+
+/*
+ * Port of PacketPutTransaction, or of WdfObjectDelete when bCreateTransactions is set.
+ */
+static VOID SimPutTransaction(PSIM_DMA_EXT pDmaExt, PSIM_DMA_XFER pDmaXfer)
+{
+        if (pDmaExt->bCreateTransactions) {
+                free(pDmaXfer);
+                return;
+        }
+        pDmaXfer->Request = NULL;
+        pDmaXfer->pNextFree = pDmaExt->pFreeTransactions;
+        pDmaExt->pFreeTransactions = pDmaXfer;
+}
+
+/*! SimInitializeTxDescriptors
+ *
+ * \brief Port of InitializeTxDescriptors.
+ * \param pDmaExt - Engine context
+ * \return SIM_STATUS_SUCCESS or an error
+ */
+INT32 SimInitializeTxDescriptors(IN PSIM_DMA_EXT pDmaExt)
+{
+        INT32 status;
+
+        status = SimRingStatus(PacketRingInitializeTx(&pDmaExt->Ring));
+        if (status == SIM_STATUS_SUCCESS) {
+                // Now enable the DMA Engine
+                pDmaExt->pDmaEng->ControlStatus = (COMMON_DMA_CTRL_IRQ_ENABLE | PACKET_DMA_CTRL_DMA_ENABLE);
+        }
+        return status;
+}
+
+/*! SimInitializeRxDescriptors
+ *
+ * \brief Port of InitializeRxDescriptors for
+ *  a physically contiguous receive pool, one descriptor per DescBytes.
+ * \param pDmaExt - Engine context, bFreeRun selects the streaming mode
+ * \param BufferPhys - Physical address of the receive pool
+ * \param BufferVirt - Address returned to the application for the pool
+ * \param DescBytes - Bytes per descriptor
+ * \param InterruptMode - InterruptControl value for FIFO mode
+ * \return SIM_STATUS_SUCCESS or an error
+ */
+INT32 SimInitializeRxDescriptors(IN PSIM_DMA_EXT pDmaExt, IN UINT64 BufferPhys, IN PUINT8 BufferVirt, IN UINT32 DescBytes, IN UINT32 InterruptMode)
+{
+        UINT32 descNum;
+        INT32 status = PACKET_RING_SUCCESS;
+
+        if ((DescBytes == 0) || (DescBytes > PACKET_DESC_BYTE_COUNT_MASK)) {
+                return SIM_STATUS_BAD_PARAMETER;
+        }
+
+        // Shutdown the DMA Engine
+        pDmaExt->pDmaEng->ControlStatus = 0;
+        pDmaExt->DMAEngineStatus = 0;
+
+        if (pDmaExt->bFreeRun) {
+                pDmaExt->pDmaEng->InterruptControl = 0;
+        } else {
+                // Default to EOP Interrupt mode
+                pDmaExt->pDmaEng->InterruptControl = InterruptMode;
+        }
+
+        PacketRingBeginRx(&pDmaExt->Ring);
+        for (descNum = 0; (descNum < pDmaExt->Ring.NumberOfDescriptors) && PACKET_RING_OK(status); descNum++) {
+                status = PacketRingAddRxDescriptor(&pDmaExt->Ring, BufferPhys + ((UINT64) descNum * DescBytes),
+                                                   DescBytes, BufferVirt + ((size_t) descNum * DescBytes), pDmaExt->bFreeRun);
+        }
+        if (!PACKET_RING_OK(status)) {
+                return SimRingStatus(status);
+        }
+        PacketRingEndRx(&pDmaExt->Ring, pDmaExt->bFreeRun);
+
+        // Now enable the DMA Engine
+        pDmaExt->pDmaEng->ControlStatus = (COMMON_DMA_CTRL_IRQ_ENABLE | PACKET_DMA_CTRL_DMA_ENABLE);
+        return SIM_STATUS_SUCCESS;
+}
+
+/*! SimDriverAckDmaInterrupt
+ *
+ * \brief Port of DMADriverAckDmaInterrupt.
+ * \param pDmaExt - Engine context
+ * \return none
+ */
+VOID SimDriverAckDmaInterrupt(IN PSIM_DMA_EXT pDmaExt)
+{
+        // Acknowledge interrupts for this DMA engine
+        SimWriteControlStatus(pDmaExt->pDev, pDmaExt->DmaEngine,
+                              pDmaExt->pDmaEng->ControlStatus | (COMMON_DMA_CTRL_IRQ_ACTIVE | COMMON_DMA_CTRL_IRQ_ENABLE | PACKET_DMA_CTRL_DMA_ENABLE));
+}
+
+/*! SimDriverIsr
+ *
+ * \brief Port of DMADriverHandleInterrupt, queues the DPC.
+ * \param pDmaExt - Engine context
+ * \return TRUE if the interrupt belongs to this engine
+ */
+BOOLEAN SimDriverIsr(IN PSIM_DMA_EXT pDmaExt)
+{
+        UINT32 Status;
+
+        Status = pDmaExt->pDmaEng->ControlStatus & (COMMON_DMA_CTRL_IRQ_ACTIVE | COMMON_DMA_CTRL_IRQ_ENABLE);
+
+        if (Status == (COMMON_DMA_CTRL_IRQ_ACTIVE | COMMON_DMA_CTRL_IRQ_ENABLE)) {
+                pDmaExt->IntsInLastSecond++;
+                pDmaExt->DpcPending = TRUE;
+                return TRUE;
+        }
+        return FALSE;
+}
+
+/*! SimPacketStartSend
+ *
+ * \brief Port of PacketStartSend and PacketProgramS2CDmaCallback, without
+ *  the MDL and the WDF request queue.
+ * \param pDmaExt - Engine context
+ * \param Request - Handed back to pfnSendComplete
+ * \param UserControl - User Control of the packet
+ * \param SgList - Scatter/Gather list of the packet
+ * \return SIM_STATUS_SUCCESS, SIM_STATUS_INSUFFICIENT_RESOURCES if the ring is full
+ */
+INT32 SimPacketStartSend(IN PSIM_DMA_EXT pDmaExt, IN PVOID Request, IN UINT64 UserControl, IN PSIM_SG_LIST SgList)
+{
+        PSIM_DMA_XFER pDmaXfer;
+        INT32 status;
+
+        pDmaXfer = SimGetTransaction(pDmaExt);
+        if (pDmaXfer == NULL) {
+                return SIM_STATUS_INSUFFICIENT_RESOURCES;
+        }
+        pDmaXfer->Request = Request;
+        pDmaXfer->Trans.CardOffset = 0;
+        pDmaXfer->Trans.PacketStatus = 0;
+        pDmaXfer->Trans.BytesTransfered = 0;
+
+        status = SimRingStatus(PacketRingProgramS2C(&pDmaExt->Ring, &pDmaXfer->Trans, UserControl, pDmaXfer->Trans.CardOffset, SgList));
+        if (status == SIM_STATUS_SUCCESS) {
+                pDmaExt->TimeoutCount = CARD_WATCHDOG_INTERVAL;
+        } else {
+                SimPutTransaction(pDmaExt, pDmaXfer);
+        }
+        return status;
+}
+
+/*! SimPacketFlushSends
+ *
+ * \brief Port of the end of a submit burst in PacketSubmitUnlock, hands
+ *  the engine the packets a Ring.DoorbellBatch held back.
+ * \param pDmaExt - Engine context
+ * \return none
+ */
+VOID SimPacketFlushSends(IN PSIM_DMA_EXT pDmaExt)
+{
+        PacketRingFlushDoorbell(&pDmaExt->Ring, FALSE);
+}
+
+/*
+ * PacketRingCompleteS2C callback, stands in for completing the WDF request.
+ */
+static VOID SimPacketS2CComplete(PVOID Context, PDMA_TRANSACTION_STRUCT pDmaTrans, UINT32 BytesTransferred, UINT32 PacketStatus)
+{
+        PSIM_DMA_EXT pDmaExt = (PSIM_DMA_EXT) Context;
+        PSIM_DMA_XFER pDmaXfer = (PSIM_DMA_XFER) pDmaTrans;
+
+        pDmaTrans->BytesTransfered = BytesTransferred;
+        pDmaTrans->PacketStatus = PacketStatus;
+        if (pDmaExt->pfnSendComplete != NULL) {
+                pDmaExt->pfnSendComplete(pDmaExt, pDmaXfer->Request, BytesTransferred, PacketStatus ? SIM_STATUS_HARDWARE_ERROR : SIM_STATUS_SUCCESS);
+        }
+        SimPutTransaction(pDmaExt, pDmaXfer);
+}
+
+/*! SimPacketS2CDpc
+ *
+ * \brief Port of PacketS2CDpc.  Completed packets are handed to pfnSendComplete.
+ * \param pDmaExt - Engine context
+ * \return none
+ */
+VOID SimPacketS2CDpc(IN PSIM_DMA_EXT pDmaExt)
+{
+        pDmaExt->DpcPending = FALSE;
+
+        // Inc the DPC Count
+        pDmaExt->DPCsInLastSecond++;
+
+        PacketRingCompleteS2C(&pDmaExt->Ring, SimPacketS2CComplete, pDmaExt);
+
+        SimDriverAckDmaInterrupt(pDmaExt);
+}
+
+/*! SimPacketC2SDpc
+ *
+ * \brief Port of PacketC2SDpc for the FIFO / streaming receive modes.
+ * \param pDmaExt - Engine context
+ * \return none
+ */
+VOID SimPacketC2SDpc(IN PSIM_DMA_EXT pDmaExt)
+{
+        pDmaExt->DpcPending = FALSE;
+
+        // Inc the DPC Count
+        pDmaExt->DPCsInLastSecond++;
+
+        if (pDmaExt->PacketMode == PACKET_MODE_STREAMING) {
+                pDmaExt->DMAEngineStatus |= DMA_OVERRUN_ERROR;
+        }
+
+        SimDriverAckDmaInterrupt(pDmaExt);
+}
+
+/*! SimPacketProcessCompletedFreeRunDescriptors
+ *
+ * \brief Port of PacketProcessCompletedFreeRunDescriptors.
+ * \param pDmaExt - Engine context
+ * \param pPacketRecvs - PACKET_RECVS_STRUCT to fill in
+ * \return SIM_STATUS_SUCCESS or an error
+ */
+INT32 SimPacketProcessCompletedFreeRunDescriptors(IN PSIM_DMA_EXT pDmaExt, IN PPACKET_RECVS_STRUCT pPacketRecvs)
+{
+        pPacketRecvs->EngineStatus = pDmaExt->DMAEngineStatus;
+        pDmaExt->DMAEngineStatus = 0;
+
+        return SimRingStatus(PacketRingProcessFreeRun(&pDmaExt->Ring, pPacketRecvs, (BOOLEAN) (pDmaExt->PacketMode == PACKET_MODE_FIFO)));
+}
@@ -0,0 +1,100 @@
+// -------------------------------------------------------------------------
+//
+// PRODUCT:            DMA Driver
+// MODULE NAME:        SimDriver.h
+//
+// MODULE DESCRIPTION:
+//
+// Driver side of the simulator: the per engine context and the glue
+// around the shared descriptor ring (PM40Driver/PacketRing.c), running
+// against the software model in SimEngine.c.
+//
+// $Revision:  $
+//
+// ------------------------- CONFIDENTIAL ----------------------------------
+//
+//              Copyright (c) 2017 by Northwest Logic, Inc.
+//                       All rights reserved.
+//
+// Trade Secret of Northwest Logic, Inc.  Do not disclose.
+//
+// Use of this source code in any form or means is permitted only
+// with a valid, written license agreement with Northwest Logic, Inc.
+//
+// Licensee shall keep all information contained herein confidential
+// and shall protect same in whole or in part from disclosure and
+// dissemination to all third parties.
+//
+//
+//                        Northwest Logic, Inc.
+//                  1100 NW Compton Drive, Suite 100
+//                      Beaverton, OR 97006, USA
+//
+//                        Ph:  +1 503 533 5800
+//                        Fax: +1 503 533 5900
+//                      E-Mail: info@nwlogic.com
+//                           www.nwlogic.com
+//
+// -------------------------------------------------------------------------
+
+#ifndef _SIM_DRIVER_H_
+#define _SIM_DRIVER_H_
+
+#include "SimEngine.h"
+#include "PacketRingPlatform.h"
+
+struct _SIM_DMA_EXT;
+
+//! Called by SimPacketS2CDpc in place of completing the WDF request.
+typedef VOID(*PSIM_SEND_COMPLETE) (struct _SIM_DMA_EXT * pDmaExt, PVOID Request, UINT32 BytesTransferred, INT32 Status);
+
+/*!
+ * \struct SIM_DMA_XFER
+ * \brief Stands in for a WDFDMATRANSACTION and its DMA_XFER context.
+ */
+typedef struct _SIM_DMA_XFER {
+        DMA_TRANSACTION_STRUCT Trans;   // Ring cookie, must be first
+        PVOID Request;
+        struct _SIM_DMA_XFER *pNextFree;
+} SIM_DMA_XFER, *PSIM_DMA_XFER;
+
+/*!
+ * \struct SIM_DMA_EXT
+ * \brief The DMA_ENGINE_DEVICE_EXTENSION fields used by the ring routines.
+ */
+typedef struct _SIM_DMA_EXT {
+        PSIM_DEVICE pDev;
+        UINT32 DmaEngine;
+        PDMA_ENGINE_STRUCT pDmaEng;
+        PACKET_RING Ring;               // Descriptor ring, see PacketRing.c
+        UINT32 TimeoutCount;
+        UINT32 PacketMode;
+        BOOLEAN bFreeRun;
+        UINT16 DMAEngineStatus;
+        // Performance counters
+        UINT64 IntsInLastSecond;
+        UINT64 DPCsInLastSecond;
+        // Stands in for WdfDpcEnqueue
+        BOOLEAN DpcPending;
+        PSIM_SEND_COMPLETE pfnSendComplete;
+        PVOID Context;
+        // Pre-created transactions, see DmaDriverCreateTransactionPool
+        PSIM_DMA_XFER pTransactionPool;
+        PSIM_DMA_XFER pFreeTransactions;
+        BOOLEAN bCreateTransactions;    // Allocate and free a transaction per packet instead
+} SIM_DMA_EXT, *PSIM_DMA_EXT;
+
+// SimDriver.c Prototypes
+INT32 SimDmaExtCreate(IN PSIM_DEVICE pDev, IN UINT32 DmaEngine, IN UINT32 NumberOfDescriptors, OUT PSIM_DMA_EXT pDmaExt);
+VOID SimDmaExtDestroy(IN PSIM_DMA_EXT pDmaExt);
+INT32 SimInitializeTxDescriptors(IN PSIM_DMA_EXT pDmaExt);
+INT32 SimInitializeRxDescriptors(IN PSIM_DMA_EXT pDmaExt, IN UINT64 BufferPhys, IN PUINT8 BufferVirt, IN UINT32 DescBytes, IN UINT32 InterruptMode);
+BOOLEAN SimDriverIsr(IN PSIM_DMA_EXT pDmaExt);
+VOID SimDriverAckDmaInterrupt(IN PSIM_DMA_EXT pDmaExt);
+INT32 SimPacketStartSend(IN PSIM_DMA_EXT pDmaExt, IN PVOID Request, IN UINT64 UserControl, IN PSIM_SG_LIST SgList);
+VOID SimPacketFlushSends(IN PSIM_DMA_EXT pDmaExt);
+VOID SimPacketS2CDpc(IN PSIM_DMA_EXT pDmaExt);
+VOID SimPacketC2SDpc(IN PSIM_DMA_EXT pDmaExt);
+INT32 SimPacketProcessCompletedFreeRunDescriptors(IN PSIM_DMA_EXT pDmaExt, IN PPACKET_RECVS_STRUCT pPacketRecvs);
+
+#endif                          // _SIM_DRIVER_H_
@@ -0,0 +1,429 @@
+// -------------------------------------------------------------------------
+//
+// PRODUCT:            DMA Driver
+// MODULE NAME:        SimEngine.c
+//
+// MODULE DESCRIPTION:
+//
+// Contains the software model of the packet DMA engine: the register
+// semantics of DMA_ENGINE_STRUCT / DMA_COMMON_CONTROL_STRUCT and the
+// S2C / C2S descriptor ring walk.
+//
+// $Revision:  $
+//
+// ------------------------- CONFIDENTIAL ----------------------------------
+//
+//              Copyright (c) 2017 by Northwest Logic, Inc.
+//                       All rights reserved.
+//
+// Trade Secret of Northwest Logic, Inc.  Do not disclose.
+//
+// Use of this source code in any form or means is permitted only
+// with a valid, written license agreement with Northwest Logic, Inc.
+//
+// Licensee shall keep all information contained herein confidential
+// and shall protect same in whole or in part from disclosure and
+// dissemination to all third parties.
+//
+//
+//                        Northwest Logic, Inc.
+//                  1100 NW Compton Drive, Suite 100
+//                      Beaverton, OR 97006, USA
+//
+//                        Ph:  +1 503 533 5800
+//                        Fax: +1 503 533 5900
+//                      E-Mail: info@nwlogic.com
+//                           www.nwlogic.com
+//
+// -------------------------------------------------------------------------
+
+#include "SimEngine.h"
+
+/*! \note Register model
+ *
+ *  The engine processes the descriptor at NextDescriptorPtr as long as
+ *  NextDescriptorPtr != SoftwareDescriptorPtr and DMA_ENABLE is set.  After a
+ *  descriptor completes, its status is written back, CompletedDescriptorPtr
+ *  is set to it and NextDescriptorPtr follows its NextDescriptorPhys link.
+ *  Writing SoftwareDescriptorPtr = 0 (free run) never matches a descriptor so
+ *  the engine loops around the ring forever.
+ *
+ *  COMMON_DMA_CTRL_IRQ_ACTIVE is write one to clear.  Since the register image
+ *  is plain host memory, writes to ControlStatus that must honor that
+ *  semantic go through SimWriteControlStatus().  While IRQ_ACTIVE is set
+ *  further completions do not assert the interrupt again.
+ */
+
+#define SIM_CTRL_WRITABLE_BITS      (COMMON_DMA_CTRL_IRQ_ENABLE | PACKET_DMA_CTRL_DMA_ENABLE)
+
+/*
+ * Common Control status bit for this engine.
+ */
+static inline UINT32 SimCommonIrqBit(PSIM_ENGINE pEng)
+{
+        return pEng->CardToSystem ? (1U << (24 + (pEng->EngineNum & 7))) : (1U << (16 + (pEng->EngineNum & 7)));
+}
+
+/*
+ * Translate a descriptor physical address into the host descriptor window.
+ */
+static PDMA_DESCRIPTOR_STRUCT SimMapDescriptor(PSIM_DEVICE pDev, UINT32 Phys)
+{
+        UINT32 Offset;
+
+        if ((Phys < SIM_DESC_PHYS_BASE) || (Phys & (DMA_DESCR_ALIGN_LEN - 1))) {
+                return NULL;
+        }
+        Offset = Phys - SIM_DESC_PHYS_BASE;
+        if ((Offset + sizeof(DMA_DESCRIPTOR_STRUCT)) > pDev->DescWindowUsed) {
+                return NULL;
+        }
+        return (PDMA_DESCRIPTOR_STRUCT) (pDev->pDescWindow + Offset);
+}
+
+/*
+ * Latch the per second statistics registers the driver watchdog reads.
+ */
+static void SimEngineLatchStats(PSIM_DEVICE pDev, PSIM_ENGINE pEng, PDMA_ENGINE_STRUCT pRegs)
+{
+        while ((pDev->NowNs - pEng->SecondStartNs) >= SIM_NSEC_PER_SEC) {
+                if (pEng->SecondActiveNs > SIM_NSEC_PER_SEC) {
+                        pEng->SecondActiveNs = SIM_NSEC_PER_SEC;
+                }
+                pRegs->DMAActiveTime = (UINT32) (pEng->SecondActiveNs / 4);
+                pRegs->DMAWaitTime = (UINT32) ((SIM_NSEC_PER_SEC - pEng->SecondActiveNs) / 4);
+                pRegs->DMACompletedByteCount = (UINT32) (pEng->SecondBytes / 4);
+                pEng->SecondActiveNs = 0;
+                pEng->SecondBytes = 0;
+                pEng->SecondStartNs += SIM_NSEC_PER_SEC;
+        }
+}
+
+/*
+ * Assert the engine interrupt.  Returns TRUE if a new interrupt was delivered.
+ */
+static BOOLEAN SimRaiseInterrupt(PSIM_DEVICE pDev, PSIM_ENGINE pEng, PDMA_ENGINE_STRUCT pRegs)
+{
+        if (pRegs->ControlStatus & COMMON_DMA_CTRL_IRQ_ACTIVE) {
+                // Still pending, the completion is picked up by the outstanding DPC.
+                return FALSE;
+        }
+        pRegs->ControlStatus |= COMMON_DMA_CTRL_IRQ_ACTIVE;
+        pDev->pRegs->commonControl.ControlStatus |= SimCommonIrqBit(pEng);
+        pEng->Interrupts++;
+
+        if ((pRegs->ControlStatus & COMMON_DMA_CTRL_IRQ_ENABLE) && (pDev->pRegs->commonControl.ControlStatus & CARD_IRQ_ENABLE) && (pDev->Isr != NULL)) {
+                pDev->Isr(pDev->IsrContext, pEng->EngineNum);
+        }
+        return TRUE;
+}
+
+/*
+ * Number of bytes the next descriptor will move.
+ */
+static UINT32 SimDescriptorBytes(PSIM_ENGINE pEng, PDMA_DESCRIPTOR_STRUCT pHWDesc)
+{
+        UINT32 Capacity = pHWDesc->S2C.ControlFlags_ByteCount & PACKET_DESC_BYTE_COUNT_MASK;
+        UINT32 Remaining;
+
+        if (!pEng->CardToSystem) {
+                return Capacity;
+        }
+        Remaining = pEng->C2SRemaining ? pEng->C2SRemaining : pEng->Config.C2SPacketSize;
+        return (Remaining < Capacity) ? Remaining : Capacity;
+}
+
+/*
+ * Complete the descriptor at NextDescriptorPtr.  Returns TRUE if an interrupt was delivered.
+ */
+static BOOLEAN SimCompleteDescriptor(PSIM_DEVICE pDev, PSIM_ENGINE pEng, PDMA_ENGINE_STRUCT pRegs, PDMA_DESCRIPTOR_STRUCT pHWDesc, UINT32 Bytes, UINT64 CostNs)
+{
+        UINT32 Control = pHWDesc->S2C.ControlFlags_ByteCount;
+        UINT32 Status = PACKET_DESC_S2C_STAT_COMPLETE | Bytes;
+        BOOLEAN EndOfPacket;
+        BOOLEAN Irq;
+
+        if (pEng->CardToSystem) {
+                if (pEng->C2SRemaining == 0) {
+                        pEng->C2SRemaining = pEng->Config.C2SPacketSize;
+                        Status |= PACKET_DESC_C2S_STAT_START_OF_PACKET;
+                }
+                pEng->C2SRemaining -= Bytes;
+                EndOfPacket = (pEng->C2SRemaining == 0);
+                if (EndOfPacket) {
+                        Status |= PACKET_DESC_C2S_STAT_END_OF_PACKET;
+                        if (Bytes < (Control & PACKET_DESC_BYTE_COUNT_MASK)) {
+                                Status |= PACKET_DESC_C2S_STAT_SHORT;
+                        }
+                        pHWDesc->C2S.UserStatus = pEng->Config.C2SUserStatus + pEng->Packets;
+                }
+        } else {
+                EndOfPacket = (Control & PACKET_DESC_S2C_CTRL_END_OF_PACKET) ? TRUE : FALSE;
+        }
+        pHWDesc->S2C.StatusFlags_BytesCompleted = Status;
+
+        pRegs->CompletedDescriptorPtr = pRegs->NextDescriptorPtr;
+        pRegs->NextDescriptorPtr = pHWDesc->S2C.NextDescriptorPhys;
+        pRegs->ControlStatus |= PACKET_DMA_CTRL_DESC_COMPLETE;
+
+        pEng->Descriptors++;
+        pEng->Bytes += Bytes;
+        pEng->ActiveNs += CostNs;
+        pEng->SecondActiveNs += CostNs;
+        pEng->SecondBytes += Bytes;
+        if (EndOfPacket) {
+                pEng->Packets++;
+        }
+        SimEngineLatchStats(pDev, pEng, pRegs);
+
+        // In EOP interrupt mode only an EOP descriptor can interrupt.
+        Irq = (Control & PACKET_DESC_S2C_CTRL_IRQ_ON_COMPLETE) ? TRUE : FALSE;
+        if ((pRegs->InterruptControl & PACKET_DMA_INT_CTRL_INT_EOP) && !EndOfPacket) {
+                Irq = FALSE;
+        }
+        return Irq ? SimRaiseInterrupt(pDev, pEng, pRegs) : FALSE;
+}
+
+/*! SimDeviceCreate
+ *
+ * \brief Allocate a simulated card with a descriptor window of the given size.
+ * \param ppDev - Returned device
+ * \param DescWindowSize - Bytes of descriptor memory
+ * \return SIM_STATUS_SUCCESS or an error
+ */
+INT32 SimDeviceCreate(OUT PSIM_DEVICE * ppDev, IN UINT32 DescWindowSize)
+{
+        PSIM_DEVICE pDev;
+
+        *ppDev = NULL;
+        if ((DescWindowSize == 0) || (DescWindowSize > (0xFFFFFFFF - SIM_DESC_PHYS_BASE))) {
+                return SIM_STATUS_BAD_PARAMETER;
+        }
+        pDev = calloc(1, sizeof(SIM_DEVICE));
+        if (pDev == NULL) {
+                return SIM_STATUS_NO_MEMORY;
+        }
+        pDev->pRegs = calloc(1, sizeof(BAR0_REGISTER_MAP_STRUCT));
+        pDev->pDescWindow = aligned_alloc(4096, (DescWindowSize + 4095) & ~4095U);
+        if ((pDev->pRegs == NULL) || (pDev->pDescWindow == NULL)) {
+                SimDeviceDestroy(pDev);
+                return SIM_STATUS_NO_MEMORY;
+        }
+        memset(pDev->pDescWindow, 0, DescWindowSize);
+        pDev->DescWindowSize = DescWindowSize;
+        *ppDev = pDev;
+        return SIM_STATUS_SUCCESS;
+}
+
+/*! SimDeviceDestroy
+ *
+ * \brief Free a simulated card.
+ * \param pDev - Device from SimDeviceCreate
+ * \return none
+ */
+VOID SimDeviceDestroy(IN PSIM_DEVICE pDev)
+{
+        if (pDev != NULL) {
+                free(pDev->pDescWindow);
+                free(pDev->pRegs);
+                free(pDev);
+        }
+}
+
+/*! SimDeviceSetIsr
+ *
+ * \brief Register the routine called when an engine asserts its interrupt.
+ * \param pDev - Device
+ * \param Isr - Interrupt routine
+ * \param Context - Passed to Isr
+ * \return none
+ */
+VOID SimDeviceSetIsr(IN PSIM_DEVICE pDev, IN PSIM_ISR_ROUTINE Isr, IN PVOID Context)
+{
+        pDev->Isr = Isr;
+        pDev->IsrContext = Context;
+}
+
+/*! SimEngineAdd
+ *
+ * \brief Make a DMA engine present and set its Capabilities register.
+ *  Engines 0-31 are System to Card, 32-63 are Card to System.
+ * \param pDev - Device
+ * \param EngineNum - DMA engine (register block) number
+ * \param pConfig - Link model for this engine
+ * \return SIM_STATUS_SUCCESS or an error
+ */
+INT32 SimEngineAdd(IN PSIM_DEVICE pDev, IN UINT32 EngineNum, IN PSIM_ENGINE_CONFIG pConfig)
+{
+        PSIM_ENGINE pEng;
+        PDMA_ENGINE_STRUCT pRegs;
+
+        if ((EngineNum >= MAX_NUM_DMA_ENGINES) || pDev->Engines[EngineNum].Present || (pConfig->LinkBytesPerSec == 0)) {
+                return SIM_STATUS_BAD_PARAMETER;
+        }
+        pEng = &pDev->Engines[EngineNum];
+        pRegs = &pDev->pRegs->dmaEngine[EngineNum];
+
+        memset(pEng, 0, sizeof(SIM_ENGINE));
+        pEng->Present = TRUE;
+        pEng->EngineNum = EngineNum;
+        pEng->CardToSystem = (EngineNum >= (MAX_NUM_DMA_ENGINES / 2));
+        pEng->Config = *pConfig;
+        if (pEng->CardToSystem && (pEng->Config.C2SPacketSize == 0)) {
+                return SIM_STATUS_BAD_PARAMETER;
+        }
+        pEng->Idle = TRUE;
+        pEng->BusyUntilNs = pDev->NowNs;
+        pEng->SecondStartNs = pDev->NowNs;
+
+        pRegs->Capabilities = DMA_CAP_ENGINE_PRESENT | DMA_CAP_PACKET_DMA |
+            (pEng->CardToSystem ? DMA_CAP_CARD_TO_SYSTEM : DMA_CAP_SYSTEM_TO_CARD) |
+            ((EngineNum << DMA_CAP_ENGINE_NUMBER_SHIFT_SIZE) & DMA_CAP_ENGINE_NUMBER_MASK) | (36 << DMA_CAP_CARD_ADDR_SIZE_SHIFT);
+        pRegs->ControlStatus = 0;
+
+        pDev->EngineList[pDev->NumEngines++] = EngineNum;
+        return SIM_STATUS_SUCCESS;
+}
+
+/*! SimAllocDescriptors
+ *
+ * \brief Carve a descriptor array out of the descriptor window.
+ * \param pDev - Device
+ * \param Count - Number of DMA_DESCRIPTOR_STRUCTs
+ * \param pPhys - Returned physical address of the first descriptor
+ * \return host address of the first descriptor, NULL if the window is full
+ */
+PVOID SimAllocDescriptors(IN PSIM_DEVICE pDev, IN UINT32 Count, OUT UINT32 * pPhys)
+{
+        UINT32 Offset = DMA_DESCR_ALIGN_PHYS_ADDR(pDev->DescWindowUsed);
+        UINT64 Size = (UINT64) Count * sizeof(DMA_DESCRIPTOR_STRUCT);
+
+        if ((Count == 0) || ((Offset + Size) > pDev->DescWindowSize)) {
+                return NULL;
+        }
+        pDev->DescWindowUsed = Offset + (UINT32) Size;
+        *pPhys = SIM_DESC_PHYS_BASE + Offset;
+        return pDev->pDescWindow + Offset;
+}
+
+/*! SimWriteControlStatus
+ *
+ * \brief Write an engine ControlStatus register with hardware semantics:
+ *  IRQ_ACTIVE is write one to clear, a reset request resets the engine,
+ *  status bits are read only.
+ * \param pDev - Device
+ * \param EngineNum - DMA engine number
+ * \param Value - Value written by the driver
+ * \return none
+ */
+VOID SimWriteControlStatus(IN PSIM_DEVICE pDev, IN UINT32 EngineNum, IN UINT32 Value)
+{
+        PSIM_ENGINE pEng = &pDev->Engines[EngineNum];
+        PDMA_ENGINE_STRUCT pRegs = &pDev->pRegs->dmaEngine[EngineNum];
+        UINT32 Current = pRegs->ControlStatus;
+
+        if (Value & (PACKET_DMA_CTRL_DMA_RESET_REQUEST | PACKET_DMA_CTRL_DMA_RESET)) {
+                pRegs->ControlStatus = 0;
+                pEng->C2SRemaining = 0;
+                pEng->Idle = TRUE;
+                pEng->BusyUntilNs = pDev->NowNs;
+                pDev->pRegs->commonControl.ControlStatus &= ~SimCommonIrqBit(pEng);
+                return;
+        }
+        if (Value & COMMON_DMA_CTRL_IRQ_ACTIVE) {
+                Current &= ~COMMON_DMA_CTRL_IRQ_ACTIVE;
+                pDev->pRegs->commonControl.ControlStatus &= ~SimCommonIrqBit(pEng);
+        }
+        pRegs->ControlStatus = (Current & ~SIM_CTRL_WRITABLE_BITS) | (Value & SIM_CTRL_WRITABLE_BITS);
+}
+
+/*! SimDeviceRun
+ *
+ * \brief Advance simulated time, completing every descriptor whose
+ *  completion time is <= UntilNs.
+ * \param pDev - Device
+ * \param UntilNs - Simulated time to run to, SIM_TIME_INFINITE runs until
+ *  all engines are idle (or the first interrupt if StopOnInterrupt)
+ * \param StopOnInterrupt - Return as soon as an interrupt is delivered
+ * \return number of interrupts delivered
+ *
+ * \note A free running C2S engine is never idle, do not call with
+ *  SIM_TIME_INFINITE and StopOnInterrupt FALSE in that case.
+ */
+UINT32 SimDeviceRun(IN PSIM_DEVICE pDev, IN UINT64 UntilNs, IN BOOLEAN StopOnInterrupt)
+{
+        UINT32 Interrupts = 0;
+        UINT32 i;
+
+        for (;;) {
+                PSIM_ENGINE pBest = NULL;
+                PDMA_DESCRIPTOR_STRUCT pBestDesc = NULL;
+                UINT64 BestDoneNs = SIM_TIME_INFINITE;
+                UINT64 BestCostNs = 0;
+                UINT32 BestBytes = 0;
+
+                // Find the engine with the earliest descriptor completion
+                for (i = 0; i < pDev->NumEngines; i++) {
+                        PSIM_ENGINE pEng = &pDev->Engines[pDev->EngineList[i]];
+                        PDMA_ENGINE_STRUCT pRegs = &pDev->pRegs->dmaEngine[pEng->EngineNum];
+                        PDMA_DESCRIPTOR_STRUCT pHWDesc;
+                        UINT64 StartNs;
+                        UINT64 CostNs;
+                        UINT32 Bytes;
+
+                        if (!(pRegs->ControlStatus & PACKET_DMA_CTRL_DMA_ENABLE) || (pRegs->NextDescriptorPtr == pRegs->SoftwareDescriptorPtr)) {
+                                pRegs->ControlStatus &= ~PACKET_DMA_CTRL_DMA_RUNNING;
+                                pEng->Idle = TRUE;
+                                continue;
+                        }
+                        if (pEng->Idle) {
+                                // New work, the engine starts on it now
+                                pEng->Idle = FALSE;
+                                pEng->BusyUntilNs = pDev->NowNs;
+                        }
+                        pHWDesc = SimMapDescriptor(pDev, pRegs->NextDescriptorPtr);
+                        if (pHWDesc == NULL) {
+                                // Bad descriptor pointer, the engine stops with a fetch error
+                                pRegs->ControlStatus &= ~(PACKET_DMA_CTRL_DMA_ENABLE | PACKET_DMA_CTRL_DMA_RUNNING);
+                                pRegs->ControlStatus |= PACKET_DMA_CTRL_DESC_FETCH_ERROR;
+                                if (SimRaiseInterrupt(pDev, pEng, pRegs)) {
+                                        Interrupts++;
+                                        if (StopOnInterrupt) {
+                                                return Interrupts;
+                                        }
+                                }
+                                continue;
+                        }
+                        pRegs->ControlStatus |= PACKET_DMA_CTRL_DMA_RUNNING;
+
+                        Bytes = SimDescriptorBytes(pEng, pHWDesc);
+                        CostNs = pEng->Config.DescLatencyNs + (((UINT64) Bytes * SIM_NSEC_PER_SEC) / pEng->Config.LinkBytesPerSec);
+                        StartNs = pEng->BusyUntilNs;
+                        if ((StartNs + CostNs) < BestDoneNs) {
+                                pBest = pEng;
+                                pBestDesc = pHWDesc;
+                                BestDoneNs = StartNs + CostNs;
+                                BestCostNs = CostNs;
+                                BestBytes = Bytes;
+                        }
+                }
+
+                if ((pBest == NULL) || (BestDoneNs > UntilNs)) {
+                        break;
+                }
+
+                pDev->NowNs = BestDoneNs;
+                pBest->BusyUntilNs = BestDoneNs;
+                if (SimCompleteDescriptor(pDev, pBest, &pDev->pRegs->dmaEngine[pBest->EngineNum], pBestDesc, BestBytes, BestCostNs)) {
+                        Interrupts++;
+                        if (StopOnInterrupt) {
+                                return Interrupts;
+                        }
+                }
+        }
+
+        if ((UntilNs != SIM_TIME_INFINITE) && (pDev->NowNs < UntilNs)) {
+                pDev->NowNs = UntilNs;
+        }
+        return Interrupts;
+}
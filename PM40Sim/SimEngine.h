@@ -0,0 +1,128 @@
+// -------------------------------------------------------------------------
+//
+// PRODUCT:            DMA Driver
+// MODULE NAME:        SimEngine.h
+//
+// MODULE DESCRIPTION:
+//
+// Software model of the Northwest Logic packet DMA engine.  The BAR0
+// register map lives in host memory and is accessed by the driver code
+// exactly as it would access the card.  Descriptors are allocated from a
+// host memory window that is given a 32 bit "physical" address so the
+// NextDescriptorPhys links can be followed by the model.
+//
+// $Revision:  $
+//
+// ------------------------- CONFIDENTIAL ----------------------------------
+//
+//              Copyright (c) 2017 by Northwest Logic, Inc.
+//                       All rights reserved.
+//
+// Trade Secret of Northwest Logic, Inc.  Do not disclose.
+//
+// Use of this source code in any form or means is permitted only
+// with a valid, written license agreement with Northwest Logic, Inc.
+//
+// Licensee shall keep all information contained herein confidential
+// and shall protect same in whole or in part from disclosure and
+// dissemination to all third parties.
+//
+//
+//                        Northwest Logic, Inc.
+//                  1100 NW Compton Drive, Suite 100
+//                      Beaverton, OR 97006, USA
+//
+//                        Ph:  +1 503 533 5800
+//                        Fax: +1 503 533 5900
+//                      E-Mail: info@nwlogic.com
+//                           www.nwlogic.com
+//
+// -------------------------------------------------------------------------
+
+#ifndef _SIM_ENGINE_H_
+#define _SIM_ENGINE_H_
+
+#include "SimHost.h"
+
+//! Physical address given to the first byte of the descriptor window
+#define SIM_DESC_PHYS_BASE          0x10000000
+//! "Run until something happens" time limit for SimDeviceRun
+#define SIM_TIME_INFINITE           (~0ULL)
+
+#define SIM_STATUS_SUCCESS          0
+#define SIM_STATUS_BAD_PARAMETER    -1
+#define SIM_STATUS_NO_MEMORY        -2
+#define SIM_STATUS_INSUFFICIENT_RESOURCES -3
+#define SIM_STATUS_HARDWARE_ERROR   -4
+#define SIM_STATUS_INTERNAL_ERROR   -5
+
+/*!
+ * \brief Called when an engine asserts its interrupt.  Runs synchronously
+ *  from SimDeviceRun, the same way the driver ISR runs on the card's MSI.
+ */
+typedef VOID(*PSIM_ISR_ROUTINE) (PVOID Context, UINT32 EngineNum);
+
+/*!
+ * \struct SIM_ENGINE_CONFIG
+ * \brief Per engine link model.  Each descriptor costs DescLatencyNs plus
+ *  its byte count at LinkBytesPerSec; descriptors of one engine are
+ *  processed back to back.
+ */
+typedef struct _SIM_ENGINE_CONFIG {
+        UINT64 LinkBytesPerSec;         // Payload bandwidth of the modeled link
+        UINT32 DescLatencyNs;           // Descriptor fetch and status write back latency
+        UINT32 C2SPacketSize;           // Size of the packets generated by a C2S engine
+        UINT64 C2SUserStatus;           // Base UserStatus reported in the EOP descriptor
+} SIM_ENGINE_CONFIG, *PSIM_ENGINE_CONFIG;
+
+/*!
+ * \struct SIM_ENGINE
+ * \brief Model state behind one DMA_ENGINE_STRUCT register block.
+ */
+typedef struct _SIM_ENGINE {
+        BOOLEAN Present;
+        BOOLEAN CardToSystem;
+        UINT32 EngineNum;
+        SIM_ENGINE_CONFIG Config;
+        BOOLEAN Idle;                   // No descriptor was available at the last look
+        UINT64 BusyUntilNs;             // Completion time of the last descriptor
+        UINT32 C2SRemaining;            // Bytes left in the C2S packet being generated
+        // Statistics
+        UINT64 Descriptors;             // Descriptors completed
+        UINT64 Packets;                 // EOP descriptors completed
+        UINT64 Bytes;                   // Bytes moved
+        UINT64 Interrupts;              // Interrupts asserted
+        UINT64 ActiveNs;                // Time spent moving descriptors
+        // Per second register latch (DMAActiveTime, DMAWaitTime, DMACompletedByteCount)
+        UINT64 SecondStartNs;
+        UINT64 SecondActiveNs;
+        UINT64 SecondBytes;
+} SIM_ENGINE, *PSIM_ENGINE;
+
+/*!
+ * \struct SIM_DEVICE
+ * \brief One simulated card.
+ */
+typedef struct _SIM_DEVICE {
+        PBAR0_REGISTER_MAP_STRUCT pRegs;        // BAR0 image
+        PUINT8 pDescWindow;                     // Host memory behind SIM_DESC_PHYS_BASE
+        UINT32 DescWindowSize;
+        UINT32 DescWindowUsed;
+        UINT64 NowNs;                           // Simulated time
+        PSIM_ISR_ROUTINE Isr;
+        PVOID IsrContext;
+        UINT32 NumEngines;                      // Number of entries in EngineList
+        UINT32 EngineList[MAX_NUM_DMA_ENGINES]; // Engines added with SimEngineAdd
+        SIM_ENGINE Engines[MAX_NUM_DMA_ENGINES];
+} SIM_DEVICE, *PSIM_DEVICE;
+
+// SimEngine.c Prototypes
+INT32 SimDeviceCreate(OUT PSIM_DEVICE * ppDev, IN UINT32 DescWindowSize);
+VOID SimDeviceDestroy(IN PSIM_DEVICE pDev);
+VOID SimDeviceSetIsr(IN PSIM_DEVICE pDev, IN PSIM_ISR_ROUTINE Isr, IN PVOID Context);
+INT32 SimEngineAdd(IN PSIM_DEVICE pDev, IN UINT32 EngineNum, IN PSIM_ENGINE_CONFIG pConfig);
+PVOID SimAllocDescriptors(IN PSIM_DEVICE pDev, IN UINT32 Count, OUT UINT32 * pPhys);
+VOID SimWriteControlStatus(IN PSIM_DEVICE pDev, IN UINT32 EngineNum, IN UINT32 Value);
+UINT32 SimDeviceRun(IN PSIM_DEVICE pDev, IN UINT64 UntilNs, IN BOOLEAN StopOnInterrupt);
+
+#endif                          // _SIM_ENGINE_H_
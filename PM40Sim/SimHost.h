@@ -0,0 +1,95 @@
+// -------------------------------------------------------------------------
+//
+// PRODUCT:            DMA Driver
+// MODULE NAME:        SimHost.h
+//
+// MODULE DESCRIPTION:
+//
+// Host (user space) environment for the packet DMA engine simulator.
+// Supplies the handful of Linux kernel types that the non-Windows half
+// of DmaDriverHw.h refers to, so the simulator can share the register
+// and descriptor definitions with the drivers unchanged.
+//
+// $Revision:  $
+//
+// ------------------------- CONFIDENTIAL ----------------------------------
+//
+//              Copyright (c) 2017 by Northwest Logic, Inc.
+//                       All rights reserved.
+//
+// Trade Secret of Northwest Logic, Inc.  Do not disclose.
+//
+// Use of this source code in any form or means is permitted only
+// with a valid, written license agreement with Northwest Logic, Inc.
+//
+// Licensee shall keep all information contained herein confidential
+// and shall protect same in whole or in part from disclosure and
+// dissemination to all third parties.
+//
+//
+//                        Northwest Logic, Inc.
+//                  1100 NW Compton Drive, Suite 100
+//                      Beaverton, OR 97006, USA
+//
+//                        Ph:  +1 503 533 5800
+//                        Fax: +1 503 533 5900
+//                      E-Mail: info@nwlogic.com
+//                           www.nwlogic.com
+//
+// -------------------------------------------------------------------------
+
+#ifndef _SIM_HOST_H_
+#define _SIM_HOST_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Kernel types referenced by DMA_TRANSACTION_STRUCT, never used by the simulator.
+struct list_head {
+        struct list_head *next;
+        struct list_head *prev;
+};
+typedef struct {
+        int Unused;
+} wait_queue_head_t;
+struct page;
+struct scatterlist;
+
+#ifndef MAX_NUM_DMA_ENGINES
+#define MAX_NUM_DMA_ENGINES        64
+#endif                          // MAX_NUM_DMA_ENGINES
+
+#include "StdTypes.h"
+#include "DmaDriverHw.h"
+#include "DmaDriverIoctl.h"
+
+#ifndef IN
+#define IN
+#endif                          // IN
+#ifndef OUT
+#define OUT
+#endif                          // OUT
+
+#ifndef UNREFERENCED_PARAMETER
+#define UNREFERENCED_PARAMETER(P)  ((void)(P))
+#endif                          // UNREFERENCED_PARAMETER
+
+#define SIM_NSEC_PER_SEC           1000000000ULL
+
+/*! SimHostNowNs
+ *
+ * \brief Host monotonic clock, used to time the driver side routines.
+ * \return nanoseconds
+ */
+static inline UINT64 SimHostNowNs(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((UINT64) ts.tv_sec * SIM_NSEC_PER_SEC) + (UINT64) ts.tv_nsec;
+}
+
+#endif                          // _SIM_HOST_H_